@@ -0,0 +1,54 @@
+#ifndef GPX_ARENA_H
+#define GPX_ARENA_H
+
+#include "GPXParser.h"
+
+/* Region allocator backing documents created with GPX_OPT_ARENA.  Memory is carved out of large chunks
+   and is only released all at once by deleteGPXArena, so a whole GPXdoc costs a handful of mallocs to
+   build and a handful of frees to delete.  Internal to the parser. */
+
+typedef struct gpxArena GPXArena;
+
+/** Function to create an empty arena.
+ *@return the new arena, or NULL if malloc fails
+ *@param chunkSize - size in bytes of each chunk; 0 selects a default suited to large documents
+**/
+GPXArena* createGPXArena(size_t chunkSize);
+
+//Frees every chunk of the arena, and the arena itself
+void deleteGPXArena(GPXArena* arena);
+
+//Allocates size bytes aligned for any type.  Returns NULL if malloc fails
+void* arenaAlloc(GPXArena* arena, size_t size);
+
+//Copies str into the arena.  Returns NULL if malloc fails
+char* arenaStrdup(GPXArena* arena, const char* str);
+
+//Moves every chunk of from into arena and frees from.  Memory allocated from either stays valid until
+//arena is deleted
+void mergeGPXArena(GPXArena* arena, GPXArena* from);
+
+//Total number of chunks, and of bytes handed out, for diagnostics
+size_t getArenaChunkCount(const GPXArena* arena);
+size_t getArenaBytesUsed(const GPXArena* arena);
+
+//Memory taken from malloc by the arena, including unused space at the end of its chunks
+size_t getArenaBytesReserved(const GPXArena* arena);
+
+/* Arena versions of the GPXHelpers.h constructors.  The objects, their names and their lists all live
+   in the arena.  The lists use a no-op deleteData, since their contents are freed with the arena. */
+List* createArenaList(GPXArena* arena, char* (*printFunction)(void* toBePrinted), int (*compareFunction)(const void* first, const void* second));
+GPXData* createArenaGPXData(GPXArena* arena, const char* name, const char* value);
+GPXData* createArenaGPXDataRecord(GPXArena* arena, const char* name, const char* value);
+Waypoint* createArenaWaypoint(GPXArena* arena);
+Route* createArenaRoute(GPXArena* arena);
+TrackSegment* createArenaTrackSegment(GPXArena* arena);
+Track* createArenaTrack(GPXArena* arena);
+
+//Creates an empty document that owns arena.  deleteGPXdoc on the result deletes the arena
+GPXdoc* createArenaGPXdoc(GPXArena* arena);
+
+//Appends data to an arena list, allocating the Node from the arena.  Returns false if malloc fails
+bool arenaInsertBack(GPXArena* arena, List* list, void* data);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef GPX_BATCH_H
+#define GPX_BATCH_H
+
+#include "GPXParser.h"
+
+/* Parsing many GPX files at once.  The files are parsed with createGPXdocWithOptions on a pool of
+   worker threads; a thread that finishes its share early takes files from the others, so a few very
+   large files do not leave the rest of the threads idle.
+
+   libxml2 is initialized (LIBXML_TEST_VERSION and xmlInitParser) the first time a batch is parsed,
+   exactly once per process, before any worker starts.  Call xmlCleanupParser once, at the end of the
+   program, after the last batch has finished - never while a batch is running. */
+
+//Outcome of parsing one file
+typedef enum {
+    GPX_BATCH_OK,
+    //The file does not exist or could not be opened
+    GPX_BATCH_UNREADABLE,
+    //The file was read but is not a valid GPX file, or memory ran out while parsing it
+    GPX_BATCH_INVALID
+} GPXBatchStatus;
+
+typedef struct {
+    //The parsed document, or NULL if status is not GPX_BATCH_OK.  Owned by the caller
+    GPXdoc* doc;
+    GPXBatchStatus status;
+} GPXBatchResult;
+
+/** Function to parse a list of GPX files in parallel.
+ *@pre fileNames holds numFiles file names
+ *@post results[i] describes fileNames[i]
+ *@return an array of numFiles results, to be freed with deleteGPXBatch, or NULL if numFiles < 1 or
+ *        malloc fails
+ *@param fileNames - the files to parse
+ *@param numFiles - number of files
+ *@param options - GPX_OPT_* flags passed to createGPXdocWithOptions for every file
+ *@param numThreads - number of threads to use; 0 or less means one per online processor
+**/
+GPXBatchResult* parseGPXBatch(char** fileNames, int numFiles, unsigned int options, int numThreads);
+
+//Deletes every document in a batch and the results array.  Safe to call with NULL
+void deleteGPXBatch(GPXBatchResult* results, int numFiles);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef GPX_CACHE_H
+#define GPX_CACHE_H
+
+#include <stdint.h>
+#include "GPXParser.h"
+
+/* A cache of parsed GPX files, meant to be created once and shared by every thread of a process.
+   getCachedGPXdoc returns a frozen document (see freezeGPXdoc) for a file, parsing it only when the
+   cache has no document for it yet.  An entry is keyed by the file's path together with its device,
+   inode, size and modification time, which are checked with stat on every lookup: once the file is
+   replaced or rewritten the old document is dropped and the file is parsed again.
+
+   The cache keeps the least recently used documents within a byte budget, measured with
+   estimateGPXdocSize.  Evicting a document only gives up the cache's own reference, so documents
+   still held by readers stay valid until they are released.
+
+   libxml2 is initialized the first time a file is parsed, as for parseGPXBatch.  Call xmlCleanupParser
+   only after the last lookup has finished. */
+
+typedef struct gpxCache GPXCache;
+
+//Counters for monitoring a cache.  hits + misses is the number of successful and failed lookups
+typedef struct {
+    //Lookups answered from the cache, and lookups that had to parse the file
+    uint64_t hits;
+    uint64_t misses;
+    //Documents dropped to stay within the budget, and documents dropped because their file changed
+    uint64_t evictions;
+    uint64_t invalidations;
+    //Documents currently held and their estimated size
+    int numDocs;
+    size_t bytesUsed;
+    size_t byteBudget;
+} GPXCacheStats;
+
+/** Function to create a cache of parsed documents.
+ *@return the new cache, or NULL if malloc fails
+ *@param byteBudget - largest total estimated size of the documents kept.  A document larger than the
+ *                    whole budget is returned to the caller but not kept
+ *@param options - GPX_OPT_* flags passed to createGPXdocWithOptions when a file is parsed
+**/
+GPXCache* createGPXCache(size_t byteBudget, unsigned int options);
+
+//Releases every document held by a cache and frees it.  Documents retained by callers stay valid.
+//No other thread may be using the cache.  Safe to call with NULL
+void deleteGPXCache(GPXCache* cache);
+
+/** Function to get the document for a GPX file, from the cache if the file has not changed since it was
+ * parsed.  Safe to call from any number of threads at once.
+ *@pre cache is not NULL
+ *@post The document may have been added to the cache, and other documents evicted
+ *@return a frozen document holding a reference for the caller, who gives it up with releaseGPXdoc;
+ *        NULL if the file cannot be read, is not a valid GPX file, or memory ran out
+ *@param cache - the cache
+ *@param fileName - the GPX file
+**/
+GPXdoc* getCachedGPXdoc(GPXCache* cache, const char* fileName);
+
+//Releases every document held by the cache.  The counters are kept
+void clearGPXCache(GPXCache* cache);
+
+//Copies the counters of a cache into stats
+void getGPXCacheStats(GPXCache* cache, GPXCacheStats* stats);
+
+//Estimated number of bytes of memory a document uses, including allocator overhead and its name index.
+//Returns 0 for NULL
+size_t estimateGPXdocSize(const GPXdoc* doc);
+
+#endif
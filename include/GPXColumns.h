@@ -0,0 +1,68 @@
+#ifndef GPX_COLUMNS_H
+#define GPX_COLUMNS_H
+
+#include "GPXParser.h"
+
+/* Columnar (structure-of-arrays) view of the points of a TrackSegment or Route.  Coordinates are
+   stored in contiguous arrays so that distance, bounds and resampling code can walk them without
+   chasing a Node and a Waypoint pointer per point. */
+
+//A point that has a name or GPXData other than <ele> and <time>
+typedef struct {
+    //Index of the point in the columns
+    int index;
+
+    //Point name.  Never NULL.  May be an empty string
+    const char* name;
+
+    //The point's otherData list (all of it, including <ele> and <time>)
+    List* otherData;
+} GPXSparsePoint;
+
+typedef struct {
+    //Number of points
+    int count;
+
+    //Coordinates in decimal degrees, count entries each
+    double* latitude;
+    double* longitude;
+
+    //Value of <ele> per point, or NAN where a point has none.  NULL if no point has an elevation
+    double* elevation;
+
+    //Value of <time> per point in milliseconds since the Unix epoch, or GPX_NO_TIME where a point has none.
+    //NULL if no point has a time
+    long long* time;
+
+    //Side storage for the few points that carry more than coordinates, in increasing index order
+    int numSparse;
+    GPXSparsePoint* sparse;
+} GPXColumns;
+
+/** Function to build the columnar view of a list of Waypoints.
+ *@pre waypoints is a valid list of Waypoint
+ *@post The list has not been modified.  The columns reference the names and otherData lists of the
+ *      waypoints, so they must be deleted before the waypoints are.
+ *@return the new columns, or NULL if malloc fails
+ *@param waypoints - the list to convert
+**/
+GPXColumns* createColumns(List* waypoints);
+
+//Convenience wrappers around createColumns
+GPXColumns* createSegmentColumns(const TrackSegment* seg);
+GPXColumns* createRouteColumns(const Route* rte);
+
+//Frees the columns.  The waypoints they were built from are not affected
+void deleteColumns(GPXColumns* columns);
+
+/** Function to look up the side data of a point.
+ *@return the point's sparse record, or NULL if the point has no name and no data besides <ele> and <time>
+ *@param columns - the columns to search
+ *@param index - the point index, 0 <= index < count
+**/
+const GPXSparsePoint* getSparsePoint(const GPXColumns* columns, int index);
+
+//Returns the name of a point, or an empty string if it has none
+const char* getColumnName(const GPXColumns* columns, int index);
+
+#endif
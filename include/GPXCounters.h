@@ -0,0 +1,24 @@
+#ifndef GPX_COUNTERS_H
+#define GPX_COUNTERS_H
+
+#include "GPXParser.h"
+
+/* Aggregate counts behind getNumSegments and getNumGPXData.  The document registers itself as the
+   observer of its lists and of every list reachable from them, so the counts in the GPXdoc follow each
+   insert and removal made through the List API, whether by the parser or by the caller.  An element
+   is counted when it becomes reachable from the document, and its own lists are observed from then on.
+   Internal to the parser. */
+
+//Starts maintaining the counts of doc.  Called once, when the document's lists have been created
+void attachGPXCounters(GPXdoc* doc);
+
+//Stops maintaining the counts of doc, so that tearing the document down does not update them
+void detachGPXCounters(GPXdoc* doc);
+
+//Recomputes the number of track segments by walking the document
+int countGPXSegments(const GPXdoc* doc);
+
+//Recomputes the number of GPXData elements by walking the document
+int countGPXData(const GPXdoc* doc);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef GPX_DISTANCE_H
+#define GPX_DISTANCE_H
+
+#include "GPXParser.h"
+#include "GPXColumns.h"
+
+/* Great-circle distances.  All lengths are in metres on a sphere of radius EARTH_RADIUS.
+
+   Path lengths are computed by a haversine kernel that processes batches of consecutive point pairs
+   with AVX2 when the CPU supports it, checked once at run time, and by a scalar loop otherwise.  An SSE2
+   kernel is kept for comparison; with two lanes it is not reliably faster than the scalar loop.  The vector
+   kernels agree with haversineDistance to within a few units in the last place per pair for latitudes
+   in [-90, 90]. */
+
+//Mean radius of the Earth in metres
+#define EARTH_RADIUS 6371000.0
+
+//Scalar reference: distance between two points given in decimal degrees
+double haversineDistance(double lat1, double lon1, double lat2, double lon2);
+
+/** Function to compute the length of a path.
+ *@pre latitude and longitude hold count entries each, in decimal degrees
+ *@return the sum of the distances between consecutive points, or 0 if count < 2
+ *@param latitude - point latitudes
+ *@param longitude - point longitudes
+ *@param count - number of points
+**/
+double getPathLength(const double* latitude, const double* longitude, int count);
+
+//Same as getPathLength, using haversineDistance for every pair.  Used to check the vector kernels
+double getPathLengthScalar(const double* latitude, const double* longitude, int count);
+
+//Name of the kernel getPathLength uses on this machine: "avx2" or "scalar"
+const char* getPathLengthKernel(void);
+
+/** Function to compute the length of a path with a given kernel, to check and time the kernels against each other.
+ *@return the same as getPathLength, or NAN if kernel is not one of the names below or cannot run on this machine
+ *@param kernel - "avx2", "sse2" or "scalar"
+ *@param latitude - point latitudes
+ *@param longitude - point longitudes
+ *@param count - number of points
+**/
+double getPathLengthWithKernel(const char* kernel, const double* latitude, const double* longitude, int count);
+
+//Length of the path through the points of a GPXColumns view
+double getColumnsLength(const GPXColumns* columns);
+
+//Length of the path through the waypoints of a route.  Returns 0 if rt is NULL
+float getRouteLen(const Route* rt);
+
+//Length of the path through the waypoints of a track segment.  Returns 0 if seg is NULL
+float getSegmentLen(const TrackSegment* seg);
+
+//Length of a track: the lengths of its segments plus the distance from the last point of each segment
+//to the first point of the next one.  Returns 0 if tr is NULL
+float getTrackLen(const Track* tr);
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef GPX_HELPERS_H
+#define GPX_HELPERS_H
+
+#include <libxml/xmlreader.h>
+#include "GPXParser.h"
+#include "StringBuilder.h"
+
+//Internal helpers shared by the GPX*.c modules.  These are not part of the public parser API.
+
+/** Function to duplicate a string on the heap.
+ *@pre str is not NULL
+ *@return a newly allocated copy of str, or NULL if malloc fails
+ *@param str - the string to copy
+**/
+char* gpxStrdup(const char* str);
+
+/** Function to allocate an array that may be empty.
+ *@post Room for count + 1 elements is allocated, so that an empty array does not depend on malloc(0)
+ *@return the uninitialized array, or NULL if malloc fails or the size overflows
+ *@param count - number of elements
+ *@param elemSize - size of one element
+**/
+void* gpxAllocArray(size_t count, size_t elemSize);
+
+/* Constructors for the model structs.  Every name is initialized to an empty string and every list
+   is allocated and empty, so the results already satisfy the "must not be NULL" rules in GPXParser.h.
+   Each one returns NULL if malloc fails. */
+Waypoint* createWaypoint(void);
+Route* createRoute(void);
+TrackSegment* createTrackSegment(void);
+Track* createTrack(void);
+GPXdoc* createEmptyGPXdoc(void);
+
+//Same as createGPXData, for the compact form of GPX_OPT_SHARED_NAMES (see GPXNames.h)
+GPXData* createGPXDataRecord(const char* name, const char* value);
+
+/** Function to replace a heap-allocated name field with a copy of a new value.
+ *@return true on success, false if malloc fails (the old name is kept)
+ *@param field - address of the name field (e.g. &wpt->name)
+ *@param value - the new name
+**/
+bool setGPXName(char** field, const char* value);
+
+/** Function to parse a required decimal attribute such as lat, lon or version, or an <ele> value.
+ * Accepts what strtod accepts in the C locale, whatever the program's locale, and gives the same
+ * correctly rounded result.  Plain decimals of up to 19 significant digits are converted without strtod.
+ *@return true if str holds a complete number, false otherwise
+ *@param str - the attribute text, may be NULL
+ *@param result - set to the parsed value on success
+**/
+bool parseGPXDouble(const char* str, double* result);
+
+/* Format a number with the fewest significant digits that read back as the same value: 15 or 17 for a
+   double, 6 to 9 for a float.  The C locale is used whatever locale the program has set, so the decimal
+   point is always '.', as XML attributes and JSON need.  size should be at least 32 */
+void formatGPXDouble(char* buf, size_t size, double value);
+void formatGPXFloat(char* buf, size_t size, float value);
+
+/** Function to decode an ISO-8601 <time> value such as 2020-09-13T12:26:40.5Z: a date and time with
+ * optional fractional seconds (rounded to the millisecond) and an optional Z or +hh:mm offset.  Values
+ * without a zone are taken as UTC.
+ *@return true if str is a complete timestamp of a valid date and time, false otherwise.  result is
+ *        not changed on failure
+ *@param str - the element text, may be NULL
+ *@param result - set to milliseconds since the Unix epoch (UTC) on success
+**/
+bool parseGPXTime(const char* str, long long* result);
+
+/** Function to decode a waypoint child into its typed field (time, elevation, satellites, hdop, vdop, pdop
+ * or speed).  Only the first valid occurrence of each child is decoded.
+ *@post The field and its GPX_FIELD_* bit are set when true is returned
+ *@return true if the child was stored in a typed field, false if it has none, the field is already set or
+ *        the value does not decode
+ *@param wpt - the waypoint being parsed
+ *@param name - the child's element name
+ *@param value - the child's text
+**/
+bool setWaypointField(Waypoint* wpt, const char* name, const char* value);
+
+//Initializes libxml2 (LIBXML_TEST_VERSION and xmlInitParser) once per process.  Must be called before
+//parsing on several threads
+void initGPXLibxml(void);
+
+/** Function to build a document by streaming it from a reader (defined in GPXStream.c).
+ *@post reader has been freed
+ *@return the new document, or NULL if reader is NULL or the input is not a valid GPX file
+ *@param reader - a reader at the start of the input
+ *@param options - GPX_OPT_ARENA selects arena allocation, GPX_OPT_NODE_POOL gives a heap document a node pool and
+ *                 GPX_OPT_TYPED_ONLY is honoured; other flags are ignored
+**/
+GPXdoc* buildGPXdoc(xmlTextReaderPtr reader, unsigned int options);
+
+/** Function to stream the children of another <gpx> element into an existing document (defined in GPXStream.c).
+ * The attributes of the input's root are ignored.  With continueDepth 1 the input's first <trk> continues
+ * the last track of doc instead of adding a track, and with 2 the first <trkseg> of that <trk> also
+ * continues the track's last segment.  New objects are allocated like the rest of doc, from its arena or
+ * node pool if it has one.  The input is read into lists of its own first, which are only linked into
+ * doc once all of it has been read.
+ *@pre doc is not frozen
+ *@post reader has been freed.  On failure doc is unchanged, though an arena keeps what was allocated
+ *@return true on success, false if reader is NULL, the input is not a valid GPX file, the track or
+ *        segment to continue does not exist, or malloc fails
+ *@param reader - a reader at the start of the input
+ *@param doc - the document to add to
+ *@param continueDepth - 0, 1 or 2, as above
+ *@param options - GPX_OPT_TYPED_ONLY is honoured; other flags are ignored
+**/
+bool appendGPXdoc(xmlTextReaderPtr reader, GPXdoc* doc, int continueDepth, unsigned int options);
+
+/** Function to read the points of a route, or the segments of a track, into an element that was built
+ * without them (defined in GPXStream.c).  The input is a <gpx> element whose first child is the <rte> or
+ * <trk>; the element's other children are skipped, since they have already been read.  New objects are
+ * allocated like the rest of doc.
+ *@pre doc is not frozen
+ *@post reader has been freed.  On failure the element is unchanged, though an arena keeps what was allocated
+ *@return true on success, false if reader is NULL, the input is not a valid GPX file, its first child is
+ *        not of the element's kind, or malloc fails
+ *@param reader - a reader at the start of the input
+ *@param doc - the document that holds the element
+ *@param rte - the route to read into, or NULL to read into trk
+ *@param trk - the track to read into when rte is NULL
+ *@param options - GPX_OPT_TYPED_ONLY is honoured; other flags are ignored
+**/
+bool readGPXPoints(xmlTextReaderPtr reader, GPXdoc* doc, Route* rte, Track* trk, unsigned int options);
+
+/* ******************************* File mapping *************************** */
+
+//A file mapped read-only into memory
+typedef struct {
+    const char* data;
+    size_t size;
+} MappedFile;
+
+/** Function to map a whole file read-only, advising the kernel that it will be read sequentially.
+ *@return true on success; false if the file cannot be opened, is empty or cannot be mapped
+ *@param fileName - the file to map
+ *@param file - receives the mapping
+**/
+bool mapGPXFile(const char* fileName, MappedFile* file);
+
+//Unmaps a file mapped with mapGPXFile
+void unmapGPXFile(MappedFile* file);
+
+/* ******************************* xmlTextReader helpers *************************** */
+
+/** Function to read the text content of the element the reader is positioned on, including the text of
+ * any descendants (the same result as xmlNodeGetContent on the DOM path).
+ *@post the reader is positioned on the element's end tag
+ *@return true on success, false on a parse error or malloc failure
+ *@param reader - a reader positioned on an element start tag
+ *@param buf - replaced with the element text
+**/
+bool readElementText(xmlTextReaderPtr reader, StringBuilder* buf);
+
+/** Function to iterate over the direct children of an element.
+ *@return 1 after advancing to the next child element, 0 once the parent's end tag is reached,
+ *        or -1 on a parse error
+ *@param reader - a reader positioned on the parent or one of its children
+ *@param parentDepth - the depth of the parent element
+**/
+int nextChildElement(xmlTextReaderPtr reader, int parentDepth);
+
+//Skips the subtree of the element the reader is positioned on.  Returns false on a parse error
+bool skipElement(xmlTextReaderPtr reader);
+
+//Returns true if the reader is positioned on a node with the given local name
+bool localNameIs(xmlTextReaderPtr reader, const char* name);
+
+//Reads input until the end of the document.  Returns false if the remaining input is not well-formed
+bool finishReading(xmlTextReaderPtr reader);
+
+#endif
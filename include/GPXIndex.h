@@ -0,0 +1,43 @@
+#ifndef GPX_INDEX_H
+#define GPX_INDEX_H
+
+#include "GPXParser.h"
+
+/* Name lookup tables behind getWaypoint, getRoute and getTrack.  Each table maps a name to the first
+   entity in its list with that name, and is built on first use.  Every table remembers the length,
+   head and tail of the list it was built from and is rebuilt when they change, or when the document's
+   list observers report an insert or removal.  Internal to the parser. */
+
+typedef struct gpxNameIndex GPXNameIndex;
+
+//Which list of the document a lookup applies to
+typedef enum {
+    INDEX_WAYPOINTS,
+    INDEX_ROUTES,
+    INDEX_TRACKS
+} GPXIndexKind;
+
+/** Function to find the first entity with a given name in one of the document's lists.
+ * Lists shorter than a small threshold are searched linearly without building a table.
+ *@pre doc and name are not NULL
+ *@post doc->nameIndex may have been created or rebuilt
+ *@return the first Waypoint, Route or Track with this name, or NULL if there is none
+ *@param doc - the document to search
+ *@param kind - the list to search
+ *@param name - the name to look for
+**/
+void* findByName(GPXdoc* doc, GPXIndexKind kind, const char* name);
+
+//Builds every table that findByName would use.  Returns false if malloc fails
+bool buildNameIndex(GPXdoc* doc);
+
+//Forces the table for one list to be rebuilt on the next lookup.  Safe to call with NULL
+void markNameIndexStale(GPXNameIndex* index, GPXIndexKind kind);
+
+//Bytes allocated for an index.  Safe to call with NULL
+size_t getNameIndexSize(const GPXNameIndex* index);
+
+//Frees an index.  Safe to call with NULL
+void deleteNameIndex(GPXNameIndex* index);
+
+#endif
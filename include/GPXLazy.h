@@ -0,0 +1,95 @@
+#ifndef GPX_LAZY_H
+#define GPX_LAZY_H
+
+#include "GPXParser.h"
+
+/* Lazy documents, created by createGPXdocWithOptions with GPX_OPT_LAZY.
+
+   The file is first scanned as raw bytes, which finds every <rte> and <trk> and counts their points,
+   their segments and the GPXData of their points.  Only the rest of the document is parsed: waypoints,
+   and the names and otherData of routes and tracks.  The waypoints list of each route and the segments
+   list of each track start out empty, and are read from the file the first time they are used:
+
+   - the first List API call on one of those lists - createIterator, getLength, getFromFront and the
+     others, see setListFill - loads the element first, so routeToString, getRouteLen, createColumns and
+     every other function that walks an element's lists see its points.  Reading the head, tail or
+     length fields of the List directly does not load it;
+   - getRoute and getTrack load the element they return, and return NULL if it fails to load.
+     nextGPXRoute and nextGPXTrack load the element they step to.  loadGPXRoute and loadGPXTrack load
+     an element explicitly and report whether it loaded;
+   - getNumWaypoints, getNumRoutes, getNumTracks, getNumSegments and getNumGPXData, and the counts
+     below, never load;
+   - functions that read the whole document load all of it first: freezeGPXdoc, GPXdocToString, the
+     writers, the snapshot writer, the tile writer, updateGPXBounds, getGPXdocBounds and
+     createSpatialIndex.
+
+   An element that fails to load keeps empty lists, and the next use of them tries again.  The bounds
+   of an element are empty until it is loaded.
+
+   The document keeps the file open until every element has been loaded.  The file must not be changed
+   in the meantime: a load fails when the size or modification time of the file differ from when the
+   document was created.  Errors in the points of an element are only found when it is loaded.  Loading
+   modifies the document, so a lazy document must not be read from several threads until it has been
+   loaded or frozen. */
+
+/** Function to read the points of a route that has not been loaded.
+ *@pre doc is not frozen.  rte is in doc->routes
+ *@post rte holds its points
+ *@return true if the route is loaded, false if the file could not be read, has changed or holds invalid points,
+ *        or malloc fails.  A route that fails to load is left without points and is read again by the next call
+ *@param doc - the document
+ *@param rte - the route
+**/
+bool loadGPXRoute(GPXdoc* doc, Route* rte);
+
+//Same as loadGPXRoute, for a track and its segments
+bool loadGPXTrack(GPXdoc* doc, Track* trk);
+
+/** Function to load every route and track of a document that has not been loaded yet, and close its file.
+ *@return true if the whole document is loaded, which includes a document that was not created with
+ *        GPX_OPT_LAZY, false if an element failed to load
+ *@param doc - the document
+**/
+bool loadGPXdoc(GPXdoc* doc);
+
+//Returns true if doc has routes or tracks that are still to be loaded
+bool isGPXdocLazy(const GPXdoc* doc);
+
+//Counts of a route or track, without loading it.  The same as walking its lists when it is loaded
+int getRouteNumPoints(const GPXdoc* doc, const Route* rte);
+int getTrackNumPoints(const GPXdoc* doc, const Track* trk);
+int getTrackNumSegments(const GPXdoc* doc, const Track* trk);
+
+/* Iteration over doc->routes and doc->tracks that loads each element before returning it.  iter is
+   created with createIterator.  Returns NULL at the end of the list; an element that fails to load is
+   still returned, without its points. */
+Route* nextGPXRoute(GPXdoc* doc, ListIterator* iter);
+Track* nextGPXTrack(GPXdoc* doc, ListIterator* iter);
+
+/* ******************************* Parser internals *************************** */
+
+/** Function to create a lazy document (defined in GPXLazy.c).  Files the scan cannot split are parsed
+ * whole with the other options, as are files without routes or tracks with points.
+ *@return the new document, or NULL if the file cannot be read or is not a valid GPX file
+ *@param fileName - the file
+ *@param options - GPX_OPT_ARENA, GPX_OPT_TYPED_ONLY, GPX_OPT_NODE_POOL and GPX_OPT_SHARED_NAMES are honoured,
+ *                 and apply to the elements loaded later
+**/
+GPXdoc* createLazyGPXdoc(const char* fileName, unsigned int options);
+
+//Segments of the tracks of doc that are still to be loaded, for getNumSegments
+int getLazySegmentCount(const GPXdoc* doc);
+
+//GPXData of the points of the routes and tracks of doc that are still to be loaded, for getNumGPXData
+int getLazyGPXDataCount(const GPXdoc* doc);
+
+//Returns true if element is a route or track of doc that is still to be loaded.  Does not load it
+bool isLazyElementPending(const GPXdoc* doc, const void* element);
+
+//Called when an element leaves doc->routes or doc->tracks: it is no longer loaded from the file
+void forgetLazyElement(GPXdoc* doc, const void* element);
+
+//Closes the file of a lazy document and frees the state kept for loading.  Safe to call with NULL
+void deleteGPXLazy(struct gpxLazy* lazy);
+
+#endif
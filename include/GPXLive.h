@@ -0,0 +1,73 @@
+#ifndef GPX_LIVE_H
+#define GPX_LIVE_H
+
+#include "GPXParser.h"
+
+/* Following a GPX file while another program is still writing it, such as the log of a tracker.
+
+   openGPXLiveFile parses what has been written so far, and updateGPXLiveFile brings the document up to
+   date after the file has grown.  Only the new bytes are parsed: points are added to the last segment
+   of the last track, and new segments, tracks, waypoints and routes are added to the document, so the
+   parsing done by an update is in proportion to what was appended, not to the size of the file.
+
+   The writer may be caught at any moment, even in the middle of a tag.  Only complete elements are
+   read: the document ends after the last complete child of <gpx>, <trk> or <trkseg>, and the elements
+   still open there are taken as closed.  Loggers that rewrite the closing tags after every point are
+   handled as well, since the document is resumed before those tags.
+
+   A live file remembers the offset it has read up to and a checksum of every byte before it.  When the
+   file has become shorter than that offset, or the checksum differs because earlier bytes were changed
+   or the file was replaced, the whole file is parsed again.  Checking the checksum reads the bytes before
+   the offset in chunks, which is still many times faster than parsing them.  Between updates, only the
+   start tags that the next tail continues are kept in memory, not the file.
+
+   Each tail is parsed once, into lists of its own that are only added to the document when all of it is
+   valid, so a tail that cannot be read leaves the document as it was before the whole file is parsed
+   again.
+
+   A live file is not thread safe.  Its document belongs to it: the document may be read between updates,
+   but must not be modified, frozen or deleted. */
+
+typedef struct gpxLiveFile GPXLiveFile;
+
+//Result of updateGPXLiveFile
+typedef enum {
+    //Nothing new has been completed.  The document was not changed
+    GPX_LIVE_UNCHANGED,
+    //The new elements were added to the document
+    GPX_LIVE_APPENDED,
+    //The file was parsed again into a new document, and the old one was deleted
+    GPX_LIVE_RELOADED,
+    //The file could not be read or is not a valid GPX file.  The document was not changed
+    GPX_LIVE_FAILED
+} GPXLiveStatus;
+
+/** Function to start following a GPX file.  The file is read straight away, but it does not need to
+ * exist or hold a valid document yet: the document is created by the first update that can read it.
+ *@return the live file, or NULL if fileName is NULL or empty or malloc fails
+ *@param fileName - the file to follow
+ *@param options - GPX_OPT_* flags: GPX_OPT_ARENA, GPX_OPT_TYPED_ONLY, GPX_OPT_NODE_POOL and GPX_OPT_SHARED_NAMES
+ *                 apply to the whole document, GPX_OPT_PARALLEL to parsing the whole file, and GPX_OPT_MMAP is ignored
+**/
+GPXLiveFile* openGPXLiveFile(const char* fileName, unsigned int options);
+
+/** Function to read what has been added to the file since the last update.
+ *@pre live is not NULL
+ *@post getGPXLiveDoc returns a new document after GPX_LIVE_RELOADED
+ *@return what was done, see GPXLiveStatus
+ *@param live - the live file
+**/
+GPXLiveStatus updateGPXLiveFile(GPXLiveFile* live);
+
+//Returns the document of a live file, or NULL if the file has not been read yet.  The document is valid
+//until an update returns GPX_LIVE_RELOADED or the live file is closed
+GPXdoc* getGPXLiveDoc(const GPXLiveFile* live);
+
+//Returns the number of bytes of the file that the document was read from.  Bytes after it belong to
+//elements that were not complete at the last update, or to the closing tags of the document
+size_t getGPXLiveOffset(const GPXLiveFile* live);
+
+//Frees a live file and its document.  Safe to call with NULL
+void closeGPXLiveFile(GPXLiveFile* live);
+
+#endif
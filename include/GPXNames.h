@@ -0,0 +1,77 @@
+#ifndef GPX_NAMES_H
+#define GPX_NAMES_H
+
+#include "GPXParser.h"
+
+/* Compact GPXData elements with interned names, made by the parser for GPX_OPT_SHARED_NAMES.  The names of
+   GPXData elements come from a small vocabulary, so each distinct name is stored once per process and
+   every record with that name points to the same copy.  The element names of the GPX 1.1 schema are
+   built in and looked up without locking; any other name is added to a shared table under a mutex the
+   first time it is seen.  Interned names live until the process exits, so the table holds at most
+   GPX_MAX_SHARED_NAMES of them: a document full of made-up element names cannot grow it without bound.
+   A record whose name is not shared keeps its own copy of the name after its value, in the same block,
+   and frees it with the element.  Internal to the parser. */
+
+/* A GPXData element in compact form.  It is handed out as a GPXData*, so marker lies where a GPXData holds
+   the first character of its name, which is never empty: getGPXDataName and getGPXDataValue tell the two
+   forms apart by it */
+typedef struct {
+    //Always '\0'
+    char marker;
+    //The interned name, or the record's own copy of it
+    const char* name;
+    char value[];
+} GPXDataRecord;
+
+//Longest name kept, in characters.  Longer names are truncated to fit the name buffer of GPXData
+#define GPX_MAX_NAME_LENGTH 255
+
+//Most names outside the schema kept in the shared table
+#define GPX_MAX_SHARED_NAMES 1024
+
+/** Function to find the shared copy of an element name, adding it if it is new.  Safe to call from any
+ * number of threads at once.
+ *@pre name is not NULL
+ *@return the interned name, or NULL if the table is full or malloc fails.  The element then keeps its
+ *        own copy of the name (see fillGPXData)
+ *@param name - the element name
+**/
+const char* internGPXName(const char* name);
+
+//Returns true if data is a GPXDataRecord
+bool isGPXDataRecord(const GPXData* data);
+
+/** Function to find the size of the block for a GPXData element in the public layout.
+ *@return the bytes to allocate
+ *@param valueLen - length of the element text
+**/
+size_t getGPXDataSize(size_t valueLen);
+
+/** Function to build a GPXData element in the public layout in a block of getGPXDataSize bytes.
+ *@return the element, which is block
+ *@param block - the memory for the element
+ *@param name - the element name, truncated to GPX_MAX_NAME_LENGTH characters
+ *@param value - the element text
+ *@param valueLen - length of value
+**/
+GPXData* fillGPXData(void* block, const char* name, const char* value, size_t valueLen);
+
+/** Function to find the size of the block for a GPXDataRecord.
+ *@return the bytes to allocate, including a copy of the name if it is not shared
+ *@param shared - the result of internGPXName for name
+ *@param name - the element name
+ *@param valueLen - length of the element text
+**/
+size_t getGPXDataRecordSize(const char* shared, const char* name, size_t valueLen);
+
+/** Function to build a GPXDataRecord in a block of getGPXDataRecordSize bytes.
+ *@return the element, which is block, as a GPXData*
+ *@param block - the memory for the element
+ *@param shared - the result of internGPXName for name
+ *@param name - the element name, copied after the value if shared is NULL
+ *@param value - the element text
+ *@param valueLen - length of value
+**/
+GPXData* fillGPXDataRecord(void* block, const char* shared, const char* name, const char* value, size_t valueLen);
+
+#endif
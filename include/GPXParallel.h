@@ -0,0 +1,29 @@
+#ifndef GPX_PARALLEL_H
+#define GPX_PARALLEL_H
+
+#include "GPXParser.h"
+
+/* Parsing one GPX document on several threads.  A quick scan over the raw bytes finds the boundaries
+   of the top-level <wpt>, <rte> and <trk> elements, of the <trkseg> elements of large tracks, and of
+   the <trkpt> elements of large segments.  The document is cut at those boundaries into units of
+   roughly equal size.  Each unit is parsed as a small document of its own - the prolog and the <gpx>
+   start tag, the unit's bytes, and the matching end tags, all read in place - and the results are
+   spliced together in document order.
+
+   Documents the scan cannot split safely (a DOCTYPE, a UTF-16 encoding, or anything that is not
+   well-formed at the top levels) are parsed in one piece, so the result is always the same GPXdoc,
+   or NULL, that createGPXdocWithOptions would produce.  Internal to the parser. */
+
+/** Function to parse a GPX document held in memory on several threads.
+ *@pre data holds size bytes
+ *@return the new document, or NULL if the input is not a valid GPX file or memory ran out
+ *@param data - the document
+ *@param size - number of bytes in data
+ *@param url - name used in libxml2 error messages; may be NULL
+ *@param options - GPX_OPT_ARENA, GPX_OPT_TYPED_ONLY and GPX_OPT_SHARED_NAMES are honoured, and GPX_OPT_NODE_POOL
+ *                 when the document is parsed in one piece; other flags are ignored
+ *@param numThreads - number of threads to use; 0 or less means one per online processor
+**/
+GPXdoc* parseGPXParallel(const char* data, size_t size, const char* url, unsigned int options, int numThreads);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <libxml/encoding.h>
@@ -17,6 +18,21 @@
     #define M_PI 3.14159265358979323846
 #endif
 
+//Value of Waypoint.time for waypoints without a <time>
+#define GPX_NO_TIME LLONG_MIN
+
+//Bits of Waypoint.fields, one per typed field that holds a decoded value
+#define GPX_FIELD_ELEVATION 0x1
+#define GPX_FIELD_TIME 0x2
+#define GPX_FIELD_SATELLITES 0x4
+#define GPX_FIELD_HDOP 0x8
+#define GPX_FIELD_VDOP 0x10
+#define GPX_FIELD_PDOP 0x20
+#define GPX_FIELD_SPEED 0x40
+
+//Set in Waypoint.fields when the decoded children were left out of otherData (see GPX_OPT_TYPED_ONLY)
+#define GPX_FIELD_TYPED_ONLY 0x80
+
 //Represents a generic GPX element/XML node - i.e. some sort of an additinal piece of data, 
 // e.g. comment, elevation, desciption, etc..
 typedef struct  {
@@ -44,8 +60,33 @@ typedef struct {
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
+
+    //Value of the <time> child in milliseconds since the Unix epoch (UTC), or GPX_NO_TIME if there is none
+    //or it is not a valid timestamp.  Decoded by the parser; the <time> GPXData stays in otherData unless
+    //GPX_OPT_TYPED_ONLY was given.  GPX_FIELD_TIME is set in fields when it holds a value.  Not updated
+    //when otherData is modified
+    long long time;
+
+    //Typed copies of the <ele>, <hdop>, <vdop>, <pdop>, <speed> and <sat> children, decoded by the parser
+    //like time.  Each one holds a value only if its GPX_FIELD_* bit is set in fields.  Not updated when
+    //otherData is modified
+    double elevation;
+    float hdop;
+    float vdop;
+    float pdop;
+    float speed;
+    int satellites;
+    unsigned int fields;
 } Waypoint;
 
+//Latitude/longitude box in decimal degrees.  A box that contains no points has minLatitude > maxLatitude
+typedef struct {
+    double minLatitude;
+    double minLongitude;
+    double maxLatitude;
+    double maxLongitude;
+} GPXBounds;
+
 typedef struct {
     //Route name.  Must not be NULL.  May be an empty string.
     char* name;
@@ -54,6 +95,10 @@ typedef struct {
     //All objects in the list will be of type Waypoint.  It must not be NULL.  It may be empty.
     List* waypoints;
 
+    //Box around the waypoints with finite coordinates, computed by the parser.  Not updated when waypoints
+    //is modified - see updateGPXBounds in GPXSpatial.h
+    GPXBounds bounds;
+
     //Additional route data - i.e. children of the GPX route other than <name>.  
     //We will assume that all waypoint children have no children of their own
     //This can be comment, description, etc.. Note that while the element <name> can be a child of the route node,
@@ -66,6 +111,9 @@ typedef struct {
     //Waypoints that make up the track segment
     //All objects in the list will be of type Waypoint.  It must not be NULL.  It may be empty.
     List* waypoints;
+
+    //Box around the waypoints, like Route.bounds
+    GPXBounds bounds;
 } TrackSegment;
 
 typedef struct {
@@ -76,6 +124,9 @@ typedef struct {
     //All objects in the list will be of type TrackSegment.  It must not be NULL.  It may be empty.
     List* segments;
 
+    //Box around the bounds of every segment, like Route.bounds
+    GPXBounds bounds;
+
     //Additional track data - i.e. children of the GPX track other than <name>.  
     //We will assume that all waypoint children have no children of their own
     //This can be comment, description, etc.. Note that while the element <name> can be a child of the track node,
@@ -108,6 +159,28 @@ typedef struct {
     //Tracks in the GPX file
     //All objects in the list will be of type Track.  It must not be NULL.  It may be empty.
     List* tracks;
+
+    //Region allocator that owns the whole document when it was created with GPX_OPT_ARENA, NULL otherwise.
+    //Managed by the parser - do not modify.
+    struct gpxArena* arena;
+
+    //Name lookup tables built on demand by getWaypoint, getRoute and getTrack.  NULL until first needed.
+    //Managed by the parser - do not modify.
+    struct gpxNameIndex* nameIndex;
+
+    //Counts returned by getNumSegments and getNumGPXData, kept up to date by observers on the document's lists.
+    //Managed by the parser - do not modify.
+    int numSegments;
+    int numGPXData;
+    bool countersActive;
+
+    //Where to read the routes and tracks that have not been loaded from, when the document was created with
+    //GPX_OPT_LAZY (see GPXLazy.h).  NULL once everything is loaded.  Managed by the parser - do not modify.
+    struct gpxLazy* lazy;
+
+    //Set by freezeGPXdoc, and the number of owners of a frozen document.  Managed by the parser - do not modify.
+    bool frozen;
+    _Atomic int refCount;
 } GPXdoc;
 
 
@@ -128,6 +201,87 @@ typedef struct {
 **/
 GPXdoc* createGPXdoc(char* fileName);
 
+/** Function to create an GPX object by streaming the contents of an GPX file.
+ * Produces the same GPXdoc as createGPXdoc, but the file is read with an xmlTextReader and the
+ * libxml2 tree is never built, so peak memory is bounded by the size of the resulting GPXdoc
+ * rather than the XML tree plus the GPXdoc.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+**/
+GPXdoc* createGPXdocStreaming(char* fileName);
+
+//Options for createGPXdocWithOptions.  Combine with bitwise or.
+
+//Allocate the whole document (lists, nodes, names and GPXData) from a few large chunks owned by the document.
+//Parsing makes far fewer allocator calls and deleteGPXdoc releases the chunks without walking the lists.
+//The lists of such a document may be read and iterated as usual, but must not be modified with the List API.
+#define GPX_OPT_ARENA 0x1
+
+//Map the file into memory and parse it from there instead of reading it through stdio buffers.  If the file
+//cannot be mapped it is read normally
+#define GPX_OPT_MMAP 0x2
+
+//Parse the document on several threads, one per online processor.  The file is mapped into memory, cut into
+//pieces at element boundaries and the pieces are parsed concurrently, then joined in document order.  The
+//result is the same document a single-threaded parse produces
+#define GPX_OPT_PARALLEL 0x4
+
+//Leave the children that are decoded into typed Waypoint fields (ele, time, sat, hdop, vdop, pdop, speed)
+//out of otherData, saving a GPXData per child.  Only values that decode are left out.  The writers in
+//GPXWriter.h output them from the typed fields; toString, getNumGPXData and otherData do not include them
+#define GPX_OPT_TYPED_ONLY 0x8
+
+//Scan the file and build everything but the points of routes and the segments of tracks, which are read
+//from the file when an element is first asked for (see GPXLazy.h).  Names and counts are available straight
+//away.  Takes precedence over GPX_OPT_PARALLEL, and is ignored by createGPXdocFromMemory
+#define GPX_OPT_LAZY 0x10
+
+//Draw the list nodes of the whole document from one pool instead of making a malloc per node (see NodePool in
+//LinkedListAPI.h).  Nodes later removed from its lists are kept for reuse until the document, and every element
+//taken out of it, has been freed; their lists share the pool, so must not be modified from different threads at
+//the same time.  Ignored with GPX_OPT_ARENA, which already allocates nodes from the arena, and when the document
+//is split between threads by GPX_OPT_PARALLEL
+#define GPX_OPT_NODE_POOL 0x20
+
+//Store the GPXData of the document in a compact form that points to one shared copy of each element name,
+//instead of giving every element a 256-character name buffer.  Read such elements with getGPXDataName and
+//getGPXDataValue: their name and value fields do not hold the strings.  Elements added with createGPXData, or
+//allocated by the caller, keep the GPXData layout and may be mixed with them in the same lists
+#define GPX_OPT_SHARED_NAMES 0x40
+
+/** Function to create an GPX object by streaming the contents of an GPX file, with parser options.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+ *@param options - zero or more GPX_OPT_* flags; 0 is equivalent to createGPXdocStreaming
+**/
+GPXdoc* createGPXdocWithOptions(char* fileName, unsigned int options);
+
+/** Function to create an GPX object from GPX text that is already in memory, such as an upload.
+ * The result is the same as writing the text to a file and calling createGPXdocWithOptions on it.
+ *@pre buffer holds length bytes.  It does not need to be null-terminated
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned.  The buffer is not modified and may be freed afterwards
+ *@return the pinter to the new struct or NULL.  NULL if length is 0, or larger than INT_MAX without GPX_OPT_PARALLEL
+ *@param buffer - the GPX text
+ *@param length - number of bytes in buffer
+ *@param options - zero or more GPX_OPT_* flags; GPX_OPT_MMAP and GPX_OPT_LAZY are ignored
+**/
+GPXdoc* createGPXdocFromMemory(const char* buffer, size_t length, unsigned int options);
+
 /** Function to create a string representation of an GPX object.
  *@pre GPX object exists, is not null, and is valid
  *@post GPX has not been modified in any way, and a string representing the GPX contents has been created
@@ -136,7 +290,8 @@ GPXdoc* createGPXdoc(char* fileName);
 **/
 char* GPXdocToString(GPXdoc* doc);
 
-/** Function to delete doc content and free all the memory.
+/** Function to delete doc content and free all the memory.  For a frozen document this gives up one
+ * reference, and the document is only freed when the last reference is given up.
  *@pre GPX object exists, is not null, and has not been freed
  *@post GPX object had been freed
  *@return none
@@ -144,6 +299,41 @@ char* GPXdocToString(GPXdoc* doc);
 **/
 void deleteGPXdoc(GPXdoc* doc);
 
+/* Sharing a document between threads.
+
+   A GPXdoc, like a List, is not synchronized.  Functions that only read - getNum*, iteration with
+   createIterator/nextElement, findElement, GPXdocToString, the *ToString helpers, writeGPXdoc and the
+   length and column functions - may run on one document from several threads at once as long as no
+   thread modifies it.  getWaypoint, getRoute and getTrack are the exception for an ordinary document,
+   because they build the name index on first use, and so is every function that loads part of a
+   document created with GPX_OPT_LAZY.
+
+   freezeGPXdoc makes a document safe to share: it builds the name index up front, after which every
+   read-only function, including getWaypoint, getRoute and getTrack, may be called from any thread.  A
+   frozen document must never be modified again (debug builds assert on any insert or removal through
+   the List API).  It is reference counted: each thread or cache that keeps it calls retainGPXdoc, and
+   gives the reference up with releaseGPXdoc (or deleteGPXdoc), so no thread needs to know which
+   owner finishes last.  Hand a frozen document to other threads through something that synchronizes,
+   such as a mutex, thread creation or a queue, after freezeGPXdoc has returned. */
+
+/** Function to make a document read-only and shareable between threads.
+ *@pre doc is valid and no other thread is using it
+ *@post doc is frozen and fully loaded and holds one reference, owned by the caller.  Freezing a frozen document does nothing
+ *@return true on success, false if doc is NULL, a route or track of a lazy document could not be loaded, or memory
+ *        for the name index could not be allocated
+ *@param doc - the document to freeze
+**/
+bool freezeGPXdoc(GPXdoc* doc);
+
+//Returns true if doc has been frozen
+bool isGPXdocFrozen(const GPXdoc* doc);
+
+//Adds a reference to a frozen document and returns it.  Returns NULL if doc is NULL or not frozen
+GPXdoc* retainGPXdoc(GPXdoc* doc);
+
+//Gives up a reference to a frozen document, freeing it when it was the last one.  Same as deleteGPXdoc
+void releaseGPXdoc(GPXdoc* doc);
+
 /* For the five "get..." functions below, return the count of specified entities from the file.  
 They all share the same format and only differ in what they have to count.
  
@@ -169,16 +359,48 @@ int getNumSegments(const GPXdoc* doc);
 //Total number of GPXData elements in the document
 int getNumGPXData(const GPXdoc* doc);
 
+/* All five counts are O(1).  The document observes its lists, so the segment and GPXData counts follow
+   every change made through the List API, including changes to the lists of elements already in the
+   document.  Lists of a removed element are no longer observed.  Building with -DGPX_CHECK_COUNTS makes
+   getNumSegments and getNumGPXData assert that the stored counts match a full recount. */
+
+//Recounts segments and GPXData by walking the document and compares with the stored counts.
+//Returns true if they match or doc is NULL
+bool checkGPXCounts(const GPXdoc* doc);
+
 // Function that returns a waypoint with the given name.  If more than one exists, return the first one.  
 // Return NULL if the waypoint does not exist
 Waypoint* getWaypoint(const GPXdoc* doc, char* name);
 // Function that returns a track with the given name.  If more than one exists, return the first one. 
-// Return NULL if the track does not exist 
+// Return NULL if the track does not exist, or fails to load in a document created with GPX_OPT_LAZY 
 Track* getTrack(const GPXdoc* doc, char* name);
 // Function that returns a route with the given name.  If more than one exists, return the first one.  
-// Return NULL if the route does not exist
+// Return NULL if the route does not exist, or fails to load in a document created with GPX_OPT_LAZY
 Route* getRoute(const GPXdoc* doc, char* name);
 
+/* getWaypoint, getTrack and getRoute use a hash index that is built on first use and cached in the
+   GPXdoc, so repeated lookups are O(1).  The index is rebuilt after any insert into or removal from
+   doc->waypoints, doc->routes or doc->tracks made through the List API.  After renaming an element in
+   place, or changing a list's nodes directly, call this function before the next lookup.  Because
+   lookups may build the index, they must not run concurrently with each other on the same document
+   unless it has been frozen with freezeGPXdoc. */
+void invalidateGPXIndex(GPXdoc* doc);
+
+
+/* ******************************* GPXData *************************** */
+
+/** Function to allocate a GPXData element, for example to add to an otherData list.
+ *@pre name and value are not NULL
+ *@post The element holds copies of name, truncated to 255 characters, and value.  It is freed with deleteGpxData
+ *@return the new element, or NULL if either string is empty or malloc fails
+ *@param name - the element name
+ *@param value - the element text
+**/
+GPXData* createGPXData(const char* name, const char* value);
+
+//Return the name and value of a GPXData element, including one stored compactly for GPX_OPT_SHARED_NAMES
+const char* getGPXDataName(const GPXData* data);
+const char* getGPXDataValue(const GPXData* data);
 
 /* ******************************* List helper functions  - MUST be implemented *************************** */
 
@@ -0,0 +1,120 @@
+#ifndef GPX_SCAN_H
+#define GPX_SCAN_H
+
+#include "GPXParser.h"
+#include "StringBuilder.h"
+
+/* A quick scan over the raw bytes of a GPX document.  It finds the boundaries of the top-level <wpt>,
+   <rte> and <trk> elements, of the <trkseg> elements of tracks and of the points in routes and
+   segments, without building anything.  The parser uses it to cut a document into pieces that are
+   parsed on their own: the prolog and the <gpx> start tag, some byte ranges of the document, and the
+   </gpx> end tag.  Internal to the parser. */
+
+typedef struct {
+    size_t start;
+    size_t end;
+} ByteRange;
+
+//Byte offsets of an element.  For an empty-element tag, closeStart and end are both tagEnd
+typedef struct {
+    size_t start;
+    size_t tagEnd;
+    size_t closeStart;
+    size_t end;
+} Span;
+
+typedef struct {
+    Span span;
+    int numPoints;
+
+    //Offsets just after the <trkpt> elements where the segment may be cut
+    size_t* cuts;
+    int numCuts;
+    int capCuts;
+    size_t lastCut;
+} SegmentScan;
+
+//A child of <gpx>.  Points are only counted for <rte> and <trk>, and segments only recorded for <trk>
+typedef struct {
+    Span span;
+    bool isRoute;
+    bool isTrack;
+    int numPoints;
+
+    //GPXData elements the points will have once parsed: their children other than <name> that hold text,
+    //less those decoded into typed fields when typedOnly is set
+    int numPointData;
+
+    //For <rte>: runs of <rtept> elements with no other element between them
+    ByteRange* pointRuns;
+    int numRuns;
+    int capRuns;
+    bool inRun;
+
+    SegmentScan* segments;
+    int numSegments;
+    int capSegments;
+} ChildScan;
+
+//An element whose end tag has not been reached yet
+typedef struct {
+    const char* name;
+    size_t nameLen;
+    size_t tagEnd;
+    bool isSegment;
+    bool isRoutePoint;
+    bool isPoint;
+    //A child of a point, and whether it or its descendants hold any text
+    bool isPointChild;
+    bool hasText;
+} OpenElement;
+
+//Set data, size, unitSize and typedOnly and zero the rest before scanning
+typedef struct {
+    const char* data;
+    size_t size;
+    //Segments are cut after a point every unitSize bytes.  SIZE_MAX records no cuts
+    size_t unitSize;
+    //Count the GPXData of points as GPX_OPT_TYPED_ONLY parses them
+    bool typedOnly;
+
+    //The typed fields of the current point, and the text of its child being decoded, for typedOnly
+    Waypoint point;
+    StringBuilder text;
+
+    Span root;
+    ChildScan* children;
+    int numChildren;
+    int capChildren;
+
+    OpenElement* stack;
+    int depth;
+    int capStack;
+} Scan;
+
+/** Function to walk the markup of a whole document, checking that start and end tags match.
+ *@return true on success.  false if the document cannot be split safely: it is not well-formed at the levels
+ *        the scan looks at, uses a DOCTYPE (entities could hide markup) or is not in an ASCII-compatible
+ *        encoding, or malloc fails
+ *@param scan - the scan to fill in
+**/
+bool scanGPXDocument(Scan* scan);
+
+//Frees the arrays of a scan
+void clearGPXScan(Scan* scan);
+
+//Makes room for one more element in a growable array.  Returns false if realloc fails
+bool reserveGPXArray(void** array, int* cap, int count, size_t elemSize);
+
+/** Function to parse a list of byte ranges of data as one document, reading them in place.
+ *@return the new document, or NULL if the ranges do not make a valid GPX file or memory ran out
+ *@param data - the bytes the ranges refer to
+ *@param ranges - the ranges, in order
+ *@param numRanges - number of ranges
+ *@param url - name used in libxml2 error messages; may be NULL
+ *@param options - GPX_OPT_ARENA, GPX_OPT_TYPED_ONLY, GPX_OPT_NODE_POOL and GPX_OPT_SHARED_NAMES are honoured; other
+ *                 flags are ignored
+**/
+GPXdoc* parseGPXRanges(const char* data, const ByteRange* ranges, int numRanges, const char* url, unsigned int options);
+
+#endif
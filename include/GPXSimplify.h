@@ -0,0 +1,113 @@
+#ifndef GPX_SIMPLIFY_H
+#define GPX_SIMPLIFY_H
+
+#include "GPXParser.h"
+
+/* Line simplification for drawing routes and tracks with fewer points.
+
+   Two methods are provided, both with a tolerance in metres:
+     - Douglas-Peucker keeps the point farthest from the line between the two ends of a stretch if it
+       is more than the tolerance away, and repeats on both halves.  No removed point is farther than
+       the tolerance from the simplified line.
+     - Visvalingam-Whyatt repeatedly removes the point whose triangle with its two neighbours has the
+       smallest area, while that area is at most the tolerance squared.  It keeps the overall shape
+       better at coarse tolerances.
+   Both run iteratively (an explicit stack for Douglas-Peucker, a binary heap for Visvalingam-Whyatt),
+   so long inputs cannot overflow the call stack.
+
+   Distances are measured on a local equirectangular projection around the mean latitude of the
+   input, which is accurate for tracks spanning a few hundred kilometres.  The first and last points
+   of every route and segment are always kept.  Points with a coordinate that is not finite are
+   dropped.
+
+   Results hold pointers to the Waypoints of the document, which is not modified or copied, so they
+   must be deleted before the document is.
+
+   GPXSimplifyLevels precomputes one simplification per zoom level.  Both methods rank every point
+   once by the largest tolerance at which it is kept, and each level is the points ranked above its
+   tolerance, so a level is the same result simplifyTrack would return for that tolerance. */
+
+typedef enum {
+    GPX_SIMPLIFY_DOUGLAS_PEUCKER,
+    GPX_SIMPLIFY_VISVALINGAM
+} GPXSimplifyMethod;
+
+//Points kept by a simplification
+typedef struct {
+    //Pointers to the kept Waypoints, in path order
+    int numPoints;
+    const Waypoint** points;
+
+    //The kept points of part i are points[partStart[i]] to points[partStart[i + 1] - 1].  A track has
+    //one part per segment, routes and segments have one part.  partStart has numParts + 1 entries
+    int numParts;
+    int* partStart;
+} GPXSimplified;
+
+typedef struct gpxSimplifyLevels GPXSimplifyLevels;
+
+/** Function to simplify a list of Waypoints.
+ *@pre waypoints is a valid list of Waypoint
+ *@return the kept points as one part, or NULL if waypoints is NULL, tolerance is negative or malloc fails
+ *@param waypoints - the path to simplify
+ *@param method - GPX_SIMPLIFY_DOUGLAS_PEUCKER or GPX_SIMPLIFY_VISVALINGAM
+ *@param tolerance - largest allowed deviation in metres (see above)
+**/
+GPXSimplified* simplifyWaypoints(List* waypoints, GPXSimplifyMethod method, double tolerance);
+
+//Convenience wrappers around simplifyWaypoints.  Return NULL if their argument is NULL
+GPXSimplified* simplifyRoute(const Route* rte, GPXSimplifyMethod method, double tolerance);
+GPXSimplified* simplifySegment(const TrackSegment* seg, GPXSimplifyMethod method, double tolerance);
+
+//Simplifies every segment of a track, with one part per segment.  Returns NULL if trk is NULL
+GPXSimplified* simplifyTrack(const Track* trk, GPXSimplifyMethod method, double tolerance);
+
+//Frees a result.  The Waypoints are not affected.  Safe to call with NULL
+void deleteSimplified(GPXSimplified* result);
+
+/** Function to rank the points of a path, for callers that select their own tolerances.
+ *@pre ranks has room for one entry per Waypoint of waypoints
+ *@post ranks[i] is the rank of the i-th Waypoint with finite coordinates.  simplifyWaypoints keeps exactly
+ *      the points ranked above its tolerance, for every tolerance of at least minTolerance
+ *@return the number of points ranked, or -1 if waypoints or ranks is NULL, minTolerance is negative or
+ *        malloc fails
+ *@param waypoints - the path to rank
+ *@param method - GPX_SIMPLIFY_DOUGLAS_PEUCKER or GPX_SIMPLIFY_VISVALINGAM
+ *@param minTolerance - smallest tolerance the ranks will be compared with.  Douglas-Peucker ranks are only
+ *        exact above it, which saves splitting stretches that no tolerance of interest would split
+ *@param ranks - receives the ranks, in metres
+**/
+int rankWaypoints(List* waypoints, GPXSimplifyMethod method, double minTolerance, double* ranks);
+
+/** Function to precompute the simplifications of a track for a range of tolerances.
+ *@pre trk is a valid Track
+ *@return the levels, or NULL if trk is NULL, minTolerance is not positive, numLevels is not positive
+ *        or malloc fails
+ *@param trk - the track
+ *@param method - GPX_SIMPLIFY_DOUGLAS_PEUCKER or GPX_SIMPLIFY_VISVALINGAM
+ *@param minTolerance - tolerance of level 0, in metres
+ *@param numLevels - number of levels.  The tolerance doubles from one level to the next
+**/
+GPXSimplifyLevels* createTrackLevels(const Track* trk, GPXSimplifyMethod method, double minTolerance, int numLevels);
+
+//Same as createTrackLevels for the waypoints of a route
+GPXSimplifyLevels* createRouteLevels(const Route* rte, GPXSimplifyMethod method, double minTolerance, int numLevels);
+
+//Frees the levels.  The Waypoints are not affected.  Safe to call with NULL
+void deleteSimplifyLevels(GPXSimplifyLevels* levels);
+
+//Number of levels
+int getSimplifyLevelCount(const GPXSimplifyLevels* levels);
+
+//Tolerance of a level in metres, or NAN if level is out of range
+double getSimplifyLevelTolerance(const GPXSimplifyLevels* levels, int level);
+
+/** Function to find the level to draw at a given tolerance.
+ *@return the coarsest level whose tolerance is at most the given one (level 0 if there is none), or NULL
+ *        if levels is NULL.  Owned by levels - do not free
+ *@param levels - the precomputed levels
+ *@param tolerance - largest deviation that is acceptable, e.g. the ground size of a pixel at the current zoom
+**/
+const GPXSimplified* getSimplifyLevel(const GPXSimplifyLevels* levels, double tolerance);
+
+#endif
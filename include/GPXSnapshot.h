@@ -0,0 +1,59 @@
+#ifndef GPX_SNAPSHOT_H
+#define GPX_SNAPSHOT_H
+
+#include "GPXWriter.h"
+
+/* Binary snapshots of a GPXdoc.  A snapshot is written once after a file has been parsed and read back
+   much faster than the XML, since loading it is mostly copying: it is mapped into memory and the
+   document is built straight from its arrays, with no text to parse.
+
+   A snapshot file starts with a fixed header (magic "GPXSNAP", format version, byte order, counts and
+   section offsets), followed by 8-byte aligned sections:
+     - the coordinates of every waypoint, route point and track point as two arrays of doubles,
+       in document order (document waypoints, then route points, then track points), and their
+       decoded times (Waypoint.time) as an array of 64-bit integers
+     - per point, the other typed Waypoint fields and their GPX_FIELD_* bits
+     - per point, the name and the index of its first GPXData record
+     - route, track and segment records that refer to ranges of points, segments and GPXData records
+     - GPXData records, each a pair of strings
+     - the string table: every distinct string once, null-terminated
+   Snapshots use the byte order of the machine that wrote them and are rejected on a machine with a
+   different one, or by a build with a different format version.  Everything read from a snapshot is
+   checked against its bounds, so a truncated or corrupt file makes the loader return NULL.
+
+   A loaded document is equivalent to the one the snapshot was written from: GPXdocToString and
+   writeGPXdoc produce the same output for both.  It is allocated like a document created with
+   GPX_OPT_ARENA, so its lists may be read and iterated but not modified. */
+
+//Format version written to new snapshots.  Loaders accept only this version
+#define GPX_SNAPSHOT_VERSION 3
+
+/** Function to write a binary snapshot of a GPXdoc to a sink.
+ *@pre doc is a valid GPXdoc
+ *@return true on success, false if doc or sink is NULL, the sink failed, memory could not be allocated,
+ *        or the document is too large for the format (more than 2^32 - 1 points, records or string bytes)
+ *@param doc - the document to write
+ *@param sink - receives the snapshot, in chunks of at most GPX_WRITER_CHUNK bytes
+**/
+bool writeGPXSnapshot(const GPXdoc* doc, const GPXSink* sink);
+
+//Writes a snapshot to a stdio stream with writeGPXSnapshot.  The stream is not flushed or closed
+bool writeGPXSnapshotToFile(const GPXdoc* doc, FILE* file);
+
+/** Function to load a snapshot file written by writeGPXSnapshot.
+ *@return the document, or NULL if the file cannot be mapped, is not a valid snapshot of this format
+ *        version, or memory ran out
+ *@param fileName - the snapshot file
+**/
+GPXdoc* loadGPXSnapshot(const char* fileName);
+
+/** Function to load a snapshot that is already in memory.
+ *@pre data holds size bytes and is 8-byte aligned, as memory from malloc or mmap is
+ *@post The document does not refer to data, which may be freed afterwards
+ *@return the document, or NULL if data is not a valid snapshot or memory ran out
+ *@param data - the snapshot
+ *@param size - number of bytes in data
+**/
+GPXdoc* loadGPXSnapshotFromMemory(const void* data, size_t size);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef GPX_SPATIAL_H
+#define GPX_SPATIAL_H
+
+#include "GPXParser.h"
+
+/* Bounding boxes and a spatial index over the points of a GPXdoc.
+
+   Every Route, TrackSegment and Track carries the box around its points (GPXParser.h), filled in by the
+   parser as the points are read, so a viewport can skip whole routes and tracks with boundsIntersect.
+
+   GPXSpatialIndex answers box and radius queries over all waypoints, route points and track points
+   without visiting the rest.  The points are bucketed into a uniform latitude/longitude grid sized for
+   a few points per cell, and stored cell by cell with copies of their coordinates, so a query scans
+   one contiguous run of points per grid row it covers.  An index is a read-only snapshot of the
+   document: it is not updated when the document changes, and may be queried from several threads.
+
+   Points with a coordinate that is not finite are left out of every box and of the index.  Longitudes
+   are not normalized; boxes with minLongitude > maxLongitude cross the antimeridian. */
+
+typedef struct gpxSpatialIndex GPXSpatialIndex;
+
+//Which list of the document a point belongs to
+typedef enum {
+    GPX_POINT_WAYPOINT,
+    GPX_POINT_ROUTE,
+    GPX_POINT_TRACK
+} GPXPointKind;
+
+//A point found by a query
+typedef struct {
+    const Waypoint* wpt;
+    GPXPointKind kind;
+
+    //The Route or Track the point belongs to, and the TrackSegment of a track point.  NULL where they do not apply
+    const void* owner;
+    const TrackSegment* segment;
+} GPXPointRef;
+
+//Receives the points found by a query, in no particular order.  Returns false to end the query early
+typedef bool (*GPXPointFound)(void* userData, const GPXPointRef* point);
+
+/* ******************************* Bounds *************************** */
+
+//Sets bounds to the empty box
+void resetBounds(GPXBounds* bounds);
+
+//Whether bounds contains no points
+bool isBoundsEmpty(const GPXBounds* bounds);
+
+//Grows bounds to include a waypoint.  Waypoints with a coordinate that is not finite are ignored
+void extendBounds(GPXBounds* bounds, const Waypoint* wpt);
+
+//Grows bounds to include another box
+void mergeBounds(GPXBounds* bounds, const GPXBounds* other);
+
+//Whether two boxes share at least one point.  other may cross the antimeridian; bounds may not
+bool boundsIntersect(const GPXBounds* bounds, const GPXBounds* other);
+
+//Recomputes the bounds of every route, segment and track, after their lists have been modified.
+//Does nothing to a NULL or frozen document
+void updateGPXBounds(GPXdoc* doc);
+
+/** Function to compute the box around every point of a document.
+ *@return true if the document has a point with finite coordinates, false otherwise (bounds is then empty)
+ *@param doc - the document.  The route, segment and track bounds must be current
+ *@param bounds - receives the box
+**/
+bool getGPXdocBounds(const GPXdoc* doc, GPXBounds* bounds);
+
+/* ******************************* Index *************************** */
+
+/** Function to build a spatial index over the points of a document.
+ *@pre doc is a valid GPXdoc
+ *@post The document has not been modified.  The index refers to its points, so it must be deleted
+ *      before the document is, and rebuilt after points are added, removed or moved
+ *@return the new index, or NULL if doc is NULL or malloc fails
+ *@param doc - the document to index
+**/
+GPXSpatialIndex* createSpatialIndex(const GPXdoc* doc);
+
+//Frees an index.  Safe to call with NULL
+void deleteSpatialIndex(GPXSpatialIndex* index);
+
+//Number of points in an index
+int getSpatialIndexCount(const GPXSpatialIndex* index);
+
+//Bytes allocated for an index
+size_t getSpatialIndexSize(const GPXSpatialIndex* index);
+
+/** Function to find the points inside a box, edges included.
+ *@return the number of points passed to found, or -1 if index or box is NULL
+ *@param index - the index to search
+ *@param box - the area to search.  May cross the antimeridian
+ *@param found - receives each point; may be NULL to only count them
+ *@param userData - passed to found unchanged
+**/
+int queryBox(const GPXSpatialIndex* index, const GPXBounds* box, GPXPointFound found, void* userData);
+
+/** Function to find the points within a great-circle distance of a location (see GPXDistance.h).
+ *@return the number of points passed to found, or -1 if index is NULL
+ *@param index - the index to search
+ *@param latitude - latitude of the centre in decimal degrees
+ *@param longitude - longitude of the centre in decimal degrees
+ *@param radius - distance in metres, edges included
+ *@param found - receives each point; may be NULL to only count them
+ *@param userData - passed to found unchanged
+**/
+int queryRadius(const GPXSpatialIndex* index, double latitude, double longitude, double radius,
+                GPXPointFound found, void* userData);
+
+#endif
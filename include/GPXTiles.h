@@ -0,0 +1,89 @@
+#ifndef GPX_TILES_H
+#define GPX_TILES_H
+
+#include "GPXParser.h"
+#include "GPXSimplify.h"
+
+/* Vector tiles of a whole GPXdoc for map front ends, so that a viewer only downloads the tiles of its
+   viewport at its zoom level.
+
+   Tiles use the usual Web Mercator z/x/y scheme: at zoom z the world is 2^z by 2^z tiles, x grows
+   eastwards from longitude -180 and y southwards from latitude 85.0511.  Each tile is written to
+   <directory>/<z>/<x>/<y>.gpxt, and only tiles that hold something are written.
+
+   The document is walked once: every point is projected and every route and track segment is ranked
+   for simplification (see rankWaypoints in GPXSimplify.h).  Then, at every zoom, each line is
+   simplified to options.tolerance tile units and the tiles it crosses are found, and finally the
+   tiles are clipped and written in parallel, one task per tile.  Lines are clipped to the tile grown
+   by options.buffer units on every side, so that renderers can draw them across tile edges without
+   seams.  Lines are not wrapped around the antimeridian.
+
+   Tile format.  Integers are unsigned LEB128 varints; signed ones are zigzag encoded first.
+     - "GPXT", then the format version, z, x, y, the extent and the number of features
+     - per feature: its kind (GPXTileFeatureKind), the index of its waypoint, route or track in the
+       document's list, the index of the segment within its track (0 otherwise), the length of its name
+       and the name's bytes (no terminator), and its number of parts
+     - per part: its number of points, then every point as the signed difference in x and y from the
+       point before it (from 0, 0 for the first point of the feature)
+   Coordinates are in tile units: 0 to extent from the tile's west and north edges, and may be negative
+   or above extent by up to the buffer.  Waypoints have one part of one point.  A line has one part for
+   every stretch of it inside the buffered tile. */
+
+//Format version written in every tile
+#define GPX_TILE_VERSION 1
+
+//Largest zoom level supported
+#define GPX_TILE_MAX_ZOOM 24
+
+typedef enum {
+    GPX_TILE_WAYPOINT,
+    GPX_TILE_ROUTE,
+    GPX_TILE_TRACK
+} GPXTileFeatureKind;
+
+typedef struct {
+    //Zoom levels to write, from 0 to GPX_TILE_MAX_ZOOM
+    int minZoom;
+    int maxZoom;
+
+    //Size of a tile in tile units, from 16 to 65536
+    int extent;
+
+    //Units of geometry kept outside each edge of a tile, from 0 to extent
+    int buffer;
+
+    //Largest distance in tile units that simplification may move a line, at every zoom.  0 only removes
+    //points that lie exactly on the line
+    double tolerance;
+    GPXSimplifyMethod method;
+
+    //Number of threads to use; 0 or less means one per online processor
+    int numThreads;
+} GPXTileOptions;
+
+//What writeGPXTiles wrote
+typedef struct {
+    long long numTiles;
+    long long numFeatures;
+    long long numPoints;
+    long long numBytes;
+} GPXTileStats;
+
+//Fills options with the defaults: zoom 0 to 14, extent 4096, buffer 64, tolerance 4, Douglas-Peucker,
+//one thread per processor
+void initGPXTileOptions(GPXTileOptions* options);
+
+/** Function to write the tile pyramid of a document.
+ *@pre doc is a valid GPXdoc that is not modified while the tiles are written
+ *@post <directory>/<z>/<x>/<y>.gpxt exists for every tile with content.  Directories are created as
+ *      needed; existing tiles are overwritten, other files are left alone
+ *@return true on success, false if an argument is NULL or an option is out of range, malloc fails or a
+ *        directory or tile could not be written
+ *@param doc - the document
+ *@param directory - the root of the pyramid
+ *@param options - see GPXTileOptions
+ *@param stats - receives the totals of the tiles written.  May be NULL
+**/
+bool writeGPXTiles(const GPXdoc* doc, const char* directory, const GPXTileOptions* options, GPXTileStats* stats);
+
+#endif
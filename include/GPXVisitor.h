@@ -0,0 +1,81 @@
+#ifndef GPX_VISITOR_H
+#define GPX_VISITOR_H
+
+#include "GPXParser.h"
+
+/* Push-style traversal of a GPX file.  The file is streamed once and each entity is reported to a set
+   of callbacks as soon as it is complete, so no GPXdoc is built and memory use does not grow with the
+   size of the file. */
+
+//A decoded <wpt>, <rtept> or <trkpt>.  Only valid for the duration of the callback it is passed to
+typedef struct {
+    //Point name.  Never NULL.  Empty if the point has no <name>
+    const char* name;
+
+    double latitude;
+    double longitude;
+
+    //Value of <ele>, if hasElevation is true
+    double elevation;
+    bool hasElevation;
+
+    //Value of <time> in milliseconds since the Unix epoch (UTC), if hasTime is true
+    long long time;
+    bool hasTime;
+} GPXPoint;
+
+/* Callbacks invoked during visitGPXFile.  Any callback may be NULL.  userData is passed back unchanged.
+   Names are only valid for the duration of the callback.
+
+   beginTrack and beginRoute are reported when the first point or segment is reached (or at the end
+   of the element if it has none), so that the name is known even though <name> is a child element. */
+typedef struct {
+    void* userData;
+
+    //Top-level <wpt> elements
+    void (*waypoint)(void* userData, const GPXPoint* point);
+
+    void (*beginRoute)(void* userData, const char* name);
+    void (*routePoint)(void* userData, const GPXPoint* point);
+    void (*endRoute)(void* userData);
+
+    void (*beginTrack)(void* userData, const char* name);
+    void (*beginSegment)(void* userData);
+    void (*trackPoint)(void* userData, const GPXPoint* point);
+    void (*endSegment)(void* userData);
+    void (*endTrack)(void* userData);
+
+    //Every element that createGPXdoc would store as GPXData, in document order
+    void (*gpxData)(void* userData, const char* name, const char* value);
+} GPXVisitor;
+
+//Counts matching the getNum* functions for the GPXdoc that createGPXdoc would build from the same file
+typedef struct {
+    int numWaypoints;
+    int numRoutes;
+    int numTracks;
+    int numSegments;
+    int numGPXData;
+} GPXCounts;
+
+/** Function to stream a GPX file through a visitor.
+ *@pre File name cannot be an empty string or NULL.  visitor is not NULL.
+ *@post The callbacks have been invoked for every entity in the file, in document order
+ *@return true if the whole file was visited, false if it could not be read or is not a valid GPX file.
+ *        Callbacks may already have been invoked when false is returned.
+ *@param fileName - a string containing the name of the GPX file
+ *@param visitor - the callbacks to invoke
+**/
+bool visitGPXFile(char* fileName, const GPXVisitor* visitor);
+
+/** Function to count the entities in a GPX file without building a GPXdoc.
+ *@pre File name cannot be an empty string or NULL.  counts is not NULL.
+ *@post counts holds the values getNumWaypoints, getNumRoutes, getNumTracks, getNumSegments and
+ *      getNumGPXData would return for createGPXdoc(fileName)
+ *@return true on success, false if the file could not be read or is not a valid GPX file
+ *@param fileName - a string containing the name of the GPX file
+ *@param counts - receives the counts
+**/
+bool countGPXFile(char* fileName, GPXCounts* counts);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef GPX_WORKERS_H
+#define GPX_WORKERS_H
+
+#include <stdbool.h>
+
+/* A small fork-join pool for running independent tasks on several threads.  Tasks are numbered
+   0..count-1 and dealt out in contiguous blocks, one block per thread.  Each thread works through its
+   own block from the front, and a thread that runs out of work takes tasks from the back of another
+   thread's block, so uneven task sizes still keep every thread busy.  Internal to the parser. */
+
+//Number of online processors, at least 1
+int getGPXProcessorCount(void);
+
+/** Function to run task(userData, i) for every i in [0, count), spread over numThreads threads.
+ * The calling thread is one of the workers.  If threads cannot be created, the threads that were
+ * created run all the tasks between them.
+ *@pre task is not NULL and is safe to call concurrently for different indices
+ *@post every task has run exactly once
+ *@param count - number of tasks
+ *@param numThreads - number of threads to use; 0 or less means getGPXProcessorCount()
+ *@param task - the function to run
+ *@param userData - passed to every call of task
+**/
+void runGPXTasks(int count, int numThreads, void (*task)(void* userData, int index), void* userData);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef GPX_WRITER_H
+#define GPX_WRITER_H
+
+#include "GPXParser.h"
+
+/* Serialization of a GPXdoc as GPX XML or JSON.  Output is produced while the document is walked and
+   handed to a sink in chunks of at most GPX_WRITER_CHUNK bytes, so the caller can start sending it
+   straight away and the full text is never held in memory.
+
+   The XML form is a GPX file that createGPXdoc reads back into an equivalent document: for waypoints,
+   the GPXData elements that the GPX schema places before <name> (ele, time, magvar, geoidheight) are
+   written before it and the rest after it.  Coordinates are written with the fewest digits that
+   convert back to the same double.  Values that a GPX_OPT_TYPED_ONLY parse left out of otherData are
+   written from the typed Waypoint fields, in schema order in XML and after the rest of otherData in JSON.
+
+   The JSON form is a single object:
+   {"namespace":"...","version":1.1,"creator":"...",
+    "waypoints":[{"name":"...","lat":0,"lon":0,"otherData":[{"name":"ele","value":"..."}]}],
+    "routes":[{"name":"...","otherData":[...],"points":[<waypoint>...]}],
+    "tracks":[{"name":"...","otherData":[...],"segments":[{"points":[<waypoint>...]}]}]}
+   Coordinates that are not finite are written as null. */
+
+//Largest chunk passed to a sink
+#define GPX_WRITER_CHUNK 16384
+
+//Output formats
+typedef enum {
+    GPX_FORMAT_XML,
+    GPX_FORMAT_JSON
+} GPXFormat;
+
+//Destination for written output.  write receives consecutive pieces of the output, each between 1 and
+//GPX_WRITER_CHUNK bytes long, and returns false to stop writing.  userData is passed back unchanged
+typedef struct {
+    void* userData;
+    bool (*write)(void* userData, const char* data, size_t len);
+} GPXSink;
+
+/** Function to write a GPXdoc to a sink.
+ *@pre doc is a valid GPXdoc.  sink is not NULL and its write function is set
+ *@post The whole document has been passed to the sink, unless false was returned
+ *@return true on success, false if doc or sink is NULL, the sink failed or memory could not be allocated.
+ *        Part of the output may already have been written when false is returned.
+ *@param doc - the document to write
+ *@param format - GPX_FORMAT_XML or GPX_FORMAT_JSON
+ *@param sink - receives the output
+**/
+bool writeGPXdoc(const GPXdoc* doc, GPXFormat format, const GPXSink* sink);
+
+//Writes a GPXdoc to a stdio stream with writeGPXdoc.  The stream is not flushed or closed
+bool writeGPXdocToFile(const GPXdoc* doc, GPXFormat format, FILE* file);
+
+//Writes a GPXdoc to a file descriptor with writeGPXdoc, retrying short and interrupted writes.
+//The descriptor is not closed
+bool writeGPXdocToFd(const GPXdoc* doc, GPXFormat format, int fd);
+
+#endif
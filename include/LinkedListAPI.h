@@ -24,6 +24,34 @@ typedef struct listNode{
     struct listNode* next;
 } Node;
 
+/**
+ * Pool of list nodes.  Nodes are carved out of slabs of nodesPerSlab nodes, and nodes removed from a list go
+ * on a free list for the next insert instead of back to free, so a list that draws from a pool makes one
+ * malloc per slab instead of one per element.  Memory is only given back when the pool is freed.
+ *
+ * Any number of lists may share a pool, each holding a reference to it.  The pool is freed once its creator
+ * has called deleteNodePool and every list using it has been freed, so the lists may outlive the code that
+ * created the pool.  A pool is not synchronized: lists sharing one must not be modified from different
+ * threads at the same time.
+ **/
+typedef struct listNodeSlab{
+    struct listNodeSlab* next;
+    Node nodes[];
+} NodeSlab;
+
+typedef struct listNodePool{
+    //Newest slab first, and the number of its nodes handed out so far
+    NodeSlab* slabs;
+    int used;
+    int nodesPerSlab;
+
+    //Nodes given back by the lists, linked through their next pointers
+    Node* freeNodes;
+
+    //Lists using the pool, plus one for the creator until deleteNodePool
+    int numUsers;
+} NodePool;
+
 /**
  * Metadata head of the list. 
  * Contains no actual data but contains
@@ -37,6 +65,20 @@ typedef struct listHead{
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+
+    //Optional observer, notified after an element is added to the list and before an element is removed
+    //from it.  NULL unless set with setListObserver.
+    void (*onInsert)(void* observer, void* data);
+    void (*onRemove)(void* observer, void* data);
+    void* observer;
+
+    //Pool the list's nodes come from, or NULL to allocate each node with malloc.  Set with setListNodePool
+    NodePool* pool;
+
+    //Optional function that fills the list on first use, for lists whose contents are read on demand.
+    //NULL unless set with setListFill.
+    void (*fill)(void* source, struct listHead* list);
+    void* source;
 } List;
 
 
@@ -44,6 +86,11 @@ typedef struct listHead{
  * List iterator structure.
  * It represents an abstract object for iterating through the list.
  * The list implemntation is hidden from the user
+ *
+ * Concurrency: the list is not synchronized.  Any number of threads may read one list at the same time -
+ * each with its own iterator, or with getLength, findElement, getFromFront, getFromBack and toString -
+ * provided no thread inserts, deletes or frees while they do.  An iterator is only valid while the list
+ * is not modified.
  **/
 typedef struct iter{
     Node* current;
@@ -80,6 +127,7 @@ Node* initializeNode(void* data);
 /**Inserts a Node at the front of a linked list.  List metadata is updated
 * so that head and tail pointers are correct.
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
+*@post If no node could be allocated the list is unchanged, which callers can detect with getLength
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
 **/
@@ -90,6 +138,7 @@ void insertFront(List* list, void* toBeAdded);
 /**Inserts a Node at the back of a linked list. 
 *List metadata is updated so that head and tail pointers are correct.
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
+*@post If no node could be allocated the list is unchanged, which callers can detect with getLength
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
 **/
@@ -97,6 +146,34 @@ void insertBack(List* list, void* toBeAdded);
 
 
 
+/**Inserts a batch of data at the back of a linked list, in array order.  Every node is allocated before
+* any is linked, so the batch is added completely or not at all.  The observer, if any, is notified once
+* per element after the whole batch has been linked.
+*@pre 'List' type must exist and be used in order to keep track of the linked list.
+*@post On failure the list is unchanged
+*@return true on success, false if list or data is NULL, count is negative, an element is NULL, or
+*        nodes could not be allocated
+*@param list pointer to the List struct
+*@param data - the data to add
+*@param count - number of elements of data
+**/
+bool insertBackArray(List* list, void* const* data, int count);
+
+
+
+/**Moves every element of another list to the back of a linked list, in order, without allocating: the
+* nodes themselves are relinked.  The other list's observer is notified of each removal first, and then the
+* list's observer of each insert.
+*@pre Both lists exist.  Their nodes were allocated the same way - from the same pool, or both with malloc
+*@post other is empty.  On failure both lists are unchanged
+*@return true on success, false if either list is NULL, they are the same list, or their pools differ
+*@param list pointer to the List struct to add to
+*@param other - pointer to the List struct to take the elements from
+**/
+bool moveListElements(List* list, List* other);
+
+
+
 /** Deletes the entire linked list, freeing all memory asssociated with the list, including the list struct itself.
 * Uses the supplied function pointer to release allocated memory for the data.
 * @pre 'List' type must exist and be used in order to keep track of the linked list.
@@ -214,4 +291,57 @@ int getLength(List* list);
  **/
 void* findElement(List * list, bool (*customCompare)(const void* first,const void* second), const void* searchRecord);
 
+
+/** Function that registers an observer on the list.  onInsert is called with the observer and the data
+ * after every insertFront, insertBack and insertSorted; onRemove is called with the observer and the data
+ * before the data is removed by deleteDataFromList, clearList or freeList.
+ *@pre List exists and is valid.
+ *@post The list's previous observer, if any, has been replaced.
+ *@param list - a pointer to the List struct
+ *@param observer - passed back to the callbacks unchanged
+ *@param onInsert - called after data is added.  May be NULL
+ *@param onRemove - called before data is removed.  May be NULL
+ **/
+void setListObserver(List* list, void* observer, void (*onInsert)(void* observer, void* data), void (*onRemove)(void* observer, void* data));
+
+
+/** Function that makes a list fill itself on first use.  The next call that reads or changes the list -
+ * createIterator, getLength, getFromFront, getFromBack, findElement, toString, the inserts,
+ * moveListElements and deleteDataFromList - first unsets the function and then calls it with source and
+ * the list, so the function may add elements, or call setListFill again to be tried on the next use.
+ * clearList and freeList unset it without calling it.  Since that first read changes the list, threads
+ * may only share a list that has no fill function.
+ *@pre List exists and is valid.
+ *@post The list's previous fill function, if any, has been replaced.
+ *@param list - a pointer to the List struct
+ *@param source - passed back to fill unchanged
+ *@param fill - called before the next use of the list, or NULL to unset it
+ **/
+void setListFill(List* list, void* source, void (*fill)(void* source, List* list));
+
+
+/** Function to create a pool of list nodes (see NodePool).
+ *@post The pool holds one reference for the caller, given up with deleteNodePool
+ *@return the new pool, or NULL if malloc fails
+ *@param nodesPerSlab - number of nodes allocated at a time; 0 or less for a default of 256
+ **/
+NodePool* createNodePool(int nodesPerSlab);
+
+
+/** Function to give up the creator's reference to a pool.  The pool is freed now if no list uses it, or
+ * else when the last list using it is freed.  Safe to call with NULL.
+ *@param pool - the pool
+ **/
+void deleteNodePool(NodePool* pool);
+
+
+/** Function to make a list draw its nodes from a pool, or from malloc again when pool is NULL.
+ *@pre List exists and is valid.
+ *@post The list holds a reference to the new pool and has given up the one to its previous pool
+ *@return true on success, false if list is NULL or not empty
+ *@param list - a pointer to the List struct
+ *@param pool - the pool, or NULL
+ **/
+bool setListNodePool(List* list, NodePool* pool);
+
 #endif
\ No newline at end of file
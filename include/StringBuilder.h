@@ -0,0 +1,37 @@
+/**
+ * @file StringBuilder.h
+ * @brief Growable string used to build the output of toString and the GPX *ToString functions
+ */
+
+#ifndef _STRING_BUILDER_
+#define _STRING_BUILDER_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A string that grows as text is appended to it.  The capacity doubles whenever it runs out, so building
+ * a string of n characters costs O(n) no matter how many pieces it is made of.
+ * Initialize with {NULL, 0, 0}.  str is always null-terminated once anything has been appended, and
+ * belongs to the caller, who must free it.
+ **/
+typedef struct stringBuilder {
+    char* str;
+    size_t len;
+    size_t cap;
+} StringBuilder;
+
+/** Function to append a null-terminated string.
+ *@return false if memory could not be allocated, in which case the builder is unchanged
+ *@param sb - the builder
+ *@param str - the string to append
+ **/
+bool appendString(StringBuilder* sb, const char* str);
+
+//Same as appendString for the first len characters of str
+bool appendStringLen(StringBuilder* sb, const char* str, size_t len);
+
+//Appends printf-style formatted text.  Returns false if memory could not be allocated
+bool appendFormat(StringBuilder* sb, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Benchmark of documents allocated from an arena (GPX_OPT_ARENA) against ordinary heap documents.
+ *
+ * Usage: ArenaBench file.gpx [runs]
+ *
+ * Built with -Wl,--wrap=malloc, calloc, realloc and free, so every allocation the list and parser code
+ * makes goes through the counters below.  libxml2 allocates through its own references to malloc, so it
+ * is given counting functions of its own with xmlMemSetup, and its calls are reported apart: they are
+ * the same in both modes.
+ *
+ * The file is parsed runs times (default 3) with createGPXdocWithOptions, without options and with
+ * GPX_OPT_ARENA, and each document is freed with deleteGPXdoc.  Prints the best parse and delete times
+ * and the allocator calls of each.  Both documents must print the same with GPXdocToString.
+ *
+ * Exits with 1 if a parse fails or the documents differ.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libxml/xmlmemory.h>
+#include "GPXParser.h"
+
+#define DEFAULT_RUNS 3
+
+/* ******************************* Instrumented allocator *************************** */
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+typedef struct {
+	long allocs;
+	long frees;
+} Counts;
+
+static Counts parserCounts;
+static Counts xmlCounts;
+
+void* __wrap_malloc(size_t size){
+	parserCounts.allocs++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size){
+	parserCounts.allocs++;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size){
+	parserCounts.allocs++;
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr){
+	if (ptr != NULL){
+		parserCounts.frees++;
+	}
+	__real_free(ptr);
+}
+
+static void* xmlCountMalloc(size_t size){
+	xmlCounts.allocs++;
+	return __real_malloc(size);
+}
+
+static void* xmlCountRealloc(void* ptr, size_t size){
+	xmlCounts.allocs++;
+	return __real_realloc(ptr, size);
+}
+
+static void xmlCountFree(void* ptr){
+	if (ptr != NULL){
+		xmlCounts.frees++;
+	}
+	__real_free(ptr);
+}
+
+static char* xmlCountStrdup(const char* str){
+	size_t len = strlen(str) + 1;
+	char* copy = xmlCountMalloc(len);
+
+	if (copy != NULL){
+		memcpy(copy, str, len);
+	}
+	return copy;
+}
+
+/* ******************************* Benchmark *************************** */
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+	const char* name;
+	unsigned int options;
+} Mode;
+
+static const Mode modes[] = {
+	{"heap", 0},
+	{"arena", GPX_OPT_ARENA},
+};
+
+#define NUM_MODES (sizeof(modes) / sizeof(modes[0]))
+
+typedef struct {
+	double parseTime;
+	double deleteTime;
+	Counts parse;
+	Counts parseXml;
+	Counts delete;
+} Result;
+
+//Parses and deletes the file runs times.  Returns false if a parse fails
+static bool runMode(const Mode* mode, char* fileName, int runs, Result* result){
+	for (int i = 0; i < runs; i++){
+		Counts parserBefore = parserCounts;
+		Counts xmlBefore = xmlCounts;
+		double start = now();
+		GPXdoc* doc = createGPXdocWithOptions(fileName, mode->options);
+		double parseTime = now() - start;
+
+		if (doc == NULL){
+			return false;
+		}
+		Counts parse = {parserCounts.allocs - parserBefore.allocs, parserCounts.frees - parserBefore.frees};
+		Counts parseXml = {xmlCounts.allocs - xmlBefore.allocs, xmlCounts.frees - xmlBefore.frees};
+
+		parserBefore = parserCounts;
+		start = now();
+		deleteGPXdoc(doc);
+		double deleteTime = now() - start;
+		Counts delete = {parserCounts.allocs - parserBefore.allocs, parserCounts.frees - parserBefore.frees};
+
+		if (i == 0 || parseTime < result->parseTime){
+			result->parseTime = parseTime;
+		}
+		if (i == 0 || deleteTime < result->deleteTime){
+			result->deleteTime = deleteTime;
+		}
+		result->parse = parse;
+		result->parseXml = parseXml;
+		result->delete = delete;
+	}
+	return true;
+}
+
+static bool sameDocuments(char* fileName){
+	GPXdoc* first = createGPXdocWithOptions(fileName, modes[0].options);
+	char* firstText = first != NULL ? GPXdocToString(first) : NULL;
+	bool same = firstText != NULL;
+
+	deleteGPXdoc(first);
+	for (size_t i = 1; same && i < NUM_MODES; i++){
+		GPXdoc* doc = createGPXdocWithOptions(fileName, modes[i].options);
+		char* text = doc != NULL ? GPXdocToString(doc) : NULL;
+
+		same = text != NULL && strcmp(firstText, text) == 0;
+		free(text);
+		deleteGPXdoc(doc);
+	}
+	free(firstText);
+	return same;
+}
+
+int main(int argc, char** argv){
+	if (argc < 2){
+		fprintf(stderr, "Usage: %s file.gpx [runs]\n", argv[0]);
+		return 1;
+	}
+
+	char* fileName = argv[1];
+	int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+
+	if (runs < 1 || xmlMemSetup(&xmlCountFree, &xmlCountMalloc, &xmlCountRealloc, &xmlCountStrdup) != 0){
+		fprintf(stderr, "Cannot set up the benchmark\n");
+		return 1;
+	}
+
+	bool ok = true;
+
+	printf("%s: best of %d\n", fileName, runs);
+	for (size_t i = 0; i < NUM_MODES; i++){
+		Result result;
+
+		if (!runMode(&modes[i], fileName, runs, &result)){
+			printf("  %-6s failed\n", modes[i].name);
+			ok = false;
+			continue;
+		}
+		printf("  %-6s parse %8.1f ms  %9ld allocs (libxml2 %9ld)   delete %7.1f ms  %9ld frees\n", modes[i].name,
+		       result.parseTime * 1000, result.parse.allocs, result.parseXml.allocs, result.deleteTime * 1000,
+		       result.delete.frees);
+	}
+
+	if (ok && !sameDocuments(fileName)){
+		printf("  documents differ\n");
+		ok = false;
+	}
+
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
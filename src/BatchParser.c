@@ -0,0 +1,111 @@
+/*
+ * Command-line front end for parseGPXBatch.
+ *
+ * Usage: BatchParser [-j threads] [-a] [-m] [-s] file...
+ *   -j  number of worker threads (default: one per online processor)
+ *   -a  parse with GPX_OPT_ARENA
+ *   -m  parse with GPX_OPT_MMAP
+ *   -s  scaling benchmark: parse the files with 1, 2, ... threads up to -j and print the times
+ *
+ * Without -s, prints one line per file with its counts or the reason it failed, and a summary on stderr.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "GPXBatch.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void printResult(const char* fileName, const GPXBatchResult* result){
+	switch (result->status){
+		case GPX_BATCH_OK:
+			printf("%s: waypoints=%d routes=%d tracks=%d segments=%d data=%d\n", fileName,
+				getNumWaypoints(result->doc), getNumRoutes(result->doc), getNumTracks(result->doc),
+				getNumSegments(result->doc), getNumGPXData(result->doc));
+			break;
+		case GPX_BATCH_UNREADABLE:
+			printf("%s: unreadable\n", fileName);
+			break;
+		default:
+			printf("%s: invalid GPX\n", fileName);
+	}
+}
+
+int main(int argc, char** argv){
+	long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int options = 0;
+	int scaling = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:ams")) != -1){
+		switch (opt){
+			case 'j':
+				numThreads = atoi(optarg);
+				break;
+			case 'a':
+				options |= GPX_OPT_ARENA;
+				break;
+			case 'm':
+				options |= GPX_OPT_MMAP;
+				break;
+			case 's':
+				scaling = 1;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-j threads] [-a] [-m] [-s] file...\n", argv[0]);
+				return 2;
+		}
+	}
+
+	int numFiles = argc - optind;
+	char** fileNames = argv + optind;
+	if (numFiles < 1 || numThreads < 1){
+		fprintf(stderr, "Usage: %s [-j threads] [-a] [-m] [-s] file...\n", argv[0]);
+		return 2;
+	}
+
+	if (scaling){
+		double base = 0.0;
+
+		printf("%8s %10s %8s\n", "threads", "seconds", "speedup");
+		for (int threads = 1; threads <= numThreads; threads++){
+			double start = now();
+			GPXBatchResult* results = parseGPXBatch(fileNames, numFiles, options, threads);
+			double elapsed = now() - start;
+
+			deleteGPXBatch(results, numFiles);
+			if (threads == 1){
+				base = elapsed;
+			}
+			printf("%8d %10.3f %8.2f\n", threads, elapsed, base / elapsed);
+		}
+		xmlCleanupParser();
+		return 0;
+	}
+
+	double start = now();
+	GPXBatchResult* results = parseGPXBatch(fileNames, numFiles, options, numThreads);
+	double elapsed = now() - start;
+
+	if (results == NULL){
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	int failed = 0;
+	for (int i = 0; i < numFiles; i++){
+		printResult(fileNames[i], &results[i]);
+		failed += results[i].status != GPX_BATCH_OK;
+	}
+	fprintf(stderr, "%d files, %d failed, %.3f s on %ld threads\n", numFiles, failed, elapsed, numThreads);
+
+	deleteGPXBatch(results, numFiles);
+	xmlCleanupParser();
+	return failed == 0 ? 0 : 1;
+}
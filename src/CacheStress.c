@@ -0,0 +1,272 @@
+/*
+ * Stress test for the document cache (GPXCache.h).
+ *
+ * Usage: CacheStress [threads] [seconds]
+ *
+ * Writes a set of small GPX files into a temporary directory.  Each version of a file has its version in
+ * the creator attribute and a number of waypoints that depends on it, so a reader can tell a document
+ * that mixes two versions of its file from one that is merely out of date.
+ *
+ * First, single-threaded lookups check the counters exactly: misses on first use, hits after, evictions
+ * once the budget is full, an invalidation when a file is replaced or removed, and an empty cache after
+ * clearGPXCache.  Then reader threads look up random files for the given time (default 2 seconds) while
+ * the main thread keeps replacing them.  Every document returned must be consistent, and at the end the
+ * counters must add up to the number of lookups made.
+ *
+ * The CacheStress target builds the parser sources with ThreadSanitizer, which reports any data race.
+ * Exits with 1 on any failure.
+ */
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "GPXParser.h"
+#include "GPXCache.h"
+
+#define NUM_FILES 24
+#define DEFAULT_THREADS 4
+#define DEFAULT_SECONDS 2
+
+static char directory[] = "/tmp/CacheStressXXXXXX";
+static atomic_int failures;
+
+static void check(bool ok, const char* what){
+	if (!ok){
+		atomic_fetch_add(&failures, 1);
+		fprintf(stderr, "Mismatch: %s\n", what);
+	}
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void filePath(char* path, size_t size, int file){
+	snprintf(path, size, "%s/file%02d.gpx", directory, file);
+}
+
+//Consecutive versions differ in size, so a replaced file never matches the old one's stat
+static int numWaypoints(int file, int version){
+	return 20 + file * 3 + version % 17;
+}
+
+//Writes a version of a file next to it and renames it into place, as a server replacing an upload would
+static bool writeVersion(int file, int version){
+	char path[64];
+	char temp[80];
+
+	filePath(path, sizeof(path), file);
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+	FILE* out = fopen(temp, "w");
+	if (out == NULL){
+		return false;
+	}
+	fprintf(out, "<?xml version=\"1.0\"?>\n<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"v%d\">\n", version);
+	for (int i = 0; i < numWaypoints(file, version); i++){
+		fprintf(out, "<wpt lat=\"%d.%04d\" lon=\"-%d.%04d\"><name>w%d</name><ele>%d</ele></wpt>\n", 40 + file, i, 80, i, i, version);
+	}
+	fprintf(out, "</gpx>\n");
+
+	return fclose(out) == 0 && rename(temp, path) == 0;
+}
+
+//Checks that a document is one whole version of its file.  Returns the version
+static int checkDocument(GPXdoc* doc, int file){
+	int version = -1;
+
+	if (doc == NULL || sscanf(doc->creator, "v%d", &version) != 1){
+		check(false, "document or its version missing");
+		return -1;
+	}
+	check(getNumWaypoints(doc) == numWaypoints(file, version), "document does not match its version");
+	check(getWaypoint(doc, "w0") != NULL, "getWaypoint on a cached document");
+	return version;
+}
+
+static GPXdoc* lookUp(GPXCache* cache, int file){
+	char path[64];
+
+	filePath(path, sizeof(path), file);
+	return getCachedGPXdoc(cache, path);
+}
+
+/* ******************************* Counters *************************** */
+
+static void checkStats(GPXCache* cache, uint64_t hits, uint64_t misses, uint64_t evictions, uint64_t invalidations, const char* what){
+	GPXCacheStats stats;
+
+	getGPXCacheStats(cache, &stats);
+	if (stats.hits != hits || stats.misses != misses || stats.evictions != evictions || stats.invalidations != invalidations){
+		fprintf(stderr, "%s: hits %llu misses %llu evictions %llu invalidations %llu, expected %llu %llu %llu %llu\n", what,
+		        (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions,
+		        (unsigned long long)stats.invalidations, (unsigned long long)hits, (unsigned long long)misses,
+		        (unsigned long long)evictions, (unsigned long long)invalidations);
+		check(false, what);
+	}
+	check(stats.bytesUsed <= stats.byteBudget, "bytes used over the budget");
+}
+
+static void checkCounters(void){
+	//Room for the first four files and no more
+	size_t budget = 0;
+	for (int file = 0; file < 4; file++){
+		GPXdoc* doc = lookUp(NULL, file);
+		check(doc == NULL, "lookup without a cache");
+
+		char path[64];
+		filePath(path, sizeof(path), file);
+		doc = createGPXdocWithOptions(path, 0);
+		freezeGPXdoc(doc);
+		budget += estimateGPXdocSize(doc);
+		releaseGPXdoc(doc);
+	}
+
+	GPXCache* cache = createGPXCache(budget, 0);
+	for (int file = 0; file < 4; file++){
+		releaseGPXdoc(lookUp(cache, file));
+	}
+	checkStats(cache, 0, 4, 0, 0, "first lookups");
+
+	for (int file = 0; file < 4; file++){
+		GPXdoc* doc = lookUp(cache, file);
+		checkDocument(doc, file);
+		releaseGPXdoc(doc);
+	}
+	checkStats(cache, 4, 4, 0, 0, "repeated lookups");
+
+	//File 4 is larger than any of the first four, so at least two of them go, the least recent first
+	releaseGPXdoc(lookUp(cache, 4));
+	GPXCacheStats stats;
+	getGPXCacheStats(cache, &stats);
+	check(stats.evictions >= 2 && stats.numDocs == 5 - (int)stats.evictions, "evictions when the budget is full");
+	uint64_t evictions = stats.evictions;
+	releaseGPXdoc(lookUp(cache, 3));
+	checkStats(cache, 5, 5, evictions, 0, "most recent file kept");
+	releaseGPXdoc(lookUp(cache, 0));
+	checkStats(cache, 5, 6, evictions + 1, 0, "least recent file evicted");
+
+	//A document held by a caller outlives its entry
+	GPXdoc* held = lookUp(cache, 0);
+	check(writeVersion(0, 1), "replacing a file");
+	GPXdoc* replaced = lookUp(cache, 0);
+	check(checkDocument(held, 0) == 0 && checkDocument(replaced, 0) == 1, "replaced file parsed again");
+	releaseGPXdoc(held);
+	releaseGPXdoc(replaced);
+	checkStats(cache, 6, 7, evictions + 1, 1, "replaced file");
+
+	char path[64];
+	filePath(path, sizeof(path), 0);
+	check(unlink(path) == 0 && lookUp(cache, 0) == NULL, "lookup of a removed file");
+	checkStats(cache, 6, 8, evictions + 1, 2, "removed file");
+	check(writeVersion(0, 2), "restoring a file");
+
+	clearGPXCache(cache);
+	getGPXCacheStats(cache, &stats);
+	check(stats.numDocs == 0 && stats.bytesUsed == 0 && stats.hits == 6, "clearGPXCache");
+	deleteGPXCache(cache);
+}
+
+/* ******************************* Threads *************************** */
+
+typedef struct {
+	GPXCache* cache;
+	unsigned int seed;
+	atomic_bool* stop;
+	long lookups;
+	long found;
+} ReaderArgs;
+
+static void* reader(void* arg){
+	ReaderArgs* args = arg;
+
+	while (!atomic_load(args->stop)){
+		int file = rand_r(&args->seed) % NUM_FILES;
+		GPXdoc* doc = lookUp(args->cache, file);
+
+		args->lookups++;
+		if (doc != NULL){
+			checkDocument(doc, file);
+			args->found++;
+			releaseGPXdoc(doc);
+		}
+	}
+	return NULL;
+}
+
+static void stressThreads(int numThreads, double seconds){
+	//Room for about a third of the files, so documents are evicted all the time
+	GPXCache* cache = createGPXCache(NUM_FILES / 3 * 12000, 0);
+	pthread_t threads[numThreads];
+	ReaderArgs args[numThreads];
+	atomic_bool stop = false;
+
+	for (int i = 0; i < numThreads; i++){
+		args[i] = (ReaderArgs){cache, 1234u + i, &stop, 0, 0};
+		pthread_create(&threads[i], NULL, &reader, &args[i]);
+	}
+
+	int version = 3;
+	int replacements = 0;
+	double end = now() + seconds;
+	while (now() < end){
+		check(writeVersion(replacements % NUM_FILES, version++), "replacing a file");
+		replacements++;
+		usleep(2000);
+	}
+
+	atomic_store(&stop, true);
+	long lookups = 0;
+	long found = 0;
+	for (int i = 0; i < numThreads; i++){
+		pthread_join(threads[i], NULL);
+		lookups += args[i].lookups;
+		found += args[i].found;
+	}
+
+	GPXCacheStats stats;
+	getGPXCacheStats(cache, &stats);
+	printf("  %d threads: %ld lookups, %d replacements; %llu hits, %llu misses, %llu evictions, %llu invalidations\n",
+	       numThreads, lookups, replacements, (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+	       (unsigned long long)stats.evictions, (unsigned long long)stats.invalidations);
+
+	check(found == lookups, "lookup of an existing file failed");
+	check(stats.hits + stats.misses == (uint64_t)lookups, "hits and misses do not add up to the lookups");
+	check(stats.evictions > 0 && stats.invalidations > 0, "no evictions or invalidations");
+	check(stats.bytesUsed <= stats.byteBudget, "bytes used over the budget");
+	deleteGPXCache(cache);
+}
+
+int main(int argc, char** argv){
+	int numThreads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+	double seconds = argc > 2 ? atof(argv[2]) : DEFAULT_SECONDS;
+
+	if (numThreads < 1 || seconds <= 0 || mkdtemp(directory) == NULL){
+		fprintf(stderr, "Usage: %s [threads] [seconds]\n", argv[0]);
+		return 2;
+	}
+
+	for (int file = 0; file < NUM_FILES; file++){
+		check(writeVersion(file, 0), "writing a file");
+	}
+
+	checkCounters();
+	stressThreads(numThreads, seconds);
+
+	for (int file = 0; file < NUM_FILES; file++){
+		char path[64];
+		filePath(path, sizeof(path), file);
+		unlink(path);
+	}
+	rmdir(directory);
+	xmlCleanupParser();
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*
+ * Check of the segment and GPXData counts kept by the document (GPXCounters.h) as its lists are changed.
+ *
+ * Usage: CountsCheck [file.gpx...]
+ *
+ * The CountsCheck target builds the parser with -DGPX_CHECK_COUNTS, so getNumSegments and getNumGPXData
+ * also assert on every call that the stored counts match a recount.  A built-in document, and each file
+ * given, is parsed and then changed step by step through the List API: elements are added at the front,
+ * the back and in order, in batches and one at a time, to the document and to lists deep inside it;
+ * elements are removed and freed; a track is taken out, changed while outside the document and put back;
+ * lists are cleared and moved to other elements.  After every step the counts must match a walk of the
+ * whole document made here, and checkGPXCounts must pass.
+ *
+ * Exits with 1 on any difference.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GPXParser.h"
+#include "GPXHelpers.h"
+
+#ifndef GPX_CHECK_COUNTS
+#error "CountsCheck must be built with -DGPX_CHECK_COUNTS"
+#endif
+
+static const char* builtIn =
+	"<?xml version=\"1.0\"?>\n"
+	"<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"CountsCheck\">\n"
+	"<wpt lat=\"45.1\" lon=\"-75.1\"><name>A</name><ele>100</ele><sym>Flag</sym></wpt>\n"
+	"<wpt lat=\"45.2\" lon=\"-75.2\"/>\n"
+	"<rte><name>R</name><desc>route</desc>\n"
+	"<rtept lat=\"45.3\" lon=\"-75.3\"><ele>101</ele></rtept><rtept lat=\"45.4\" lon=\"-75.4\"/>\n"
+	"</rte>\n"
+	"<trk><name>T1</name><type>run</type>\n"
+	"<trkseg><trkpt lat=\"45.5\" lon=\"-75.5\"><ele>102</ele><time>2020-09-13T12:00:00Z</time></trkpt></trkseg>\n"
+	"<trkseg><trkpt lat=\"45.6\" lon=\"-75.6\"><cmt>x</cmt></trkpt><trkpt lat=\"45.7\" lon=\"-75.7\"/></trkseg>\n"
+	"</trk>\n"
+	"<trk><name>T2</name><trkseg/></trk>\n"
+	"</gpx>\n";
+
+/* ******************************* Recount *************************** */
+
+static int countData(List* waypoints){
+	ListIterator iter = createIterator(waypoints);
+	Waypoint* wpt;
+	int count = 0;
+
+	while ((wpt = nextElement(&iter)) != NULL){
+		count += getLength(wpt->otherData);
+	}
+	return count;
+}
+
+//Counts segments and GPXData with plain iteration, independently of the parser's own recount
+static void walk(GPXdoc* doc, int* numSegments, int* numData){
+	*numSegments = 0;
+	*numData = countData(doc->waypoints);
+
+	ListIterator iter = createIterator(doc->routes);
+	Route* rte;
+	while ((rte = nextElement(&iter)) != NULL){
+		*numData += getLength(rte->otherData) + countData(rte->waypoints);
+	}
+
+	iter = createIterator(doc->tracks);
+	Track* trk;
+	while ((trk = nextElement(&iter)) != NULL){
+		*numData += getLength(trk->otherData);
+
+		ListIterator segIter = createIterator(trk->segments);
+		TrackSegment* seg;
+		while ((seg = nextElement(&segIter)) != NULL){
+			(*numSegments)++;
+			*numData += countData(seg->waypoints);
+		}
+	}
+}
+
+static int failures;
+
+static void check(GPXdoc* doc, const char* source, const char* step){
+	int numSegments;
+	int numData;
+
+	walk(doc, &numSegments, &numData);
+	if (getNumSegments(doc) != numSegments || getNumGPXData(doc) != numData || !checkGPXCounts(doc)){
+		printf("  %s, %s: %d segments and %d GPXData counted, %d and %d walked\n", source, step,
+		       getNumSegments(doc), getNumGPXData(doc), numSegments, numData);
+		failures++;
+	}
+}
+
+/* ******************************* Elements *************************** */
+
+static Waypoint* newPoint(int numData){
+	Waypoint* wpt = createWaypoint();
+
+	for (int i = 0; i < numData; i++){
+		insertBack(wpt->otherData, createGPXData(i % 2 == 0 ? "cmt" : "desc", "added"));
+	}
+	return wpt;
+}
+
+static TrackSegment* newSegment(int numPoints){
+	TrackSegment* seg = createTrackSegment();
+
+	for (int i = 0; i < numPoints; i++){
+		insertBack(seg->waypoints, newPoint(i % 3));
+	}
+	return seg;
+}
+
+static Track* newTrack(int numSegments){
+	Track* trk = createTrack();
+
+	insertBack(trk->otherData, createGPXData("type", "walk"));
+	for (int i = 0; i < numSegments; i++){
+		insertBack(trk->segments, newSegment(i + 1));
+	}
+	return trk;
+}
+
+static Route* newRoute(int numPoints){
+	Route* rte = createRoute();
+
+	insertBack(rte->otherData, createGPXData("desc", "added"));
+	for (int i = 0; i < numPoints; i++){
+		insertBack(rte->waypoints, newPoint(1));
+	}
+	return rte;
+}
+
+/* ******************************* Steps *************************** */
+
+static void changeDocument(GPXdoc* doc, const char* source){
+	check(doc, source, "parsed");
+
+	insertBack(doc->tracks, newTrack(3));
+	check(doc, source, "insertBack track");
+
+	insertFront(doc->routes, newRoute(4));
+	check(doc, source, "insertFront route");
+
+	insertSorted(doc->waypoints, newPoint(2));
+	check(doc, source, "insertSorted waypoint");
+
+	//Lists deep inside elements that are already in the document
+	Track* trk = getFromBack(doc->tracks);
+	TrackSegment* seg = getFromFront(trk->segments);
+	Waypoint* wpt = getFromFront(seg->waypoints);
+	insertBack(wpt->otherData, createGPXData("sym", "Pin"));
+	insertFront(trk->otherData, createGPXData("cmt", "track"));
+	insertBack(trk->segments, newSegment(5));
+	check(doc, source, "insert into nested lists");
+
+	Waypoint* batch[] = {newPoint(0), newPoint(1), newPoint(2), newPoint(3)};
+	if (!insertBackArray(seg->waypoints, (void* const*)batch, 4)){
+		for (int i = 0; i < 4; i++){
+			deleteWaypoint(batch[i]);
+		}
+	}
+	check(doc, source, "insertBackArray points");
+
+	GPXData* data = deleteDataFromList(wpt->otherData, getFromBack(wpt->otherData));
+	deleteGpxData(data);
+	check(doc, source, "delete GPXData");
+
+	//A segment taken out is no longer counted, and neither are changes made to it afterwards
+	TrackSegment* removed = deleteDataFromList(trk->segments, getFromBack(trk->segments));
+	check(doc, source, "delete segment");
+	insertBack(removed->waypoints, newPoint(2));
+	check(doc, source, "change removed segment");
+	deleteTrackSegment(removed);
+
+	//A track taken out, changed and put back is counted again with its changes
+	Track* first = deleteDataFromList(doc->tracks, getFromFront(doc->tracks));
+	if (first != NULL){
+		check(doc, source, "delete track");
+		insertBack(first->segments, newSegment(2));
+		clearList(((TrackSegment*)getFromFront(first->segments))->waypoints);
+		check(doc, source, "change removed track");
+		insertSorted(doc->tracks, first);
+		check(doc, source, "insertSorted removed track");
+	}
+
+	//Moving segments between two tracks of the document leaves the totals as they were
+	Track* from = getFromFront(doc->tracks);
+	Track* to = getFromBack(doc->tracks);
+	if (from != to && from->segments->pool == to->segments->pool){
+		moveListElements(to->segments, from->segments);
+		check(doc, source, "moveListElements segments");
+	}
+
+	clearList(to->segments);
+	check(doc, source, "clearList segments");
+
+	Route* rte = getFromBack(doc->routes);
+	clearList(rte->waypoints);
+	check(doc, source, "clearList route points");
+
+	clearList(doc->routes);
+	clearList(doc->waypoints);
+	check(doc, source, "clearList routes and waypoints");
+
+	clearList(doc->tracks);
+	check(doc, source, "clearList tracks");
+
+	insertBack(doc->tracks, newTrack(2));
+	insertBack(doc->routes, newRoute(2));
+	check(doc, source, "insert into emptied document");
+}
+
+int main(int argc, char** argv){
+	GPXdoc* doc = createGPXdocFromMemory(builtIn, strlen(builtIn), 0);
+
+	if (doc == NULL){
+		fprintf(stderr, "Could not parse the built-in document\n");
+		return 1;
+	}
+	changeDocument(doc, "built-in");
+	deleteGPXdoc(doc);
+
+	doc = createEmptyGPXdoc();
+	changeDocument(doc, "empty");
+	deleteGPXdoc(doc);
+
+	for (int i = 1; i < argc; i++){
+		doc = createGPXdoc(argv[i]);
+		if (doc == NULL){
+			printf("  %s: cannot parse\n", argv[i]);
+			failures++;
+			continue;
+		}
+		changeDocument(doc, argv[i]);
+		deleteGPXdoc(doc);
+	}
+
+	printf("%d documents: %s\n", argc + 1, failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/*
+ * Equivalence test and benchmark for the path length kernels (GPXDistance.h).
+ *
+ * Usage: DistanceBench [numPoints]
+ *   Generates paths of numPoints points (default 2000000): uniformly random points on the sphere, a
+ *   dense random walk like a recorded track, points near the poles and pairs of nearly antipodal points.
+ *   Every kernel that runs on this machine is checked against getPathLengthScalar, over the whole path
+ *   and over windows of a few pairs, and timed in millions of points per second.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "GPXDistance.h"
+
+#define DEFAULT_POINTS 2000000
+
+//Points per window for the per-pair check: enough for one vector of each kernel plus leftover pairs
+#define WINDOW 7
+
+//Total time to spend timing each kernel on each path
+#define TIMING_SECONDS 0.5
+
+static const char* const KERNELS[] = {"scalar", "sse2", "avx2"};
+#define NUM_KERNELS (sizeof(KERNELS) / sizeof(KERNELS[0]))
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void){
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+//Uniform in [0, 1)
+static double nextUniform(void){
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+	const char* name;
+	double* latitude;
+	double* longitude;
+	int count;
+
+	//Largest relative difference from the scalar reference that is accepted
+	double tolerance;
+} Path;
+
+static double randomLatitude(void){
+	return asin(2 * nextUniform() - 1) * 180 / M_PI;
+}
+
+static double randomLongitude(void){
+	return 360 * nextUniform() - 180;
+}
+
+static void generateRandom(Path* path){
+	for (int i = 0; i < path->count; i++){
+		path->latitude[i] = randomLatitude();
+		path->longitude[i] = randomLongitude();
+	}
+}
+
+//Steps of up to ~15 m, turning slowly, as a GPS logger would record
+static void generateWalk(Path* path){
+	double lat = 43.5;
+	double lon = -80.2;
+	double heading = 0;
+
+	for (int i = 0; i < path->count; i++){
+		heading += (nextUniform() - 0.5) * 0.3;
+		lat += cos(heading) * nextUniform() * 1.4e-4;
+		lon += sin(heading) * nextUniform() * 1.9e-4;
+		path->latitude[i] = lat;
+		path->longitude[i] = lon;
+	}
+}
+
+//Within 0.1 degrees of the north pole, at any longitude, then of the south pole
+static void generatePolar(Path* path){
+	for (int i = 0; i < path->count; i++){
+		double lat = 90 - nextUniform() * 0.1;
+		path->latitude[i] = i < path->count / 2 ? lat : -lat;
+		path->longitude[i] = randomLongitude();
+	}
+}
+
+//Every point is within a few metres of the antipode of the one before
+static void generateAntipodal(Path* path){
+	for (int i = 0; i < path->count; i++){
+		if (i == 0){
+			path->latitude[i] = randomLatitude();
+			path->longitude[i] = randomLongitude();
+			continue;
+		}
+
+		double lon = path->longitude[i - 1] + 180 + (nextUniform() - 0.5) * 1e-4;
+		path->latitude[i] = -path->latitude[i - 1] + (nextUniform() - 0.5) * 1e-4;
+		path->longitude[i] = lon >= 180 ? lon - 360 : lon;
+	}
+}
+
+static int failures;
+
+static double relativeDifference(double value, double reference){
+	double diff = fabs(value - reference);
+	return reference != 0 ? diff / fabs(reference) : diff;
+}
+
+//Compares one kernel with the scalar reference.  Returns the largest relative difference found
+static double checkKernel(const Path* path, const char* kernel){
+	double worst = relativeDifference(getPathLengthWithKernel(kernel, path->latitude, path->longitude, path->count),
+	                                  getPathLengthScalar(path->latitude, path->longitude, path->count));
+
+	for (int i = 0; i + WINDOW <= path->count; i += WINDOW){
+		double value = getPathLengthWithKernel(kernel, path->latitude + i, path->longitude + i, WINDOW);
+		double reference = getPathLengthScalar(path->latitude + i, path->longitude + i, WINDOW);
+		double diff = relativeDifference(value, reference);
+
+		if (diff > worst){
+			worst = diff;
+		}
+	}
+	return worst;
+}
+
+//Returns millions of points per second
+static double timeKernel(const Path* path, const char* kernel){
+	volatile double sink = 0;
+	long points = 0;
+	double start = now();
+	double elapsed;
+
+	do {
+		sink += getPathLengthWithKernel(kernel, path->latitude, path->longitude, path->count);
+		points += path->count;
+		elapsed = now() - start;
+	} while (elapsed < TIMING_SECONDS);
+
+	(void)sink;
+	return points / elapsed / 1e6;
+}
+
+int main(int argc, char** argv){
+	int count = argc > 1 ? atoi(argv[1]) : DEFAULT_POINTS;
+
+	if (count < WINDOW){
+		fprintf(stderr, "Usage: %s [numPoints >= %d]\n", argv[0], WINDOW);
+		return 1;
+	}
+
+	//Nearly antipodal pairs are ill-conditioned: a rounding error in a coordinate moves the result far more
+	Path paths[] = {
+		{"random", NULL, NULL, count, 1e-12},
+		{"walk", NULL, NULL, count, 1e-12},
+		{"polar", NULL, NULL, count, 1e-12},
+		{"antipodal", NULL, NULL, count, 1e-8},
+	};
+	void (*generators[])(Path*) = {&generateRandom, &generateWalk, &generatePolar, &generateAntipodal};
+	int numPaths = sizeof(paths) / sizeof(paths[0]);
+
+	printf("%d points, getPathLength uses %s\n", count, getPathLengthKernel());
+	printf("  %-10s", "path");
+	for (size_t k = 0; k < NUM_KERNELS; k++){
+		printf(" %10s %-11s", KERNELS[k], "");
+	}
+	printf("\n");
+
+	for (int p = 0; p < numPaths; p++){
+		Path* path = &paths[p];
+		path->latitude = malloc(sizeof(double) * count);
+		path->longitude = malloc(sizeof(double) * count);
+		if (path->latitude == NULL || path->longitude == NULL){
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		generators[p](path);
+
+		double diffs[NUM_KERNELS] = {0};
+		printf("  %-10s", path->name);
+		for (size_t k = 0; k < NUM_KERNELS; k++){
+			if (isnan(getPathLengthWithKernel(KERNELS[k], path->latitude, path->longitude, WINDOW))){
+				printf(" %10s %-11s", "-", "");
+				continue;
+			}
+			diffs[k] = checkKernel(path, KERNELS[k]);
+			printf(" %6.1f Mpt/s (%7.1e)", timeKernel(path, KERNELS[k]), diffs[k]);
+		}
+		printf("\n");
+
+		for (size_t k = 0; k < NUM_KERNELS; k++){
+			if (!(diffs[k] <= path->tolerance)){
+				printf("  %s differs from the scalar reference on the %s path by %.3g, more than %.0e\n", KERNELS[k],
+				       path->name, diffs[k], path->tolerance);
+				failures++;
+			}
+		}
+
+		free(path->latitude);
+		free(path->longitude);
+	}
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
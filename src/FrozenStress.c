@@ -0,0 +1,162 @@
+/*
+ * Stress test for frozen documents: many threads share one frozen GPXdoc and read it at the same time
+ * with lookups, counts, iteration, printing and serialization, while the main thread gives up its own
+ * reference early so that the last reader frees the document.
+ *
+ * The FrozenStress target builds the parser sources with ThreadSanitizer, which reports any data race.
+ * Usage: FrozenStress file [threads] [iterations]
+ * Exits with 1 if any thread sees a result different from the one computed before the threads started.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "GPXParser.h"
+#include "GPXWriter.h"
+#include "GPXDistance.h"
+
+typedef struct {
+	int counts[5];
+	size_t stringLength;
+	size_t jsonLength;
+	float trackLength;
+} Expected;
+
+typedef struct {
+	GPXdoc* doc;
+	const Expected* expected;
+	int iterations;
+} ThreadArgs;
+
+static atomic_int failures;
+
+static void check(int ok, const char* what){
+	if (!ok){
+		atomic_fetch_add(&failures, 1);
+		fprintf(stderr, "Mismatch: %s\n", what);
+	}
+}
+
+static bool countBytes(void* userData, const char* data, size_t len){
+	*(size_t*)userData += len;
+	return true;
+}
+
+static void getCounts(const GPXdoc* doc, int* counts){
+	counts[0] = getNumWaypoints(doc);
+	counts[1] = getNumRoutes(doc);
+	counts[2] = getNumTracks(doc);
+	counts[3] = getNumSegments(doc);
+	counts[4] = getNumGPXData(doc);
+}
+
+static void getExpected(GPXdoc* doc, Expected* expected){
+	getCounts(doc, expected->counts);
+
+	char* str = GPXdocToString(doc);
+	expected->stringLength = strlen(str);
+	free(str);
+
+	GPXSink sink = {&expected->jsonLength, &countBytes};
+	expected->jsonLength = 0;
+	writeGPXdoc(doc, GPX_FORMAT_JSON, &sink);
+
+	expected->trackLength = 0;
+	ListIterator iter = createIterator(doc->tracks);
+	Track* trk;
+	while ((trk = nextElement(&iter)) != NULL){
+		expected->trackLength += getTrackLen(trk);
+	}
+}
+
+static void* reader(void* arg){
+	ThreadArgs* args = arg;
+	GPXdoc* doc = args->doc;
+
+	for (int i = 0; i < args->iterations; i++){
+		int counts[5];
+		getCounts(doc, counts);
+		check(memcmp(counts, args->expected->counts, sizeof(counts)) == 0, "counts");
+
+		ListIterator iter = createIterator(doc->waypoints);
+		Waypoint* wpt;
+		while ((wpt = nextElement(&iter)) != NULL){
+			Waypoint* found = getWaypoint(doc, wpt->name);
+			check(found != NULL && strcmp(found->name, wpt->name) == 0, "getWaypoint");
+		}
+
+		iter = createIterator(doc->routes);
+		Route* rte;
+		while ((rte = nextElement(&iter)) != NULL){
+			check(getRoute(doc, rte->name) != NULL, "getRoute");
+		}
+
+		iter = createIterator(doc->tracks);
+		Track* trk;
+		float trackLength = 0;
+		while ((trk = nextElement(&iter)) != NULL){
+			check(getTrack(doc, trk->name) != NULL, "getTrack");
+			trackLength += getTrackLen(trk);
+		}
+		check(trackLength == args->expected->trackLength, "getTrackLen");
+
+		char* str = GPXdocToString(doc);
+		check(str != NULL && strlen(str) == args->expected->stringLength, "GPXdocToString");
+		free(str);
+
+		size_t jsonLength = 0;
+		GPXSink sink = {&jsonLength, &countBytes};
+		check(writeGPXdoc(doc, GPX_FORMAT_JSON, &sink) && jsonLength == args->expected->jsonLength, "writeGPXdoc");
+	}
+
+	releaseGPXdoc(doc);
+	return NULL;
+}
+
+int main(int argc, char** argv){
+	if (argc < 2){
+		fprintf(stderr, "Usage: %s file [threads] [iterations]\n", argv[0]);
+		return 2;
+	}
+	int numThreads = argc > 2 ? atoi(argv[2]) : 8;
+	int iterations = argc > 3 ? atoi(argv[3]) : 20;
+
+	GPXdoc* doc = createGPXdoc(argv[1]);
+	if (doc == NULL || numThreads < 1){
+		fprintf(stderr, "Could not parse %s\n", argv[1]);
+		return 2;
+	}
+
+	Expected expected;
+	getExpected(doc, &expected);
+	if (!freezeGPXdoc(doc)){
+		fprintf(stderr, "Could not freeze the document\n");
+		return 2;
+	}
+
+	pthread_t* threads = malloc(numThreads * sizeof(pthread_t));
+	ThreadArgs args = {doc, &expected, iterations};
+	int started = 0;
+
+	for (int i = 0; i < numThreads; i++){
+		retainGPXdoc(doc);
+		if (pthread_create(&threads[i], NULL, &reader, &args) != 0){
+			releaseGPXdoc(doc);
+			break;
+		}
+		started++;
+	}
+
+	//The threads now own the document between them
+	releaseGPXdoc(doc);
+
+	for (int i = 0; i < started; i++){
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+	xmlCleanupParser();
+
+	int failed = atomic_load(&failures);
+	printf("%d threads x %d iterations: %s\n", started, iterations, failed == 0 ? "ok" : "FAILED");
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include "GPXArena.h"
+#include "GPXCounters.h"
+#include "GPXNames.h"
+#include "GPXSpatial.h"
+
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+#define ALIGNMENT (sizeof(max_align_t))
+
+typedef struct arenaChunk {
+    struct arenaChunk* next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaChunk;
+
+struct gpxArena {
+    ArenaChunk* chunks;
+    size_t chunkSize;
+    size_t numChunks;
+    size_t bytesUsed;
+    size_t bytesReserved;
+};
+
+GPXArena* createGPXArena(size_t chunkSize){
+    GPXArena* arena = malloc(sizeof(GPXArena));
+
+    if (arena == NULL){
+        return NULL;
+    }
+
+    arena->chunks = NULL;
+    arena->chunkSize = chunkSize == 0 ? DEFAULT_CHUNK_SIZE : chunkSize;
+    arena->numChunks = 0;
+    arena->bytesUsed = 0;
+    arena->bytesReserved = 0;
+
+    return arena;
+}
+
+void deleteGPXArena(GPXArena* arena){
+    if (arena == NULL){
+        return;
+    }
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL){
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void* arenaAlloc(GPXArena* arena, size_t size){
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size){
+        //Oversized requests get a chunk of their own so the current chunk is not abandoned
+        size_t chunkSize = size > arena->chunkSize / 4 ? size : arena->chunkSize;
+        ArenaChunk* newChunk = malloc(sizeof(ArenaChunk) + chunkSize);
+
+        if (newChunk == NULL){
+            return NULL;
+        }
+        newChunk->size = chunkSize;
+        newChunk->used = 0;
+
+        if (chunkSize == size && chunk != NULL){
+            newChunk->next = chunk->next;
+            chunk->next = newChunk;
+        }else{
+            newChunk->next = chunk;
+            arena->chunks = newChunk;
+        }
+        chunk = newChunk;
+        arena->numChunks++;
+        arena->bytesReserved += sizeof(ArenaChunk) + chunkSize;
+    }
+
+    void* ptr = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytesUsed += size;
+
+    return ptr;
+}
+
+char* arenaStrdup(GPXArena* arena, const char* str){
+    size_t len = strlen(str);
+    char* copy = arenaAlloc(arena, len + 1);
+
+    if (copy != NULL){
+        memcpy(copy, str, len + 1);
+    }
+    return copy;
+}
+
+void mergeGPXArena(GPXArena* arena, GPXArena* from){
+    ArenaChunk* last = from->chunks;
+
+    //The first chunk of arena is the one being allocated from, so the new chunks go after it
+    if (last != NULL){
+        while (last->next != NULL){
+            last = last->next;
+        }
+
+        if (arena->chunks == NULL){
+            arena->chunks = from->chunks;
+        }else{
+            last->next = arena->chunks->next;
+            arena->chunks->next = from->chunks;
+        }
+    }
+
+    arena->numChunks += from->numChunks;
+    arena->bytesUsed += from->bytesUsed;
+    arena->bytesReserved += from->bytesReserved;
+    free(from);
+}
+
+size_t getArenaChunkCount(const GPXArena* arena){
+    return arena->numChunks;
+}
+
+size_t getArenaBytesUsed(const GPXArena* arena){
+    return arena->bytesUsed;
+}
+
+size_t getArenaBytesReserved(const GPXArena* arena){
+    return sizeof(GPXArena) + arena->bytesReserved;
+}
+
+/* ******************************* Model constructors *************************** */
+
+//Contents of arena lists are released with the arena, not one by one
+static void deleteArenaData(void* data){
+}
+
+List* createArenaList(GPXArena* arena, char* (*printFunction)(void* toBePrinted), int (*compareFunction)(const void* first, const void* second)){
+    List* list = arenaAlloc(arena, sizeof(List));
+
+    if (list == NULL){
+        return NULL;
+    }
+
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
+    list->deleteData = &deleteArenaData;
+    list->compare = compareFunction;
+    list->printData = printFunction;
+    list->onInsert = NULL;
+    list->onRemove = NULL;
+    list->observer = NULL;
+    list->pool = NULL;
+    list->fill = NULL;
+    list->source = NULL;
+
+    return list;
+}
+
+GPXData* createArenaGPXData(GPXArena* arena, const char* name, const char* value){
+    if (name[0] == '\0' || value[0] == '\0'){
+        return NULL;
+    }
+
+    size_t valueLen = strlen(value);
+    void* block = arenaAlloc(arena, getGPXDataSize(valueLen));
+
+    return block != NULL ? fillGPXData(block, name, value, valueLen) : NULL;
+}
+
+GPXData* createArenaGPXDataRecord(GPXArena* arena, const char* name, const char* value){
+    if (name[0] == '\0' || value[0] == '\0'){
+        return NULL;
+    }
+
+    const char* shared = internGPXName(name);
+    size_t valueLen = strlen(value);
+    void* block = arenaAlloc(arena, getGPXDataRecordSize(shared, name, valueLen));
+
+    return block != NULL ? fillGPXDataRecord(block, shared, name, value, valueLen) : NULL;
+}
+
+Waypoint* createArenaWaypoint(GPXArena* arena){
+    Waypoint* wpt = arenaAlloc(arena, sizeof(Waypoint));
+
+    if (wpt == NULL){
+        return NULL;
+    }
+
+    wpt->name = arenaStrdup(arena, "");
+    wpt->latitude = 0.0;
+    wpt->longitude = 0.0;
+    wpt->time = GPX_NO_TIME;
+    wpt->fields = 0;
+    wpt->otherData = createArenaList(arena, &gpxDataToString, &compareGpxData);
+
+    return wpt->name != NULL && wpt->otherData != NULL ? wpt : NULL;
+}
+
+Route* createArenaRoute(GPXArena* arena){
+    Route* rte = arenaAlloc(arena, sizeof(Route));
+
+    if (rte == NULL){
+        return NULL;
+    }
+
+    rte->name = arenaStrdup(arena, "");
+    resetBounds(&rte->bounds);
+    rte->waypoints = createArenaList(arena, &waypointToString, &compareWaypoints);
+    rte->otherData = createArenaList(arena, &gpxDataToString, &compareGpxData);
+
+    return rte->name != NULL && rte->waypoints != NULL && rte->otherData != NULL ? rte : NULL;
+}
+
+TrackSegment* createArenaTrackSegment(GPXArena* arena){
+    TrackSegment* seg = arenaAlloc(arena, sizeof(TrackSegment));
+
+    if (seg == NULL){
+        return NULL;
+    }
+
+    resetBounds(&seg->bounds);
+    seg->waypoints = createArenaList(arena, &waypointToString, &compareWaypoints);
+
+    return seg->waypoints != NULL ? seg : NULL;
+}
+
+Track* createArenaTrack(GPXArena* arena){
+    Track* trk = arenaAlloc(arena, sizeof(Track));
+
+    if (trk == NULL){
+        return NULL;
+    }
+
+    trk->name = arenaStrdup(arena, "");
+    resetBounds(&trk->bounds);
+    trk->segments = createArenaList(arena, &trackSegmentToString, &compareTrackSegments);
+    trk->otherData = createArenaList(arena, &gpxDataToString, &compareGpxData);
+
+    return trk->name != NULL && trk->segments != NULL && trk->otherData != NULL ? trk : NULL;
+}
+
+GPXdoc* createArenaGPXdoc(GPXArena* arena){
+    GPXdoc* doc = arenaAlloc(arena, sizeof(GPXdoc));
+
+    if (doc == NULL){
+        return NULL;
+    }
+
+    doc->namespace[0] = '\0';
+    doc->version = 0.0;
+    doc->creator = NULL;
+    doc->arena = arena;
+    doc->nameIndex = NULL;
+    doc->lazy = NULL;
+    doc->frozen = false;
+    atomic_init(&doc->refCount, 1);
+    doc->waypoints = createArenaList(arena, &waypointToString, &compareWaypoints);
+    doc->routes = createArenaList(arena, &routeToString, &compareRoutes);
+    doc->tracks = createArenaList(arena, &trackToString, &compareTracks);
+
+    if (doc->waypoints == NULL || doc->routes == NULL || doc->tracks == NULL){
+        return NULL;
+    }
+
+    attachGPXCounters(doc);
+    return doc;
+}
+
+bool arenaInsertBack(GPXArena* arena, List* list, void* data){
+    Node* node = arenaAlloc(arena, sizeof(Node));
+
+    if (node == NULL){
+        return false;
+    }
+
+    node->data = data;
+    node->next = NULL;
+    node->previous = list->tail;
+
+    if (list->tail == NULL){
+        list->head = node;
+    }else{
+        list->tail->next = node;
+    }
+    list->tail = node;
+    list->length++;
+
+    if (list->onInsert != NULL){
+        list->onInsert(list->observer, data);
+    }
+    return true;
+}
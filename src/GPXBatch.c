@@ -0,0 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <unistd.h>
+#include "GPXBatch.h"
+#include "GPXWorkers.h"
+#include "GPXHelpers.h"
+
+typedef struct {
+    char** fileNames;
+    unsigned int options;
+    GPXBatchResult* results;
+} Batch;
+
+static void parseFile(void* userData, int index){
+    Batch* batch = userData;
+    GPXBatchResult* result = &batch->results[index];
+
+    result->doc = createGPXdocWithOptions(batch->fileNames[index], batch->options);
+    if (result->doc != NULL){
+        result->status = GPX_BATCH_OK;
+    }else if (batch->fileNames[index] == NULL || access(batch->fileNames[index], R_OK) != 0){
+        result->status = GPX_BATCH_UNREADABLE;
+    }else{
+        result->status = GPX_BATCH_INVALID;
+    }
+}
+
+GPXBatchResult* parseGPXBatch(char** fileNames, int numFiles, unsigned int options, int numThreads){
+    if (fileNames == NULL || numFiles < 1){
+        return NULL;
+    }
+
+    GPXBatchResult* results = malloc(numFiles * sizeof(GPXBatchResult));
+    if (results == NULL){
+        return NULL;
+    }
+
+    initGPXLibxml();
+
+    Batch batch = {fileNames, options, results};
+    runGPXTasks(numFiles, numThreads, &parseFile, &batch);
+
+    return results;
+}
+
+void deleteGPXBatch(GPXBatchResult* results, int numFiles){
+    if (results == NULL){
+        return;
+    }
+
+    for (int i = 0; i < numFiles; i++){
+        deleteGPXdoc(results[i].doc);
+    }
+    free(results);
+}
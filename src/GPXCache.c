@@ -0,0 +1,417 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "GPXCache.h"
+#include "GPXArena.h"
+#include "GPXIndex.h"
+#include "GPXHelpers.h"
+#include "GPXNames.h"
+
+#define INITIAL_BUCKETS 16
+
+//Identity of a file at the time it was parsed
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+} FileKey;
+
+typedef struct cacheEntry {
+    char* path;
+    uint32_t hash;
+    FileKey key;
+    GPXdoc* doc;
+    size_t bytes;
+
+    //Next entry in the same bucket
+    struct cacheEntry* next;
+    //Neighbours in recency order
+    struct cacheEntry* newer;
+    struct cacheEntry* older;
+} CacheEntry;
+
+struct gpxCache {
+    pthread_mutex_t lock;
+    size_t byteBudget;
+    unsigned int options;
+
+    //Chained hash table on path.  numBuckets is a power of two
+    CacheEntry** buckets;
+    size_t numBuckets;
+
+    CacheEntry* newest;
+    CacheEntry* oldest;
+
+    GPXCacheStats stats;
+};
+
+/* ******************************* Size estimate *************************** */
+
+//Size of the block malloc hands out for a request of size bytes
+static size_t allocSize(size_t size){
+    size = (size + sizeof(size_t) + 15) & ~(size_t)15;
+    return size < 32 ? 32 : size;
+}
+
+static size_t stringSize(const char* str){
+    return str == NULL ? 0 : allocSize(strlen(str) + 1);
+}
+
+static size_t listSize(const List* list){
+    //Pooled nodes are packed into slabs with no malloc header of their own
+    size_t nodeSize = list->pool != NULL ? sizeof(Node) : allocSize(sizeof(Node));
+    return allocSize(sizeof(List)) + (size_t)list->length * nodeSize;
+}
+
+static size_t gpxDataListSize(List* list){
+    size_t size = listSize(list);
+    ListIterator iter = createIterator(list);
+    GPXData* data;
+
+    while ((data = nextElement(&iter)) != NULL){
+        const GPXDataRecord* record = isGPXDataRecord(data) ? (const GPXDataRecord*)data : NULL;
+
+        if (record == NULL){
+            size += allocSize(getGPXDataSize(strlen(data->value)));
+            continue;
+        }
+
+        //A name that is not shared is stored right after the value
+        size_t valueLen = strlen(record->value);
+        const char* shared = record->name == record->value + valueLen + 1 ? NULL : record->name;
+        size += allocSize(getGPXDataRecordSize(shared, record->name, valueLen));
+    }
+    return size;
+}
+
+static size_t waypointListSize(List* list){
+    size_t size = listSize(list);
+    ListIterator iter = createIterator(list);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        size += allocSize(sizeof(Waypoint)) + stringSize(wpt->name) + gpxDataListSize(wpt->otherData);
+    }
+    return size;
+}
+
+size_t estimateGPXdocSize(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+
+    size_t size = getNameIndexSize(doc->nameIndex);
+
+    //Everything else in an arena document lives in the arena's chunks
+    if (doc->arena != NULL){
+        return size + getArenaBytesReserved(doc->arena);
+    }
+
+    size += allocSize(sizeof(GPXdoc)) + stringSize(doc->creator);
+    size += waypointListSize(doc->waypoints);
+
+    size += listSize(doc->routes);
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        size += allocSize(sizeof(Route)) + stringSize(rte->name);
+        size += waypointListSize(rte->waypoints) + gpxDataListSize(rte->otherData);
+    }
+
+    size += listSize(doc->tracks);
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        size += allocSize(sizeof(Track)) + stringSize(trk->name);
+        size += listSize(trk->segments) + gpxDataListSize(trk->otherData);
+
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+        while ((seg = nextElement(&segIter)) != NULL){
+            size += allocSize(sizeof(TrackSegment)) + waypointListSize(seg->waypoints);
+        }
+    }
+
+    return size;
+}
+
+/* ******************************* Entries *************************** */
+
+static uint32_t hashPath(const char* path){
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char* c = (const unsigned char*)path; *c != '\0'; c++){
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static bool statFile(const char* fileName, FileKey* key){
+    struct stat info;
+
+    if (stat(fileName, &info) != 0 || !S_ISREG(info.st_mode)){
+        return false;
+    }
+
+    key->device = info.st_dev;
+    key->inode = info.st_ino;
+    key->size = info.st_size;
+    key->modified = info.st_mtim;
+    return true;
+}
+
+static bool sameFile(const FileKey* first, const FileKey* second){
+    return first->device == second->device && first->inode == second->inode && first->size == second->size
+        && first->modified.tv_sec == second->modified.tv_sec && first->modified.tv_nsec == second->modified.tv_nsec;
+}
+
+static CacheEntry** findSlot(GPXCache* cache, const char* path, uint32_t hash){
+    CacheEntry** slot = &cache->buckets[hash & (cache->numBuckets - 1)];
+
+    while (*slot != NULL && !((*slot)->hash == hash && strcmp((*slot)->path, path) == 0)){
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static void unlinkRecency(GPXCache* cache, CacheEntry* entry){
+    if (entry->newer != NULL){
+        entry->newer->older = entry->older;
+    }else{
+        cache->newest = entry->older;
+    }
+
+    if (entry->older != NULL){
+        entry->older->newer = entry->newer;
+    }else{
+        cache->oldest = entry->newer;
+    }
+}
+
+static void linkNewest(GPXCache* cache, CacheEntry* entry){
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if (cache->newest != NULL){
+        cache->newest->newer = entry;
+    }else{
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+//Takes an entry out of the cache and pushes it on removed, to be freed once the lock is released
+static void removeEntry(GPXCache* cache, CacheEntry* entry, CacheEntry** removed){
+    CacheEntry** slot = findSlot(cache, entry->path, entry->hash);
+
+    *slot = entry->next;
+    unlinkRecency(cache, entry);
+
+    cache->stats.numDocs--;
+    cache->stats.bytesUsed -= entry->bytes;
+
+    entry->next = *removed;
+    *removed = entry;
+}
+
+//Releasing a large document takes a while, so it is done outside the lock
+static void freeEntries(CacheEntry* entry){
+    while (entry != NULL){
+        CacheEntry* next = entry->next;
+
+        releaseGPXdoc(entry->doc);
+        free(entry->path);
+        free(entry);
+        entry = next;
+    }
+}
+
+//Doubles the bucket array.  The table keeps working at its old size if malloc fails
+static void growBuckets(GPXCache* cache){
+    size_t numBuckets = cache->numBuckets * 2;
+    CacheEntry** buckets = calloc(numBuckets, sizeof(CacheEntry*));
+
+    if (buckets == NULL){
+        return;
+    }
+
+    for (size_t i = 0; i < cache->numBuckets; i++){
+        CacheEntry* entry = cache->buckets[i];
+
+        while (entry != NULL){
+            CacheEntry* next = entry->next;
+            size_t bucket = entry->hash & (numBuckets - 1);
+
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->numBuckets = numBuckets;
+}
+
+/* ******************************* Public API *************************** */
+
+GPXCache* createGPXCache(size_t byteBudget, unsigned int options){
+    GPXCache* cache = calloc(1, sizeof(GPXCache));
+
+    if (cache == NULL){
+        return NULL;
+    }
+
+    cache->buckets = calloc(INITIAL_BUCKETS, sizeof(CacheEntry*));
+    if (cache->buckets == NULL || pthread_mutex_init(&cache->lock, NULL) != 0){
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+
+    cache->numBuckets = INITIAL_BUCKETS;
+    cache->byteBudget = byteBudget;
+    cache->options = options;
+    cache->stats.byteBudget = byteBudget;
+
+    return cache;
+}
+
+void deleteGPXCache(GPXCache* cache){
+    if (cache == NULL){
+        return;
+    }
+
+    clearGPXCache(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+void clearGPXCache(GPXCache* cache){
+    CacheEntry* removed = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    while (cache->oldest != NULL){
+        removeEntry(cache, cache->oldest, &removed);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    freeEntries(removed);
+}
+
+void getGPXCacheStats(GPXCache* cache, GPXCacheStats* stats){
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+GPXdoc* getCachedGPXdoc(GPXCache* cache, const char* fileName){
+    if (cache == NULL || fileName == NULL){
+        return NULL;
+    }
+
+    uint32_t hash = hashPath(fileName);
+    CacheEntry* removed = NULL;
+    FileKey key;
+    bool exists = statFile(fileName, &key);
+
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry* entry = *findSlot(cache, fileName, hash);
+
+    if (entry != NULL && exists && sameFile(&entry->key, &key)){
+        GPXdoc* doc = retainGPXdoc(entry->doc);
+
+        cache->stats.hits++;
+        unlinkRecency(cache, entry);
+        linkNewest(cache, entry);
+        pthread_mutex_unlock(&cache->lock);
+        return doc;
+    }
+
+    if (entry != NULL){
+        removeEntry(cache, entry, &removed);
+        cache->stats.invalidations++;
+    }
+    cache->stats.misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    freeEntries(removed);
+    removed = NULL;
+
+    if (!exists){
+        return NULL;
+    }
+
+    //The file is parsed without holding the lock, so other files can be looked up meanwhile
+    initGPXLibxml();
+    GPXdoc* doc = createGPXdocWithOptions((char*)fileName, cache->options);
+    if (doc == NULL || !freezeGPXdoc(doc)){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+
+    //A file that changed while it was being parsed may have been read half old and half new
+    FileKey after;
+    size_t bytes = estimateGPXdocSize(doc);
+    if (!statFile(fileName, &after) || !sameFile(&key, &after) || bytes > cache->byteBudget){
+        return doc;
+    }
+
+    CacheEntry* added = malloc(sizeof(CacheEntry));
+    char* path = malloc(strlen(fileName) + 1);
+    if (added == NULL || path == NULL){
+        free(added);
+        free(path);
+        return doc;
+    }
+    strcpy(path, fileName);
+
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry** slot = findSlot(cache, fileName, hash);
+
+    //Another thread parsed the same file at the same time.  Its document is shared rather than kept twice
+    if (*slot != NULL && sameFile(&(*slot)->key, &key)){
+        GPXdoc* shared = retainGPXdoc((*slot)->doc);
+
+        unlinkRecency(cache, *slot);
+        linkNewest(cache, *slot);
+        pthread_mutex_unlock(&cache->lock);
+
+        releaseGPXdoc(doc);
+        free(added);
+        free(path);
+        return shared;
+    }
+    if (*slot != NULL){
+        removeEntry(cache, *slot, &removed);
+        cache->stats.invalidations++;
+        slot = findSlot(cache, fileName, hash);
+    }
+
+    added->path = path;
+    added->hash = hash;
+    added->key = key;
+    added->doc = retainGPXdoc(doc);
+    added->bytes = bytes;
+    added->next = NULL;
+    *slot = added;
+    linkNewest(cache, added);
+
+    cache->stats.numDocs++;
+    cache->stats.bytesUsed += bytes;
+
+    while (cache->stats.bytesUsed > cache->byteBudget){
+        removeEntry(cache, cache->oldest, &removed);
+        cache->stats.evictions++;
+    }
+    if ((size_t)cache->stats.numDocs > cache->numBuckets){
+        growBuckets(cache);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    freeEntries(removed);
+    return doc;
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include "GPXColumns.h"
+#include "GPXHelpers.h"
+
+//Takes <ele> and <time> from the values the parser decoded, or decodes them from a point's otherData.
+//Returns true if the point has any other data
+static bool decodeOtherData(const Waypoint* wpt, double* ele, long long* time){
+    ListIterator iter = createIterator(wpt->otherData);
+    GPXData* data;
+    bool hasOther = false;
+
+    if (wpt->fields & GPX_FIELD_ELEVATION){
+        *ele = wpt->elevation;
+    }
+    if (wpt->fields & GPX_FIELD_TIME){
+        *time = wpt->time;
+    }
+
+    while ((data = nextElement(&iter)) != NULL){
+        const char* name = getGPXDataName(data);
+        const char* value = getGPXDataValue(data);
+
+        if (strcmp(name, "ele") == 0 && ((wpt->fields & GPX_FIELD_ELEVATION) || parseGPXDouble(value, ele))){
+            continue;
+        }
+        //Waypoints built outside the parser may carry a <time> that was never decoded
+        if (strcmp(name, "time") == 0 && ((wpt->fields & GPX_FIELD_TIME) || parseGPXTime(value, time))){
+            continue;
+        }
+        hasOther = true;
+    }
+    return hasOther;
+}
+
+GPXColumns* createColumns(List* waypoints){
+    if (waypoints == NULL){
+        return NULL;
+    }
+
+    int count = getLength(waypoints);
+
+    //The three coordinate arrays share one allocation so they are contiguous in memory.  The time column has
+    //its own, so that it can be freed on its own when no point has a time
+    GPXColumns* columns = malloc(sizeof(GPXColumns));
+    double* values = malloc(sizeof(double) * 3 * (count > 0 ? count : 1));
+    long long* times = malloc(sizeof(long long) * (count > 0 ? count : 1));
+
+    if (columns == NULL || values == NULL || times == NULL){
+        free(columns);
+        free(values);
+        free(times);
+        return NULL;
+    }
+
+    columns->count = count;
+    columns->latitude = values;
+    columns->longitude = values + count;
+    columns->elevation = values + 2 * count;
+    columns->time = times;
+    columns->numSparse = 0;
+    columns->sparse = NULL;
+
+    bool anyElevation = false;
+    bool anyTime = false;
+    int sparseCap = 0;
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    for (int i = 0; (wpt = nextElement(&iter)) != NULL; i++){
+        double ele = NAN;
+        long long time = GPX_NO_TIME;
+        bool hasOther = decodeOtherData(wpt, &ele, &time);
+
+        columns->latitude[i] = wpt->latitude;
+        columns->longitude[i] = wpt->longitude;
+        columns->elevation[i] = ele;
+        columns->time[i] = time;
+        anyElevation = anyElevation || !isnan(ele);
+        anyTime = anyTime || time != GPX_NO_TIME;
+
+        if (!hasOther && wpt->name[0] == '\0'){
+            continue;
+        }
+        if (columns->numSparse == sparseCap){
+            sparseCap = sparseCap == 0 ? 16 : sparseCap * 2;
+            GPXSparsePoint* tmp = realloc(columns->sparse, sizeof(GPXSparsePoint) * sparseCap);
+            if (tmp == NULL){
+                deleteColumns(columns);
+                return NULL;
+            }
+            columns->sparse = tmp;
+        }
+
+        GPXSparsePoint* point = &columns->sparse[columns->numSparse++];
+        point->index = i;
+        point->name = wpt->name;
+        point->otherData = wpt->otherData;
+    }
+
+    //Drop the optional columns nobody uses.  The elevation column is part of the coordinate block
+    if (!anyElevation){
+        columns->elevation = NULL;
+    }
+    if (!anyTime){
+        free(columns->time);
+        columns->time = NULL;
+    }
+    return columns;
+}
+
+GPXColumns* createSegmentColumns(const TrackSegment* seg){
+    return seg != NULL ? createColumns(seg->waypoints) : NULL;
+}
+
+GPXColumns* createRouteColumns(const Route* rte){
+    return rte != NULL ? createColumns(rte->waypoints) : NULL;
+}
+
+void deleteColumns(GPXColumns* columns){
+    if (columns == NULL){
+        return;
+    }
+
+    free(columns->latitude);
+    free(columns->time);
+    free(columns->sparse);
+    free(columns);
+}
+
+const GPXSparsePoint* getSparsePoint(const GPXColumns* columns, int index){
+    if (columns == NULL){
+        return NULL;
+    }
+
+    int low = 0;
+    int high = columns->numSparse - 1;
+
+    while (low <= high){
+        int mid = low + (high - low) / 2;
+        int found = columns->sparse[mid].index;
+
+        if (found == index){
+            return &columns->sparse[mid];
+        }
+        if (found < index){
+            low = mid + 1;
+        }else{
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+const char* getColumnName(const GPXColumns* columns, int index){
+    const GPXSparsePoint* point = getSparsePoint(columns, index);
+
+    return point != NULL ? point->name : "";
+}
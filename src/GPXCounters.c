@@ -0,0 +1,278 @@
+#include <assert.h>
+#include "GPXCounters.h"
+#include "GPXIndex.h"
+#include "GPXLazy.h"
+
+/* ******************************* Observers *************************** */
+
+//Whether a change should be counted.  A frozen document must not change at all
+static bool isTracking(GPXdoc* doc){
+    assert(!doc->countersActive || !doc->frozen);
+    return doc->countersActive;
+}
+
+static void gpxDataInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        doc->numGPXData++;
+    }
+}
+
+static void gpxDataRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        doc->numGPXData--;
+    }
+}
+
+static void observeData(GPXdoc* doc, List* otherData){
+    doc->numGPXData += getLength(otherData);
+    setListObserver(otherData, doc, &gpxDataInserted, &gpxDataRemoved);
+}
+
+static void ignoreData(GPXdoc* doc, List* otherData){
+    doc->numGPXData -= getLength(otherData);
+    setListObserver(otherData, NULL, NULL, NULL);
+}
+
+static void waypointInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        observeData(doc, ((Waypoint*)data)->otherData);
+    }
+}
+
+static void waypointRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        ignoreData(doc, ((Waypoint*)data)->otherData);
+    }
+}
+
+static void observeWaypoints(GPXdoc* doc, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        observeData(doc, wpt->otherData);
+    }
+    setListObserver(waypoints, doc, &waypointInserted, &waypointRemoved);
+}
+
+static void ignoreWaypoints(GPXdoc* doc, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        ignoreData(doc, wpt->otherData);
+    }
+    setListObserver(waypoints, NULL, NULL, NULL);
+}
+
+static void segmentInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        doc->numSegments++;
+        observeWaypoints(doc, ((TrackSegment*)data)->waypoints);
+    }
+}
+
+static void segmentRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        doc->numSegments--;
+        ignoreWaypoints(doc, ((TrackSegment*)data)->waypoints);
+    }
+}
+
+static void observeTrack(GPXdoc* doc, Track* trk){
+    ListIterator iter = createIterator(trk->segments);
+    TrackSegment* seg;
+
+    while ((seg = nextElement(&iter)) != NULL){
+        doc->numSegments++;
+        observeWaypoints(doc, seg->waypoints);
+    }
+    setListObserver(trk->segments, doc, &segmentInserted, &segmentRemoved);
+    observeData(doc, trk->otherData);
+}
+
+static void ignoreTrack(GPXdoc* doc, Track* trk){
+    ListIterator iter = createIterator(trk->segments);
+    TrackSegment* seg;
+
+    while ((seg = nextElement(&iter)) != NULL){
+        doc->numSegments--;
+        ignoreWaypoints(doc, seg->waypoints);
+    }
+    setListObserver(trk->segments, NULL, NULL, NULL);
+    ignoreData(doc, trk->otherData);
+}
+
+//The document's own lists also keep the name index, and the elements still to load of a lazy document, informed
+
+static void docWaypointInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_WAYPOINTS);
+        observeData(doc, ((Waypoint*)data)->otherData);
+    }
+}
+
+static void docWaypointRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_WAYPOINTS);
+        ignoreData(doc, ((Waypoint*)data)->otherData);
+    }
+}
+
+static void docRouteInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+    Route* rte = data;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_ROUTES);
+        observeWaypoints(doc, rte->waypoints);
+        observeData(doc, rte->otherData);
+    }
+}
+
+static void docRouteRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+    Route* rte = data;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_ROUTES);
+        forgetLazyElement(doc, rte);
+        ignoreWaypoints(doc, rte->waypoints);
+        ignoreData(doc, rte->otherData);
+    }
+}
+
+static void docTrackInserted(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_TRACKS);
+        observeTrack(doc, data);
+    }
+}
+
+static void docTrackRemoved(void* observer, void* data){
+    GPXdoc* doc = observer;
+
+    if (isTracking(doc)){
+        markNameIndexStale(doc->nameIndex, INDEX_TRACKS);
+        forgetLazyElement(doc, data);
+        ignoreTrack(doc, data);
+    }
+}
+
+void attachGPXCounters(GPXdoc* doc){
+    doc->numSegments = 0;
+    doc->numGPXData = 0;
+    doc->countersActive = true;
+
+    ListIterator iter = createIterator(doc->waypoints);
+    void* elem;
+
+    while ((elem = nextElement(&iter)) != NULL){
+        observeData(doc, ((Waypoint*)elem)->otherData);
+    }
+
+    iter = createIterator(doc->routes);
+    while ((elem = nextElement(&iter)) != NULL){
+        observeWaypoints(doc, ((Route*)elem)->waypoints);
+        observeData(doc, ((Route*)elem)->otherData);
+    }
+
+    iter = createIterator(doc->tracks);
+    while ((elem = nextElement(&iter)) != NULL){
+        observeTrack(doc, elem);
+    }
+
+    setListObserver(doc->waypoints, doc, &docWaypointInserted, &docWaypointRemoved);
+    setListObserver(doc->routes, doc, &docRouteInserted, &docRouteRemoved);
+    setListObserver(doc->tracks, doc, &docTrackInserted, &docTrackRemoved);
+}
+
+void detachGPXCounters(GPXdoc* doc){
+    //Observers still registered on nested lists see the flag and do nothing
+    doc->countersActive = false;
+}
+
+/* ******************************* Recounting *************************** */
+
+//The recounts skip the elements of a lazy document that are still to be loaded: their lists are empty,
+//and reading them would load them
+
+int countGPXSegments(const GPXdoc* doc){
+    int count = 0;
+    ListIterator iter = createIterator(doc->tracks);
+    Track* trk;
+
+    while ((trk = nextElement(&iter)) != NULL){
+        if (!isLazyElementPending(doc, trk)){
+            count += getLength(trk->segments);
+        }
+    }
+    return count;
+}
+
+//Counts the otherData elements of every waypoint in a list
+static int countWaypointData(List* waypoints){
+    int count = 0;
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        count += getLength(wpt->otherData);
+    }
+    return count;
+}
+
+int countGPXData(const GPXdoc* doc){
+    int count = countWaypointData(doc->waypoints);
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+
+    while ((rte = nextElement(&iter)) != NULL){
+        count += getLength(rte->otherData);
+        if (!isLazyElementPending(doc, rte)){
+            count += countWaypointData(rte->waypoints);
+        }
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+
+    while ((trk = nextElement(&iter)) != NULL){
+        count += getLength(trk->otherData);
+        if (isLazyElementPending(doc, trk)){
+            continue;
+        }
+
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+        while ((seg = nextElement(&segIter)) != NULL){
+            count += countWaypointData(seg->waypoints);
+        }
+    }
+    return count;
+}
+
+bool checkGPXCounts(const GPXdoc* doc){
+    if (doc == NULL){
+        return true;
+    }
+    return doc->numSegments == countGPXSegments(doc) && doc->numGPXData == countGPXData(doc);
+}
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "GPXDistance.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+    #define GPX_X86_SIMD
+    #include <immintrin.h>
+#endif
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+//Number of points gathered from a List before running the kernel over them
+#define BATCH_SIZE 1024
+
+double haversineDistance(double lat1, double lon1, double lat2, double lon2){
+    //Differences are taken in degrees, before conversion, to avoid cancellation between nearby points
+    double sinLat = sin((lat2 - lat1) * DEG_TO_RAD / 2);
+    double sinLon = sin((lon2 - lon1) * DEG_TO_RAD / 2);
+    double a = sinLat * sinLat + cos(lat1 * DEG_TO_RAD) * cos(lat2 * DEG_TO_RAD) * sinLon * sinLon;
+
+    if (a > 1.0){
+        a = 1.0;
+    }
+    return 2 * EARTH_RADIUS * asin(sqrt(a));
+}
+
+double getPathLengthScalar(const double* latitude, const double* longitude, int count){
+    double total = 0.0;
+
+    for (int i = 0; i + 1 < count; i++){
+        total += haversineDistance(latitude[i], longitude[i], latitude[i + 1], longitude[i + 1]);
+    }
+    return total;
+}
+
+#ifdef GPX_X86_SIMD
+
+/* The vector kernels evaluate
+       a = sin^2(dLat/2) + cos(lat1) cos(lat2) sin^2(dLon/2),   d = 2R asin(sqrt(a))
+   with polynomials instead of libm calls:
+   - Arguments are reduced by multiples of pi (two-part constant) into [-pi/2, pi/2].  sin^2 has
+     period pi; cos changes sign for odd multiples.
+   - sin uses its Taylor series to x^21, accurate to ~1e-18 on [-pi/2, pi/2].  cos(x) is evaluated as
+     sin(pi/2 - |x|) so it keeps full relative accuracy near the poles.
+   - asin(h) uses its Taylor series to x^17, accurate to ~1e-18 for h < 0.1 (pairs up to ~1270 km
+     apart).  When any lane is larger, the angle is first halved four times with
+     s' = s / sqrt(2(1 + c)), c' = sqrt((1 + c) / 2). */
+
+static const double SIN_COEF[] = {
+    1.9572941063391263e-20, -8.22063524662433e-18, 2.8114572543455206e-15, -7.647163731819816e-13,
+    1.6059043836821613e-10, -2.505210838544172e-08, 2.7557319223985893e-06, -0.0001984126984126984,
+    0.008333333333333333, -0.16666666666666666, 1.0
+};
+
+static const double ASIN_COEF[] = {
+    0.011551800896139705, 0.01396484375, 0.017352764423076924, 0.022372159090909092,
+    0.030381944444444444, 0.044642857142857144, 0.075, 0.16666666666666666, 1.0
+};
+
+#define NUM_SIN_COEF (sizeof(SIN_COEF) / sizeof(SIN_COEF[0]))
+#define NUM_ASIN_COEF (sizeof(ASIN_COEF) / sizeof(ASIN_COEF[0]))
+#define ASIN_HALVINGS 4
+#define ASIN_DIRECT_LIMIT 0.1
+
+//pi and pi/2 split into a double and the remainder, for accurate argument reduction
+#define PI_HIGH 3.141592653589793
+#define PI_LOW 1.2246467991473532e-16
+#define HALF_PI_HIGH (PI_HIGH / 2)
+#define HALF_PI_LOW (PI_LOW / 2)
+
+/* ******************************* SSE2 *************************** */
+
+//Evaluates the polynomial with the given coefficients (highest power first) at x
+static __m128d polySSE2(__m128d x, const double* coef, int numCoef){
+    __m128d result = _mm_set1_pd(coef[0]);
+
+    for (int i = 1; i < numCoef; i++){
+        result = _mm_add_pd(_mm_mul_pd(result, x), _mm_set1_pd(coef[i]));
+    }
+    return result;
+}
+
+//Reduces x into [-pi/2, pi/2] by a multiple k of pi.  sign receives the sign bit set where k is odd
+static __m128d reduceSSE2(__m128d x, __m128d* sign){
+    __m128i k32 = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(1.0 / M_PI)));
+    __m128d k = _mm_cvtepi32_pd(k32);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(PI_HIGH))), _mm_mul_pd(k, _mm_set1_pd(PI_LOW)));
+    __m128i odd = _mm_and_si128(_mm_unpacklo_epi32(k32, k32), _mm_set1_epi64x(1));
+
+    *sign = _mm_castsi128_pd(_mm_slli_epi64(odd, 63));
+    return r;
+}
+
+static __m128d sinSquaredSSE2(__m128d x){
+    __m128d sign;
+    __m128d r = reduceSSE2(x, &sign);
+    __m128d s = _mm_mul_pd(r, polySSE2(_mm_mul_pd(r, r), SIN_COEF, NUM_SIN_COEF));
+
+    return _mm_mul_pd(s, s);
+}
+
+static __m128d cosSSE2(__m128d x){
+    __m128d sign;
+    __m128d r = reduceSSE2(x, &sign);
+    __m128d absR = _mm_andnot_pd(_mm_set1_pd(-0.0), r);
+    __m128d q = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(HALF_PI_HIGH), absR), _mm_set1_pd(HALF_PI_LOW));
+
+    return _mm_xor_pd(_mm_mul_pd(q, polySSE2(_mm_mul_pd(q, q), SIN_COEF, NUM_SIN_COEF)), sign);
+}
+
+//Returns 2 asin(sqrt(a)) for a in [0, 1]
+static __m128d centralAngleSSE2(__m128d a){
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d half = _mm_set1_pd(0.5);
+
+    a = _mm_min_pd(_mm_max_pd(a, _mm_setzero_pd()), one);
+    __m128d s = _mm_sqrt_pd(a);
+    double scale = 2.0;
+
+    //Consecutive track points are close together, so the halvings are usually not needed
+    if (_mm_movemask_pd(_mm_cmpge_pd(s, _mm_set1_pd(ASIN_DIRECT_LIMIT))) != 0){
+        __m128d c = _mm_sqrt_pd(_mm_sub_pd(one, a));
+
+        for (int i = 0; i < ASIN_HALVINGS; i++){
+            __m128d t = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(one, c), _mm_add_pd(one, c)));
+            s = _mm_div_pd(s, t);
+            c = _mm_mul_pd(t, half);
+        }
+        scale *= 1 << ASIN_HALVINGS;
+    }
+
+    __m128d angle = _mm_mul_pd(s, polySSE2(_mm_mul_pd(s, s), ASIN_COEF, NUM_ASIN_COEF));
+    return _mm_mul_pd(angle, _mm_set1_pd(scale));
+}
+
+//Sums the lengths of pairs (i, i+1) for i < numPairs.  numPairs must be a multiple of 2
+static double pathLengthSSE2(const double* latitude, const double* longitude, int numPairs){
+    __m128d toRad = _mm_set1_pd(DEG_TO_RAD);
+    __m128d halfToRad = _mm_set1_pd(DEG_TO_RAD / 2);
+    __m128d sum = _mm_setzero_pd();
+
+    //The cosine of each latitude is evaluated once: the first point of a pair is the second point of the pair
+    //before, so cos(lat1) is put together from the last lane of the previous cos(lat2) and the current one
+    __m128d prevCos2 = cosSSE2(_mm_set1_pd(latitude[0] * DEG_TO_RAD));
+
+    for (int i = 0; i < numPairs; i += 2){
+        __m128d lat1 = _mm_loadu_pd(latitude + i);
+        __m128d lat2 = _mm_loadu_pd(latitude + i + 1);
+        __m128d dLon = _mm_sub_pd(_mm_loadu_pd(longitude + i + 1), _mm_loadu_pd(longitude + i));
+
+        __m128d sinLat = sinSquaredSSE2(_mm_mul_pd(_mm_sub_pd(lat2, lat1), halfToRad));
+        __m128d sinLon = sinSquaredSSE2(_mm_mul_pd(dLon, halfToRad));
+        __m128d cos2 = cosSSE2(_mm_mul_pd(lat2, toRad));
+        __m128d cos1 = _mm_shuffle_pd(prevCos2, cos2, 1);
+        __m128d a = _mm_add_pd(sinLat, _mm_mul_pd(_mm_mul_pd(cos1, cos2), sinLon));
+
+        sum = _mm_add_pd(sum, centralAngleSSE2(a));
+        prevCos2 = cos2;
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) * EARTH_RADIUS;
+}
+
+/* ******************************* AVX2 *************************** */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static __m256d polyAVX2(__m256d x, const double* coef, int numCoef){
+    __m256d result = _mm256_set1_pd(coef[0]);
+
+    for (int i = 1; i < numCoef; i++){
+        result = _mm256_add_pd(_mm256_mul_pd(result, x), _mm256_set1_pd(coef[i]));
+    }
+    return result;
+}
+
+AVX2 static __m256d reduceAVX2(__m256d x, __m256d* sign){
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.0 / M_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(PI_HIGH))), _mm256_mul_pd(k, _mm256_set1_pd(PI_LOW)));
+    __m256i odd = _mm256_and_si256(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k)), _mm256_set1_epi64x(1));
+
+    *sign = _mm256_castsi256_pd(_mm256_slli_epi64(odd, 63));
+    return r;
+}
+
+AVX2 static __m256d sinSquaredAVX2(__m256d x){
+    __m256d sign;
+    __m256d r = reduceAVX2(x, &sign);
+    __m256d s = _mm256_mul_pd(r, polyAVX2(_mm256_mul_pd(r, r), SIN_COEF, NUM_SIN_COEF));
+
+    return _mm256_mul_pd(s, s);
+}
+
+AVX2 static __m256d cosAVX2(__m256d x){
+    __m256d sign;
+    __m256d r = reduceAVX2(x, &sign);
+    __m256d absR = _mm256_andnot_pd(_mm256_set1_pd(-0.0), r);
+    __m256d q = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(HALF_PI_HIGH), absR), _mm256_set1_pd(HALF_PI_LOW));
+
+    return _mm256_xor_pd(_mm256_mul_pd(q, polyAVX2(_mm256_mul_pd(q, q), SIN_COEF, NUM_SIN_COEF)), sign);
+}
+
+AVX2 static __m256d centralAngleAVX2(__m256d a){
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d half = _mm256_set1_pd(0.5);
+
+    a = _mm256_min_pd(_mm256_max_pd(a, _mm256_setzero_pd()), one);
+    __m256d s = _mm256_sqrt_pd(a);
+    double scale = 2.0;
+
+    if (_mm256_movemask_pd(_mm256_cmp_pd(s, _mm256_set1_pd(ASIN_DIRECT_LIMIT), _CMP_GE_OQ)) != 0){
+        __m256d c = _mm256_sqrt_pd(_mm256_sub_pd(one, a));
+
+        for (int i = 0; i < ASIN_HALVINGS; i++){
+            __m256d t = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(one, c), _mm256_add_pd(one, c)));
+            s = _mm256_div_pd(s, t);
+            c = _mm256_mul_pd(t, half);
+        }
+        scale *= 1 << ASIN_HALVINGS;
+    }
+
+    __m256d angle = _mm256_mul_pd(s, polyAVX2(_mm256_mul_pd(s, s), ASIN_COEF, NUM_ASIN_COEF));
+    return _mm256_mul_pd(angle, _mm256_set1_pd(scale));
+}
+
+//Sums the lengths of pairs (i, i+1) for i < numPairs.  numPairs must be a multiple of 4
+AVX2 static double pathLengthAVX2(const double* latitude, const double* longitude, int numPairs){
+    __m256d toRad = _mm256_set1_pd(DEG_TO_RAD);
+    __m256d halfToRad = _mm256_set1_pd(DEG_TO_RAD / 2);
+    __m256d sum = _mm256_setzero_pd();
+
+    //As in pathLengthSSE2, cos(lat1) is the previous cos(lat2) shifted by one lane
+    __m256d prevCos2 = cosAVX2(_mm256_set1_pd(latitude[0] * DEG_TO_RAD));
+
+    for (int i = 0; i < numPairs; i += 4){
+        __m256d lat1 = _mm256_loadu_pd(latitude + i);
+        __m256d lat2 = _mm256_loadu_pd(latitude + i + 1);
+        __m256d dLon = _mm256_sub_pd(_mm256_loadu_pd(longitude + i + 1), _mm256_loadu_pd(longitude + i));
+
+        __m256d sinLat = sinSquaredAVX2(_mm256_mul_pd(_mm256_sub_pd(lat2, lat1), halfToRad));
+        __m256d sinLon = sinSquaredAVX2(_mm256_mul_pd(dLon, halfToRad));
+        __m256d cos2 = cosAVX2(_mm256_mul_pd(lat2, toRad));
+        __m256d cos1 = _mm256_shuffle_pd(_mm256_permute2f128_pd(prevCos2, cos2, 0x21), cos2, 5);
+        __m256d a = _mm256_add_pd(sinLat, _mm256_mul_pd(_mm256_mul_pd(cos1, cos2), sinLon));
+
+        sum = _mm256_add_pd(sum, centralAngleAVX2(a));
+        prevCos2 = cos2;
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1] + lanes[2] + lanes[3]) * EARTH_RADIUS;
+}
+
+#endif
+
+/* ******************************* Dispatch *************************** */
+
+typedef enum { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 } PathKernel;
+
+static const char* const KERNEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+static PathKernel bestKernel = KERNEL_SCALAR;
+
+/* Looks up the CPU features once per process.  The SSE2 kernel only has two lanes, which is not enough to
+   reliably beat the scalar loop and libm on a dense track (see DistanceBench), so getPathLength uses the scalar loop
+   on CPUs without AVX2.  It can still be run with getPathLengthWithKernel. */
+static void chooseKernel(void){
+#ifdef GPX_X86_SIMD
+    bestKernel = __builtin_cpu_supports("avx2") ? KERNEL_AVX2 : KERNEL_SCALAR;
+#endif
+}
+
+static bool isKernelAvailable(PathKernel kernel){
+    pthread_once(&kernelOnce, &chooseKernel);
+#ifdef GPX_X86_SIMD
+    return kernel != KERNEL_AVX2 || bestKernel == KERNEL_AVX2;
+#else
+    return kernel == KERNEL_SCALAR;
+#endif
+}
+
+static double runKernel(PathKernel kernel, const double* latitude, const double* longitude, int count){
+    int numPairs = count - 1;
+    int done = 0;
+    double total = 0.0;
+
+#ifdef GPX_X86_SIMD
+    if (kernel == KERNEL_AVX2){
+        done = numPairs & ~3;
+        total = pathLengthAVX2(latitude, longitude, done);
+    }else if (kernel == KERNEL_SSE2){
+        done = numPairs & ~1;
+        total = pathLengthSSE2(latitude, longitude, done);
+    }
+#endif
+
+    //Leftover pairs, and every pair with the scalar kernel
+    return total + getPathLengthScalar(latitude + done, longitude + done, count - done);
+}
+
+const char* getPathLengthKernel(void){
+    pthread_once(&kernelOnce, &chooseKernel);
+    return KERNEL_NAMES[bestKernel];
+}
+
+double getPathLength(const double* latitude, const double* longitude, int count){
+    if (latitude == NULL || longitude == NULL || count < 2){
+        return 0.0;
+    }
+
+    pthread_once(&kernelOnce, &chooseKernel);
+    return runKernel(bestKernel, latitude, longitude, count);
+}
+
+double getPathLengthWithKernel(const char* kernel, const double* latitude, const double* longitude, int count){
+    for (PathKernel k = KERNEL_SCALAR; k <= KERNEL_AVX2; k++){
+        if (kernel != NULL && strcmp(kernel, KERNEL_NAMES[k]) == 0){
+            if (!isKernelAvailable(k)){
+                return NAN;
+            }
+            return latitude == NULL || longitude == NULL || count < 2 ? 0.0 : runKernel(k, latitude, longitude, count);
+        }
+    }
+    return NAN;
+}
+
+double getColumnsLength(const GPXColumns* columns){
+    if (columns == NULL){
+        return 0.0;
+    }
+    return getPathLength(columns->latitude, columns->longitude, columns->count);
+}
+
+/* Running length of a list of waypoints.  Points are gathered into fixed-size batches for the
+   kernel; the last point of each batch is carried over so no pair is skipped. */
+typedef struct {
+    double latitude[BATCH_SIZE];
+    double longitude[BATCH_SIZE];
+    int count;
+    double total;
+} PathBatch;
+
+static void addPoint(PathBatch* batch, double latitude, double longitude){
+    if (batch->count == BATCH_SIZE){
+        batch->total += getPathLength(batch->latitude, batch->longitude, batch->count);
+        batch->latitude[0] = batch->latitude[BATCH_SIZE - 1];
+        batch->longitude[0] = batch->longitude[BATCH_SIZE - 1];
+        batch->count = 1;
+    }
+
+    batch->latitude[batch->count] = latitude;
+    batch->longitude[batch->count] = longitude;
+    batch->count++;
+}
+
+static void addWaypoints(PathBatch* batch, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        addPoint(batch, wpt->latitude, wpt->longitude);
+    }
+}
+
+static double finishPath(PathBatch* batch){
+    return batch->total + getPathLength(batch->latitude, batch->longitude, batch->count);
+}
+
+float getRouteLen(const Route* rt){
+    if (rt == NULL){
+        return 0;
+    }
+
+    PathBatch batch = {.count = 0, .total = 0.0};
+    addWaypoints(&batch, rt->waypoints);
+    return (float)finishPath(&batch);
+}
+
+float getSegmentLen(const TrackSegment* seg){
+    if (seg == NULL){
+        return 0;
+    }
+
+    PathBatch batch = {.count = 0, .total = 0.0};
+    addWaypoints(&batch, seg->waypoints);
+    return (float)finishPath(&batch);
+}
+
+float getTrackLen(const Track* tr){
+    if (tr == NULL){
+        return 0;
+    }
+
+    //Feeding every segment into one path also counts the gaps between segments
+    PathBatch batch = {.count = 0, .total = 0.0};
+    ListIterator iter = createIterator(tr->segments);
+    TrackSegment* seg;
+
+    while ((seg = nextElement(&iter)) != NULL){
+        addWaypoints(&batch, seg->waypoints);
+    }
+    return (float)finishPath(&batch);
+}
@@ -0,0 +1,689 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <float.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "GPXHelpers.h"
+#include "GPXCounters.h"
+#include "GPXNames.h"
+#include "GPXSpatial.h"
+
+char* gpxStrdup(const char* str){
+    size_t len = strlen(str);
+    char* copy = malloc(len + 1);
+
+    if (copy == NULL){
+        return NULL;
+    }
+    memcpy(copy, str, len + 1);
+
+    return copy;
+}
+
+void* gpxAllocArray(size_t count, size_t elemSize){
+    if (elemSize != 0 && count >= SIZE_MAX / elemSize){
+        return NULL;
+    }
+    return malloc((count + 1) * elemSize);
+}
+
+GPXData* createGPXData(const char* name, const char* value){
+    if (name == NULL || value == NULL || name[0] == '\0' || value[0] == '\0'){
+        return NULL;
+    }
+
+    size_t valueLen = strlen(value);
+    void* block = malloc(getGPXDataSize(valueLen));
+
+    if (block == NULL){
+        return NULL;
+    }
+
+    //Names longer than the fixed buffer are truncated rather than rejected
+    return fillGPXData(block, name, value, valueLen);
+}
+
+GPXData* createGPXDataRecord(const char* name, const char* value){
+    if (name[0] == '\0' || value[0] == '\0'){
+        return NULL;
+    }
+
+    const char* shared = internGPXName(name);
+    size_t valueLen = strlen(value);
+    void* block = malloc(getGPXDataRecordSize(shared, name, valueLen));
+
+    if (block == NULL){
+        return NULL;
+    }
+
+    return fillGPXDataRecord(block, shared, name, value, valueLen);
+}
+
+const char* getGPXDataName(const GPXData* data){
+    return isGPXDataRecord(data) ? ((const GPXDataRecord*)data)->name : data->name;
+}
+
+const char* getGPXDataValue(const GPXData* data){
+    return isGPXDataRecord(data) ? ((const GPXDataRecord*)data)->value : data->value;
+}
+
+Waypoint* createWaypoint(void){
+    Waypoint* wpt = malloc(sizeof(Waypoint));
+
+    if (wpt == NULL){
+        return NULL;
+    }
+
+    wpt->name = gpxStrdup("");
+    wpt->latitude = 0.0;
+    wpt->longitude = 0.0;
+    wpt->time = GPX_NO_TIME;
+    wpt->fields = 0;
+    wpt->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+
+    if (wpt->name == NULL || wpt->otherData == NULL){
+        deleteWaypoint(wpt);
+        return NULL;
+    }
+
+    return wpt;
+}
+
+Route* createRoute(void){
+    Route* rte = malloc(sizeof(Route));
+
+    if (rte == NULL){
+        return NULL;
+    }
+
+    rte->name = gpxStrdup("");
+    resetBounds(&rte->bounds);
+    rte->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
+    rte->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+
+    if (rte->name == NULL || rte->waypoints == NULL || rte->otherData == NULL){
+        deleteRoute(rte);
+        return NULL;
+    }
+
+    return rte;
+}
+
+TrackSegment* createTrackSegment(void){
+    TrackSegment* seg = malloc(sizeof(TrackSegment));
+
+    if (seg == NULL){
+        return NULL;
+    }
+
+    resetBounds(&seg->bounds);
+    seg->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
+
+    if (seg->waypoints == NULL){
+        deleteTrackSegment(seg);
+        return NULL;
+    }
+
+    return seg;
+}
+
+Track* createTrack(void){
+    Track* trk = malloc(sizeof(Track));
+
+    if (trk == NULL){
+        return NULL;
+    }
+
+    trk->name = gpxStrdup("");
+    resetBounds(&trk->bounds);
+    trk->segments = initializeList(&trackSegmentToString, &deleteTrackSegment, &compareTrackSegments);
+    trk->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+
+    if (trk->name == NULL || trk->segments == NULL || trk->otherData == NULL){
+        deleteTrack(trk);
+        return NULL;
+    }
+
+    return trk;
+}
+
+GPXdoc* createEmptyGPXdoc(void){
+    GPXdoc* doc = malloc(sizeof(GPXdoc));
+
+    if (doc == NULL){
+        return NULL;
+    }
+
+    doc->namespace[0] = '\0';
+    doc->version = 0.0;
+    doc->creator = NULL;
+    doc->arena = NULL;
+    doc->nameIndex = NULL;
+    doc->countersActive = false;
+    doc->lazy = NULL;
+    doc->frozen = false;
+    atomic_init(&doc->refCount, 1);
+    doc->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
+    doc->routes = initializeList(&routeToString, &deleteRoute, &compareRoutes);
+    doc->tracks = initializeList(&trackToString, &deleteTrack, &compareTracks);
+
+    if (doc->waypoints == NULL || doc->routes == NULL || doc->tracks == NULL){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+
+    attachGPXCounters(doc);
+    return doc;
+}
+
+bool setGPXName(char** field, const char* value){
+    char* copy = gpxStrdup(value);
+
+    if (copy == NULL){
+        return false;
+    }
+    free(*field);
+    *field = copy;
+
+    return true;
+}
+
+/* ******************************* Number parsing *************************** */
+
+//Largest mantissa that a double holds exactly, and the powers of ten that a double holds exactly
+#define EXACT_MANTISSA (UINT64_C(1) << 53)
+#define MAX_EXACT_POW10 22
+
+static const double exactPowersOf10[MAX_EXACT_POW10 + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isSpace(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool isDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+/* Parses [sign] digits [. digits] [e [sign] digits] when the result is exact to compute: a mantissa of at
+   most 2^53 scaled by a power of ten up to 10^22 is one correctly rounded multiplication or division
+   (Clinger's fast path), since both operands are exact doubles.  That covers practically every lat, lon
+   and ele value.  Returns false for everything else. */
+static bool parseFastDouble(const char* str, double* result, const char** end){
+    const char* c = str;
+    bool negative = *c == '-';
+
+    if (*c == '-' || *c == '+'){
+        c++;
+    }
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+
+    for (; isDigit(*c); c++){
+        anyDigits = true;
+        if (mantissa != 0 || *c != '0'){
+            mantissa = mantissa * 10 + (*c - '0');
+            significantDigits++;
+        }
+        if (significantDigits > 19){
+            return false;
+        }
+    }
+    if (*c == '.'){
+        for (c++; isDigit(*c); c++){
+            anyDigits = true;
+            if (mantissa != 0 || *c != '0'){
+                mantissa = mantissa * 10 + (*c - '0');
+                significantDigits++;
+            }
+            exponent--;
+            if (significantDigits > 19){
+                return false;
+            }
+        }
+    }
+    if (!anyDigits){
+        return false;
+    }
+
+    if (*c == 'e' || *c == 'E'){
+        const char* e = c + 1;
+        bool negativeExponent = *e == '-';
+        int value = 0;
+
+        if (*e == '-' || *e == '+'){
+            e++;
+        }
+        //strtod leaves an incomplete exponent unread, which the caller rejects as trailing text
+        if (!isDigit(*e)){
+            return false;
+        }
+        for (; isDigit(*e); e++){
+            if (value > 10000){
+                return false;
+            }
+            value = value * 10 + (*e - '0');
+        }
+        exponent += negativeExponent ? -value : value;
+        c = e;
+    }
+
+    if (mantissa > EXACT_MANTISSA || exponent < -MAX_EXACT_POW10 || exponent > MAX_EXACT_POW10){
+        return false;
+    }
+
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / exactPowersOf10[-exponent] : value * exactPowersOf10[exponent];
+
+    *result = negative ? -value : value;
+    *end = c;
+    return true;
+}
+
+static pthread_once_t cLocaleInit = PTHREAD_ONCE_INIT;
+static locale_t cLocale = (locale_t)0;
+
+static void initCLocale(void){
+    cLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+//Switches the calling thread to the C locale.  Returns the locale to give restoreLocale, or (locale_t)0 if
+//the C locale could not be created and the thread was left as it was
+static locale_t useCLocale(void){
+    pthread_once(&cLocaleInit, &initCLocale);
+    return cLocale != (locale_t)0 ? uselocale(cLocale) : (locale_t)0;
+}
+
+static void restoreLocale(locale_t previous){
+    if (previous != (locale_t)0){
+        uselocale(previous);
+    }
+}
+
+//strtod in the C locale, whatever locale the program has set
+static double strtodC(const char* str, char** end){
+    locale_t previous = useCLocale();
+    double value = strtod(str, end);
+    restoreLocale(previous);
+    return value;
+}
+
+void formatGPXDouble(char* buf, size_t size, double value){
+    locale_t previous = useCLocale();
+
+    snprintf(buf, size, "%.15g", value);
+    if (strtod(buf, NULL) != value){
+        snprintf(buf, size, "%.17g", value);
+    }
+    restoreLocale(previous);
+}
+
+void formatGPXFloat(char* buf, size_t size, float value){
+    locale_t previous = useCLocale();
+    int digits = 6;
+
+    snprintf(buf, size, "%.*g", digits, value);
+    while (digits < 9 && strtof(buf, NULL) != value){
+        digits++;
+        snprintf(buf, size, "%.*g", digits, value);
+    }
+    restoreLocale(previous);
+}
+
+static bool isTrailingSpace(const char* end){
+    while (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r'){
+        end++;
+    }
+    return *end == '\0';
+}
+
+bool parseGPXDouble(const char* str, double* result){
+    if (str == NULL){
+        return false;
+    }
+
+    const char* start = str;
+    while (isSpace(*start)){
+        start++;
+    }
+
+    //Intermediate precision would round twice, so the fast path is only used with plain double arithmetic.
+    //Anything it stops short on (hex, inf, nan, long mantissas, large exponents) is left to strtod
+    const char* fastEnd;
+    double value;
+    if (FLT_EVAL_METHOD == 0 && parseFastDouble(start, &value, &fastEnd) && isTrailingSpace(fastEnd)){
+        *result = value;
+        return true;
+    }
+
+    char* end;
+    value = strtodC(start, &end);
+    if (end == start || !isTrailingSpace(end)){
+        return false;
+    }
+
+    *result = value;
+    return true;
+}
+
+//Days between 1970-01-01 and the given proleptic Gregorian date
+static long long daysFromCivil(int year, int month, int day){
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static bool isLeapYear(int year){
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static int daysInMonth(int year, int month){
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    return month == 2 && isLeapYear(year) ? 29 : days[month - 1];
+}
+
+//Reads exactly count digits and advances str past them.  Returns -1, leaving str alone, if any is missing
+static int readDigits(const char** str, int count){
+    int value = 0;
+
+    for (int i = 0; i < count; i++){
+        char c = (*str)[i];
+
+        if (!isDigit(c)){
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+    *str += count;
+    return value;
+}
+
+//Reads the separator sep and advances str past it
+static bool readChar(const char** str, char sep){
+    if (**str != sep){
+        return false;
+    }
+    (*str)++;
+    return true;
+}
+
+/* Decodes YYYY-MM-DDThh:mm:ss[.fraction][Z|+hh:mm|-hh:mm|+hhmm|+hh] by hand: sscanf and strptime spend
+   most of their time interpreting the format string, and mktime applies the local time zone. */
+bool parseGPXTime(const char* str, long long* result){
+    if (str == NULL){
+        return false;
+    }
+
+    const char* c = str;
+    while (isSpace(*c)){
+        c++;
+    }
+
+    int year = readDigits(&c, 4);
+    int month = readChar(&c, '-') ? readDigits(&c, 2) : -1;
+    int day = readChar(&c, '-') ? readDigits(&c, 2) : -1;
+    bool separator = readChar(&c, 'T') || readChar(&c, 't');
+    int hour = separator ? readDigits(&c, 2) : -1;
+    int minute = readChar(&c, ':') ? readDigits(&c, 2) : -1;
+    int second = readChar(&c, ':') ? readDigits(&c, 2) : -1;
+
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60){
+        return false;
+    }
+
+    //Fractions are rounded to the nearest millisecond
+    int millis = 0;
+    if (readChar(&c, '.') || readChar(&c, ',')){
+        int digits = 0;
+
+        if (!isDigit(*c)){
+            return false;
+        }
+        for (; isDigit(*c); c++, digits++){
+            if (digits < 3){
+                millis = millis * 10 + (*c - '0');
+            }else if (digits == 3 && *c >= '5'){
+                millis++;
+            }
+        }
+        for (; digits < 3; digits++){
+            millis *= 10;
+        }
+    }
+
+    //Timestamps without a zone are taken as UTC
+    int offset = 0;
+    if (*c == '+' || *c == '-'){
+        int sign = *c == '-' ? -1 : 1;
+        c++;
+
+        int offHour = readDigits(&c, 2);
+        int offMinute = 0;
+        if (readChar(&c, ':') || isDigit(*c)){
+            offMinute = readDigits(&c, 2);
+        }
+        if (offHour < 0 || offHour > 23 || offMinute < 0 || offMinute > 59){
+            return false;
+        }
+        offset = sign * (offHour * 60 + offMinute);
+    }else if (!readChar(&c, 'Z')){
+        readChar(&c, 'z');
+    }
+
+    if (!isTrailingSpace(c)){
+        return false;
+    }
+
+    long long minutes = (daysFromCivil(year, month, day) * 24 + hour) * 60 + minute - offset;
+    *result = (minutes * 60 + second) * 1000 + millis;
+    return true;
+}
+
+//Decodes a float field such as hdop
+static bool setFloatField(Waypoint* wpt, unsigned int field, float* target, const char* value){
+    double result;
+
+    if (!parseGPXDouble(value, &result)){
+        return false;
+    }
+    *target = (float)result;
+    wpt->fields |= field;
+    return true;
+}
+
+bool setWaypointField(Waypoint* wpt, const char* name, const char* value){
+    unsigned int field;
+
+    switch (name[0]){
+        case 'e':
+            field = strcmp(name, "ele") == 0 ? GPX_FIELD_ELEVATION : 0;
+            break;
+        case 't':
+            field = strcmp(name, "time") == 0 ? GPX_FIELD_TIME : 0;
+            break;
+        case 's':
+            field = strcmp(name, "sat") == 0 ? GPX_FIELD_SATELLITES : strcmp(name, "speed") == 0 ? GPX_FIELD_SPEED : 0;
+            break;
+        case 'h':
+            field = strcmp(name, "hdop") == 0 ? GPX_FIELD_HDOP : 0;
+            break;
+        case 'v':
+            field = strcmp(name, "vdop") == 0 ? GPX_FIELD_VDOP : 0;
+            break;
+        case 'p':
+            field = strcmp(name, "pdop") == 0 ? GPX_FIELD_PDOP : 0;
+            break;
+        default:
+            field = 0;
+    }
+    if (field == 0 || (wpt->fields & field) != 0){
+        return false;
+    }
+
+    double number;
+    switch (field){
+        case GPX_FIELD_TIME:
+            if (!parseGPXTime(value, &wpt->time)){
+                return false;
+            }
+            wpt->fields |= field;
+            return true;
+        case GPX_FIELD_ELEVATION:
+            if (!parseGPXDouble(value, &wpt->elevation)){
+                return false;
+            }
+            wpt->fields |= field;
+            return true;
+        case GPX_FIELD_SATELLITES:
+            //A nonNegativeInteger in the schema.  NaN passes both range checks, so it is rejected before the cast
+            if (!parseGPXDouble(value, &number) || !isfinite(number) || number < 0 || number > INT_MAX || number != (int)number){
+                return false;
+            }
+            wpt->satellites = (int)number;
+            wpt->fields |= field;
+            return true;
+        case GPX_FIELD_HDOP:
+            return setFloatField(wpt, field, &wpt->hdop, value);
+        case GPX_FIELD_VDOP:
+            return setFloatField(wpt, field, &wpt->vdop, value);
+        case GPX_FIELD_PDOP:
+            return setFloatField(wpt, field, &wpt->pdop, value);
+        default:
+            return setFloatField(wpt, field, &wpt->speed, value);
+    }
+}
+
+/* ******************************* libxml2 *************************** */
+
+static pthread_once_t libxmlInit = PTHREAD_ONCE_INIT;
+
+static void initLibxml(void){
+    LIBXML_TEST_VERSION
+    xmlInitParser();
+}
+
+void initGPXLibxml(void){
+    pthread_once(&libxmlInit, &initLibxml);
+}
+
+/* ******************************* File mapping *************************** */
+
+bool mapGPXFile(const char* fileName, MappedFile* file){
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0){
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    //The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (data == MAP_FAILED){
+        return false;
+    }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    file->size = info.st_size;
+    return true;
+}
+
+void unmapGPXFile(MappedFile* file){
+    munmap((void*)file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+/* ******************************* xmlTextReader helpers *************************** */
+
+static bool isTextNode(int type){
+    return type == XML_READER_TYPE_TEXT || type == XML_READER_TYPE_CDATA ||
+           type == XML_READER_TYPE_WHITESPACE || type == XML_READER_TYPE_SIGNIFICANT_WHITESPACE;
+}
+
+bool readElementText(xmlTextReaderPtr reader, StringBuilder* buf){
+    buf->len = 0;
+    if (!appendString(buf, "")){
+        return false;
+    }
+    if (xmlTextReaderIsEmptyElement(reader)){
+        return true;
+    }
+
+    int depth = xmlTextReaderDepth(reader);
+    while (xmlTextReaderRead(reader) == 1){
+        int type = xmlTextReaderNodeType(reader);
+
+        if (type == XML_READER_TYPE_END_ELEMENT && xmlTextReaderDepth(reader) == depth){
+            return true;
+        }
+        if (isTextNode(type) && !appendString(buf, (const char*)xmlTextReaderConstValue(reader))){
+            return false;
+        }
+    }
+    return false;
+}
+
+int nextChildElement(xmlTextReaderPtr reader, int parentDepth){
+    while (xmlTextReaderRead(reader) == 1){
+        int type = xmlTextReaderNodeType(reader);
+        int depth = xmlTextReaderDepth(reader);
+
+        if (type == XML_READER_TYPE_END_ELEMENT && depth == parentDepth){
+            return 0;
+        }
+        if (type == XML_READER_TYPE_ELEMENT && depth == parentDepth + 1){
+            return 1;
+        }
+    }
+    return -1;
+}
+
+bool skipElement(xmlTextReaderPtr reader){
+    if (xmlTextReaderIsEmptyElement(reader)){
+        return true;
+    }
+
+    int depth = xmlTextReaderDepth(reader);
+    while (xmlTextReaderRead(reader) == 1){
+        if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_END_ELEMENT && xmlTextReaderDepth(reader) == depth){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool localNameIs(xmlTextReaderPtr reader, const char* name){
+    const xmlChar* localName = xmlTextReaderConstLocalName(reader);
+
+    return localName != NULL && strcmp((const char*)localName, name) == 0;
+}
+
+bool finishReading(xmlTextReaderPtr reader){
+    int status;
+
+    while ((status = xmlTextReaderRead(reader)) == 1);
+    return status == 0;
+}
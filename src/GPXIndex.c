@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "GPXIndex.h"
+
+//Lists shorter than this are searched with findElement
+#define INDEX_MIN_LENGTH 16
+
+typedef struct {
+    uint32_t hash;
+    const void* entity;
+} IndexSlot;
+
+//Open-addressing hash table over one list.  capacity is a power of two, 0 until the table is built
+typedef struct {
+    IndexSlot* slots;
+    size_t capacity;
+
+    //State of the list when the table was built
+    int length;
+    Node* head;
+    Node* tail;
+} NameTable;
+
+struct gpxNameIndex {
+    NameTable tables[3];
+};
+
+//Waypoint, Route and Track all start with their name
+typedef struct {
+    char* name;
+} Named;
+
+static uint32_t hashName(const char* name){
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++){
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static List* indexedList(const GPXdoc* doc, GPXIndexKind kind){
+    switch (kind){
+        case INDEX_WAYPOINTS:
+            return doc->waypoints;
+        case INDEX_ROUTES:
+            return doc->routes;
+        default:
+            return doc->tracks;
+    }
+}
+
+static bool isCurrent(const NameTable* table, const List* list){
+    return table->capacity != 0 && table->length == list->length && table->head == list->head && table->tail == list->tail;
+}
+
+//Rebuilds table from list.  Returns false if malloc fails
+static bool buildTable(NameTable* table, List* list){
+    size_t capacity = 16;
+    while (capacity < (size_t)list->length * 2){
+        capacity *= 2;
+    }
+
+    IndexSlot* slots = calloc(capacity, sizeof(IndexSlot));
+    if (slots == NULL){
+        return false;
+    }
+
+    ListIterator iter = createIterator(list);
+    const Named* entity;
+
+    while ((entity = nextElement(&iter)) != NULL){
+        uint32_t hash = hashName(entity->name);
+        size_t i = hash & (capacity - 1);
+
+        //Only the first entity with a given name is kept
+        while (slots[i].entity != NULL && !(slots[i].hash == hash && strcmp(((const Named*)slots[i].entity)->name, entity->name) == 0)){
+            i = (i + 1) & (capacity - 1);
+        }
+        if (slots[i].entity == NULL){
+            slots[i].hash = hash;
+            slots[i].entity = entity;
+        }
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    table->length = list->length;
+    table->head = list->head;
+    table->tail = list->tail;
+    return true;
+}
+
+static bool namedEquals(const void* first, const void* second){
+    return strcmp(((const Named*)first)->name, (const char*)second) == 0;
+}
+
+void* findByName(GPXdoc* doc, GPXIndexKind kind, const char* name){
+    List* list = indexedList(doc, kind);
+
+    if (list->length < INDEX_MIN_LENGTH){
+        return findElement(list, &namedEquals, name);
+    }
+
+    //A frozen document is shared between threads, so its index is never built or changed here
+    if (doc->nameIndex == NULL && !doc->frozen){
+        doc->nameIndex = calloc(1, sizeof(GPXNameIndex));
+    }
+    if (doc->nameIndex == NULL){
+        return findElement(list, &namedEquals, name);
+    }
+
+    NameTable* table = &doc->nameIndex->tables[kind];
+    if (!isCurrent(table, list) && (doc->frozen || !buildTable(table, list))){
+        return findElement(list, &namedEquals, name);
+    }
+
+    uint32_t hash = hashName(name);
+    for (size_t i = hash & (table->capacity - 1); table->slots[i].entity != NULL; i = (i + 1) & (table->capacity - 1)){
+        const Named* entity = table->slots[i].entity;
+
+        if (table->slots[i].hash == hash && strcmp(entity->name, name) == 0){
+            return (void*)entity;
+        }
+    }
+    return NULL;
+}
+
+bool buildNameIndex(GPXdoc* doc){
+    for (GPXIndexKind kind = INDEX_WAYPOINTS; kind <= INDEX_TRACKS; kind++){
+        List* list = indexedList(doc, kind);
+
+        if (list->length < INDEX_MIN_LENGTH){
+            continue;
+        }
+        if (doc->nameIndex == NULL){
+            doc->nameIndex = calloc(1, sizeof(GPXNameIndex));
+            if (doc->nameIndex == NULL){
+                return false;
+            }
+        }
+
+        NameTable* table = &doc->nameIndex->tables[kind];
+        if (!isCurrent(table, list) && !buildTable(table, list)){
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t getNameIndexSize(const GPXNameIndex* index){
+    if (index == NULL){
+        return 0;
+    }
+
+    size_t size = sizeof(GPXNameIndex);
+    for (int i = 0; i < 3; i++){
+        size += index->tables[i].capacity * sizeof(IndexSlot);
+    }
+    return size;
+}
+
+void deleteNameIndex(GPXNameIndex* index){
+    if (index == NULL){
+        return;
+    }
+
+    for (int i = 0; i < 3; i++){
+        free(index->tables[i].slots);
+    }
+    free(index);
+}
+
+void invalidateGPXIndex(GPXdoc* doc){
+    if (doc == NULL || doc->frozen){
+        return;
+    }
+
+    deleteNameIndex(doc->nameIndex);
+    doc->nameIndex = NULL;
+}
+
+void markNameIndexStale(GPXNameIndex* index, GPXIndexKind kind){
+    if (index != NULL){
+        index->tables[kind].length = -1;
+    }
+}
@@ -0,0 +1,458 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "GPXLazy.h"
+#include "GPXScan.h"
+#include "GPXHelpers.h"
+
+/* A lazy document keeps the byte range of every route and track that has not been loaded.  Loading one
+   reads its range from the file and parses it as a small document of its own - the prolog and the <gpx>
+   start tag, the element, and </gpx> - adding the points to the element that is already in the document. */
+
+//A route or track of the document and where it is in the file
+typedef struct {
+    GPXdoc* doc;
+    void* element;
+    bool isTrack;
+    bool loaded;
+    size_t start;
+    size_t end;
+    int numPoints;
+    int numSegments;
+    int numPointData;
+} LazyElement;
+
+struct gpxLazy {
+    int fd;
+    off_t size;
+    struct timespec modified;
+    char* url;
+    unsigned int options;
+
+    //The prolog and <gpx> start tag, and the </gpx> end tag, that wrap an element when it is parsed
+    char* head;
+    size_t headLen;
+    char* tail;
+    size_t tailLen;
+
+    //Every route and track that had points when the document was created, sorted by address
+    LazyElement* elements;
+    int numElements;
+    int numPending;
+    int pendingSegments;
+    int pendingData;
+};
+
+/* ******************************* Elements *************************** */
+
+static int compareElements(const void* first, const void* second){
+    uintptr_t a = (uintptr_t)((const LazyElement*)first)->element;
+    uintptr_t b = (uintptr_t)((const LazyElement*)second)->element;
+
+    return a < b ? -1 : a > b;
+}
+
+//Returns the entry of an element that is still to be loaded, or NULL if it has been loaded or never was lazy
+static LazyElement* findPending(const GPXdoc* doc, const void* element){
+    if (doc == NULL || doc->lazy == NULL || element == NULL){
+        return NULL;
+    }
+
+    LazyElement key = {.element = (void*)element};
+    LazyElement* found = bsearch(&key, doc->lazy->elements, doc->lazy->numElements, sizeof(LazyElement), &compareElements);
+    return found != NULL && !found->loaded ? found : NULL;
+}
+
+//The list of an element that is read from the file: the waypoints of a route or the segments of a track
+static List* pendingList(const LazyElement* elem){
+    return elem->isTrack ? ((Track*)elem->element)->segments : ((Route*)elem->element)->waypoints;
+}
+
+//Marks an element as loaded.  The state is released once nothing is left to load
+static void markLoaded(GPXdoc* doc, LazyElement* elem){
+    struct gpxLazy* lazy = doc->lazy;
+
+    setListFill(pendingList(elem), NULL, NULL);
+    elem->loaded = true;
+    lazy->numPending--;
+    if (elem->isTrack){
+        lazy->pendingSegments -= elem->numSegments;
+    }
+    lazy->pendingData -= elem->numPointData;
+
+    if (lazy->numPending == 0){
+        deleteGPXLazy(lazy);
+        doc->lazy = NULL;
+    }
+}
+
+//Reads len bytes at offset.  Returns false on a read error or end of file
+static bool readAt(int fd, char* buffer, size_t len, off_t offset){
+    while (len > 0){
+        ssize_t n = pread(fd, buffer, len, offset);
+
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return false;
+        }
+        buffer += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool isFileUnchanged(const struct gpxLazy* lazy){
+    struct stat info;
+
+    return fstat(lazy->fd, &info) == 0 && info.st_size == lazy->size &&
+           info.st_mtim.tv_sec == lazy->modified.tv_sec && info.st_mtim.tv_nsec == lazy->modified.tv_nsec;
+}
+
+static void fillElement(void* source, List* list);
+
+static bool loadElement(GPXdoc* doc, LazyElement* elem){
+    struct gpxLazy* lazy = doc->lazy;
+    size_t len = elem->end - elem->start;
+    size_t total = lazy->headLen + len + lazy->tailLen;
+    char* buffer = total <= INT_MAX && isFileUnchanged(lazy) ? malloc(total) : NULL;
+
+    //Adding the points must not load the element again
+    setListFill(pendingList(elem), NULL, NULL);
+    if (buffer == NULL || !readAt(lazy->fd, buffer + lazy->headLen, len, elem->start)){
+        free(buffer);
+        setListFill(pendingList(elem), elem, &fillElement);
+        return false;
+    }
+    memcpy(buffer, lazy->head, lazy->headLen);
+    memcpy(buffer + lazy->headLen + len, lazy->tail, lazy->tailLen);
+
+    xmlTextReaderPtr reader = xmlReaderForMemory(buffer, total, lazy->url, NULL, 0);
+    bool ok = elem->isTrack ? readGPXPoints(reader, doc, NULL, elem->element, lazy->options)
+                            : readGPXPoints(reader, doc, elem->element, NULL, lazy->options);
+
+    //A failed parse leaves the element as it was, so a later call tries again
+    free(buffer);
+    if (ok){
+        markLoaded(doc, elem);
+    }else{
+        setListFill(pendingList(elem), elem, &fillElement);
+    }
+    return ok;
+}
+
+//Fill function of the list of an element that has not been loaded, called on the first use of the list
+static void fillElement(void* source, List* list){
+    LazyElement* elem = source;
+
+    loadElement(elem->doc, elem);
+}
+
+/* ******************************* Creation *************************** */
+
+typedef struct {
+    ByteRange* ranges;
+    int numRanges;
+    int capRanges;
+} RangeList;
+
+//Adds the bytes from *from up to start to the list, and continues after end
+static bool cutOut(RangeList* list, size_t* from, size_t start, size_t end){
+    if (start > *from){
+        if (!reserveGPXArray((void**)&list->ranges, &list->capRanges, list->numRanges, sizeof(ByteRange))){
+            return false;
+        }
+        list->ranges[list->numRanges].start = *from;
+        list->ranges[list->numRanges].end = start;
+        list->numRanges++;
+    }
+    *from = end;
+    return true;
+}
+
+//Parses the document without the points of its routes and the segments of its tracks
+static GPXdoc* parseSummary(const Scan* scan, const char* fileName, unsigned int options){
+    RangeList list = {NULL, 0, 0};
+    size_t from = 0;
+    bool ok = true;
+
+    for (int i = 0; ok && i < scan->numChildren; i++){
+        const ChildScan* child = &scan->children[i];
+
+        for (int j = 0; ok && j < child->numRuns; j++){
+            ok = cutOut(&list, &from, child->pointRuns[j].start, child->pointRuns[j].end);
+        }
+        for (int j = 0; ok && j < child->numSegments; j++){
+            ok = cutOut(&list, &from, child->segments[j].span.start, child->segments[j].span.end);
+        }
+    }
+    ok = ok && cutOut(&list, &from, scan->size, scan->size);
+
+    GPXdoc* doc = ok ? parseGPXRanges(scan->data, list.ranges, list.numRanges, fileName, options) : NULL;
+    free(list.ranges);
+    return doc;
+}
+
+//Pairs the routes or tracks of doc with the scanned elements.  Returns false if their numbers differ
+static bool pairElements(struct gpxLazy* lazy, List* list, const Scan* scan, bool isTrack){
+    ListIterator iter = createIterator(list);
+
+    for (int i = 0; i < scan->numChildren; i++){
+        const ChildScan* child = &scan->children[i];
+        if (isTrack ? !child->isTrack : !child->isRoute){
+            continue;
+        }
+
+        void* element = nextElement(&iter);
+        if (element == NULL){
+            return false;
+        }
+        if (child->numRuns == 0 && child->numSegments == 0){
+            continue;
+        }
+
+        LazyElement* elem = &lazy->elements[lazy->numElements++];
+        elem->element = element;
+        elem->isTrack = isTrack;
+        elem->loaded = false;
+        elem->start = child->span.start;
+        elem->end = child->span.end;
+        elem->numPoints = child->numPoints;
+        elem->numSegments = child->numSegments;
+        elem->numPointData = child->numPointData;
+        lazy->pendingSegments += child->numSegments;
+        lazy->pendingData += child->numPointData;
+    }
+    return nextElement(&iter) == NULL;
+}
+
+static char* copyBytes(const char* data, size_t len){
+    char* copy = malloc(len + 1);
+
+    if (copy != NULL){
+        memcpy(copy, data, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+//Creates the lazy state of doc.  Returns NULL if malloc fails or the document does not match the scan
+static struct gpxLazy* createLazyState(GPXdoc* doc, const Scan* scan, const char* fileName, unsigned int options){
+    struct gpxLazy* lazy = calloc(1, sizeof(struct gpxLazy));
+    int count = 0;
+
+    if (lazy == NULL){
+        return NULL;
+    }
+    lazy->fd = -1;
+    for (int i = 0; i < scan->numChildren; i++){
+        count += scan->children[i].numRuns > 0 || scan->children[i].numSegments > 0;
+    }
+
+    lazy->url = gpxStrdup(fileName);
+    lazy->options = options & (GPX_OPT_ARENA | GPX_OPT_TYPED_ONLY | GPX_OPT_NODE_POOL | GPX_OPT_SHARED_NAMES);
+    lazy->headLen = scan->root.tagEnd;
+    lazy->head = copyBytes(scan->data, lazy->headLen);
+    lazy->tailLen = scan->root.end - scan->root.closeStart;
+    lazy->tail = copyBytes(scan->data + scan->root.closeStart, lazy->tailLen);
+    lazy->elements = malloc((count + 1) * sizeof(LazyElement));
+
+    if (lazy->url == NULL || lazy->head == NULL || lazy->tail == NULL || lazy->elements == NULL ||
+        !pairElements(lazy, doc->routes, scan, false) || !pairElements(lazy, doc->tracks, scan, true)){
+        deleteGPXLazy(lazy);
+        return NULL;
+    }
+
+    qsort(lazy->elements, lazy->numElements, sizeof(LazyElement), &compareElements);
+    lazy->numPending = lazy->numElements;
+    return lazy;
+}
+
+GPXdoc* createLazyGPXdoc(const char* fileName, unsigned int options){
+    unsigned int wholeOptions = options & ~GPX_OPT_LAZY;
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    MappedFile file;
+
+    if (fd < 0){
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || !mapGPXFile(fileName, &file)){
+        close(fd);
+        return createGPXdocWithOptions((char*)fileName, wholeOptions);
+    }
+
+    Scan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.data = file.data;
+    scan.size = file.size;
+    scan.unitSize = SIZE_MAX;
+    scan.typedOnly = (options & GPX_OPT_TYPED_ONLY) != 0;
+
+    //The mapping must hold the same bytes as the descriptor that later loads read from
+    bool split = file.size == (size_t)info.st_size && scanGPXDocument(&scan);
+    GPXdoc* doc = split ? parseSummary(&scan, fileName, options) : NULL;
+    struct gpxLazy* lazy = doc != NULL ? createLazyState(doc, &scan, fileName, options) : NULL;
+
+    if (doc != NULL && lazy == NULL){
+        //Out of memory, or the document does not hold the elements the scan found
+        deleteGPXdoc(doc);
+        doc = NULL;
+        split = false;
+    }
+    clearGPXScan(&scan);
+    unmapGPXFile(&file);
+
+    if (!split){
+        close(fd);
+        return createGPXdocWithOptions((char*)fileName, wholeOptions);
+    }
+
+    if (lazy != NULL && lazy->numPending > 0){
+        lazy->fd = fd;
+        lazy->size = info.st_size;
+        lazy->modified = info.st_mtim;
+        doc->lazy = lazy;
+
+        //The entries have been sorted, so their addresses no longer change
+        for (int i = 0; i < lazy->numElements; i++){
+            lazy->elements[i].doc = doc;
+            setListFill(pendingList(&lazy->elements[i]), &lazy->elements[i], &fillElement);
+        }
+    }else{
+        deleteGPXLazy(lazy);
+        close(fd);
+    }
+    return doc;
+}
+
+/* ******************************* Public API *************************** */
+
+bool loadGPXRoute(GPXdoc* doc, Route* rte){
+    LazyElement* elem = findPending(doc, rte);
+    return elem == NULL || (!elem->isTrack && loadElement(doc, elem));
+}
+
+bool loadGPXTrack(GPXdoc* doc, Track* trk){
+    LazyElement* elem = findPending(doc, trk);
+    return elem == NULL || (elem->isTrack && loadElement(doc, elem));
+}
+
+bool loadGPXdoc(GPXdoc* doc){
+    bool ok = true;
+
+    //The state is released by the last load
+    for (int i = 0; doc != NULL && doc->lazy != NULL && i < doc->lazy->numElements; i++){
+        LazyElement* elem = &doc->lazy->elements[i];
+        if (!elem->loaded){
+            ok = loadElement(doc, elem) && ok;
+        }
+    }
+    return ok;
+}
+
+bool isGPXdocLazy(const GPXdoc* doc){
+    return doc != NULL && doc->lazy != NULL;
+}
+
+int getRouteNumPoints(const GPXdoc* doc, const Route* rte){
+    if (rte == NULL){
+        return 0;
+    }
+
+    const LazyElement* elem = findPending(doc, rte);
+    return elem != NULL ? elem->numPoints : getLength(rte->waypoints);
+}
+
+int getTrackNumPoints(const GPXdoc* doc, const Track* trk){
+    if (trk == NULL){
+        return 0;
+    }
+
+    const LazyElement* elem = findPending(doc, trk);
+    if (elem != NULL){
+        return elem->numPoints;
+    }
+
+    ListIterator iter = createIterator(trk->segments);
+    TrackSegment* seg;
+    int count = 0;
+
+    while ((seg = nextElement(&iter)) != NULL){
+        count += getLength(seg->waypoints);
+    }
+    return count;
+}
+
+int getTrackNumSegments(const GPXdoc* doc, const Track* trk){
+    if (trk == NULL){
+        return 0;
+    }
+
+    const LazyElement* elem = findPending(doc, trk);
+    return elem != NULL ? elem->numSegments : getLength(trk->segments);
+}
+
+Route* nextGPXRoute(GPXdoc* doc, ListIterator* iter){
+    Route* rte = nextElement(iter);
+
+    loadGPXRoute(doc, rte);
+    return rte;
+}
+
+Track* nextGPXTrack(GPXdoc* doc, ListIterator* iter){
+    Track* trk = nextElement(iter);
+
+    loadGPXTrack(doc, trk);
+    return trk;
+}
+
+/* ******************************* Parser internals *************************** */
+
+int getLazySegmentCount(const GPXdoc* doc){
+    return doc->lazy != NULL ? doc->lazy->pendingSegments : 0;
+}
+
+int getLazyGPXDataCount(const GPXdoc* doc){
+    return doc->lazy != NULL ? doc->lazy->pendingData : 0;
+}
+
+bool isLazyElementPending(const GPXdoc* doc, const void* element){
+    return findPending(doc, element) != NULL;
+}
+
+void forgetLazyElement(GPXdoc* doc, const void* element){
+    LazyElement* elem = findPending(doc, element);
+
+    if (elem != NULL){
+        markLoaded(doc, elem);
+    }
+}
+
+void deleteGPXLazy(struct gpxLazy* lazy){
+    if (lazy == NULL){
+        return;
+    }
+
+    //The lists of the elements left unloaded stay in the document, empty
+    for (int i = 0; i < lazy->numElements; i++){
+        if (!lazy->elements[i].loaded){
+            setListFill(pendingList(&lazy->elements[i]), NULL, NULL);
+        }
+    }
+    if (lazy->fd >= 0){
+        close(lazy->fd);
+    }
+    free(lazy->url);
+    free(lazy->head);
+    free(lazy->tail);
+    free(lazy->elements);
+    free(lazy);
+}
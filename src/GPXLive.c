@@ -0,0 +1,637 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "GPXLive.h"
+#include "GPXHelpers.h"
+
+//Depth of the deepest element on the path <gpx><trk><trkseg> that a document can be resumed inside
+#define MAX_PATH_DEPTH 3
+
+//Kinds of the open elements.  The kind of an element on the path is its depth
+typedef enum {
+    OTHER_ELEMENT,
+    GPX_ELEMENT,
+    TRK_ELEMENT,
+    TRKSEG_ELEMENT
+} ElementKind;
+
+//An open element at depth 1 to MAX_PATH_DEPTH, and the offsets of its start tag in the file
+typedef struct {
+    ElementKind kind;
+    size_t start;
+    size_t end;
+} OpenTag;
+
+/* Where the scanner is in the file.  Only the tags of the outer elements are kept, so that the same
+   elements can be opened again before an appended tail and closed after it. */
+typedef struct {
+    int depth;
+    OpenTag open[MAX_PATH_DEPTH + 1];
+    //The root element has been closed
+    bool ended;
+    //Something other than white space, comments and PIs follows the root, or an end tag has no start tag
+    bool trailing;
+} ScanState;
+
+//Checksum of a run of bytes, fed in pieces of any size.  It covers the whole words, and pending holds the rest
+typedef struct {
+    uint64_t value;
+    char pending[8];
+    size_t numPending;
+} Checksum;
+
+struct gpxLiveFile {
+    char* fileName;
+    unsigned int options;
+    GPXdoc* doc;
+
+    /* The prolog and start tag of the root, and the start tags of the <trk> and <trkseg> open at offset, which
+       state points into: the head that the next tail is wrapped in.  During an update it is followed by the
+       bytes of the file after offset.  Between updates nothing else of the file is kept */
+    char* data;
+    size_t headLength;
+    size_t size;
+    size_t capacity;
+
+    //Number of bytes of the file read into doc, the scanner state after them and their checksum
+    size_t offset;
+    ScanState state;
+    Checksum checksum;
+
+    //End tags of the elements open at the resume point
+    StringBuilder tail;
+};
+
+/* ******************************* Checksum *************************** */
+
+#define CHECKSUM_SEED 0x84222325cbf29ce4ULL
+
+static void initChecksum(Checksum* checksum){
+    checksum->value = CHECKSUM_SEED;
+    checksum->numPending = 0;
+}
+
+static uint64_t mixWord(uint64_t value, const char* data){
+    uint64_t word;
+
+    memcpy(&word, data, 8);
+    value = (value ^ word) * 0x9e3779b97f4a7c15ULL;
+    return value ^ (value >> 32);
+}
+
+//Continues a checksum over length more bytes.  The result does not depend on how the bytes are split up
+static void addToChecksum(Checksum* checksum, const char* data, size_t length){
+    if (checksum->numPending > 0){
+        size_t count = 8 - checksum->numPending < length ? 8 - checksum->numPending : length;
+
+        memcpy(checksum->pending + checksum->numPending, data, count);
+        checksum->numPending += count;
+        data += count;
+        length -= count;
+        if (checksum->numPending < 8){
+            return;
+        }
+        checksum->value = mixWord(checksum->value, checksum->pending);
+        checksum->numPending = 0;
+    }
+
+    size_t words = length & ~(size_t)7;
+    for (size_t i = 0; i < words; i += 8){
+        checksum->value = mixWord(checksum->value, data + i);
+    }
+    memcpy(checksum->pending, data + words, length - words);
+    checksum->numPending = length - words;
+}
+
+static bool sameChecksum(const Checksum* first, const Checksum* second){
+    return first->value == second->value && first->numPending == second->numPending &&
+           memcmp(first->pending, second->pending, first->numPending) == 0;
+}
+
+/* ******************************* Scanner *************************** */
+
+//Returns the offset of text in data between start and end, or end if it is not there
+static size_t findText(const char* data, size_t start, size_t end, const char* text){
+    size_t length = strlen(text);
+
+    while (start + length <= end){
+        const char* next = memchr(data + start, text[0], end - start - length + 1);
+        if (next == NULL){
+            break;
+        }
+        start = next - data;
+        if (memcmp(next, text, length) == 0){
+            return start;
+        }
+        start++;
+    }
+    return end;
+}
+
+//Returns the offset of the '>' that ends the tag starting at start, or end if the tag is incomplete
+static size_t findTagEnd(const char* data, size_t start, size_t end){
+    char quote = '\0';
+
+    for (size_t i = start; i < end; i++){
+        char c = data[i];
+        if (quote != '\0'){
+            if (c == quote){
+                quote = '\0';
+            }
+        }else if (c == '"' || c == '\''){
+            quote = c;
+        }else if (c == '>'){
+            return i;
+        }
+    }
+    return end;
+}
+
+/* Returns the offset of the '>' that ends a DOCTYPE, or end if it is incomplete.  start is just after
+   "<!".  The internal subset between '[' and ']' may hold declarations, comments and PIs, and quoted
+   strings anywhere may hold '>' */
+static size_t findDoctypeEnd(const char* data, size_t start, size_t end){
+    bool inSubset = false;
+
+    for (size_t i = start; i < end; i++){
+        char c = data[i];
+        if (c == '"' || c == '\''){
+            const char* quote = memchr(data + i + 1, c, end - i - 1);
+            if (quote == NULL){
+                return end;
+            }
+            i = quote - data;
+        }else if (inSubset && c == '<' && i + 3 < end && memcmp(data + i, "<!--", 4) == 0){
+            i = findText(data, i + 4, end, "-->");
+            if (i == end){
+                return end;
+            }
+            i += 2;
+        }else if (inSubset && c == '<' && i + 1 < end && data[i + 1] == '?'){
+            i = findText(data, i + 2, end, "?>");
+            if (i == end){
+                return end;
+            }
+            i++;
+        }else if (c == '['){
+            inSubset = true;
+        }else if (c == ']'){
+            inSubset = false;
+        }else if (c == '>' && !inSubset){
+            return i;
+        }
+    }
+    return end;
+}
+
+//Returns the length of the qualified element name at the start of a tag, after its '<' or "</"
+static size_t tagNameLength(const char* name, const char* end){
+    size_t length = 0;
+
+    while (name + length < end && !isspace((unsigned char)name[length]) && name[length] != '/' && name[length] != '>'){
+        length++;
+    }
+    return length;
+}
+
+static ElementKind elementKind(const char* name, size_t length, int depth){
+    static const char* pathNames[MAX_PATH_DEPTH + 1] = {NULL, "gpx", "trk", "trkseg"};
+    const char* colon = memchr(name, ':', length);
+
+    if (depth > MAX_PATH_DEPTH){
+        return OTHER_ELEMENT;
+    }
+    if (colon != NULL){
+        length -= colon + 1 - name;
+        name = colon + 1;
+    }
+    return length == strlen(pathNames[depth]) && memcmp(name, pathNames[depth], length) == 0 ? (ElementKind)depth : OTHER_ELEMENT;
+}
+
+//Returns true if every open element is on the path <gpx><trk><trkseg>
+static bool isOnPath(const ScanState* state){
+    if (state->ended || state->depth < 1 || state->depth > MAX_PATH_DEPTH){
+        return false;
+    }
+    for (int depth = 1; depth <= state->depth; depth++){
+        if (state->open[depth].kind != (ElementKind)depth){
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Scans the tags of data from start, where the scanner was in state, up to end.  Returns the last offset
+   a document can be resumed from, and leaves state as it was there: just after the start tag of an
+   element on the path <gpx><trk><trkseg>, or after the end of a child of one.  The end tags of the path
+   are never resume points, so that the closing tags of a file can be rewritten without changing the
+   bytes before its resume point.  Returns start if there is no resume point. */
+static size_t scanToResumePoint(const char* data, size_t start, size_t end, ScanState* state){
+    ScanState resumeState = *state;
+    size_t resume = start;
+    size_t i = start;
+
+    while (i < end && !state->trailing){
+        if (data[i] != '<'){
+            const char* next = memchr(data + i, '<', end - i);
+            size_t textEnd = next != NULL ? (size_t)(next - data) : end;
+
+            for (; state->ended && i < textEnd; i++){
+                state->trailing |= !isspace((unsigned char)data[i]);
+            }
+            i = textEnd;
+            continue;
+        }
+
+        //Comments, CDATA sections and DOCTYPEs are only told apart once their first bytes have been written
+        size_t close;
+        if (i + 2 >= end || (data[i + 1] == '!' && end - i < (data[i + 2] == '[' ? 9 : 4))){
+            break;
+        }
+        if (data[i + 1] == '?'){
+            close = findText(data, i + 2, end, "?>");
+            if (close == end){
+                break;
+            }
+            i = close + 2;
+            continue;
+        }
+        if (data[i + 1] == '!' && data[i + 2] == '-' && data[i + 3] == '-'){
+            close = findText(data, i + 4, end, "-->");
+            if (close == end){
+                break;
+            }
+            i = close + 3;
+            continue;
+        }
+        if (data[i + 1] == '!' && data[i + 2] == '[' && memcmp(data + i, "<![CDATA[", 9) == 0){
+            close = findText(data, i + 9, end, "]]>");
+            if (close == end){
+                break;
+            }
+            state->trailing |= state->ended;
+            i = close + 3;
+            continue;
+        }
+        if (data[i + 1] == '!'){
+            close = findDoctypeEnd(data, i + 2, end);
+            if (close == end){
+                break;
+            }
+            state->trailing |= state->ended || state->depth > 0;
+            i = close + 1;
+            continue;
+        }
+
+        close = findTagEnd(data, i + 1, end);
+        if (close == end){
+            break;
+        }
+
+        bool resumable = false;
+        if (data[i + 1] == '/'){
+            if (state->depth == 0){
+                state->trailing = true;
+                break;
+            }
+            bool onPath = state->depth <= MAX_PATH_DEPTH && state->open[state->depth].kind == (ElementKind)state->depth;
+            state->depth--;
+            state->ended = state->depth == 0;
+            resumable = !onPath;
+        }else{
+            if (state->ended){
+                state->trailing = true;
+                break;
+            }
+            state->depth++;
+            if (state->depth <= MAX_PATH_DEPTH){
+                const char* name = data + i + 1;
+                OpenTag* tag = &state->open[state->depth];
+
+                tag->kind = elementKind(name, tagNameLength(name, data + close), state->depth);
+                tag->start = i;
+                tag->end = close + 1;
+            }
+            if (data[close - 1] == '/'){
+                state->depth--;
+                state->ended = state->depth == 0;
+            }
+            resumable = true;
+        }
+
+        i = close + 1;
+        if (resumable && isOnPath(state)){
+            resume = i;
+            resumeState = *state;
+        }
+    }
+
+    resumeState.trailing = state->trailing;
+    *state = resumeState;
+    return resume;
+}
+
+//Appends the end tags of the open elements of state to sb
+static bool appendEndTags(StringBuilder* sb, const char* data, const ScanState* state){
+    bool ok = true;
+
+    for (int depth = state->depth; ok && depth >= 1; depth--){
+        const char* name = data + state->open[depth].start + 1;
+        size_t length = tagNameLength(name, data + state->open[depth].end);
+
+        ok = appendString(sb, "</") && appendStringLen(sb, name, length) && appendString(sb, ">");
+    }
+    return ok;
+}
+
+/* ******************************* Updates *************************** */
+
+//Size of the pieces the bytes before the offset are read and checksummed in
+#define READ_CHUNK_SIZE 65536
+
+//Reads up to length bytes.  Returns the number read, fewer only at the end of the file, or -1 on an error
+static ssize_t readBytes(int fd, char* data, size_t length){
+    size_t done = 0;
+
+    while (done < length){
+        ssize_t count = read(fd, data + done, length - done);
+        if (count < 0 && errno == EINTR){
+            continue;
+        }
+        if (count < 0){
+            return -1;
+        }
+        if (count == 0){
+            break;
+        }
+        done += count;
+    }
+    return done;
+}
+
+//Makes room for capacity bytes in *data.  Returns false if realloc fails
+static bool reserve(char** data, size_t* currentCapacity, size_t capacity){
+    if (*currentCapacity >= capacity){
+        return true;
+    }
+
+    char* grown = realloc(*data, capacity);
+    if (grown == NULL){
+        return false;
+    }
+    *data = grown;
+    *currentCapacity = capacity;
+    return true;
+}
+
+//Reads the rest of the file into *data after its first *size bytes.  Returns false on an error or if realloc fails
+static bool readToEnd(int fd, char** data, size_t* size, size_t* capacity){
+    //The file may be growing, so read until the end instead of st_size bytes
+    while (true){
+        if (*size == *capacity && !reserve(data, capacity, *capacity * 2 > *size + READ_CHUNK_SIZE ? *capacity * 2 : *size + READ_CHUNK_SIZE)){
+            return false;
+        }
+
+        ssize_t count = readBytes(fd, *data + *size, *capacity - *size);
+        if (count < 0){
+            return false;
+        }
+        *size += count;
+        if (*size < *capacity){
+            return true;
+        }
+    }
+}
+
+/* Reads the first live->offset bytes of the file in chunks, after the head, and returns true if they are the
+   ones that were read into the document.  The file is left positioned after them */
+static bool isPrefixUnchanged(GPXLiveFile* live, int fd){
+    Checksum checksum;
+    size_t done = 0;
+
+    initChecksum(&checksum);
+    if (!reserve(&live->data, &live->capacity, live->headLength + READ_CHUNK_SIZE)){
+        return false;
+    }
+    while (done < live->offset){
+        size_t length = live->offset - done < READ_CHUNK_SIZE ? live->offset - done : READ_CHUNK_SIZE;
+
+        if (readBytes(fd, live->data + live->headLength, length) != (ssize_t)length){
+            return false;
+        }
+        addToChecksum(&checksum, live->data + live->headLength, length);
+        done += length;
+    }
+    return sameChecksum(&checksum, &live->checksum);
+}
+
+/* Copies the head for the elements of state that are open at a resume point in data to head, and points
+   state at the copy.  Returns its length: 0 if the document cannot be resumed there.  The pieces are copied
+   in order to lower offsets, so head may be data itself */
+static size_t copyHead(char* head, const char* data, ScanState* state){
+    if (!isOnPath(state)){
+        return 0;
+    }
+
+    size_t length = state->open[GPX_ELEMENT].end;
+    memmove(head, data, length);
+    for (int depth = TRK_ELEMENT; depth <= state->depth; depth++){
+        OpenTag* tag = &state->open[depth];
+        size_t tagLength = tag->end - tag->start;
+
+        memmove(head + length, data + tag->start, tagLength);
+        tag->start = length;
+        tag->end = length + tagLength;
+        length += tagLength;
+    }
+    return length;
+}
+
+//Returns the length of the head copyHead would copy
+static size_t headLength(const ScanState* state){
+    size_t length = isOnPath(state) ? state->open[GPX_ELEMENT].end : 0;
+
+    for (int depth = TRK_ELEMENT; length > 0 && depth <= state->depth; depth++){
+        length += state->open[depth].end - state->open[depth].start;
+    }
+    return length;
+}
+
+//Parses the whole file into a new document.  The file is read into a buffer of its own, freed afterwards
+static GPXLiveStatus reload(GPXLiveFile* live, int fd){
+    char* data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    if (lseek(fd, 0, SEEK_SET) != 0 || !readToEnd(fd, &data, &size, &capacity)){
+        free(data);
+        return GPX_LIVE_FAILED;
+    }
+
+    ScanState state;
+    memset(&state, 0, sizeof(ScanState));
+
+    size_t resume = scanToResumePoint(data, 0, size, &state);
+    size_t length = resume;
+    bool closed = false;
+
+    //A complete file with no resume point, such as <gpx .../>, and files that cannot be resumed are read as they are
+    if (state.trailing || (resume == 0 && state.ended)){
+        resume = length = size;
+        closed = true;
+    }
+
+    Checksum checksum;
+    initChecksum(&checksum);
+    addToChecksum(&checksum, data, resume);
+
+    live->tail.len = 0;
+    size_t newHeadLength = closed ? 0 : headLength(&state);
+    char* head = malloc(newHeadLength + 1);
+    bool ok = resume > 0 && head != NULL;
+
+    if (ok && !closed){
+        //The bytes after the resume point are not needed any more, so the end tags are written over them
+        ok = appendEndTags(&live->tail, data, &state) && reserve(&data, &capacity, resume + live->tail.len);
+        if (ok){
+            memcpy(data + resume, live->tail.str, live->tail.len);
+            length = resume + live->tail.len;
+            copyHead(head, data, &state);
+        }
+    }
+
+    GPXdoc* doc = ok ? createGPXdocFromMemory(data, length, live->options) : NULL;
+    free(data);
+    if (doc == NULL){
+        free(head);
+        return GPX_LIVE_FAILED;
+    }
+
+    deleteGPXdoc(live->doc);
+    free(live->data);
+    live->doc = doc;
+    live->data = head;
+    live->headLength = live->size = newHeadLength;
+    live->capacity = newHeadLength + 1;
+    live->state = state;
+    live->offset = resume;
+    live->checksum = checksum;
+    return GPX_LIVE_RELOADED;
+}
+
+/* Parses the bytes between live->offset and the next resume point, which follow the head in live->data,
+   into the document.  The head wraps them in the root's start tag, with the prolog before it, and the
+   start tags of the <trk> and <trkseg> they continue, and they are closed with the end tags of the
+   elements open at the resume point.  The tail is parsed once: appendGPXdoc leaves the document as it was
+   if it is not valid GPX, and the whole file is parsed again. */
+static GPXLiveStatus appendTail(GPXLiveFile* live, int fd){
+    ScanState state = live->state;
+    size_t resume = scanToResumePoint(live->data, live->headLength, live->size, &state);
+
+    if (state.trailing){
+        return reload(live, fd);
+    }
+    if (resume == live->headLength){
+        return GPX_LIVE_UNCHANGED;
+    }
+
+    //The bytes after the resume point are read again by the next update, so the end tags are written over them
+    live->tail.len = 0;
+    if (!appendEndTags(&live->tail, live->data, &state) || !reserve(&live->data, &live->capacity, resume + live->tail.len) ||
+        resume + live->tail.len > INT_MAX){
+        return reload(live, fd);
+    }
+    memcpy(live->data + resume, live->tail.str, live->tail.len);
+
+    if (!appendGPXdoc(xmlReaderForMemory(live->data, resume + live->tail.len, live->fileName, NULL, 0), live->doc,
+                      live->state.depth - 1, live->options)){
+        return reload(live, fd);
+    }
+
+    addToChecksum(&live->checksum, live->data + live->headLength, resume - live->headLength);
+    live->offset += resume - live->headLength;
+    live->state = state;
+    live->headLength = live->size = copyHead(live->data, live->data, &live->state);
+
+    //Give back the room the tail took, when it was large
+    if (live->capacity > 2 * live->headLength + 4 * READ_CHUNK_SIZE){
+        char* data = realloc(live->data, live->headLength + READ_CHUNK_SIZE);
+        if (data != NULL){
+            live->data = data;
+            live->capacity = live->headLength + READ_CHUNK_SIZE;
+        }
+    }
+    return GPX_LIVE_APPENDED;
+}
+
+GPXLiveFile* openGPXLiveFile(const char* fileName, unsigned int options){
+    if (fileName == NULL || fileName[0] == '\0'){
+        return NULL;
+    }
+
+    GPXLiveFile* live = calloc(1, sizeof(GPXLiveFile));
+    if (live == NULL || (live->fileName = gpxStrdup(fileName)) == NULL){
+        free(live);
+        return NULL;
+    }
+    live->options = options & ~GPX_OPT_MMAP;
+
+    updateGPXLiveFile(live);
+    return live;
+}
+
+GPXLiveStatus updateGPXLiveFile(GPXLiveFile* live){
+    if (live == NULL){
+        return GPX_LIVE_FAILED;
+    }
+
+    int fd = open(live->fileName, O_RDONLY);
+    struct stat info;
+    GPXLiveStatus status = GPX_LIVE_FAILED;
+
+    if (fd < 0){
+        return GPX_LIVE_FAILED;
+    }
+
+    live->size = live->headLength;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+        status = GPX_LIVE_FAILED;
+    }else if (live->doc == NULL || !isPrefixUnchanged(live, fd)){
+        status = reload(live, fd);
+    }else if (!readToEnd(fd, &live->data, &live->size, &live->capacity)){
+        status = GPX_LIVE_FAILED;
+    }else if (live->state.trailing || !isOnPath(&live->state)){
+        status = live->size == live->headLength ? GPX_LIVE_UNCHANGED : reload(live, fd);
+    }else{
+        status = appendTail(live, fd);
+    }
+
+    //Only the head is kept until the next update
+    live->size = live->headLength;
+    close(fd);
+    return status;
+}
+
+GPXdoc* getGPXLiveDoc(const GPXLiveFile* live){
+    return live != NULL ? live->doc : NULL;
+}
+
+size_t getGPXLiveOffset(const GPXLiveFile* live){
+    return live != NULL ? live->offset : 0;
+}
+
+void closeGPXLiveFile(GPXLiveFile* live){
+    if (live == NULL){
+        return;
+    }
+    deleteGPXdoc(live->doc);
+    free(live->fileName);
+    free(live->data);
+    free(live->tail.str);
+    free(live);
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "GPXNames.h"
+
+//Child elements of <wpt>, <rte> and <trk> in the GPX 1.1 schema, most frequent first
+static const char* const schemaNames[] = {
+    "ele", "time", "sym", "desc", "cmt", "type", "src", "link", "sat", "hdop", "vdop", "pdop", "fix",
+    "magvar", "geoidheight", "ageofdgpsdata", "dgpsid", "number", "extensions"
+};
+
+#define NUM_SCHEMA_NAMES (sizeof(schemaNames) / sizeof(schemaNames[0]))
+
+//Open-addressing table of other names, guarded by lock.  capacity is a power of two
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char** names = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+static uint32_t hashName(const char* name, size_t len){
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++){
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+//Whether the table entry equals the first len characters of name
+static bool sameName(const char* entry, const char* name, size_t len){
+    return strncmp(entry, name, len) == 0 && entry[len] == '\0';
+}
+
+static bool growTable(void){
+    size_t newCapacity = capacity == 0 ? 64 : capacity * 2;
+    char** table = calloc(newCapacity, sizeof(char*));
+
+    if (table == NULL){
+        return false;
+    }
+
+    for (size_t i = 0; i < capacity; i++){
+        if (names[i] != NULL){
+            size_t j = hashName(names[i], strlen(names[i])) & (newCapacity - 1);
+
+            while (table[j] != NULL){
+                j = (j + 1) & (newCapacity - 1);
+            }
+            table[j] = names[i];
+        }
+    }
+
+    free(names);
+    names = table;
+    capacity = newCapacity;
+    return true;
+}
+
+static const char* internOther(const char* name, size_t len){
+    const char* result = NULL;
+
+    pthread_mutex_lock(&lock);
+    //A full table is not grown again, and is still at most half full
+    if (count * 2 < capacity || count >= GPX_MAX_SHARED_NAMES || growTable()){
+        uint32_t hash = hashName(name, len);
+        size_t i = hash & (capacity - 1);
+
+        while (names[i] != NULL && !sameName(names[i], name, len)){
+            i = (i + 1) & (capacity - 1);
+        }
+
+        //Once the table is full, new names are left to the caller and only the names already in it are shared
+        if (names[i] == NULL && count < GPX_MAX_SHARED_NAMES){
+            char* copy = malloc(len + 1);
+
+            if (copy != NULL){
+                memcpy(copy, name, len);
+                copy[len] = '\0';
+                names[i] = copy;
+                count++;
+            }
+        }
+        result = names[i];
+    }
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+const char* internGPXName(const char* name){
+    size_t len = strnlen(name, GPX_MAX_NAME_LENGTH);
+
+    for (size_t i = 0; i < NUM_SCHEMA_NAMES; i++){
+        if (schemaNames[i][0] == name[0] && sameName(schemaNames[i], name, len)){
+            return schemaNames[i];
+        }
+    }
+    return internOther(name, len);
+}
+
+bool isGPXDataRecord(const GPXData* data){
+    return data->name[0] == '\0';
+}
+
+size_t getGPXDataSize(size_t valueLen){
+    return sizeof(GPXData) + valueLen + 1;
+}
+
+GPXData* fillGPXData(void* block, const char* name, const char* value, size_t valueLen){
+    GPXData* data = block;
+    size_t len = strnlen(name, GPX_MAX_NAME_LENGTH);
+
+    memcpy(data->name, name, len);
+    data->name[len] = '\0';
+    memcpy(data->value, value, valueLen + 1);
+    return data;
+}
+
+size_t getGPXDataRecordSize(const char* shared, const char* name, size_t valueLen){
+    size_t size = sizeof(GPXDataRecord) + valueLen + 1;
+
+    return shared != NULL ? size : size + strnlen(name, GPX_MAX_NAME_LENGTH) + 1;
+}
+
+GPXData* fillGPXDataRecord(void* block, const char* shared, const char* name, const char* value, size_t valueLen){
+    GPXDataRecord* record = block;
+
+    record->marker = '\0';
+    memcpy(record->value, value, valueLen + 1);
+    if (shared != NULL){
+        record->name = shared;
+    }else{
+        char* copy = record->value + valueLen + 1;
+        size_t len = strnlen(name, GPX_MAX_NAME_LENGTH);
+
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+        record->name = copy;
+    }
+    return block;
+}
@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include "GPXParallel.h"
+#include "GPXScan.h"
+#include "GPXHelpers.h"
+#include "GPXArena.h"
+#include "GPXCounters.h"
+#include "GPXWorkers.h"
+#include "GPXSpatial.h"
+
+//Smallest piece of a document worth parsing on its own
+#define MIN_UNIT_SIZE (256 * 1024)
+
+//Units per thread, so that threads that finish early can take work from the others
+#define UNITS_PER_THREAD 4
+
+/* ******************************* Units *************************** */
+
+typedef enum {
+    //Complete top-level elements
+    UNIT_TOP,
+    //One <trk> without its <trkseg> elements
+    UNIT_TRACK,
+    //Complete <trkseg> elements of the last UNIT_TRACK
+    UNIT_SEGMENTS,
+    //Points of one <trkseg> of the last UNIT_TRACK
+    UNIT_POINTS
+} UnitKind;
+
+typedef struct {
+    UnitKind kind;
+    //For UNIT_POINTS: whether this is the first piece of its segment
+    bool startsSegment;
+
+    ByteRange* ranges;
+    int numRanges;
+    int capRanges;
+
+    GPXdoc* doc;
+} Unit;
+
+typedef struct {
+    const char* data;
+    const char* url;
+    unsigned int options;
+
+    Unit* units;
+    int numUnits;
+    int capUnits;
+    bool failed;
+} Plan;
+
+static Unit* addUnit(Plan* plan, UnitKind kind){
+    if (!reserveGPXArray((void**)&plan->units, &plan->capUnits, plan->numUnits, sizeof(Unit))){
+        plan->failed = true;
+        return NULL;
+    }
+
+    Unit* unit = &plan->units[plan->numUnits++];
+    unit->kind = kind;
+    unit->startsSegment = false;
+    unit->ranges = NULL;
+    unit->numRanges = 0;
+    unit->capRanges = 0;
+    unit->doc = NULL;
+    return unit;
+}
+
+static void addRange(Plan* plan, Unit* unit, size_t start, size_t end){
+    if (unit == NULL || start >= end){
+        return;
+    }
+    if (!reserveGPXArray((void**)&unit->ranges, &unit->capRanges, unit->numRanges, sizeof(ByteRange))){
+        plan->failed = true;
+        return;
+    }
+    unit->ranges[unit->numRanges].start = start;
+    unit->ranges[unit->numRanges].end = end;
+    unit->numRanges++;
+}
+
+//Adds a unit made of the prolog and <gpx> start tag, the given ranges and the </gpx> end tag
+static Unit* addWrappedUnit(Plan* plan, const Scan* scan, UnitKind kind, const ByteRange* ranges, int numRanges){
+    Unit* unit = addUnit(plan, kind);
+
+    addRange(plan, unit, 0, scan->root.tagEnd);
+    for (int i = 0; i < numRanges; i++){
+        addRange(plan, unit, ranges[i].start, ranges[i].end);
+    }
+    addRange(plan, unit, scan->root.closeStart, scan->root.end);
+    return unit;
+}
+
+//Splits a large track into a UNIT_TRACK for everything but its segments, then segment and point units
+static void planTrack(Plan* plan, const Scan* scan, const ChildScan* trk){
+    Unit* unit = addUnit(plan, UNIT_TRACK);
+    size_t from = trk->span.start;
+
+    addRange(plan, unit, 0, scan->root.tagEnd);
+    for (int i = 0; i < trk->numSegments; i++){
+        addRange(plan, unit, from, trk->segments[i].span.start);
+        from = trk->segments[i].span.end;
+    }
+    addRange(plan, unit, from, trk->span.end);
+    addRange(plan, unit, scan->root.closeStart, scan->root.end);
+
+    ByteRange trkStart = {trk->span.start, trk->span.tagEnd};
+    ByteRange trkEnd = {trk->span.closeStart, trk->span.end};
+
+    for (int i = 0; i < trk->numSegments; ){
+        const SegmentScan* seg = &trk->segments[i];
+
+        if (seg->numCuts == 0){
+            //Group whole segments until the group is large enough
+            int last = i;
+            while (last + 1 < trk->numSegments && trk->segments[last + 1].numCuts == 0 &&
+                   trk->segments[last].span.end - seg->span.start < scan->unitSize){
+                last++;
+            }
+
+            ByteRange ranges[] = {trkStart, {seg->span.start, trk->segments[last].span.end}, trkEnd};
+            addWrappedUnit(plan, scan, UNIT_SEGMENTS, ranges, 3);
+            i = last + 1;
+            continue;
+        }
+
+        //Cut a large segment between its points
+        size_t from = seg->span.tagEnd;
+        for (int j = 0; j <= seg->numCuts; j++){
+            size_t to = j < seg->numCuts ? seg->cuts[j] : seg->span.closeStart;
+            if (to <= from && j > 0){
+                continue;
+            }
+
+            ByteRange ranges[] = {trkStart, {seg->span.start, seg->span.tagEnd}, {from, to},
+                                  {seg->span.closeStart, seg->span.end}, trkEnd};
+            Unit* piece = addWrappedUnit(plan, scan, UNIT_POINTS, ranges, 5);
+            if (piece != NULL){
+                piece->startsSegment = j == 0;
+            }
+            from = to;
+        }
+        i++;
+    }
+}
+
+static void planDocument(Plan* plan, const Scan* scan){
+    size_t groupStart = 0;
+    size_t groupEnd = 0;
+
+    for (int i = 0; i < scan->numChildren && !plan->failed; i++){
+        const ChildScan* child = &scan->children[i];
+        bool large = child->isTrack && child->numSegments > 0 && child->span.end - child->span.start >= scan->unitSize;
+
+        if (groupEnd > groupStart && (large || groupEnd - groupStart >= scan->unitSize)){
+            ByteRange range = {groupStart, groupEnd};
+            addWrappedUnit(plan, scan, UNIT_TOP, &range, 1);
+            groupStart = groupEnd = 0;
+        }
+
+        if (large){
+            planTrack(plan, scan, child);
+        }else{
+            if (groupEnd == groupStart){
+                groupStart = child->span.start;
+            }
+            groupEnd = child->span.end;
+        }
+    }
+
+    if (groupEnd > groupStart || plan->numUnits == 0){
+        ByteRange range = {groupStart, groupEnd};
+        addWrappedUnit(plan, scan, UNIT_TOP, &range, 1);
+    }
+}
+
+/* ******************************* Parsing *************************** */
+
+static void parseUnit(void* userData, int index){
+    Plan* plan = userData;
+    Unit* unit = &plan->units[index];
+
+    unit->doc = parseGPXRanges(plan->data, unit->ranges, unit->numRanges, plan->url, plan->options);
+}
+
+/* ******************************* Merging *************************** */
+
+//Moves every node of from to the end of into, leaving from empty.  Observers are not notified
+static void spliceList(List* into, List* from){
+    if (from->head == NULL){
+        return;
+    }
+
+    if (into->tail == NULL){
+        into->head = from->head;
+    }else{
+        into->tail->next = from->head;
+        from->head->previous = into->tail;
+    }
+    into->tail = from->tail;
+    into->length += from->length;
+
+    from->head = NULL;
+    from->tail = NULL;
+    from->length = 0;
+}
+
+//Moves the contents of part into doc.  Returns false if part does not have the shape its unit implies
+static bool mergeUnit(GPXdoc* doc, Track** current, const Unit* unit){
+    GPXdoc* part = unit->doc;
+
+    if (unit->kind == UNIT_TOP){
+        spliceList(doc->waypoints, part->waypoints);
+        spliceList(doc->routes, part->routes);
+        spliceList(doc->tracks, part->tracks);
+        *current = NULL;
+        return true;
+    }
+
+    if (getLength(part->tracks) != 1){
+        return false;
+    }
+    Track* trk = getFromFront(part->tracks);
+
+    switch (unit->kind){
+        case UNIT_TRACK:
+            spliceList(doc->tracks, part->tracks);
+            *current = trk;
+            return true;
+        case UNIT_SEGMENTS:
+            if (*current == NULL){
+                return false;
+            }
+            spliceList((*current)->segments, trk->segments);
+            mergeBounds(&(*current)->bounds, &trk->bounds);
+            return true;
+        default:
+            if (*current == NULL || getLength(trk->segments) != 1){
+                return false;
+            }
+            if (unit->startsSegment){
+                spliceList((*current)->segments, trk->segments);
+            }else{
+                TrackSegment* last = getFromBack((*current)->segments);
+                TrackSegment* seg = getFromFront(trk->segments);
+                if (last == NULL){
+                    return false;
+                }
+                spliceList(last->waypoints, seg->waypoints);
+                mergeBounds(&last->bounds, &seg->bounds);
+            }
+            mergeBounds(&(*current)->bounds, &trk->bounds);
+            return true;
+    }
+}
+
+//Merges every unit into the first one's document.  The other documents are released
+static GPXdoc* mergeUnits(Plan* plan){
+    GPXdoc* doc = plan->units[0].doc;
+    Track* current = plan->units[0].kind == UNIT_TRACK ? getFromBack(doc->tracks) : NULL;
+    bool ok = true;
+
+    plan->units[0].doc = NULL;
+    for (int i = 1; i < plan->numUnits; i++){
+        GPXdoc* part = plan->units[i].doc;
+
+        ok = ok && mergeUnit(doc, &current, &plan->units[i]);
+        plan->units[i].doc = NULL;
+
+        if (part->arena != NULL){
+            mergeGPXArena(doc->arena, part->arena);
+        }else{
+            deleteGPXdoc(part);
+        }
+    }
+
+    //The spliced lists still report to the documents they came from
+    attachGPXCounters(doc);
+
+    if (!ok){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+GPXdoc* parseGPXParallel(const char* data, size_t size, const char* url, unsigned int options, int numThreads){
+    if (numThreads <= 0){
+        numThreads = getGPXProcessorCount();
+    }
+
+    ByteRange whole = {0, size};
+    if (numThreads == 1 || size < 2 * MIN_UNIT_SIZE){
+        return parseGPXRanges(data, &whole, 1, url, options);
+    }
+
+    Scan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.data = data;
+    scan.size = size;
+    scan.unitSize = size / (numThreads * UNITS_PER_THREAD);
+    if (scan.unitSize < MIN_UNIT_SIZE){
+        scan.unitSize = MIN_UNIT_SIZE;
+    }
+
+    //Nodes must stay in lists of the pool they came from, which splicing the units together would break
+    Plan plan = {data, url, options & ~GPX_OPT_NODE_POOL, NULL, 0, 0, false};
+    if (scanGPXDocument(&scan)){
+        planDocument(&plan, &scan);
+    }else{
+        plan.failed = true;
+    }
+    clearGPXScan(&scan);
+
+    GPXdoc* doc = NULL;
+    if (plan.failed || plan.numUnits < 2){
+        doc = parseGPXRanges(data, &whole, 1, url, options);
+    }else{
+        initGPXLibxml();
+        runGPXTasks(plan.numUnits, numThreads, &parseUnit, &plan);
+
+        bool ok = true;
+        for (int i = 0; i < plan.numUnits; i++){
+            ok = ok && plan.units[i].doc != NULL;
+        }
+
+        if (ok){
+            doc = mergeUnits(&plan);
+        }
+        for (int i = 0; i < plan.numUnits; i++){
+            deleteGPXdoc(plan.units[i].doc);
+        }
+    }
+
+    for (int i = 0; i < plan.numUnits; i++){
+        free(plan.units[i].ranges);
+    }
+    free(plan.units);
+    return doc;
+}
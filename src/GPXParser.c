@@ -0,0 +1,538 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include "GPXParser.h"
+#include "GPXHelpers.h"
+#include "GPXArena.h"
+#include "GPXIndex.h"
+#include "GPXCounters.h"
+#include "GPXSpatial.h"
+#include "GPXLazy.h"
+#include "StringBuilder.h"
+
+/* ******************************* DOM parsing *************************** */
+
+//Returns true if node is an element with the given local name
+static bool isElement(xmlNode* node, const char* name){
+    return node->type == XML_ELEMENT_NODE && strcmp((char*)node->name, name) == 0;
+}
+
+//Reads the text content of a child element.  The result must be freed with xmlFree
+static char* nodeText(xmlNode* node){
+    xmlChar* content = xmlNodeGetContent(node);
+
+    if (content == NULL){
+        return (char*)xmlStrdup((xmlChar*)"");
+    }
+    return (char*)content;
+}
+
+//Adds a child element to a name field or an otherData list.  The children of a waypoint (wpt is NULL for
+//routes and tracks) are also decoded into its typed fields.  Returns false if malloc fails
+static bool addChildData(xmlNode* child, char** name, List* otherData, Waypoint* wpt){
+    char* text = nodeText(child);
+    bool ok = true;
+
+    if (text == NULL){
+        return false;
+    }
+
+    if (strcmp((char*)child->name, "name") == 0){
+        ok = setGPXName(name, text);
+    }else if (text[0] != '\0'){
+        GPXData* data = createGPXData((char*)child->name, text);
+
+        if (wpt != NULL){
+            setWaypointField(wpt, (char*)child->name, text);
+        }
+        if (data == NULL){
+            ok = false;
+        }else{
+            insertBack(otherData, data);
+        }
+    }
+
+    xmlFree(text);
+    return ok;
+}
+
+static Waypoint* parseWaypointNode(xmlNode* node){
+    Waypoint* wpt = createWaypoint();
+
+    if (wpt == NULL){
+        return NULL;
+    }
+
+    char* lat = (char*)xmlGetProp(node, (xmlChar*)"lat");
+    char* lon = (char*)xmlGetProp(node, (xmlChar*)"lon");
+    bool ok = parseGPXDouble(lat, &wpt->latitude) && parseGPXDouble(lon, &wpt->longitude);
+    xmlFree(lat);
+    xmlFree(lon);
+
+    for (xmlNode* child = node->children; ok && child != NULL; child = child->next){
+        if (child->type == XML_ELEMENT_NODE){
+            ok = addChildData(child, &wpt->name, wpt->otherData, wpt);
+        }
+    }
+
+    if (!ok){
+        deleteWaypoint(wpt);
+        return NULL;
+    }
+    return wpt;
+}
+
+static Route* parseRouteNode(xmlNode* node){
+    Route* rte = createRoute();
+    bool ok = rte != NULL;
+
+    for (xmlNode* child = ok ? node->children : NULL; ok && child != NULL; child = child->next){
+        if (isElement(child, "rtept")){
+            Waypoint* wpt = parseWaypointNode(child);
+            ok = wpt != NULL;
+            insertBack(rte->waypoints, wpt);
+            if (ok){
+                extendBounds(&rte->bounds, wpt);
+            }
+        }else if (child->type == XML_ELEMENT_NODE){
+            ok = addChildData(child, &rte->name, rte->otherData, NULL);
+        }
+    }
+
+    if (!ok){
+        deleteRoute(rte);
+        return NULL;
+    }
+    return rte;
+}
+
+static TrackSegment* parseTrackSegmentNode(xmlNode* node){
+    TrackSegment* seg = createTrackSegment();
+    bool ok = seg != NULL;
+
+    for (xmlNode* child = ok ? node->children : NULL; ok && child != NULL; child = child->next){
+        if (isElement(child, "trkpt")){
+            Waypoint* wpt = parseWaypointNode(child);
+            ok = wpt != NULL;
+            insertBack(seg->waypoints, wpt);
+            if (ok){
+                extendBounds(&seg->bounds, wpt);
+            }
+        }
+    }
+
+    if (!ok){
+        deleteTrackSegment(seg);
+        return NULL;
+    }
+    return seg;
+}
+
+static Track* parseTrackNode(xmlNode* node){
+    Track* trk = createTrack();
+    bool ok = trk != NULL;
+
+    for (xmlNode* child = ok ? node->children : NULL; ok && child != NULL; child = child->next){
+        if (isElement(child, "trkseg")){
+            TrackSegment* seg = parseTrackSegmentNode(child);
+            ok = seg != NULL;
+            insertBack(trk->segments, seg);
+            if (ok){
+                mergeBounds(&trk->bounds, &seg->bounds);
+            }
+        }else if (child->type == XML_ELEMENT_NODE){
+            ok = addChildData(child, &trk->name, trk->otherData, NULL);
+        }
+    }
+
+    if (!ok){
+        deleteTrack(trk);
+        return NULL;
+    }
+    return trk;
+}
+
+//Copies the attributes of the <gpx> root element into doc
+static bool parseRootNode(xmlNode* root, GPXdoc* doc){
+    if (root == NULL || !isElement(root, "gpx") || root->ns == NULL || root->ns->href == NULL){
+        return false;
+    }
+
+    const char* href = (char*)root->ns->href;
+    if (href[0] == '\0' || strlen(href) >= sizeof(doc->namespace)){
+        return false;
+    }
+    strcpy(doc->namespace, href);
+
+    char* version = (char*)xmlGetProp(root, (xmlChar*)"version");
+    char* creator = (char*)xmlGetProp(root, (xmlChar*)"creator");
+    bool ok = parseGPXDouble(version, &doc->version) && creator != NULL && creator[0] != '\0';
+
+    if (ok){
+        doc->creator = gpxStrdup(creator);
+        ok = doc->creator != NULL;
+    }
+
+    xmlFree(version);
+    xmlFree(creator);
+    return ok;
+}
+
+GPXdoc* createGPXdoc(char* fileName){
+    if (fileName == NULL || fileName[0] == '\0'){
+        return NULL;
+    }
+
+    xmlDoc* xml = xmlReadFile(fileName, NULL, 0);
+    if (xml == NULL){
+        return NULL;
+    }
+
+    GPXdoc* doc = createEmptyGPXdoc();
+    xmlNode* root = xmlDocGetRootElement(xml);
+    bool ok = doc != NULL && parseRootNode(root, doc);
+
+    for (xmlNode* node = ok ? root->children : NULL; ok && node != NULL; node = node->next){
+        if (isElement(node, "wpt")){
+            Waypoint* wpt = parseWaypointNode(node);
+            ok = wpt != NULL;
+            insertBack(doc->waypoints, wpt);
+        }else if (isElement(node, "rte")){
+            Route* rte = parseRouteNode(node);
+            ok = rte != NULL;
+            insertBack(doc->routes, rte);
+        }else if (isElement(node, "trk")){
+            Track* trk = parseTrackNode(node);
+            ok = trk != NULL;
+            insertBack(doc->tracks, trk);
+        }
+    }
+
+    xmlFreeDoc(xml);
+
+    if (!ok){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+/* ******************************* Printing *************************** */
+
+/* The *ToString functions append straight into one StringBuilder instead of concatenating the strings
+   of their children, so printing a document is linear in the size of the output. */
+
+//Appends "\n" and the string of each element of a list, like toString
+static bool appendList(StringBuilder* sb, List* list, bool (*appendElement)(StringBuilder* sb, const void* data)){
+    ListIterator iter = createIterator(list);
+    void* elem;
+
+    while ((elem = nextElement(&iter)) != NULL){
+        if (!appendString(sb, "\n") || !appendElement(sb, elem)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool appendGPXData(StringBuilder* sb, const void* data){
+    return appendString(sb, getGPXDataName(data)) && appendString(sb, ": ") && appendString(sb, getGPXDataValue(data));
+}
+
+static bool appendWaypoint(StringBuilder* sb, const void* data){
+    const Waypoint* wpt = data;
+    return appendFormat(sb, "Waypoint: name=%s, lat=%f, lon=%f", wpt->name, wpt->latitude, wpt->longitude) &&
+           appendList(sb, wpt->otherData, &appendGPXData);
+}
+
+static bool appendRoute(StringBuilder* sb, const void* data){
+    const Route* rte = data;
+    return appendString(sb, "Route: name=") && appendString(sb, rte->name) &&
+           appendList(sb, rte->otherData, &appendGPXData) && appendList(sb, rte->waypoints, &appendWaypoint);
+}
+
+static bool appendTrackSegment(StringBuilder* sb, const void* data){
+    const TrackSegment* seg = data;
+    return appendString(sb, "Track segment:") && appendList(sb, seg->waypoints, &appendWaypoint);
+}
+
+static bool appendTrack(StringBuilder* sb, const void* data){
+    const Track* trk = data;
+    return appendString(sb, "Track: name=") && appendString(sb, trk->name) &&
+           appendList(sb, trk->otherData, &appendGPXData) && appendList(sb, trk->segments, &appendTrackSegment);
+}
+
+//Hands over the built string, or frees it and returns NULL if building failed
+static char* finishString(StringBuilder* sb, bool ok){
+    if (!ok){
+        free(sb->str);
+        return NULL;
+    }
+    return sb->str;
+}
+
+//Prints one element with its appender
+static char* elementToString(const void* data, bool (*appendElement)(StringBuilder* sb, const void* data)){
+    if (data == NULL){
+        return NULL;
+    }
+
+    StringBuilder sb = {NULL, 0, 0};
+    return finishString(&sb, appendElement(&sb, data));
+}
+
+/* ******************************* Public API *************************** */
+
+char* GPXdocToString(GPXdoc* doc){
+    if (doc == NULL || !loadGPXdoc(doc)){
+        return NULL;
+    }
+
+    StringBuilder sb = {NULL, 0, 0};
+    bool ok = appendFormat(&sb, "GPX doc: namespace=%s, version=%.1f, creator=%s", doc->namespace, doc->version, doc->creator) &&
+              appendString(&sb, "\nWaypoints:") && appendList(&sb, doc->waypoints, &appendWaypoint) &&
+              appendString(&sb, "\nRoutes:") && appendList(&sb, doc->routes, &appendRoute) &&
+              appendString(&sb, "\nTracks:") && appendList(&sb, doc->tracks, &appendTrack) &&
+              appendString(&sb, "\n");
+
+    return finishString(&sb, ok);
+}
+
+void deleteGPXdoc(GPXdoc* doc){
+    if (doc == NULL){
+        return;
+    }
+
+    //Only the last owner of a frozen document frees it
+    if (doc->frozen && atomic_fetch_sub(&doc->refCount, 1) != 1){
+        return;
+    }
+
+    deleteNameIndex(doc->nameIndex);
+    detachGPXCounters(doc);
+    deleteGPXLazy(doc->lazy);
+
+    //The document itself lives in its arena
+    if (doc->arena != NULL){
+        deleteGPXArena(doc->arena);
+        return;
+    }
+
+    freeList(doc->waypoints);
+    freeList(doc->routes);
+    freeList(doc->tracks);
+    free(doc->creator);
+    free(doc);
+}
+
+bool freezeGPXdoc(GPXdoc* doc){
+    if (doc == NULL){
+        return false;
+    }
+    if (doc->frozen){
+        return true;
+    }
+
+    if (!loadGPXdoc(doc) || !buildNameIndex(doc)){
+        return false;
+    }
+    atomic_store(&doc->refCount, 1);
+    doc->frozen = true;
+    return true;
+}
+
+bool isGPXdocFrozen(const GPXdoc* doc){
+    return doc != NULL && doc->frozen;
+}
+
+GPXdoc* retainGPXdoc(GPXdoc* doc){
+    if (doc == NULL || !doc->frozen){
+        return NULL;
+    }
+
+    atomic_fetch_add(&doc->refCount, 1);
+    return doc;
+}
+
+void releaseGPXdoc(GPXdoc* doc){
+    deleteGPXdoc(doc);
+}
+
+int getNumWaypoints(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+    return getLength(doc->waypoints);
+}
+
+int getNumRoutes(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+    return getLength(doc->routes);
+}
+
+int getNumTracks(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+    return getLength(doc->tracks);
+}
+
+int getNumSegments(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+
+#ifdef GPX_CHECK_COUNTS
+    assert(doc->numSegments == countGPXSegments(doc));
+#endif
+    return doc->numSegments + getLazySegmentCount(doc);
+}
+
+int getNumGPXData(const GPXdoc* doc){
+    if (doc == NULL){
+        return 0;
+    }
+
+#ifdef GPX_CHECK_COUNTS
+    assert(doc->numGPXData == countGPXData(doc));
+#endif
+    return doc->numGPXData + getLazyGPXDataCount(doc);
+}
+
+//The lookups only modify the document's cached index, and load the route or track of a lazy document
+Waypoint* getWaypoint(const GPXdoc* doc, char* name){
+    if (doc == NULL || name == NULL){
+        return NULL;
+    }
+    return findByName((GPXdoc*)doc, INDEX_WAYPOINTS, name);
+}
+
+Track* getTrack(const GPXdoc* doc, char* name){
+    if (doc == NULL || name == NULL){
+        return NULL;
+    }
+    Track* trk = findByName((GPXdoc*)doc, INDEX_TRACKS, name);
+    return loadGPXTrack((GPXdoc*)doc, trk) ? trk : NULL;
+}
+
+Route* getRoute(const GPXdoc* doc, char* name){
+    if (doc == NULL || name == NULL){
+        return NULL;
+    }
+    Route* rte = findByName((GPXdoc*)doc, INDEX_ROUTES, name);
+    return loadGPXRoute((GPXdoc*)doc, rte) ? rte : NULL;
+}
+
+/* ******************************* List helper functions *************************** */
+
+void deleteGpxData(void* data){
+    free(data);
+}
+
+char* gpxDataToString(void* data){
+    return elementToString(data, &appendGPXData);
+}
+
+int compareGpxData(const void* first, const void* second){
+    if (first == NULL || second == NULL){
+        return 0;
+    }
+
+    const GPXData* a = (const GPXData*)first;
+    const GPXData* b = (const GPXData*)second;
+    int result = strcmp(getGPXDataName(a), getGPXDataName(b));
+
+    return result != 0 ? result : strcmp(getGPXDataValue(a), getGPXDataValue(b));
+}
+
+void deleteWaypoint(void* data){
+    if (data == NULL){
+        return;
+    }
+
+    Waypoint* wpt = (Waypoint*)data;
+    free(wpt->name);
+    freeList(wpt->otherData);
+    free(wpt);
+}
+
+char* waypointToString(void* data){
+    return elementToString(data, &appendWaypoint);
+}
+
+int compareWaypoints(const void* first, const void* second){
+    if (first == NULL || second == NULL){
+        return 0;
+    }
+    return strcmp(((const Waypoint*)first)->name, ((const Waypoint*)second)->name);
+}
+
+void deleteRoute(void* data){
+    if (data == NULL){
+        return;
+    }
+
+    Route* rte = (Route*)data;
+    free(rte->name);
+    freeList(rte->waypoints);
+    freeList(rte->otherData);
+    free(rte);
+}
+
+char* routeToString(void* data){
+    return elementToString(data, &appendRoute);
+}
+
+int compareRoutes(const void* first, const void* second){
+    if (first == NULL || second == NULL){
+        return 0;
+    }
+    return strcmp(((const Route*)first)->name, ((const Route*)second)->name);
+}
+
+void deleteTrackSegment(void* data){
+    if (data == NULL){
+        return;
+    }
+
+    TrackSegment* seg = (TrackSegment*)data;
+    freeList(seg->waypoints);
+    free(seg);
+}
+
+char* trackSegmentToString(void* data){
+    return elementToString(data, &appendTrackSegment);
+}
+
+//Segments have no name, so they are ordered by their number of points
+int compareTrackSegments(const void* first, const void* second){
+    if (first == NULL || second == NULL){
+        return 0;
+    }
+    return getLength(((const TrackSegment*)first)->waypoints) - getLength(((const TrackSegment*)second)->waypoints);
+}
+
+void deleteTrack(void* data){
+    if (data == NULL){
+        return;
+    }
+
+    Track* trk = (Track*)data;
+    free(trk->name);
+    freeList(trk->segments);
+    freeList(trk->otherData);
+    free(trk);
+}
+
+char* trackToString(void* data){
+    return elementToString(data, &appendTrack);
+}
+
+int compareTracks(const void* first, const void* second){
+    if (first == NULL || second == NULL){
+        return 0;
+    }
+    return strcmp(((const Track*)first)->name, ((const Track*)second)->name);
+}
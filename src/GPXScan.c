@@ -0,0 +1,496 @@
+#include <stdlib.h>
+#include "GPXScan.h"
+#include "GPXHelpers.h"
+
+/* ******************************* Scanning *************************** */
+
+bool reserveGPXArray(void** array, int* cap, int count, size_t elemSize){
+    if (count < *cap){
+        return true;
+    }
+
+    int newCap = *cap == 0 ? 16 : *cap * 2;
+    void* tmp = realloc(*array, newCap * elemSize);
+    if (tmp == NULL){
+        return false;
+    }
+    *array = tmp;
+    *cap = newCap;
+    return true;
+}
+
+static bool localNameEquals(const char* name, size_t len, const char* localName){
+    const char* colon = memchr(name, ':', len);
+
+    if (colon != NULL){
+        len -= colon + 1 - name;
+        name = colon + 1;
+    }
+    return len == strlen(localName) && memcmp(name, localName, len) == 0;
+}
+
+static bool isSpace(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool startsWith(const Scan* scan, size_t pos, const char* prefix){
+    size_t len = strlen(prefix);
+    return scan->size - pos >= len && memcmp(scan->data + pos, prefix, len) == 0;
+}
+
+//Returns the offset just past the next occurrence of terminator at or after pos, or 0 if there is none
+static size_t skipPast(const Scan* scan, size_t pos, const char* terminator){
+    size_t len = strlen(terminator);
+
+    while (pos + len <= scan->size){
+        const char* found = memchr(scan->data + pos, terminator[0], scan->size - pos);
+        if (found == NULL){
+            return 0;
+        }
+
+        pos = found - scan->data;
+        if (scan->size - pos >= len && memcmp(found, terminator, len) == 0){
+            return pos + len;
+        }
+        pos++;
+    }
+    return 0;
+}
+
+static ChildScan* currentChild(Scan* scan){
+    return &scan->children[scan->numChildren - 1];
+}
+
+//Records the start of an element at the current depth
+static bool openElement(Scan* scan, const char* name, size_t nameLen, size_t start, size_t tagEnd){
+    bool isSegment = false;
+    bool isRoutePoint = false;
+
+    if (scan->depth == 0){
+        scan->root.start = start;
+        scan->root.tagEnd = tagEnd;
+    }else if (scan->depth == 1){
+        if (!reserveGPXArray((void**)&scan->children, &scan->capChildren, scan->numChildren, sizeof(ChildScan))){
+            return false;
+        }
+
+        ChildScan* child = &scan->children[scan->numChildren++];
+        memset(child, 0, sizeof(ChildScan));
+        child->span.start = start;
+        child->span.tagEnd = tagEnd;
+        child->isRoute = localNameEquals(name, nameLen, "rte");
+        child->isTrack = localNameEquals(name, nameLen, "trk");
+    }else if (scan->depth == 2 && currentChild(scan)->isRoute){
+        ChildScan* rte = currentChild(scan);
+
+        isRoutePoint = localNameEquals(name, nameLen, "rtept");
+        if (isRoutePoint && !rte->inRun){
+            if (!reserveGPXArray((void**)&rte->pointRuns, &rte->capRuns, rte->numRuns, sizeof(ByteRange))){
+                return false;
+            }
+            rte->pointRuns[rte->numRuns++].start = start;
+        }
+        rte->inRun = isRoutePoint;
+    }else if (scan->depth == 2 && currentChild(scan)->isTrack && localNameEquals(name, nameLen, "trkseg")){
+        ChildScan* trk = currentChild(scan);
+        if (!reserveGPXArray((void**)&trk->segments, &trk->capSegments, trk->numSegments, sizeof(SegmentScan))){
+            return false;
+        }
+
+        SegmentScan* seg = &trk->segments[trk->numSegments++];
+        memset(seg, 0, sizeof(SegmentScan));
+        seg->span.start = start;
+        seg->span.tagEnd = tagEnd;
+        seg->lastCut = tagEnd;
+        isSegment = true;
+    }
+
+    bool isPoint = isRoutePoint || (scan->depth == 3 && scan->stack[2].isSegment && localNameEquals(name, nameLen, "trkpt"));
+    if (isPoint){
+        scan->point.fields = 0;
+    }
+
+    if (!reserveGPXArray((void**)&scan->stack, &scan->capStack, scan->depth, sizeof(OpenElement))){
+        return false;
+    }
+    OpenElement* elem = &scan->stack[scan->depth];
+    elem->name = name;
+    elem->nameLen = nameLen;
+    elem->tagEnd = tagEnd;
+    elem->isSegment = isSegment;
+    elem->isRoutePoint = isRoutePoint;
+    elem->isPoint = isPoint;
+    elem->isPointChild = scan->depth > 0 && scan->stack[scan->depth - 1].isPoint;
+    elem->hasText = false;
+    scan->depth++;
+    return true;
+}
+
+/* ******************************* GPXData of points *************************** */
+
+//Children of a waypoint that setWaypointField may decode
+static bool isTypedName(const char* name, size_t len){
+    static const char* const names[] = {"ele", "time", "sat", "speed", "hdop", "vdop", "pdop"};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if (len == strlen(names[i]) && memcmp(name, names[i], len) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+//Appends the character a reference between & and ; stands for, or the reference itself if it is not one
+static bool appendReference(StringBuilder* sb, const char* ref, size_t len){
+    static const char* const names[] = {"lt", "gt", "amp", "apos", "quot"};
+    static const char chars[] = "<>&'\"";
+    unsigned long code = 0;
+    char* end = NULL;
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if (len == strlen(names[i]) && memcmp(ref, names[i], len) == 0){
+            return appendStringLen(sb, &chars[i], 1);
+        }
+    }
+    if (len >= 2 && ref[0] == '#'){
+        code = ref[1] == 'x' ? strtoul(ref + 2, &end, 16) : strtoul(ref + 1, &end, 10);
+    }
+    if (end != ref + len || code == 0 || code > 0x10FFFF){
+        return appendString(sb, "&") && appendStringLen(sb, ref, len) && appendString(sb, ";");
+    }
+
+    char utf8[4];
+    size_t n = code < 0x80 ? 1 : code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+    static const unsigned char leads[] = {0, 0, 0xC0, 0xE0, 0xF0};
+
+    for (size_t i = n - 1; i > 0; i--){
+        utf8[i] = (char)(0x80 | (code & 0x3F));
+        code >>= 6;
+    }
+    utf8[0] = (char)(leads[n] | code);
+    return appendStringLen(sb, utf8, n);
+}
+
+/* Puts the text of the bytes from start to end into scan->text as the parser reads it: the character data
+   of the element and its descendants, with references replaced, CDATA sections unwrapped and line ends
+   normalized */
+static bool decodeText(Scan* scan, size_t start, size_t end){
+    StringBuilder* sb = &scan->text;
+    const char* data = scan->data;
+    size_t i = start;
+    bool ok = true;
+
+    sb->len = 0;
+    ok = appendString(sb, "");
+    while (ok && i < end){
+        size_t run = i;
+
+        while (run < end && data[run] != '<' && data[run] != '&' && data[run] != '\r'){
+            run++;
+        }
+        ok = appendStringLen(sb, data + i, run - i);
+        i = run;
+        if (!ok || i == end){
+            break;
+        }
+
+        if (data[i] == '\r'){
+            ok = appendString(sb, "\n");
+            i += i + 1 < end && data[i + 1] == '\n' ? 2 : 1;
+        }else if (data[i] == '&'){
+            const char* semicolon = memchr(data + i, ';', end - i);
+            size_t refEnd = semicolon != NULL ? (size_t)(semicolon - data) : end;
+
+            ok = appendReference(sb, data + i + 1, refEnd - i - 1);
+            i = refEnd + 1;
+        }else if (startsWith(scan, i, "<![CDATA[")){
+            size_t close = skipPast(scan, i + 9, "]]>");
+            ok = close != 0 && appendStringLen(sb, data + i + 9, close - 3 - (i + 9));
+            i = close;
+        }else if (startsWith(scan, i, "<!--")){
+            i = skipPast(scan, i + 4, "-->");
+        }else if (startsWith(scan, i, "<?")){
+            i = skipPast(scan, i + 2, "?>");
+        }else{
+            //A tag of a descendant.  The scan has checked that it ends, and quoted values may hold '>'
+            char quote = '\0';
+            for (i++; i < end && (quote != '\0' || data[i] != '>'); i++){
+                if (quote == '\0' && (data[i] == '"' || data[i] == '\'')){
+                    quote = data[i];
+                }else if (data[i] == quote){
+                    quote = '\0';
+                }
+            }
+            i++;
+        }
+        ok = ok && i != 0;
+    }
+    return ok;
+}
+
+//Counts a child of a point that has ended if the parser will make a GPXData of it
+static bool countPointChild(Scan* scan, const OpenElement* elem, size_t closeStart){
+    const char* name = elem->name;
+    size_t len = elem->nameLen;
+    const char* colon = memchr(name, ':', len);
+
+    if (colon != NULL){
+        len -= colon + 1 - name;
+        name = colon + 1;
+    }
+    if (!elem->hasText || (len == 4 && memcmp(name, "name", 4) == 0)){
+        return true;
+    }
+
+    if (scan->typedOnly && isTypedName(name, len)){
+        char localName[8];
+
+        memcpy(localName, name, len);
+        localName[len] = '\0';
+        if (!decodeText(scan, elem->tagEnd, closeStart)){
+            return false;
+        }
+        if (setWaypointField(&scan->point, localName, scan->text.str)){
+            return true;
+        }
+    }
+
+    currentChild(scan)->numPointData++;
+    return true;
+}
+
+//Records the end of the innermost open element
+static bool closeElement(Scan* scan, size_t closeStart, size_t end){
+    OpenElement* elem = &scan->stack[--scan->depth];
+    Span* span = NULL;
+
+    if (elem->isPointChild){
+        if (!countPointChild(scan, elem, closeStart)){
+            return false;
+        }
+    }else if (elem->hasText && scan->depth > 0){
+        scan->stack[scan->depth - 1].hasText = true;
+    }
+
+    if (scan->depth == 0){
+        span = &scan->root;
+    }else if (scan->depth == 1){
+        span = &currentChild(scan)->span;
+    }else if (elem->isRoutePoint){
+        ChildScan* rte = currentChild(scan);
+        rte->pointRuns[rte->numRuns - 1].end = end;
+        rte->numPoints++;
+    }else if (elem->isSegment){
+        ChildScan* trk = currentChild(scan);
+        span = &trk->segments[trk->numSegments - 1].span;
+    }else if (scan->depth == 3 && scan->stack[2].isSegment){
+        //End of a child of a segment: a place where the segment can be cut
+        ChildScan* trk = currentChild(scan);
+        SegmentScan* seg = &trk->segments[trk->numSegments - 1];
+
+        if (localNameEquals(elem->name, elem->nameLen, "trkpt")){
+            seg->numPoints++;
+            trk->numPoints++;
+        }
+        if (end - seg->lastCut >= scan->unitSize){
+            if (!reserveGPXArray((void**)&seg->cuts, &seg->capCuts, seg->numCuts, sizeof(size_t))){
+                return false;
+            }
+            seg->cuts[seg->numCuts++] = end;
+            seg->lastCut = end;
+        }
+    }
+
+    if (span != NULL){
+        span->closeStart = closeStart;
+        span->end = end;
+    }
+    return true;
+}
+
+//Reads a tag name starting at pos.  Returns its length, 0 if there is none
+static size_t tagNameLength(const Scan* scan, size_t pos){
+    size_t len = 0;
+
+    while (pos + len < scan->size){
+        char c = scan->data[pos + len];
+        if (isSpace(c) || c == '>' || c == '/' || c == '<'){
+            break;
+        }
+        len++;
+    }
+    return len;
+}
+
+bool scanGPXDocument(Scan* scan){
+    const unsigned char* bytes = (const unsigned char*)scan->data;
+
+    if (scan->size < 4 || bytes[0] == 0 || bytes[1] == 0 || bytes[2] == 0 || bytes[3] == 0 ||
+        (bytes[0] == 0xFE && bytes[1] == 0xFF) || (bytes[0] == 0xFF && bytes[1] == 0xFE)){
+        return false;
+    }
+
+    bool seenRoot = false;
+    size_t pos = 0;
+
+    //Skip a UTF-8 byte order mark
+    if (bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF){
+        pos = 3;
+    }
+
+    while (pos < scan->size){
+        const char* lt = memchr(scan->data + pos, '<', scan->size - pos);
+        size_t next = lt != NULL ? (size_t)(lt - scan->data) : scan->size;
+
+        //Outside the root element only whitespace may appear between markup
+        if (scan->depth == 0){
+            for (size_t i = pos; i < next; i++){
+                if (!isSpace(scan->data[i])){
+                    return false;
+                }
+            }
+        }else if (next > pos){
+            scan->stack[scan->depth - 1].hasText = true;
+        }
+        if (lt == NULL){
+            break;
+        }
+        pos = next;
+
+        if (startsWith(scan, pos, "<!--")){
+            pos = skipPast(scan, pos + 4, "-->");
+        }else if (startsWith(scan, pos, "<![CDATA[")){
+            size_t start = pos + 9;
+
+            pos = scan->depth > 0 ? skipPast(scan, start, "]]>") : 0;
+            if (pos > start + 3){
+                scan->stack[scan->depth - 1].hasText = true;
+            }
+        }else if (startsWith(scan, pos, "<?")){
+            pos = skipPast(scan, pos + 2, "?>");
+        }else if (startsWith(scan, pos, "<!")){
+            return false;
+        }else if (startsWith(scan, pos, "</")){
+            size_t nameLen = tagNameLength(scan, pos + 2);
+            size_t end = pos + 2 + nameLen;
+
+            while (end < scan->size && isSpace(scan->data[end])){
+                end++;
+            }
+            if (scan->depth == 0 || nameLen == 0 || end >= scan->size || scan->data[end] != '>'){
+                return false;
+            }
+
+            OpenElement* elem = &scan->stack[scan->depth - 1];
+            if (elem->nameLen != nameLen || memcmp(elem->name, scan->data + pos + 2, nameLen) != 0){
+                return false;
+            }
+            if (!closeElement(scan, pos, end + 1)){
+                return false;
+            }
+            pos = end + 1;
+        }else{
+            const char* name = scan->data + pos + 1;
+            size_t nameLen = tagNameLength(scan, pos + 1);
+            size_t end = pos + 1 + nameLen;
+            bool empty = false;
+
+            if (nameLen == 0 || (scan->depth == 0 && seenRoot)){
+                return false;
+            }
+
+            //Find the end of the tag, skipping over quoted attribute values
+            for (;;){
+                if (end >= scan->size){
+                    return false;
+                }
+
+                char c = scan->data[end];
+                if (c == '"' || c == '\''){
+                    const char* quote = memchr(scan->data + end + 1, c, scan->size - end - 1);
+                    if (quote == NULL){
+                        return false;
+                    }
+                    end = quote - scan->data;
+                }else if (c == '>'){
+                    break;
+                }else if (c == '/' && end + 1 < scan->size && scan->data[end + 1] == '>'){
+                    empty = true;
+                    end++;
+                    break;
+                }else if (c == '<'){
+                    return false;
+                }
+                end++;
+            }
+
+            seenRoot = true;
+            if (!openElement(scan, name, nameLen, pos, end + 1) || (empty && !closeElement(scan, end + 1, end + 1))){
+                return false;
+            }
+            pos = end + 1;
+        }
+
+        if (pos == 0){
+            return false;
+        }
+    }
+
+    return seenRoot && scan->depth == 0;
+}
+
+void clearGPXScan(Scan* scan){
+    for (int i = 0; i < scan->numChildren; i++){
+        free(scan->children[i].pointRuns);
+        for (int j = 0; j < scan->children[i].numSegments; j++){
+            free(scan->children[i].segments[j].cuts);
+        }
+        free(scan->children[i].segments);
+    }
+    free(scan->children);
+    free(scan->stack);
+    free(scan->text.str);
+}
+
+/* ******************************* Parsing *************************** */
+
+//Input callback context that reads a list of byte ranges as one stream
+typedef struct {
+    const char* data;
+    const ByteRange* ranges;
+    int numRanges;
+    int current;
+    size_t offset;
+} RangeInput;
+
+static int readRanges(void* context, char* buffer, int len){
+    RangeInput* input = context;
+    int total = 0;
+
+    while (total < len && input->current < input->numRanges){
+        const ByteRange* range = &input->ranges[input->current];
+        size_t available = range->end - range->start - input->offset;
+        size_t n = available < (size_t)(len - total) ? available : (size_t)(len - total);
+
+        memcpy(buffer + total, input->data + range->start + input->offset, n);
+        total += n;
+        input->offset += n;
+
+        if (input->offset == range->end - range->start){
+            input->current++;
+            input->offset = 0;
+        }
+    }
+    return total;
+}
+
+static int closeRanges(void* context){
+    return 0;
+}
+
+GPXdoc* parseGPXRanges(const char* data, const ByteRange* ranges, int numRanges, const char* url, unsigned int options){
+    RangeInput input = {data, ranges, numRanges, 0, 0};
+    unsigned int honoured = GPX_OPT_ARENA | GPX_OPT_TYPED_ONLY | GPX_OPT_NODE_POOL | GPX_OPT_SHARED_NAMES;
+
+    return buildGPXdoc(xmlReaderForIO(&readRanges, &closeRanges, &input, url, NULL, 0), options & honoured);
+}
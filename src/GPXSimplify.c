@@ -0,0 +1,526 @@
+#include <stdlib.h>
+#include "GPXSimplify.h"
+#include "GPXDistance.h"
+#include "GPXHelpers.h"
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+/* Both methods work in two steps.  First every point gets a rank: the largest tolerance at which the
+   method keeps it (INFINITY for the ends of a path).  Then the result for a tolerance is the points
+   ranked above it.  A single simplification ranks only as far as its own tolerance needs; levels rank
+   every point once and select all of their tolerances from the same ranks. */
+
+//The finite points of one or more paths, projected to metres.  Path i is points pathStart[i] to
+//pathStart[i + 1] - 1
+typedef struct {
+    int numPoints;
+    int numPaths;
+    const Waypoint** points;
+    double* x;
+    double* y;
+    double* rank;
+    int* pathStart;
+} PathSet;
+
+struct gpxSimplifyLevels {
+    int numLevels;
+    double* tolerances;
+    GPXSimplified** levels;
+};
+
+static void clearPathSet(PathSet* set){
+    free(set->points);
+    free(set->x);
+    free(set->y);
+    free(set->rank);
+    free(set->pathStart);
+}
+
+//Collects and projects the points of the given lists, one path per list.  Returns false if malloc fails
+static bool createPathSet(PathSet* set, List** paths, int numPaths){
+    long long total = 0;
+    for (int i = 0; i < numPaths; i++){
+        total += getLength(paths[i]);
+    }
+
+    memset(set, 0, sizeof(PathSet));
+    if (total >= INT_MAX){
+        return false;
+    }
+
+    set->numPaths = numPaths;
+    set->points = gpxAllocArray(total, sizeof(Waypoint*));
+    set->x = gpxAllocArray(total, sizeof(double));
+    set->y = gpxAllocArray(total, sizeof(double));
+    set->rank = gpxAllocArray(total, sizeof(double));
+    //The start of each path, and the end of the last one
+    set->pathStart = malloc(sizeof(int) * (numPaths + 1));
+    if (set->points == NULL || set->x == NULL || set->y == NULL || set->rank == NULL || set->pathStart == NULL){
+        clearPathSet(set);
+        return false;
+    }
+
+    double latitudeSum = 0.0;
+    for (int i = 0; i < numPaths; i++){
+        ListIterator iter = createIterator(paths[i]);
+        const Waypoint* wpt;
+
+        set->pathStart[i] = set->numPoints;
+        while ((wpt = nextElement(&iter)) != NULL){
+            if (isfinite(wpt->latitude) && isfinite(wpt->longitude)){
+                set->points[set->numPoints++] = wpt;
+                latitudeSum += wpt->latitude;
+            }
+        }
+    }
+    set->pathStart[numPaths] = set->numPoints;
+
+    //Equirectangular projection around the mean latitude
+    double scale = EARTH_RADIUS * DEG_TO_RAD;
+    double xScale = set->numPoints > 0 ? scale * cos(latitudeSum / set->numPoints * DEG_TO_RAD) : scale;
+
+    for (int i = 0; i < set->numPoints; i++){
+        set->x[i] = set->points[i]->longitude * xScale;
+        set->y[i] = set->points[i]->latitude * scale;
+    }
+    return true;
+}
+
+/* ******************************* Douglas-Peucker *************************** */
+
+//A stretch of a path still to be split, and the rank of the point that bounds it
+typedef struct {
+    int first;
+    int last;
+    double cap;
+} Stretch;
+
+//Squared distance from point p to the segment from a to b
+static double segmentDistance2(const PathSet* set, int a, int b, int p){
+    double dx = set->x[b] - set->x[a];
+    double dy = set->y[b] - set->y[a];
+    double px = set->x[p] - set->x[a];
+    double py = set->y[p] - set->y[a];
+    double length2 = dx * dx + dy * dy;
+
+    if (length2 > 0){
+        double t = (px * dx + py * dy) / length2;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return px * px + py * py;
+}
+
+//Ranks the points of path [start, end).  Stretches whose farthest point is within stop are not split,
+//and their points are ranked 0.  Returns false if malloc fails
+static bool rankDouglasPeucker(PathSet* set, int start, int end, double stop){
+    int capacity = 64;
+    int depth = 0;
+    Stretch* stack = malloc(sizeof(Stretch) * capacity);
+
+    if (stack == NULL){
+        return false;
+    }
+
+    for (int i = start; i < end; i++){
+        set->rank[i] = 0.0;
+    }
+    set->rank[start] = INFINITY;
+    set->rank[end - 1] = INFINITY;
+    stack[depth++] = (Stretch){start, end - 1, INFINITY};
+
+    while (depth > 0){
+        Stretch stretch = stack[--depth];
+        double farthest2 = -1.0;
+        int split = -1;
+
+        for (int i = stretch.first + 1; i < stretch.last; i++){
+            double distance2 = segmentDistance2(set, stretch.first, stretch.last, i);
+
+            if (distance2 > farthest2){
+                farthest2 = distance2;
+                split = i;
+            }
+        }
+
+        double farthest = sqrt(farthest2);
+        if (split < 0 || farthest <= stop){
+            continue;
+        }
+
+        //A point is only kept while the point that split its stretch off is
+        set->rank[split] = farthest < stretch.cap ? farthest : stretch.cap;
+
+        if (depth + 2 > capacity){
+            capacity *= 2;
+            Stretch* tmp = realloc(stack, sizeof(Stretch) * capacity);
+            if (tmp == NULL){
+                free(stack);
+                return false;
+            }
+            stack = tmp;
+        }
+        stack[depth++] = (Stretch){stretch.first, split, set->rank[split]};
+        stack[depth++] = (Stretch){split, stretch.last, set->rank[split]};
+    }
+
+    free(stack);
+    return true;
+}
+
+/* ******************************* Visvalingam-Whyatt *************************** */
+
+//Points not yet removed are linked through prev and next, and the interior ones are kept in a binary
+//min-heap on area.  Entries carry their area so that sifting does not touch the point arrays.  position
+//holds each point's index in the heap
+typedef struct {
+    double area;
+    int point;
+} HeapEntry;
+
+typedef struct {
+    const PathSet* set;
+    int* prev;
+    int* next;
+    HeapEntry* heap;
+    int* position;
+    int heapSize;
+} Triangles;
+
+static double triangleArea(const Triangles* t, int p){
+    const double* x = t->set->x;
+    const double* y = t->set->y;
+    int a = t->prev[p];
+    int b = t->next[p];
+
+    return fabs((x[p] - x[a]) * (y[b] - y[a]) - (x[b] - x[a]) * (y[p] - y[a])) / 2;
+}
+
+static void placeEntry(Triangles* t, int i, HeapEntry entry){
+    t->heap[i] = entry;
+    t->position[entry.point] = i;
+}
+
+static void siftUp(Triangles* t, int i){
+    HeapEntry entry = t->heap[i];
+
+    while (i > 0 && entry.area < t->heap[(i - 1) / 2].area){
+        placeEntry(t, i, t->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    placeEntry(t, i, entry);
+}
+
+static void siftDown(Triangles* t, int i){
+    HeapEntry entry = t->heap[i];
+
+    for (;;){
+        int smallest = 2 * i + 1;
+
+        if (smallest >= t->heapSize){
+            break;
+        }
+        if (smallest + 1 < t->heapSize && t->heap[smallest + 1].area < t->heap[smallest].area){
+            smallest++;
+        }
+        if (!(t->heap[smallest].area < entry.area)){
+            break;
+        }
+        placeEntry(t, i, t->heap[smallest]);
+        i = smallest;
+    }
+    placeEntry(t, i, entry);
+}
+
+static void updateArea(Triangles* t, int p){
+    int i = t->position[p];
+    double old = t->heap[i].area;
+
+    t->heap[i].area = triangleArea(t, p);
+    if (t->heap[i].area < old){
+        siftUp(t, i);
+    }else{
+        siftDown(t, i);
+    }
+}
+
+//Ranks the points of path [start, end) using the arrays of t.  Removal stops once the smallest area is
+//above stopArea, and the points left are ranked INFINITY
+static void rankVisvalingam(Triangles* t, PathSet* set, int start, int end, double stopArea){
+    t->heapSize = 0;
+    for (int i = start; i < end; i++){
+        t->prev[i] = i - 1;
+        t->next[i] = i + 1;
+        set->rank[i] = INFINITY;
+    }
+    for (int i = start + 1; i < end - 1; i++){
+        placeEntry(t, t->heapSize++, (HeapEntry){triangleArea(t, i), i});
+    }
+    for (int i = t->heapSize / 2 - 1; i >= 0; i--){
+        siftDown(t, i);
+    }
+
+    //Effective areas never decrease, so that every tolerance removes a prefix of the same sequence
+    double removedArea = 0.0;
+    while (t->heapSize > 0){
+        int p = t->heap[0].point;
+        double area = t->heap[0].area > removedArea ? t->heap[0].area : removedArea;
+
+        if (area > stopArea){
+            break;
+        }
+        removedArea = area;
+        set->rank[p] = sqrt(area);
+
+        if (--t->heapSize > 0){
+            placeEntry(t, 0, t->heap[t->heapSize]);
+            siftDown(t, 0);
+        }
+
+        int a = t->prev[p];
+        int b = t->next[p];
+        t->next[a] = b;
+        t->prev[b] = a;
+        if (a > start){
+            updateArea(t, a);
+        }
+        if (b < end - 1){
+            updateArea(t, b);
+        }
+    }
+}
+
+/* ******************************* Ranking and selection *************************** */
+
+//Ranks every point of set.  Ranks above stop are exact; points ranked at most stop are removed at
+//every tolerance of at least stop.  Returns false if malloc fails
+static bool rankPoints(PathSet* set, GPXSimplifyMethod method, double stop){
+    if (method == GPX_SIMPLIFY_DOUGLAS_PEUCKER){
+        for (int i = 0; i < set->numPaths; i++){
+            if (set->pathStart[i] < set->pathStart[i + 1] && !rankDouglasPeucker(set, set->pathStart[i], set->pathStart[i + 1], stop)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Triangles t = {set, NULL, NULL, NULL, NULL, 0};
+    size_t n = set->numPoints + 1;
+    t.prev = malloc(sizeof(int) * n);
+    t.next = malloc(sizeof(int) * n);
+    t.heap = malloc(sizeof(HeapEntry) * n);
+    t.position = malloc(sizeof(int) * n);
+
+    bool ok = t.prev != NULL && t.next != NULL && t.heap != NULL && t.position != NULL;
+    for (int i = 0; ok && i < set->numPaths; i++){
+        if (set->pathStart[i] < set->pathStart[i + 1]){
+            rankVisvalingam(&t, set, set->pathStart[i], set->pathStart[i + 1], stop * stop);
+        }
+    }
+
+    free(t.prev);
+    free(t.next);
+    free(t.heap);
+    free(t.position);
+    return ok;
+}
+
+//Builds the result for a tolerance from the ranks of set
+static GPXSimplified* selectPoints(const PathSet* set, double tolerance){
+    int count = 0;
+    for (int i = 0; i < set->numPoints; i++){
+        count += set->rank[i] > tolerance;
+    }
+
+    GPXSimplified* result = malloc(sizeof(GPXSimplified));
+    if (result == NULL){
+        return NULL;
+    }
+    result->numPoints = count;
+    result->numParts = set->numPaths;
+    result->points = malloc(sizeof(Waypoint*) * (count + 1));
+    result->partStart = malloc(sizeof(int) * (set->numPaths + 1));
+    if (result->points == NULL || result->partStart == NULL){
+        deleteSimplified(result);
+        return NULL;
+    }
+
+    count = 0;
+    for (int path = 0; path < set->numPaths; path++){
+        result->partStart[path] = count;
+        for (int i = set->pathStart[path]; i < set->pathStart[path + 1]; i++){
+            if (set->rank[i] > tolerance){
+                result->points[count++] = set->points[i];
+            }
+        }
+    }
+    result->partStart[set->numPaths] = count;
+    return result;
+}
+
+static GPXSimplified* simplifyPaths(List** paths, int numPaths, GPXSimplifyMethod method, double tolerance){
+    PathSet set;
+
+    if (!(tolerance >= 0) || !createPathSet(&set, paths, numPaths)){
+        return NULL;
+    }
+
+    GPXSimplified* result = rankPoints(&set, method, tolerance) ? selectPoints(&set, tolerance) : NULL;
+    clearPathSet(&set);
+    return result;
+}
+
+//The waypoint lists of a track's segments.  Returns NULL if malloc fails
+static List** getSegmentLists(const Track* trk, int* numPaths){
+    List** paths = malloc(sizeof(List*) * (getLength(trk->segments) + 1));
+    ListIterator iter = createIterator(trk->segments);
+    TrackSegment* seg;
+
+    *numPaths = 0;
+    while (paths != NULL && (seg = nextElement(&iter)) != NULL){
+        paths[(*numPaths)++] = seg->waypoints;
+    }
+    return paths;
+}
+
+GPXSimplified* simplifyWaypoints(List* waypoints, GPXSimplifyMethod method, double tolerance){
+    return waypoints != NULL ? simplifyPaths(&waypoints, 1, method, tolerance) : NULL;
+}
+
+GPXSimplified* simplifyRoute(const Route* rte, GPXSimplifyMethod method, double tolerance){
+    return rte != NULL ? simplifyWaypoints(rte->waypoints, method, tolerance) : NULL;
+}
+
+GPXSimplified* simplifySegment(const TrackSegment* seg, GPXSimplifyMethod method, double tolerance){
+    return seg != NULL ? simplifyWaypoints(seg->waypoints, method, tolerance) : NULL;
+}
+
+GPXSimplified* simplifyTrack(const Track* trk, GPXSimplifyMethod method, double tolerance){
+    if (trk == NULL){
+        return NULL;
+    }
+
+    int numPaths;
+    List** paths = getSegmentLists(trk, &numPaths);
+    GPXSimplified* result = paths != NULL ? simplifyPaths(paths, numPaths, method, tolerance) : NULL;
+
+    free(paths);
+    return result;
+}
+
+void deleteSimplified(GPXSimplified* result){
+    if (result == NULL){
+        return;
+    }
+
+    free(result->points);
+    free(result->partStart);
+    free(result);
+}
+
+/* ******************************* Levels *************************** */
+
+static GPXSimplifyLevels* createLevels(List** paths, int numPaths, GPXSimplifyMethod method, double minTolerance, int numLevels){
+    PathSet set;
+
+    if (!(minTolerance > 0) || numLevels <= 0 || !createPathSet(&set, paths, numPaths)){
+        return NULL;
+    }
+
+    //Visvalingam-Whyatt is ranked to the end: unlike Douglas-Peucker it removes the least important
+    //points first, so stopping early would leave the coarse levels unranked
+    bool ok = rankPoints(&set, method, method == GPX_SIMPLIFY_DOUGLAS_PEUCKER ? minTolerance : INFINITY);
+    GPXSimplifyLevels* levels = ok ? calloc(1, sizeof(GPXSimplifyLevels)) : NULL;
+
+    if (levels != NULL){
+        levels->tolerances = malloc(sizeof(double) * numLevels);
+        levels->levels = calloc(numLevels, sizeof(GPXSimplified*));
+        ok = levels->tolerances != NULL && levels->levels != NULL;
+
+        for (int i = 0; ok && i < numLevels; i++){
+            levels->tolerances[i] = ldexp(minTolerance, i);
+            levels->levels[i] = selectPoints(&set, levels->tolerances[i]);
+            levels->numLevels = i + 1;
+            ok = levels->levels[i] != NULL;
+        }
+        if (!ok){
+            deleteSimplifyLevels(levels);
+            levels = NULL;
+        }
+    }
+
+    clearPathSet(&set);
+    return levels;
+}
+
+GPXSimplifyLevels* createTrackLevels(const Track* trk, GPXSimplifyMethod method, double minTolerance, int numLevels){
+    if (trk == NULL){
+        return NULL;
+    }
+
+    int numPaths;
+    List** paths = getSegmentLists(trk, &numPaths);
+    GPXSimplifyLevels* levels = paths != NULL ? createLevels(paths, numPaths, method, minTolerance, numLevels) : NULL;
+
+    free(paths);
+    return levels;
+}
+
+GPXSimplifyLevels* createRouteLevels(const Route* rte, GPXSimplifyMethod method, double minTolerance, int numLevels){
+    if (rte == NULL){
+        return NULL;
+    }
+
+    List* waypoints = rte->waypoints;
+    return createLevels(&waypoints, 1, method, minTolerance, numLevels);
+}
+
+int rankWaypoints(List* waypoints, GPXSimplifyMethod method, double minTolerance, double* ranks){
+    PathSet set;
+
+    if (waypoints == NULL || ranks == NULL || !(minTolerance >= 0) || !createPathSet(&set, &waypoints, 1)){
+        return -1;
+    }
+
+    int count = -1;
+    if (rankPoints(&set, method, method == GPX_SIMPLIFY_DOUGLAS_PEUCKER ? minTolerance : INFINITY)){
+        count = set.numPoints;
+        memcpy(ranks, set.rank, sizeof(double) * count);
+    }
+    clearPathSet(&set);
+    return count;
+}
+
+void deleteSimplifyLevels(GPXSimplifyLevels* levels){
+    if (levels == NULL){
+        return;
+    }
+
+    for (int i = 0; levels->levels != NULL && i < levels->numLevels; i++){
+        deleteSimplified(levels->levels[i]);
+    }
+    free(levels->levels);
+    free(levels->tolerances);
+    free(levels);
+}
+
+int getSimplifyLevelCount(const GPXSimplifyLevels* levels){
+    return levels != NULL ? levels->numLevels : 0;
+}
+
+double getSimplifyLevelTolerance(const GPXSimplifyLevels* levels, int level){
+    return levels != NULL && level >= 0 && level < levels->numLevels ? levels->tolerances[level] : NAN;
+}
+
+const GPXSimplified* getSimplifyLevel(const GPXSimplifyLevels* levels, double tolerance){
+    if (levels == NULL){
+        return NULL;
+    }
+
+    int level = 0;
+    while (level + 1 < levels->numLevels && levels->tolerances[level + 1] <= tolerance){
+        level++;
+    }
+    return levels->levels[level];
+}
@@ -0,0 +1,699 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "GPXSnapshot.h"
+#include "GPXLazy.h"
+#include "GPXArena.h"
+#include "GPXHelpers.h"
+#include "GPXSpatial.h"
+
+#define SNAPSHOT_MAGIC "GPXSNAP"
+#define BYTE_ORDER_MARK 0x01020304u
+
+enum {
+    SECTION_LATITUDE,
+    SECTION_LONGITUDE,
+    SECTION_TIME,
+    SECTION_FIELDS,
+    SECTION_POINT_NAMES,
+    SECTION_POINT_DATA,
+    SECTION_ROUTES,
+    SECTION_TRACKS,
+    SECTION_SEGMENTS,
+    SECTION_DATA,
+    SECTION_STRINGS,
+    NUM_SECTIONS
+};
+
+//Strings are stored as offsets into the string table
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t totalSize;
+
+    double gpxVersion;
+    uint32_t namespace;
+    uint32_t creator;
+
+    //Points 0 to numWaypoints - 1 are the document's waypoints
+    uint32_t numWaypoints;
+    uint32_t numRoutes;
+    uint32_t numTracks;
+    uint32_t numSegments;
+    uint32_t numPoints;
+    uint32_t numData;
+    uint32_t stringBytes;
+    uint32_t padding;
+
+    uint64_t offsets[NUM_SECTIONS];
+} SnapshotHeader;
+
+//A route (first and count are points) or a track (first and count are segments)
+typedef struct {
+    uint32_t name;
+    uint32_t first;
+    uint32_t count;
+    uint32_t firstData;
+    uint32_t numData;
+} EntityRecord;
+
+typedef struct {
+    uint32_t firstPoint;
+    uint32_t numPoints;
+} SegmentRecord;
+
+typedef struct {
+    uint32_t name;
+    uint32_t value;
+} DataRecord;
+
+//The typed fields of a point other than time
+typedef struct {
+    double elevation;
+    float hdop;
+    float vdop;
+    float pdop;
+    float speed;
+    int32_t satellites;
+    uint32_t fields;
+} FieldsRecord;
+
+static uint32_t hashString(const char* str){
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++){
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t align8(uint64_t size){
+    return (size + 7) & ~(uint64_t)7;
+}
+
+static void getSectionLengths(const SnapshotHeader* header, uint64_t* lengths){
+    lengths[SECTION_LATITUDE] = header->numPoints * sizeof(double);
+    lengths[SECTION_LONGITUDE] = header->numPoints * sizeof(double);
+    lengths[SECTION_TIME] = header->numPoints * sizeof(int64_t);
+    lengths[SECTION_FIELDS] = header->numPoints * sizeof(FieldsRecord);
+    lengths[SECTION_POINT_NAMES] = header->numPoints * sizeof(uint32_t);
+    lengths[SECTION_POINT_DATA] = (header->numPoints + (uint64_t)1) * sizeof(uint32_t);
+    lengths[SECTION_ROUTES] = header->numRoutes * sizeof(EntityRecord);
+    lengths[SECTION_TRACKS] = header->numTracks * sizeof(EntityRecord);
+    lengths[SECTION_SEGMENTS] = header->numSegments * sizeof(SegmentRecord);
+    lengths[SECTION_DATA] = header->numData * sizeof(DataRecord);
+    lengths[SECTION_STRINGS] = header->stringBytes;
+}
+
+/* ******************************* Writing *************************** */
+
+typedef struct {
+    SnapshotHeader header;
+
+    double* latitude;
+    double* longitude;
+    int64_t* time;
+    FieldsRecord* fields;
+    uint32_t* pointNames;
+    //numPoints + 1 entries: the GPXData of point i are records pointData[i] to pointData[i + 1] - 1
+    uint32_t* pointData;
+    EntityRecord* routes;
+    EntityRecord* tracks;
+    SegmentRecord* segments;
+    DataRecord* data;
+
+    //Next free slot in each array.  The data of points come first, then the data of routes and tracks
+    uint32_t nextPoint;
+    uint32_t nextSegment;
+    uint32_t nextPointData;
+    uint32_t nextEntityData;
+
+    //The string table, and an open-addressing set over it holding offset + 1 per slot (0 is empty)
+    StringBuilder strings;
+    uint32_t* interned;
+    size_t internCapacity;
+    size_t numInterned;
+} SnapshotBuilder;
+
+typedef struct {
+    uint64_t points;
+    uint64_t segments;
+    uint64_t pointData;
+    uint64_t entityData;
+} SnapshotCounts;
+
+static void countWaypoints(List* waypoints, SnapshotCounts* counts){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    counts->points += getLength(waypoints);
+    while ((wpt = nextElement(&iter)) != NULL){
+        counts->pointData += getLength(wpt->otherData);
+    }
+}
+
+static void countDocument(const GPXdoc* doc, SnapshotCounts* counts){
+    countWaypoints(doc->waypoints, counts);
+
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        countWaypoints(rte->waypoints, counts);
+        counts->entityData += getLength(rte->otherData);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        while ((seg = nextElement(&segIter)) != NULL){
+            countWaypoints(seg->waypoints, counts);
+        }
+        counts->segments += getLength(trk->segments);
+        counts->entityData += getLength(trk->otherData);
+    }
+}
+
+static bool growInterned(SnapshotBuilder* b){
+    size_t capacity = b->internCapacity == 0 ? 1024 : b->internCapacity * 2;
+    uint32_t* slots = calloc(capacity, sizeof(uint32_t));
+
+    if (slots == NULL){
+        return false;
+    }
+
+    for (size_t i = 0; i < b->internCapacity; i++){
+        if (b->interned[i] != 0){
+            size_t j = hashString(b->strings.str + b->interned[i] - 1) & (capacity - 1);
+
+            while (slots[j] != 0){
+                j = (j + 1) & (capacity - 1);
+            }
+            slots[j] = b->interned[i];
+        }
+    }
+
+    free(b->interned);
+    b->interned = slots;
+    b->internCapacity = capacity;
+    return true;
+}
+
+//Finds str in the string table, adding it if it is not there yet
+static bool intern(SnapshotBuilder* b, const char* str, uint32_t* offset){
+    if (str == NULL){
+        str = "";
+    }
+    if (b->numInterned * 2 >= b->internCapacity && !growInterned(b)){
+        return false;
+    }
+
+    size_t i = hashString(str) & (b->internCapacity - 1);
+    while (b->interned[i] != 0){
+        if (strcmp(b->strings.str + b->interned[i] - 1, str) == 0){
+            *offset = b->interned[i] - 1;
+            return true;
+        }
+        i = (i + 1) & (b->internCapacity - 1);
+    }
+
+    size_t len = strlen(str);
+    if (b->strings.len + len + 1 >= UINT32_MAX || !appendStringLen(&b->strings, str, len + 1)){
+        return false;
+    }
+
+    *offset = b->strings.len - len - 1;
+    b->interned[i] = *offset + 1;
+    b->numInterned++;
+    return true;
+}
+
+static bool addData(SnapshotBuilder* b, List* otherData, uint32_t* next){
+    ListIterator iter = createIterator(otherData);
+    GPXData* data;
+
+    while ((data = nextElement(&iter)) != NULL){
+        DataRecord* record = &b->data[(*next)++];
+
+        if (!intern(b, getGPXDataName(data), &record->name) || !intern(b, getGPXDataValue(data), &record->value)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Fields without a value may be uninitialized, so they are written as zero
+static void fillFields(FieldsRecord* record, const Waypoint* wpt){
+    unsigned int fields = wpt->fields;
+
+    record->elevation = (fields & GPX_FIELD_ELEVATION) ? wpt->elevation : 0.0;
+    record->hdop = (fields & GPX_FIELD_HDOP) ? wpt->hdop : 0.0f;
+    record->vdop = (fields & GPX_FIELD_VDOP) ? wpt->vdop : 0.0f;
+    record->pdop = (fields & GPX_FIELD_PDOP) ? wpt->pdop : 0.0f;
+    record->speed = (fields & GPX_FIELD_SPEED) ? wpt->speed : 0.0f;
+    record->satellites = (fields & GPX_FIELD_SATELLITES) ? wpt->satellites : 0;
+    record->fields = fields;
+}
+
+static bool addPoints(SnapshotBuilder* b, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        uint32_t i = b->nextPoint++;
+
+        b->latitude[i] = wpt->latitude;
+        b->longitude[i] = wpt->longitude;
+        b->time[i] = wpt->time;
+        fillFields(&b->fields[i], wpt);
+        b->pointData[i] = b->nextPointData;
+        if (!intern(b, wpt->name, &b->pointNames[i]) || !addData(b, wpt->otherData, &b->nextPointData)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool fillEntity(SnapshotBuilder* b, EntityRecord* record, const char* name, List* otherData){
+    record->firstData = b->nextEntityData;
+    record->numData = getLength(otherData);
+    return intern(b, name, &record->name) && addData(b, otherData, &b->nextEntityData);
+}
+
+static bool buildSnapshot(SnapshotBuilder* b, const GPXdoc* doc){
+    if (!intern(b, doc->namespace, &b->header.namespace) || !intern(b, doc->creator, &b->header.creator) ||
+        !addPoints(b, doc->waypoints)){
+        return false;
+    }
+
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    for (uint32_t i = 0; (rte = nextElement(&iter)) != NULL; i++){
+        EntityRecord* record = &b->routes[i];
+
+        record->first = b->nextPoint;
+        record->count = getLength(rte->waypoints);
+        if (!addPoints(b, rte->waypoints) || !fillEntity(b, record, rte->name, rte->otherData)){
+            return false;
+        }
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    for (uint32_t i = 0; (trk = nextElement(&iter)) != NULL; i++){
+        EntityRecord* record = &b->tracks[i];
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        record->first = b->nextSegment;
+        record->count = getLength(trk->segments);
+        while ((seg = nextElement(&segIter)) != NULL){
+            SegmentRecord* segment = &b->segments[b->nextSegment++];
+
+            segment->firstPoint = b->nextPoint;
+            segment->numPoints = getLength(seg->waypoints);
+            if (!addPoints(b, seg->waypoints)){
+                return false;
+            }
+        }
+        if (!fillEntity(b, record, trk->name, trk->otherData)){
+            return false;
+        }
+    }
+
+    b->pointData[b->nextPoint] = b->nextPointData;
+    b->header.stringBytes = b->strings.len;
+    return true;
+}
+
+//Passes data to the sink in pieces of at most GPX_WRITER_CHUNK bytes, followed by zeros up to a multiple of 8
+static bool writeSection(const GPXSink* sink, const void* data, size_t len){
+    static const char zeros[8] = {0};
+    const char* bytes = data;
+    size_t padding = align8(len) - len;
+
+    while (len > 0){
+        size_t n = len < GPX_WRITER_CHUNK ? len : GPX_WRITER_CHUNK;
+
+        if (!sink->write(sink->userData, bytes, n)){
+            return false;
+        }
+        bytes += n;
+        len -= n;
+    }
+    return padding == 0 || sink->write(sink->userData, zeros, padding);
+}
+
+static bool emitSnapshot(SnapshotBuilder* b, const GPXSink* sink){
+    SnapshotHeader* header = &b->header;
+    const void* sections[NUM_SECTIONS] = {
+        b->latitude, b->longitude, b->time, b->fields, b->pointNames, b->pointData,
+        b->routes, b->tracks, b->segments, b->data, b->strings.str
+    };
+    uint64_t lengths[NUM_SECTIONS];
+
+    getSectionLengths(header, lengths);
+    uint64_t offset = sizeof(SnapshotHeader);
+    for (int i = 0; i < NUM_SECTIONS; i++){
+        header->offsets[i] = offset;
+        offset += align8(lengths[i]);
+    }
+    header->totalSize = offset;
+
+    if (!writeSection(sink, header, sizeof(SnapshotHeader))){
+        return false;
+    }
+    for (int i = 0; i < NUM_SECTIONS; i++){
+        if (lengths[i] > 0 && !writeSection(sink, sections[i], lengths[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeGPXSnapshot(const GPXdoc* doc, const GPXSink* sink){
+    if (doc == NULL || sink == NULL || sink->write == NULL || !loadGPXdoc((GPXdoc*)doc)){
+        return false;
+    }
+
+    SnapshotCounts counts = {0, 0, 0, 0};
+    countDocument(doc, &counts);
+    if (counts.points >= UINT32_MAX || counts.pointData + counts.entityData >= UINT32_MAX || counts.segments >= UINT32_MAX){
+        return false;
+    }
+
+    SnapshotBuilder b;
+    memset(&b, 0, sizeof(b));
+    memcpy(b.header.magic, SNAPSHOT_MAGIC, sizeof(b.header.magic));
+    b.header.version = GPX_SNAPSHOT_VERSION;
+    b.header.byteOrder = BYTE_ORDER_MARK;
+    b.header.gpxVersion = doc->version;
+    b.header.numWaypoints = getLength(doc->waypoints);
+    b.header.numRoutes = getLength(doc->routes);
+    b.header.numTracks = getLength(doc->tracks);
+    b.header.numSegments = counts.segments;
+    b.header.numPoints = counts.points;
+    b.header.numData = counts.pointData + counts.entityData;
+    b.nextEntityData = counts.pointData;
+
+    b.latitude = gpxAllocArray(counts.points, sizeof(double));
+    b.longitude = gpxAllocArray(counts.points, sizeof(double));
+    b.time = gpxAllocArray(counts.points, sizeof(int64_t));
+    b.fields = gpxAllocArray(counts.points, sizeof(FieldsRecord));
+    b.pointNames = gpxAllocArray(counts.points, sizeof(uint32_t));
+    b.pointData = gpxAllocArray(counts.points, sizeof(uint32_t));
+    b.routes = gpxAllocArray(b.header.numRoutes, sizeof(EntityRecord));
+    b.tracks = gpxAllocArray(b.header.numTracks, sizeof(EntityRecord));
+    b.segments = gpxAllocArray(counts.segments, sizeof(SegmentRecord));
+    b.data = gpxAllocArray(b.header.numData, sizeof(DataRecord));
+
+    bool result = b.latitude != NULL && b.longitude != NULL && b.time != NULL && b.fields != NULL &&
+                  b.pointNames != NULL && b.pointData != NULL &&
+                  b.routes != NULL && b.tracks != NULL && b.segments != NULL && b.data != NULL &&
+                  buildSnapshot(&b, doc) && emitSnapshot(&b, sink);
+
+    free(b.latitude);
+    free(b.longitude);
+    free(b.time);
+    free(b.fields);
+    free(b.pointNames);
+    free(b.pointData);
+    free(b.routes);
+    free(b.tracks);
+    free(b.segments);
+    free(b.data);
+    free(b.strings.str);
+    free(b.interned);
+    return result;
+}
+
+static bool fileWrite(void* userData, const char* data, size_t len){
+    return fwrite(data, 1, len, userData) == len;
+}
+
+bool writeGPXSnapshotToFile(const GPXdoc* doc, FILE* file){
+    if (file == NULL){
+        return false;
+    }
+
+    GPXSink sink = {file, &fileWrite};
+    return writeGPXSnapshot(doc, &sink);
+}
+
+/* ******************************* Loading *************************** */
+
+typedef struct {
+    const SnapshotHeader* header;
+    const double* latitude;
+    const double* longitude;
+    const int64_t* time;
+    const FieldsRecord* fields;
+    const uint32_t* pointNames;
+    const uint32_t* pointData;
+    const EntityRecord* routes;
+    const EntityRecord* tracks;
+    const SegmentRecord* segments;
+    const DataRecord* data;
+
+    //Copy of the string table in the arena, shared by every name in the document
+    const char* strings;
+    GPXArena* arena;
+} SnapshotReader;
+
+static bool validRange(uint32_t first, uint32_t count, uint32_t total){
+    return (uint64_t)first + count <= total;
+}
+
+static bool getString(const SnapshotReader* r, uint32_t offset, const char** str){
+    if (offset >= r->header->stringBytes){
+        return false;
+    }
+    *str = r->strings + offset;
+    return true;
+}
+
+static bool loadData(const SnapshotReader* r, List* otherData, uint32_t first, uint32_t count){
+    if (!validRange(first, count, r->header->numData)){
+        return false;
+    }
+
+    for (uint32_t i = first; i < first + count; i++){
+        const char* name;
+        const char* value;
+
+        if (!getString(r, r->data[i].name, &name) || !getString(r, r->data[i].value, &value)){
+            return false;
+        }
+
+        GPXData* data = createArenaGPXData(r->arena, name, value);
+        if (data == NULL || !arenaInsertBack(r->arena, otherData, data)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Loads count points starting at first into waypoints, and grows bounds to include them if it is not NULL
+static bool loadPoints(const SnapshotReader* r, List* waypoints, GPXBounds* bounds, uint32_t first, uint32_t count){
+    if (!validRange(first, count, r->header->numPoints)){
+        return false;
+    }
+
+    for (uint32_t i = first; i < first + count; i++){
+        Waypoint* wpt = arenaAlloc(r->arena, sizeof(Waypoint));
+        const char* name;
+
+        if (wpt == NULL || !getString(r, r->pointNames[i], &name) || r->pointData[i] > r->pointData[i + 1]){
+            return false;
+        }
+
+        wpt->name = (char*)name;
+        wpt->latitude = r->latitude[i];
+        wpt->longitude = r->longitude[i];
+        wpt->time = r->time[i];
+        wpt->elevation = r->fields[i].elevation;
+        wpt->hdop = r->fields[i].hdop;
+        wpt->vdop = r->fields[i].vdop;
+        wpt->pdop = r->fields[i].pdop;
+        wpt->speed = r->fields[i].speed;
+        wpt->satellites = r->fields[i].satellites;
+        wpt->fields = r->fields[i].fields;
+        wpt->otherData = createArenaList(r->arena, &gpxDataToString, &compareGpxData);
+
+        if (wpt->otherData == NULL || !loadData(r, wpt->otherData, r->pointData[i], r->pointData[i + 1] - r->pointData[i]) ||
+            !arenaInsertBack(r->arena, waypoints, wpt)){
+            return false;
+        }
+        if (bounds != NULL){
+            extendBounds(bounds, wpt);
+        }
+    }
+    return true;
+}
+
+static bool loadRoutes(const SnapshotReader* r, GPXdoc* doc){
+    for (uint32_t i = 0; i < r->header->numRoutes; i++){
+        const EntityRecord* record = &r->routes[i];
+        Route* rte = arenaAlloc(r->arena, sizeof(Route));
+        const char* name;
+
+        if (rte == NULL || !getString(r, record->name, &name)){
+            return false;
+        }
+
+        rte->name = (char*)name;
+        resetBounds(&rte->bounds);
+        rte->waypoints = createArenaList(r->arena, &waypointToString, &compareWaypoints);
+        rte->otherData = createArenaList(r->arena, &gpxDataToString, &compareGpxData);
+
+        if (rte->waypoints == NULL || rte->otherData == NULL ||
+            !loadPoints(r, rte->waypoints, &rte->bounds, record->first, record->count) ||
+            !loadData(r, rte->otherData, record->firstData, record->numData) ||
+            !arenaInsertBack(r->arena, doc->routes, rte)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool loadTracks(const SnapshotReader* r, GPXdoc* doc){
+    for (uint32_t i = 0; i < r->header->numTracks; i++){
+        const EntityRecord* record = &r->tracks[i];
+        Track* trk = arenaAlloc(r->arena, sizeof(Track));
+        const char* name;
+
+        if (trk == NULL || !getString(r, record->name, &name) || !validRange(record->first, record->count, r->header->numSegments)){
+            return false;
+        }
+
+        trk->name = (char*)name;
+        resetBounds(&trk->bounds);
+        trk->segments = createArenaList(r->arena, &trackSegmentToString, &compareTrackSegments);
+        trk->otherData = createArenaList(r->arena, &gpxDataToString, &compareGpxData);
+        if (trk->segments == NULL || trk->otherData == NULL){
+            return false;
+        }
+
+        for (uint32_t j = record->first; j < record->first + record->count; j++){
+            TrackSegment* seg = createArenaTrackSegment(r->arena);
+
+            if (seg == NULL || !loadPoints(r, seg->waypoints, &seg->bounds, r->segments[j].firstPoint, r->segments[j].numPoints) ||
+                !arenaInsertBack(r->arena, trk->segments, seg)){
+                return false;
+            }
+            mergeBounds(&trk->bounds, &seg->bounds);
+        }
+
+        if (!loadData(r, trk->otherData, record->firstData, record->numData) ||
+            !arenaInsertBack(r->arena, doc->tracks, trk)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Checks the header and points the reader's arrays at the sections.  Returns false if data is not a valid snapshot
+static bool openSnapshot(SnapshotReader* r, const void* data, size_t size){
+    const SnapshotHeader* header = data;
+
+    if (size < sizeof(SnapshotHeader) || (uintptr_t)data % 8 != 0 ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GPX_SNAPSHOT_VERSION || header->byteOrder != BYTE_ORDER_MARK ||
+        header->totalSize != size || header->numWaypoints > header->numPoints ||
+        header->numPoints == UINT32_MAX || header->stringBytes == 0){
+        return false;
+    }
+
+    uint64_t lengths[NUM_SECTIONS];
+    getSectionLengths(header, lengths);
+    const void* sections[NUM_SECTIONS];
+
+    for (int i = 0; i < NUM_SECTIONS; i++){
+        uint64_t offset = header->offsets[i];
+
+        if (offset % 8 != 0 || offset < sizeof(SnapshotHeader) || offset > size || lengths[i] > size - offset){
+            return false;
+        }
+        sections[i] = (const char*)data + offset;
+    }
+
+    //Every string ends inside the table once its last byte is a terminator
+    const char* strings = sections[SECTION_STRINGS];
+    if (strings[header->stringBytes - 1] != '\0'){
+        return false;
+    }
+
+    r->header = header;
+    r->latitude = sections[SECTION_LATITUDE];
+    r->longitude = sections[SECTION_LONGITUDE];
+    r->time = sections[SECTION_TIME];
+    r->fields = sections[SECTION_FIELDS];
+    r->pointNames = sections[SECTION_POINT_NAMES];
+    r->pointData = sections[SECTION_POINT_DATA];
+    r->routes = sections[SECTION_ROUTES];
+    r->tracks = sections[SECTION_TRACKS];
+    r->segments = sections[SECTION_SEGMENTS];
+    r->data = sections[SECTION_DATA];
+    r->strings = strings;
+    return true;
+}
+
+static bool loadDocument(SnapshotReader* r, GPXdoc* doc){
+    char* strings = arenaAlloc(r->arena, r->header->stringBytes);
+    const char* namespace;
+    const char* creator;
+
+    if (strings == NULL){
+        return false;
+    }
+    memcpy(strings, r->strings, r->header->stringBytes);
+    r->strings = strings;
+
+    if (!getString(r, r->header->namespace, &namespace) || strlen(namespace) >= sizeof(doc->namespace) ||
+        !getString(r, r->header->creator, &creator)){
+        return false;
+    }
+    strcpy(doc->namespace, namespace);
+    doc->creator = (char*)creator;
+    doc->version = r->header->gpxVersion;
+
+    return loadPoints(r, doc->waypoints, NULL, 0, r->header->numWaypoints) && loadRoutes(r, doc) && loadTracks(r, doc);
+}
+
+GPXdoc* loadGPXSnapshotFromMemory(const void* data, size_t size){
+    SnapshotReader r;
+
+    if (data == NULL || !openSnapshot(&r, data, size)){
+        return NULL;
+    }
+
+    r.arena = createGPXArena(0);
+    if (r.arena == NULL){
+        return NULL;
+    }
+
+    GPXdoc* doc = createArenaGPXdoc(r.arena);
+    if (doc == NULL){
+        deleteGPXArena(r.arena);
+        return NULL;
+    }
+    if (!loadDocument(&r, doc)){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+GPXdoc* loadGPXSnapshot(const char* fileName){
+    MappedFile file;
+
+    if (fileName == NULL || !mapGPXFile(fileName, &file)){
+        return NULL;
+    }
+
+    GPXdoc* doc = loadGPXSnapshotFromMemory(file.data, file.size);
+    unmapGPXFile(&file);
+    return doc;
+}
@@ -0,0 +1,472 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "GPXSpatial.h"
+#include "GPXLazy.h"
+#include "GPXDistance.h"
+#include "GPXHelpers.h"
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+//Average number of points per grid cell the index is sized for, and the largest grid it builds
+#define POINTS_PER_CELL 8
+#define MAX_CELLS (1 << 22)
+
+/* ******************************* Bounds *************************** */
+
+void resetBounds(GPXBounds* bounds){
+    bounds->minLatitude = INFINITY;
+    bounds->minLongitude = INFINITY;
+    bounds->maxLatitude = -INFINITY;
+    bounds->maxLongitude = -INFINITY;
+}
+
+bool isBoundsEmpty(const GPXBounds* bounds){
+    return !(bounds->minLatitude <= bounds->maxLatitude);
+}
+
+static void extendBoundsTo(GPXBounds* bounds, double latitude, double longitude){
+    if (latitude < bounds->minLatitude){
+        bounds->minLatitude = latitude;
+    }
+    if (latitude > bounds->maxLatitude){
+        bounds->maxLatitude = latitude;
+    }
+    if (longitude < bounds->minLongitude){
+        bounds->minLongitude = longitude;
+    }
+    if (longitude > bounds->maxLongitude){
+        bounds->maxLongitude = longitude;
+    }
+}
+
+void extendBounds(GPXBounds* bounds, const Waypoint* wpt){
+    if (isfinite(wpt->latitude) && isfinite(wpt->longitude)){
+        extendBoundsTo(bounds, wpt->latitude, wpt->longitude);
+    }
+}
+
+void mergeBounds(GPXBounds* bounds, const GPXBounds* other){
+    if (!isBoundsEmpty(other)){
+        extendBoundsTo(bounds, other->minLatitude, other->minLongitude);
+        extendBoundsTo(bounds, other->maxLatitude, other->maxLongitude);
+    }
+}
+
+bool boundsIntersect(const GPXBounds* bounds, const GPXBounds* other){
+    if (isBoundsEmpty(bounds) || isBoundsEmpty(other) ||
+        bounds->maxLatitude < other->minLatitude || bounds->minLatitude > other->maxLatitude){
+        return false;
+    }
+
+    if (other->minLongitude <= other->maxLongitude){
+        return bounds->maxLongitude >= other->minLongitude && bounds->minLongitude <= other->maxLongitude;
+    }
+    //other covers [minLongitude, 180] and [-180, maxLongitude]
+    return bounds->maxLongitude >= other->minLongitude || bounds->minLongitude <= other->maxLongitude;
+}
+
+static void computeBounds(List* waypoints, GPXBounds* bounds){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    resetBounds(bounds);
+    while ((wpt = nextElement(&iter)) != NULL){
+        extendBounds(bounds, wpt);
+    }
+}
+
+void updateGPXBounds(GPXdoc* doc){
+    if (doc == NULL || doc->frozen){
+        return;
+    }
+    loadGPXdoc(doc);
+
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        computeBounds(rte->waypoints, &rte->bounds);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        resetBounds(&trk->bounds);
+        while ((seg = nextElement(&segIter)) != NULL){
+            computeBounds(seg->waypoints, &seg->bounds);
+            mergeBounds(&trk->bounds, &seg->bounds);
+        }
+    }
+}
+
+bool getGPXdocBounds(const GPXdoc* doc, GPXBounds* bounds){
+    resetBounds(bounds);
+    if (doc == NULL){
+        return false;
+    }
+    loadGPXdoc((GPXdoc*)doc);
+
+    ListIterator iter = createIterator(doc->waypoints);
+    Waypoint* wpt;
+    while ((wpt = nextElement(&iter)) != NULL){
+        extendBounds(bounds, wpt);
+    }
+
+    iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        mergeBounds(bounds, &rte->bounds);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        mergeBounds(bounds, &trk->bounds);
+    }
+    return !isBoundsEmpty(bounds);
+}
+
+/* ******************************* Index *************************** */
+
+//The points of cell i (row-major) are entries cellStart[i] to cellStart[i + 1] - 1 of the point arrays
+struct gpxSpatialIndex {
+    GPXBounds bounds;
+    int rows;
+    int columns;
+    double rowScale;
+    double columnScale;
+    uint32_t* cellStart;
+
+    int numPoints;
+    double* latitude;
+    double* longitude;
+    GPXPointRef* points;
+};
+
+//Points collected from the document before they are sorted into cells
+typedef struct {
+    int count;
+    double* latitude;
+    double* longitude;
+    GPXPointRef* points;
+} PointSet;
+
+static void collectPoints(PointSet* set, List* waypoints, GPXPointKind kind, const void* owner, const TrackSegment* segment){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        if (!isfinite(wpt->latitude) || !isfinite(wpt->longitude)){
+            continue;
+        }
+
+        int i = set->count++;
+        set->latitude[i] = wpt->latitude;
+        set->longitude[i] = wpt->longitude;
+        set->points[i] = (GPXPointRef){wpt, kind, owner, segment};
+    }
+}
+
+static int countDocPoints(const GPXdoc* doc){
+    long long count = getLength(doc->waypoints);
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+
+    while ((rte = nextElement(&iter)) != NULL){
+        count += getLength(rte->waypoints);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        while ((seg = nextElement(&segIter)) != NULL){
+            count += getLength(seg->waypoints);
+        }
+    }
+    return count < INT32_MAX ? (int)count : -1;
+}
+
+static void collectDocPoints(PointSet* set, const GPXdoc* doc){
+    collectPoints(set, doc->waypoints, GPX_POINT_WAYPOINT, NULL, NULL);
+
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        collectPoints(set, rte->waypoints, GPX_POINT_ROUTE, rte, NULL);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        while ((seg = nextElement(&segIter)) != NULL){
+            collectPoints(set, seg->waypoints, GPX_POINT_TRACK, trk, seg);
+        }
+    }
+}
+
+//Chooses a grid with about POINTS_PER_CELL points per cell and cells as square as the bounds allow
+static void sizeGrid(GPXSpatialIndex* index){
+    double height = index->bounds.maxLatitude - index->bounds.minLatitude;
+    double width = index->bounds.maxLongitude - index->bounds.minLongitude;
+    double cells = index->numPoints / POINTS_PER_CELL;
+
+    if (cells > MAX_CELLS){
+        cells = MAX_CELLS;
+    }
+    if (cells < 1 || (height <= 0 && width <= 0)){
+        cells = 1;
+    }
+
+    if (height <= 0){
+        index->rows = 1;
+        index->columns = (int)cells;
+    }else if (width <= 0){
+        index->rows = (int)cells;
+        index->columns = 1;
+    }else{
+        double columns = round(sqrt(cells * width / height));
+        columns = columns < 1 ? 1 : columns > cells ? cells : columns;
+
+        index->columns = (int)columns;
+        index->rows = (int)(cells / columns);
+    }
+
+    index->rowScale = height > 0 ? index->rows / height : 0.0;
+    index->columnScale = width > 0 ? index->columns / width : 0.0;
+}
+
+static int cellRow(const GPXSpatialIndex* index, double latitude){
+    double row = (latitude - index->bounds.minLatitude) * index->rowScale;
+    //Also clamps infinite query bounds, and NAN from infinity times a scale of 0
+    return !(row > 0) ? 0 : row >= index->rows ? index->rows - 1 : (int)row;
+}
+
+static int cellColumn(const GPXSpatialIndex* index, double longitude){
+    double column = (longitude - index->bounds.minLongitude) * index->columnScale;
+    return !(column > 0) ? 0 : column >= index->columns ? index->columns - 1 : (int)column;
+}
+
+//Sorts the collected points into cells with a counting sort.  Returns false if malloc fails
+static bool fillCells(GPXSpatialIndex* index, const PointSet* set){
+    size_t numCells = (size_t)index->rows * index->columns;
+    uint32_t* cells = malloc(sizeof(uint32_t) * (set->count + 1));
+
+    index->cellStart = calloc(numCells + 1, sizeof(uint32_t));
+    if (cells == NULL || index->cellStart == NULL){
+        free(cells);
+        return false;
+    }
+
+    //cellStart[i + 1] counts the points of cell i, then becomes the end of cell i once summed
+    for (int i = 0; i < set->count; i++){
+        cells[i] = (uint32_t)cellRow(index, set->latitude[i]) * index->columns + cellColumn(index, set->longitude[i]);
+        index->cellStart[cells[i] + 1]++;
+    }
+    for (size_t i = 0; i < numCells; i++){
+        index->cellStart[i + 1] += index->cellStart[i];
+    }
+
+    //Each point goes to the next free slot of its cell; the slots are counted up from cellStart, which is
+    //shifted back into place afterwards
+    for (int i = 0; i < set->count; i++){
+        uint32_t slot = index->cellStart[cells[i]]++;
+
+        index->latitude[slot] = set->latitude[i];
+        index->longitude[slot] = set->longitude[i];
+        index->points[slot] = set->points[i];
+    }
+    memmove(index->cellStart + 1, index->cellStart, sizeof(uint32_t) * numCells);
+    index->cellStart[0] = 0;
+
+    free(cells);
+    return true;
+}
+
+static void freePointSet(PointSet* set){
+    free(set->latitude);
+    free(set->longitude);
+    free(set->points);
+}
+
+GPXSpatialIndex* createSpatialIndex(const GPXdoc* doc){
+    int capacity = doc != NULL && loadGPXdoc((GPXdoc*)doc) ? countDocPoints(doc) : -1;
+    if (capacity < 0){
+        return NULL;
+    }
+
+    GPXSpatialIndex* index = calloc(1, sizeof(GPXSpatialIndex));
+    PointSet set = {0, NULL, NULL, NULL};
+
+    set.latitude = gpxAllocArray(capacity, sizeof(double));
+    set.longitude = gpxAllocArray(capacity, sizeof(double));
+    set.points = gpxAllocArray(capacity, sizeof(GPXPointRef));
+    if (index == NULL || set.latitude == NULL || set.longitude == NULL || set.points == NULL){
+        free(index);
+        freePointSet(&set);
+        return NULL;
+    }
+
+    collectDocPoints(&set, doc);
+    index->numPoints = set.count;
+    resetBounds(&index->bounds);
+    for (int i = 0; i < set.count; i++){
+        extendBoundsTo(&index->bounds, set.latitude[i], set.longitude[i]);
+    }
+    sizeGrid(index);
+
+    index->latitude = malloc(sizeof(double) * (set.count + 1));
+    index->longitude = malloc(sizeof(double) * (set.count + 1));
+    index->points = malloc(sizeof(GPXPointRef) * (set.count + 1));
+
+    bool ok = index->latitude != NULL && index->longitude != NULL && index->points != NULL && fillCells(index, &set);
+    freePointSet(&set);
+
+    if (!ok){
+        deleteSpatialIndex(index);
+        return NULL;
+    }
+    return index;
+}
+
+void deleteSpatialIndex(GPXSpatialIndex* index){
+    if (index == NULL){
+        return;
+    }
+
+    free(index->cellStart);
+    free(index->latitude);
+    free(index->longitude);
+    free(index->points);
+    free(index);
+}
+
+int getSpatialIndexCount(const GPXSpatialIndex* index){
+    return index != NULL ? index->numPoints : 0;
+}
+
+size_t getSpatialIndexSize(const GPXSpatialIndex* index){
+    if (index == NULL){
+        return 0;
+    }
+
+    size_t numCells = (size_t)index->rows * index->columns;
+    return sizeof(GPXSpatialIndex) + sizeof(uint32_t) * (numCells + 1) +
+           (sizeof(double) * 2 + sizeof(GPXPointRef)) * (index->numPoints + 1);
+}
+
+/* ******************************* Queries *************************** */
+
+//State of one query.  A radius query also checks the distance of every point inside its box
+typedef struct {
+    GPXPointFound found;
+    void* userData;
+    int count;
+    bool stopped;
+
+    bool isRadius;
+    double latitude;
+    double longitude;
+    double radius;
+} Query;
+
+//Reports the points inside a box that does not cross the antimeridian
+static void scanBox(const GPXSpatialIndex* index, const GPXBounds* box, Query* query){
+    if (query->stopped || !boundsIntersect(&index->bounds, box)){
+        return;
+    }
+
+    int firstRow = cellRow(index, box->minLatitude);
+    int lastRow = cellRow(index, box->maxLatitude);
+    int firstColumn = cellColumn(index, box->minLongitude);
+    int lastColumn = cellColumn(index, box->maxLongitude);
+
+    //The cells of a row that the box covers are adjacent, so their points form one run
+    for (int row = firstRow; row <= lastRow; row++){
+        uint32_t start = index->cellStart[row * index->columns + firstColumn];
+        uint32_t end = index->cellStart[row * index->columns + lastColumn + 1];
+
+        for (uint32_t i = start; i < end; i++){
+            double latitude = index->latitude[i];
+            double longitude = index->longitude[i];
+
+            if (latitude < box->minLatitude || latitude > box->maxLatitude ||
+                longitude < box->minLongitude || longitude > box->maxLongitude){
+                continue;
+            }
+            if (query->isRadius && haversineDistance(query->latitude, query->longitude, latitude, longitude) > query->radius){
+                continue;
+            }
+
+            query->count++;
+            if (query->found != NULL && !query->found(query->userData, &index->points[i])){
+                query->stopped = true;
+                return;
+            }
+        }
+    }
+}
+
+//Reports the points inside a box that may cross the antimeridian
+static void scanWrappedBox(const GPXSpatialIndex* index, const GPXBounds* box, Query* query){
+    if (box->minLongitude <= box->maxLongitude){
+        scanBox(index, box, query);
+        return;
+    }
+
+    GPXBounds east = {box->minLatitude, box->minLongitude, box->maxLatitude, INFINITY};
+    GPXBounds west = {box->minLatitude, -INFINITY, box->maxLatitude, box->maxLongitude};
+    scanBox(index, &east, query);
+    scanBox(index, &west, query);
+}
+
+int queryBox(const GPXSpatialIndex* index, const GPXBounds* box, GPXPointFound found, void* userData){
+    if (index == NULL || box == NULL){
+        return -1;
+    }
+
+    Query query = {found, userData, 0, false, false, 0.0, 0.0, 0.0};
+    scanWrappedBox(index, box, &query);
+    return query.count;
+}
+
+int queryRadius(const GPXSpatialIndex* index, double latitude, double longitude, double radius,
+                GPXPointFound found, void* userData){
+    if (index == NULL){
+        return -1;
+    }
+    if (!isfinite(latitude) || !isfinite(longitude) || !(radius >= 0)){
+        return 0;
+    }
+
+    //The box around the circle: the latitude range is exact, and the longitude range is the widest
+    //the circle reaches, at the latitude where it touches the meridians
+    double angle = radius / EARTH_RADIUS;
+    double deltaLatitude = angle / DEG_TO_RAD;
+    double ratio = sin(angle) / cos(latitude * DEG_TO_RAD);
+    GPXBounds box = {latitude - deltaLatitude, -INFINITY, latitude + deltaLatitude, INFINITY};
+
+    //A circle around a pole covers every longitude
+    if (box.minLatitude > -90 && box.maxLatitude < 90 && ratio < 1){
+        double deltaLongitude = asin(ratio) / DEG_TO_RAD;
+
+        box.minLongitude = longitude - deltaLongitude;
+        box.maxLongitude = longitude + deltaLongitude;
+        if (box.minLongitude < -180){
+            box.minLongitude += 360;
+        }else if (box.maxLongitude > 180){
+            box.maxLongitude -= 360;
+        }
+    }
+
+    Query query = {found, userData, 0, false, true, latitude, longitude, radius};
+    scanWrappedBox(index, &box, &query);
+    return query.count;
+}
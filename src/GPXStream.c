@@ -0,0 +1,578 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "GPXParser.h"
+#include "GPXHelpers.h"
+#include "GPXArena.h"
+#include "GPXParallel.h"
+#include "GPXLazy.h"
+#include "GPXSpatial.h"
+
+/* Streaming construction of a GPXdoc.  The xmlTextReader only ever holds the current node, so the
+   model is filled in as the file is read and the libxml tree is never built. */
+
+//Parse state.  When arena is not NULL every object is allocated from it instead of the heap, and otherwise
+//the lists of new objects draw their nodes from pool when it is not NULL.  typedOnly and sharedNames are set
+//for GPX_OPT_TYPED_ONLY and GPX_OPT_SHARED_NAMES.  pointsOnly skips the children of routes and tracks that
+//are not points or segments, for elements whose other children have already been read
+typedef struct {
+    xmlTextReaderPtr reader;
+    GPXArena* arena;
+    StringBuilder text;
+    bool typedOnly;
+    bool sharedNames;
+    bool pointsOnly;
+    NodePool* pool;
+} Builder;
+
+/* ******************************* Allocation *************************** */
+
+static Waypoint* newWaypoint(Builder* b){
+    if (b->arena != NULL){
+        return createArenaWaypoint(b->arena);
+    }
+
+    Waypoint* wpt = createWaypoint();
+    if (wpt != NULL){
+        setListNodePool(wpt->otherData, b->pool);
+    }
+    return wpt;
+}
+
+static Route* newRoute(Builder* b){
+    if (b->arena != NULL){
+        return createArenaRoute(b->arena);
+    }
+
+    Route* rte = createRoute();
+    if (rte != NULL){
+        setListNodePool(rte->waypoints, b->pool);
+        setListNodePool(rte->otherData, b->pool);
+    }
+    return rte;
+}
+
+static TrackSegment* newTrackSegment(Builder* b){
+    if (b->arena != NULL){
+        return createArenaTrackSegment(b->arena);
+    }
+
+    TrackSegment* seg = createTrackSegment();
+    if (seg != NULL){
+        setListNodePool(seg->waypoints, b->pool);
+    }
+    return seg;
+}
+
+static Track* newTrack(Builder* b){
+    if (b->arena != NULL){
+        return createArenaTrack(b->arena);
+    }
+
+    Track* trk = createTrack();
+    if (trk != NULL){
+        setListNodePool(trk->segments, b->pool);
+        setListNodePool(trk->otherData, b->pool);
+    }
+    return trk;
+}
+
+static GPXData* newGPXData(Builder* b, const char* name, const char* value){
+    if (b->sharedNames){
+        return b->arena != NULL ? createArenaGPXDataRecord(b->arena, name, value) : createGPXDataRecord(name, value);
+    }
+    return b->arena != NULL ? createArenaGPXData(b->arena, name, value) : createGPXData(name, value);
+}
+
+static bool setName(Builder* b, char** field, const char* value){
+    if (b->arena == NULL){
+        return setGPXName(field, value);
+    }
+
+    char* copy = arenaStrdup(b->arena, value);
+    if (copy == NULL){
+        return false;
+    }
+    *field = copy;
+    return true;
+}
+
+//Appends data to list.  Returns false if data is NULL or malloc fails
+static bool append(Builder* b, List* list, void* data){
+    if (data == NULL){
+        return false;
+    }
+    if (b->arena != NULL){
+        return arenaInsertBack(b->arena, list, data);
+    }
+
+    int length = getLength(list);
+    insertBack(list, data);
+    return getLength(list) != length;
+}
+
+//Frees an object that could not be added to the document.  Arena objects are freed with the arena
+static void discard(Builder* b, void (*deleteFunction)(void* toBeDeleted), void* data){
+    if (b->arena == NULL){
+        deleteFunction(data);
+    }
+}
+
+/* ******************************* Parsing *************************** */
+
+//Adds the child element the reader is positioned on to a name field or an otherData list.  The children of
+//a waypoint (wpt is NULL for routes and tracks) are also decoded into its typed fields
+static bool readChildData(Builder* b, char** name, List* otherData, Waypoint* wpt){
+    const char* element = (const char*)xmlTextReaderConstLocalName(b->reader);
+    bool isName = strcmp(element, "name") == 0;
+    char elementName[256];
+
+    //The local name is only valid until the reader moves on
+    strncpy(elementName, element, sizeof(elementName) - 1);
+    elementName[sizeof(elementName) - 1] = '\0';
+
+    if (!readElementText(b->reader, &b->text)){
+        return false;
+    }
+    if (isName){
+        return setName(b, name, b->text.str);
+    }
+    if (b->text.str[0] == '\0'){
+        return true;
+    }
+    if (wpt != NULL && setWaypointField(wpt, elementName, b->text.str) && b->typedOnly){
+        wpt->fields |= GPX_FIELD_TYPED_ONLY;
+        return true;
+    }
+
+    GPXData* data = newGPXData(b, elementName, b->text.str);
+    if (!append(b, otherData, data)){
+        discard(b, &deleteGpxData, data);
+        return false;
+    }
+    return true;
+}
+
+static Waypoint* readWaypoint(Builder* b){
+    Waypoint* wpt = newWaypoint(b);
+
+    if (wpt == NULL){
+        return NULL;
+    }
+
+    char* lat = (char*)xmlTextReaderGetAttribute(b->reader, (xmlChar*)"lat");
+    char* lon = (char*)xmlTextReaderGetAttribute(b->reader, (xmlChar*)"lon");
+    bool ok = parseGPXDouble(lat, &wpt->latitude) && parseGPXDouble(lon, &wpt->longitude);
+    xmlFree(lat);
+    xmlFree(lon);
+
+    if (ok && !xmlTextReaderIsEmptyElement(b->reader)){
+        int depth = xmlTextReaderDepth(b->reader);
+        int status = 0;
+
+        while (ok && (status = nextChildElement(b->reader, depth)) == 1){
+            ok = readChildData(b, &wpt->name, wpt->otherData, wpt);
+        }
+        ok = ok && status == 0;
+    }
+
+    if (!ok){
+        discard(b, &deleteWaypoint, wpt);
+        return NULL;
+    }
+    return wpt;
+}
+
+//Reads a waypoint, appends it to list and grows bounds to include it.  bounds is NULL for the document's waypoints
+static bool readWaypointInto(Builder* b, List* list, GPXBounds* bounds){
+    Waypoint* wpt = readWaypoint(b);
+
+    if (wpt != NULL && !append(b, list, wpt)){
+        discard(b, &deleteWaypoint, wpt);
+        return false;
+    }
+    if (wpt != NULL && bounds != NULL){
+        extendBounds(bounds, wpt);
+    }
+    return wpt != NULL;
+}
+
+//Reads the children of the <rte> the reader is positioned on into rte
+static bool readRouteInto(Builder* b, Route* rte){
+    if (xmlTextReaderIsEmptyElement(b->reader)){
+        return true;
+    }
+
+    int depth = xmlTextReaderDepth(b->reader);
+    int status = 0;
+    bool ok = true;
+
+    while (ok && (status = nextChildElement(b->reader, depth)) == 1){
+        if (localNameIs(b->reader, "rtept")){
+            ok = readWaypointInto(b, rte->waypoints, &rte->bounds);
+        }else if (b->pointsOnly){
+            ok = skipElement(b->reader);
+        }else{
+            ok = readChildData(b, &rte->name, rte->otherData, NULL);
+        }
+    }
+    return ok && status == 0;
+}
+
+static Route* readRoute(Builder* b){
+    Route* rte = newRoute(b);
+
+    if (rte != NULL && !readRouteInto(b, rte)){
+        discard(b, &deleteRoute, rte);
+        return NULL;
+    }
+    return rte;
+}
+
+//Reads the children of the <trkseg> the reader is positioned on into seg, after any points it already has
+static bool readTrackSegmentInto(Builder* b, TrackSegment* seg){
+    if (xmlTextReaderIsEmptyElement(b->reader)){
+        return true;
+    }
+
+    int depth = xmlTextReaderDepth(b->reader);
+    int status = 0;
+    bool ok = true;
+
+    while (ok && (status = nextChildElement(b->reader, depth)) == 1){
+        if (localNameIs(b->reader, "trkpt")){
+            ok = readWaypointInto(b, seg->waypoints, &seg->bounds);
+        }else{
+            ok = skipElement(b->reader);
+        }
+    }
+    return ok && status == 0;
+}
+
+static TrackSegment* readTrackSegment(Builder* b){
+    TrackSegment* seg = newTrackSegment(b);
+
+    if (seg != NULL && !readTrackSegmentInto(b, seg)){
+        discard(b, &deleteTrackSegment, seg);
+        return NULL;
+    }
+    return seg;
+}
+
+//Reads the children of the <trk> the reader is positioned on into trk.  When continued is not NULL, the
+//points of the first <trkseg> are added to it instead of to a new segment
+static bool readTrackInto(Builder* b, Track* trk, TrackSegment* continued){
+    if (xmlTextReaderIsEmptyElement(b->reader)){
+        return true;
+    }
+
+    int depth = xmlTextReaderDepth(b->reader);
+    int status = 0;
+    bool ok = true;
+
+    while (ok && (status = nextChildElement(b->reader, depth)) == 1){
+        if (localNameIs(b->reader, "trkseg") && continued != NULL){
+            ok = readTrackSegmentInto(b, continued);
+            mergeBounds(&trk->bounds, &continued->bounds);
+            continued = NULL;
+        }else if (localNameIs(b->reader, "trkseg")){
+            TrackSegment* seg = readTrackSegment(b);
+            ok = append(b, trk->segments, seg);
+            if (ok){
+                mergeBounds(&trk->bounds, &seg->bounds);
+            }else if (seg != NULL){
+                discard(b, &deleteTrackSegment, seg);
+            }
+        }else if (b->pointsOnly){
+            ok = skipElement(b->reader);
+        }else{
+            ok = readChildData(b, &trk->name, trk->otherData, NULL);
+        }
+    }
+    return ok && status == 0;
+}
+
+static Track* readTrack(Builder* b){
+    Track* trk = newTrack(b);
+
+    if (trk != NULL && !readTrackInto(b, trk, NULL)){
+        discard(b, &deleteTrack, trk);
+        return NULL;
+    }
+    return trk;
+}
+
+//Positions the reader on the root element.  Returns false if there is none or it is not <gpx>
+static bool findRoot(xmlTextReaderPtr reader){
+    do {
+        if (xmlTextReaderRead(reader) != 1){
+            return false;
+        }
+    } while (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT);
+
+    return localNameIs(reader, "gpx");
+}
+
+//Positions the reader on the <gpx> root element and copies its attributes into doc
+static bool readRoot(Builder* b, GPXdoc* doc){
+    xmlTextReaderPtr reader = b->reader;
+
+    if (!findRoot(reader)){
+        return false;
+    }
+
+    const char* href = (const char*)xmlTextReaderConstNamespaceUri(reader);
+    if (href == NULL || href[0] == '\0' || strlen(href) >= sizeof(doc->namespace)){
+        return false;
+    }
+    strcpy(doc->namespace, href);
+
+    char* version = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"version");
+    char* creator = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"creator");
+    bool ok = parseGPXDouble(version, &doc->version) && creator != NULL && creator[0] != '\0';
+
+    ok = ok && setName(b, &doc->creator, creator);
+
+    xmlFree(version);
+    xmlFree(creator);
+    return ok;
+}
+
+/* Reads the children of <gpx>, which the reader is positioned on, into doc.  continued is NULL for a new
+   document.  Otherwise the children of the first <trk> are read into continued, and when continuedSeg is
+   not NULL the points of that <trk>'s first <trkseg> are read into it. */
+static bool readContent(Builder* b, GPXdoc* doc, Track* continued, TrackSegment* continuedSeg){
+    bool ok = true;
+
+    if (!xmlTextReaderIsEmptyElement(b->reader)){
+        int status = 0;
+
+        while (ok && (status = nextChildElement(b->reader, 0)) == 1){
+            if (localNameIs(b->reader, "wpt")){
+                ok = readWaypointInto(b, doc->waypoints, NULL);
+            }else if (localNameIs(b->reader, "rte")){
+                Route* rte = readRoute(b);
+                ok = append(b, doc->routes, rte);
+                if (!ok && rte != NULL){
+                    discard(b, &deleteRoute, rte);
+                }
+            }else if (localNameIs(b->reader, "trk") && continued != NULL){
+                ok = readTrackInto(b, continued, continuedSeg);
+                continued = NULL;
+            }else if (localNameIs(b->reader, "trk")){
+                Track* trk = readTrack(b);
+                ok = append(b, doc->tracks, trk);
+                if (!ok && trk != NULL){
+                    discard(b, &deleteTrack, trk);
+                }
+            }else{
+                ok = skipElement(b->reader);
+            }
+        }
+        ok = ok && status == 0;
+    }
+
+    //Errors after </gpx> are reported the same way as xmlReadFile
+    return ok && finishReading(b->reader);
+}
+
+//Reads a whole document into doc
+static bool readDocument(Builder* b, GPXdoc* doc){
+    return readRoot(b, doc) && readContent(b, doc, NULL, NULL);
+}
+
+GPXdoc* buildGPXdoc(xmlTextReaderPtr reader, unsigned int options){
+    if (reader == NULL){
+        return NULL;
+    }
+
+    Builder b = {reader, NULL, {NULL, 0, 0}, (options & GPX_OPT_TYPED_ONLY) != 0,
+                 (options & GPX_OPT_SHARED_NAMES) != 0, false, NULL};
+    GPXdoc* doc = NULL;
+
+    if (options & GPX_OPT_ARENA){
+        b.arena = createGPXArena(0);
+        doc = b.arena != NULL ? createArenaGPXdoc(b.arena) : NULL;
+        if (doc == NULL){
+            deleteGPXArena(b.arena);
+        }
+    }else{
+        doc = createEmptyGPXdoc();
+        //Without a pool the document is still built, with a node per malloc
+        b.pool = doc != NULL && (options & GPX_OPT_NODE_POOL) ? createNodePool(0) : NULL;
+        if (b.pool != NULL){
+            setListNodePool(doc->waypoints, b.pool);
+            setListNodePool(doc->routes, b.pool);
+            setListNodePool(doc->tracks, b.pool);
+        }
+    }
+
+    bool ok = doc != NULL && readDocument(&b, doc);
+
+    //The document's lists keep the pool alive
+    deleteNodePool(b.pool);
+    xmlFreeTextReader(b.reader);
+    free(b.text.str);
+
+    if (!ok){
+        deleteGPXdoc(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+//Creates an empty document to read an appended tail into, allocated the same way as doc
+static GPXdoc* createScratchGPXdoc(Builder* b){
+    if (b->arena != NULL){
+        return createArenaGPXdoc(b->arena);
+    }
+
+    GPXdoc* scratch = createEmptyGPXdoc();
+    if (scratch != NULL){
+        setListNodePool(scratch->waypoints, b->pool);
+        setListNodePool(scratch->routes, b->pool);
+        setListNodePool(scratch->tracks, b->pool);
+    }
+    return scratch;
+}
+
+/* Moves what was read into scratch, trk and seg to the end of doc, trk into the last track of doc and seg
+   into that track's last segment.  Only nodes are relinked, so this cannot fail once the name is set:
+   every list of the document draws its nodes from the same pool as the scratch lists */
+static bool spliceContent(Builder* b, GPXdoc* doc, GPXdoc* scratch, Track* trk, TrackSegment* seg){
+    if (trk != NULL){
+        Track* last = getFromBack(doc->tracks);
+
+        if (trk->name[0] != '\0' && !setName(b, &last->name, trk->name)){
+            return false;
+        }
+        if (seg != NULL){
+            TrackSegment* lastSeg = getFromBack(last->segments);
+            moveListElements(lastSeg->waypoints, seg->waypoints);
+            mergeBounds(&lastSeg->bounds, &seg->bounds);
+        }
+        moveListElements(last->segments, trk->segments);
+        moveListElements(last->otherData, trk->otherData);
+        mergeBounds(&last->bounds, &trk->bounds);
+    }
+
+    moveListElements(doc->waypoints, scratch->waypoints);
+    moveListElements(doc->routes, scratch->routes);
+    moveListElements(doc->tracks, scratch->tracks);
+    return true;
+}
+
+bool appendGPXdoc(xmlTextReaderPtr reader, GPXdoc* doc, int continueDepth, unsigned int options){
+    if (reader == NULL){
+        return false;
+    }
+
+    Builder b = {reader, doc->arena, {NULL, 0, 0}, (options & GPX_OPT_TYPED_ONLY) != 0,
+                 (options & GPX_OPT_SHARED_NAMES) != 0, false, doc->waypoints->pool};
+    Track* last = getFromBack(doc->tracks);
+    bool ok = continueDepth == 0 || (last != NULL && (continueDepth == 1 || getFromBack(last->segments) != NULL));
+
+    //The tail is read on its own and only added to doc once all of it has been read
+    GPXdoc* scratch = ok ? createScratchGPXdoc(&b) : NULL;
+    Track* trk = scratch != NULL && continueDepth > 0 ? newTrack(&b) : NULL;
+    TrackSegment* seg = trk != NULL && continueDepth > 1 ? newTrackSegment(&b) : NULL;
+
+    ok = scratch != NULL && (continueDepth == 0 || trk != NULL) && (continueDepth < 2 || seg != NULL);
+    ok = ok && findRoot(reader) && readContent(&b, scratch, trk, seg) && spliceContent(&b, doc, scratch, trk, seg);
+
+    //Arena objects are freed with doc's arena
+    if (b.arena == NULL){
+        deleteGPXdoc(scratch);
+        if (trk != NULL){
+            deleteTrack(trk);
+        }
+        if (seg != NULL){
+            deleteTrackSegment(seg);
+        }
+    }
+    xmlFreeTextReader(b.reader);
+    free(b.text.str);
+    return ok;
+}
+
+bool readGPXPoints(xmlTextReaderPtr reader, GPXdoc* doc, Route* rte, Track* trk, unsigned int options){
+    if (reader == NULL){
+        return false;
+    }
+
+    //The points are read into a scratch element and only moved over once the whole input has been read
+    Builder b = {reader, doc->arena, {NULL, 0, 0}, (options & GPX_OPT_TYPED_ONLY) != 0,
+                 (options & GPX_OPT_SHARED_NAMES) != 0, true, doc->waypoints->pool};
+    Route* scratchRte = rte != NULL ? newRoute(&b) : NULL;
+    Track* scratchTrk = rte == NULL ? newTrack(&b) : NULL;
+    bool ok = (scratchRte != NULL || scratchTrk != NULL) && findRoot(reader) && nextChildElement(reader, 0) == 1;
+
+    if (ok && rte != NULL){
+        ok = localNameIs(reader, "rte") && readRouteInto(&b, scratchRte);
+    }else if (ok){
+        ok = localNameIs(reader, "trk") && readTrackInto(&b, scratchTrk, NULL);
+    }
+    ok = ok && finishReading(reader);
+
+    if (ok && rte != NULL){
+        moveListElements(rte->waypoints, scratchRte->waypoints);
+        mergeBounds(&rte->bounds, &scratchRte->bounds);
+    }else if (ok){
+        moveListElements(trk->segments, scratchTrk->segments);
+        mergeBounds(&trk->bounds, &scratchTrk->bounds);
+    }
+    if (scratchRte != NULL){
+        discard(&b, &deleteRoute, scratchRte);
+    }
+    if (scratchTrk != NULL){
+        discard(&b, &deleteTrack, scratchTrk);
+    }
+
+    xmlFreeTextReader(b.reader);
+    free(b.text.str);
+    return ok;
+}
+
+GPXdoc* createGPXdocWithOptions(char* fileName, unsigned int options){
+    if (fileName == NULL || fileName[0] == '\0'){
+        return NULL;
+    }
+
+    if (options & GPX_OPT_LAZY){
+        return createLazyGPXdoc(fileName, options);
+    }
+
+    MappedFile file;
+    if (!(options & (GPX_OPT_MMAP | GPX_OPT_PARALLEL)) || !mapGPXFile(fileName, &file)){
+        return buildGPXdoc(xmlReaderForFile(fileName, NULL, 0), options);
+    }
+
+    GPXdoc* doc = NULL;
+    if (options & GPX_OPT_PARALLEL){
+        doc = parseGPXParallel(file.data, file.size, fileName, options, 0);
+    }else if (file.size <= INT_MAX){
+        doc = buildGPXdoc(xmlReaderForMemory(file.data, file.size, fileName, NULL, 0), options);
+    }else{
+        doc = buildGPXdoc(xmlReaderForFile(fileName, NULL, 0), options);
+    }
+
+    unmapGPXFile(&file);
+    return doc;
+}
+
+GPXdoc* createGPXdocFromMemory(const char* buffer, size_t length, unsigned int options){
+    if (buffer == NULL || length == 0){
+        return NULL;
+    }
+
+    if (options & GPX_OPT_PARALLEL){
+        return parseGPXParallel(buffer, length, NULL, options, 0);
+    }
+    if (length > INT_MAX){
+        return NULL;
+    }
+    return buildGPXdoc(xmlReaderForMemory(buffer, length, NULL, NULL, 0), options);
+}
+
+GPXdoc* createGPXdocStreaming(char* fileName){
+    return createGPXdocWithOptions(fileName, 0);
+}
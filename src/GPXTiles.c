@@ -0,0 +1,815 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "GPXTiles.h"
+#include "GPXLazy.h"
+#include "GPXWorkers.h"
+#include "GPXDistance.h"
+#include "GPXHelpers.h"
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+//Latitude of the north edge of tile 0/0/0, where Web Mercator y is 0
+#define MAX_LATITUDE 85.05112877980659
+
+#define TILE_MAGIC "GPXT"
+
+/* Geometry is kept in Web Mercator coordinates from 0 to 1 on both axes, so that at zoom z a point is
+   in tile (floor(x * 2^z), floor(y * 2^z)).  A line segment at zoom z joins two consecutive points that
+   are kept at that zoom, and is named by the index of its first point within its feature. */
+
+//A waypoint, route or track segment, with its points at first to first + count - 1 in the pyramid's arrays
+typedef struct {
+    GPXTileFeatureKind kind;
+    int source;
+    int part;
+    const char* name;
+
+    //The list the points come from.  NULL for waypoints
+    List* waypoints;
+    int first;
+    int count;
+
+    //Ground size of a tile unit at zoom 0, at the latitude of the feature that is farthest from the
+    //equator, where the units are smallest
+    double unitMetres;
+} Feature;
+
+//A line segment or waypoint that is at least partly inside a buffered tile
+typedef struct {
+    //x in the high half, y in the low half
+    uint64_t tile;
+    uint32_t feature;
+    uint32_t segment;
+} Crossing;
+
+typedef struct {
+    Crossing* items;
+    size_t count;
+    size_t capacity;
+} CrossingList;
+
+typedef struct {
+    int zoom;
+    uint32_t x;
+    uint32_t y;
+    const Crossing* crossings;
+    size_t numCrossings;
+} Tile;
+
+typedef struct {
+    const GPXTileOptions* options;
+    const char* directory;
+
+    int numFeatures;
+    Feature* features;
+
+    //Projected coordinates and simplification rank of every point
+    int numPoints;
+    double* x;
+    double* y;
+    double* rank;
+
+    //One sorted list per zoom, minZoom first
+    CrossingList* crossings;
+
+    size_t numTiles;
+    Tile* tiles;
+
+    atomic_bool failed;
+    _Atomic long long numTilesWritten;
+    _Atomic long long numFeaturesWritten;
+    _Atomic long long numPointsWritten;
+    _Atomic long long numBytesWritten;
+} Pyramid;
+
+//A growable byte buffer.  failed is set when malloc fails, and later writes are ignored
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} Blob;
+
+void initGPXTileOptions(GPXTileOptions* options){
+    if (options == NULL){
+        return;
+    }
+
+    options->minZoom = 0;
+    options->maxZoom = 14;
+    options->extent = 4096;
+    options->buffer = 64;
+    options->tolerance = 4.0;
+    options->method = GPX_SIMPLIFY_DOUGLAS_PEUCKER;
+    options->numThreads = 0;
+}
+
+static bool isValidOptions(const GPXTileOptions* options){
+    return options->minZoom >= 0 && options->minZoom <= options->maxZoom && options->maxZoom <= GPX_TILE_MAX_ZOOM &&
+           options->extent >= 16 && options->extent <= 65536 && options->buffer >= 0 &&
+           options->buffer <= options->extent && options->tolerance >= 0 && isfinite(options->tolerance) &&
+           (options->method == GPX_SIMPLIFY_DOUGLAS_PEUCKER || options->method == GPX_SIMPLIFY_VISVALINGAM);
+}
+
+/* ******************************* Projection *************************** */
+
+static double clampLatitude(double latitude){
+    return latitude > MAX_LATITUDE ? MAX_LATITUDE : latitude < -MAX_LATITUDE ? -MAX_LATITUDE : latitude;
+}
+
+static double projectX(double longitude){
+    return (longitude + 180.0) / 360.0;
+}
+
+static double projectY(double latitude){
+    return 0.5 - log(tan(M_PI / 4 + clampLatitude(latitude) * DEG_TO_RAD / 2)) / (2 * M_PI);
+}
+
+static bool isFinitePoint(const Waypoint* wpt){
+    return isfinite(wpt->latitude) && isfinite(wpt->longitude);
+}
+
+//Appends the finite points of a list to the pyramid's arrays and sets the feature's range and unit size
+static void addLine(Pyramid* p, Feature* feature, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    const Waypoint* wpt;
+    double farthest = 0.0;
+
+    feature->waypoints = waypoints;
+    feature->first = p->numPoints;
+    while ((wpt = nextElement(&iter)) != NULL){
+        if (isFinitePoint(wpt)){
+            p->x[p->numPoints] = projectX(wpt->longitude);
+            p->y[p->numPoints] = projectY(wpt->latitude);
+            p->numPoints++;
+            farthest = fabs(wpt->latitude) > farthest ? fabs(wpt->latitude) : farthest;
+        }
+    }
+    feature->count = p->numPoints - feature->first;
+    feature->unitMetres = 2 * M_PI * EARTH_RADIUS * cos(clampLatitude(farthest) * DEG_TO_RAD) / p->options->extent;
+}
+
+//Walks the document once, collecting its features and projecting their points.  Returns false if malloc fails
+static bool collectFeatures(Pyramid* p, const GPXdoc* doc){
+    long long numPoints = getLength(doc->waypoints);
+    int numFeatures = getLength(doc->waypoints) + getLength(doc->routes);
+
+    ListIterator iter = createIterator(doc->routes);
+    Route* rte;
+    while ((rte = nextElement(&iter)) != NULL){
+        numPoints += getLength(rte->waypoints);
+    }
+
+    iter = createIterator(doc->tracks);
+    Track* trk;
+    while ((trk = nextElement(&iter)) != NULL){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        numFeatures += getLength(trk->segments);
+        while ((seg = nextElement(&segIter)) != NULL){
+            numPoints += getLength(seg->waypoints);
+        }
+    }
+    if (numPoints >= UINT32_MAX / 2){
+        return false;
+    }
+
+    p->features = gpxAllocArray(numFeatures, sizeof(Feature));
+    p->x = gpxAllocArray(numPoints, sizeof(double));
+    p->y = gpxAllocArray(numPoints, sizeof(double));
+    p->rank = gpxAllocArray(numPoints, sizeof(double));
+    if (p->features == NULL || p->x == NULL || p->y == NULL || p->rank == NULL){
+        return false;
+    }
+
+    iter = createIterator(doc->waypoints);
+    Waypoint* wpt;
+    for (int i = 0; (wpt = nextElement(&iter)) != NULL; i++){
+        if (isFinitePoint(wpt)){
+            p->x[p->numPoints] = projectX(wpt->longitude);
+            p->y[p->numPoints] = projectY(wpt->latitude);
+            p->rank[p->numPoints] = INFINITY;
+            p->features[p->numFeatures++] = (Feature){GPX_TILE_WAYPOINT, i, 0, wpt->name, NULL, p->numPoints++, 1, 0.0};
+        }
+    }
+
+    iter = createIterator(doc->routes);
+    for (int i = 0; (rte = nextElement(&iter)) != NULL; i++){
+        Feature* feature = &p->features[p->numFeatures++];
+
+        *feature = (Feature){GPX_TILE_ROUTE, i, 0, rte->name, NULL, 0, 0, 0.0};
+        addLine(p, feature, rte->waypoints);
+    }
+
+    iter = createIterator(doc->tracks);
+    for (int i = 0; (trk = nextElement(&iter)) != NULL; i++){
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+
+        for (int part = 0; (seg = nextElement(&segIter)) != NULL; part++){
+            Feature* feature = &p->features[p->numFeatures++];
+
+            *feature = (Feature){GPX_TILE_TRACK, i, part, trk->name, NULL, 0, 0, 0.0};
+            addLine(p, feature, seg->waypoints);
+        }
+    }
+    return true;
+}
+
+//Points of a line ranked above this are kept at the zoom
+static double getZoomTolerance(const Pyramid* p, const Feature* feature, int zoom){
+    return ldexp(p->options->tolerance * feature->unitMetres, -zoom);
+}
+
+static void rankFeature(void* userData, int index){
+    Pyramid* p = userData;
+    const Feature* feature = &p->features[index];
+
+    if (feature->kind != GPX_TILE_WAYPOINT){
+        double minTolerance = getZoomTolerance(p, feature, p->options->maxZoom);
+
+        if (rankWaypoints(feature->waypoints, p->options->method, minTolerance, &p->rank[feature->first]) != feature->count){
+            atomic_store(&p->failed, true);
+        }
+    }
+}
+
+/* ******************************* Finding the tiles *************************** */
+
+/* Liang-Barsky: narrows [*t0, *t1] to the part of the segment from (px, py) to (qx, qy) that is inside
+   the box.  Returns false if no part of it is.  The box is closed, so touching an edge counts. */
+static bool clipToBox(double px, double py, double qx, double qy, double minX, double minY, double maxX, double maxY,
+                      double* t0, double* t1){
+    double dx = qx - px;
+    double dy = qy - py;
+    double edgeP[4] = {-dx, dx, -dy, dy};
+    double edgeQ[4] = {px - minX, maxX - px, py - minY, maxY - py};
+
+    *t0 = 0.0;
+    *t1 = 1.0;
+    for (int i = 0; i < 4; i++){
+        if (edgeP[i] == 0){
+            if (edgeQ[i] < 0){
+                return false;
+            }
+            continue;
+        }
+
+        double t = edgeQ[i] / edgeP[i];
+        if (edgeP[i] < 0){
+            *t0 = t > *t0 ? t : *t0;
+        }else{
+            *t1 = t < *t1 ? t : *t1;
+        }
+    }
+    return *t0 <= *t1;
+}
+
+static void addCrossing(CrossingList* list, uint32_t x, uint32_t y, uint32_t feature, uint32_t segment, atomic_bool* failed){
+    if (list->count == list->capacity){
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 1024;
+        Crossing* tmp = realloc(list->items, sizeof(Crossing) * capacity);
+
+        if (tmp == NULL){
+            atomic_store(failed, true);
+            return;
+        }
+        list->items = tmp;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = (Crossing){(uint64_t)x << 32 | y, feature, segment};
+}
+
+//Tile column or row of a coordinate scaled to the zoom, in [0, numTiles)
+static int tileOf(double coordinate, int numTiles){
+    int tile = (int)floor(coordinate);
+    return tile < 0 ? 0 : tile >= numTiles ? numTiles - 1 : tile;
+}
+
+//Adds the tiles whose buffered box holds the waypoint.  Coordinates are scaled to the zoom
+static void addPointTiles(CrossingList* list, uint32_t feature, double x, double y, int numTiles, double pad, atomic_bool* failed){
+    for (int ty = tileOf(y - pad, numTiles); ty <= tileOf(y + pad, numTiles); ty++){
+        for (int tx = tileOf(x - pad, numTiles); tx <= tileOf(x + pad, numTiles); tx++){
+            addCrossing(list, tx, ty, feature, 0, failed);
+        }
+    }
+}
+
+/* Adds the tiles whose buffered box the segment crosses.  The tiles the segment itself passes through
+   are walked in order (Amanatides and Woo), and since the buffer is at most one tile, the only other
+   candidates are their neighbours, which are checked with an exact clip.  The same tile may be added
+   more than once. */
+static void addSegmentTiles(CrossingList* list, uint32_t feature, uint32_t segment, double px, double py, double qx, double qy,
+                            int numTiles, double pad, atomic_bool* failed){
+    int tx = tileOf(px, numTiles);
+    int ty = tileOf(py, numTiles);
+    int steps = abs(tileOf(qx, numTiles) - tx) + abs(tileOf(qy, numTiles) - ty);
+    double dx = qx - px;
+    double dy = qy - py;
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    double deltaX = dx != 0 ? 1 / fabs(dx) : INFINITY;
+    double deltaY = dy != 0 ? 1 / fabs(dy) : INFINITY;
+    double nextX = dx > 0 ? (tx + 1 - px) / dx : dx < 0 ? (px - tx) / -dx : INFINITY;
+    double nextY = dy > 0 ? (ty + 1 - py) / dy : dy < 0 ? (py - ty) / -dy : INFINITY;
+    double minX = fmin(px, qx) - pad;
+    double minY = fmin(py, qy) - pad;
+    double maxX = fmax(px, qx) + pad;
+    double maxY = fmax(py, qy) + pad;
+
+    //Most segments are short and well inside one tile
+    if (steps == 0 && minX > tx && minY > ty && maxX < tx + 1 && maxY < ty + 1){
+        addCrossing(list, tx, ty, feature, segment, failed);
+        return;
+    }
+
+    for (int i = 0; ; i++){
+        addCrossing(list, tx, ty, feature, segment, failed);
+        for (int ny = ty - 1; ny <= ty + 1; ny++){
+            for (int nx = tx - 1; nx <= tx + 1; nx++){
+                double t0, t1;
+
+                if ((nx != tx || ny != ty) && nx >= 0 && ny >= 0 && nx < numTiles && ny < numTiles &&
+                    minX <= nx + 1 && minY <= ny + 1 && maxX >= nx && maxY >= ny &&
+                    clipToBox(px, py, qx, qy, nx - pad, ny - pad, nx + 1 + pad, ny + 1 + pad, &t0, &t1)){
+                    addCrossing(list, nx, ny, feature, segment, failed);
+                }
+            }
+        }
+
+        if (i == steps){
+            break;
+        }
+        if (nextX < nextY){
+            tx += stepX;
+            nextX += deltaX;
+        }else{
+            ty += stepY;
+            nextY += deltaY;
+        }
+        tx = tx < 0 ? 0 : tx >= numTiles ? numTiles - 1 : tx;
+        ty = ty < 0 ? 0 : ty >= numTiles ? numTiles - 1 : ty;
+    }
+}
+
+static bool isSameCrossing(const Crossing* a, const Crossing* b){
+    return a->tile == b->tile && a->feature == b->feature && a->segment == b->segment;
+}
+
+/* Sorts crossings by tile with a stable radix sort, 11 bits of the tile's x and y per pass.  Crossings
+   are found in feature and segment order, so stability leaves each tile's crossings in that order too.
+   Returns false if malloc fails. */
+static bool sortCrossings(CrossingList* list, int zoom){
+    int keyBits = 2 * zoom;
+    uint64_t mask = ((uint64_t)1 << zoom) - 1;
+    Crossing* from = list->items;
+    Crossing* to = keyBits > 0 ? malloc(sizeof(Crossing) * (list->count + 1)) : NULL;
+    size_t counts[1 << 11];
+
+    if (keyBits > 0 && to == NULL){
+        return false;
+    }
+
+    for (int shift = 0; shift < keyBits; shift += 11){
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < list->count; i++){
+            uint64_t key = (from[i].tile >> 32) << zoom | (from[i].tile & mask);
+            counts[(key >> shift) & 0x7ff]++;
+        }
+
+        size_t total = 0;
+        for (int d = 0; d < 1 << 11; d++){
+            size_t count = counts[d];
+            counts[d] = total;
+            total += count;
+        }
+        for (size_t i = 0; i < list->count; i++){
+            uint64_t key = (from[i].tile >> 32) << zoom | (from[i].tile & mask);
+            to[counts[(key >> shift) & 0x7ff]++] = from[i];
+        }
+
+        Crossing* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    //from holds the sorted crossings; to is the other buffer, if there is one
+    if (from != list->items){
+        list->capacity = list->count + 1;
+    }
+    list->items = from;
+    free(to);
+    return true;
+}
+
+//Index of the first point after point i of the feature that is kept at the tolerance.  The last point
+//of a line is always kept
+static int nextKept(const Pyramid* p, const Feature* feature, int i, double tolerance){
+    int last = feature->first + feature->count - 1;
+
+    i++;
+    while (i < last && !(p->rank[i] > tolerance)){
+        i++;
+    }
+    return i;
+}
+
+//Finds, sorts and deduplicates the crossings of one zoom
+static void findCrossings(void* userData, int index){
+    Pyramid* p = userData;
+    int zoom = p->options->minZoom + index;
+    int numTiles = 1 << zoom;
+    double scale = numTiles;
+    double pad = (double)p->options->buffer / p->options->extent;
+    CrossingList* list = &p->crossings[index];
+
+    for (int f = 0; f < p->numFeatures && !atomic_load(&p->failed); f++){
+        const Feature* feature = &p->features[f];
+
+        if (feature->kind == GPX_TILE_WAYPOINT){
+            addPointTiles(list, f, p->x[feature->first] * scale, p->y[feature->first] * scale, numTiles, pad, &p->failed);
+            continue;
+        }
+
+        double tolerance = getZoomTolerance(p, feature, zoom);
+        int last = feature->first + feature->count - 1;
+        for (int i = feature->first; i < last; ){
+            int j = nextKept(p, feature, i, tolerance);
+
+            addSegmentTiles(list, f, i - feature->first, p->x[i] * scale, p->y[i] * scale, p->x[j] * scale,
+                            p->y[j] * scale, numTiles, pad, &p->failed);
+            i = j;
+        }
+    }
+
+    if (!sortCrossings(list, zoom)){
+        atomic_store(&p->failed, true);
+        return;
+    }
+
+    //A segment can reach the same tile from several of the tiles it passes through
+    size_t unique = 0;
+    for (size_t i = 0; i < list->count; i++){
+        if (unique == 0 || !isSameCrossing(&list->items[unique - 1], &list->items[i])){
+            list->items[unique++] = list->items[i];
+        }
+    }
+    list->count = unique;
+}
+
+//Splits the sorted crossings of every zoom into tiles.  Returns false if malloc fails
+static bool listTiles(Pyramid* p){
+    int numZooms = p->options->maxZoom - p->options->minZoom + 1;
+
+    for (int pass = 0; pass < 2; pass++){
+        p->numTiles = 0;
+        for (int z = 0; z < numZooms; z++){
+            const CrossingList* list = &p->crossings[z];
+
+            for (size_t i = 0; i < list->count; ){
+                size_t end = i + 1;
+                while (end < list->count && list->items[end].tile == list->items[i].tile){
+                    end++;
+                }
+                if (pass == 1){
+                    uint64_t tile = list->items[i].tile;
+                    p->tiles[p->numTiles] = (Tile){p->options->minZoom + z, tile >> 32, (uint32_t)tile, &list->items[i], end - i};
+                }
+                p->numTiles++;
+                i = end;
+            }
+        }
+
+        if (pass == 0){
+            if (p->numTiles >= INT_MAX){
+                return false;
+            }
+            p->tiles = malloc(sizeof(Tile) * (p->numTiles + 1));
+            if (p->tiles == NULL){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* ******************************* Writing the tiles *************************** */
+
+static void putBytes(Blob* blob, const void* bytes, size_t length){
+    if (blob->failed){
+        return;
+    }
+    if (blob->capacity - blob->length < length){
+        size_t capacity = blob->capacity > 0 ? blob->capacity : 4096;
+        while (capacity - blob->length < length){
+            capacity *= 2;
+        }
+
+        unsigned char* tmp = realloc(blob->data, capacity);
+        if (tmp == NULL){
+            blob->failed = true;
+            return;
+        }
+        blob->data = tmp;
+        blob->capacity = capacity;
+    }
+    memcpy(blob->data + blob->length, bytes, length);
+    blob->length += length;
+}
+
+static void putVarint(Blob* blob, uint64_t value){
+    unsigned char bytes[10];
+    int length = 0;
+
+    while (value >= 0x80){
+        bytes[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = (unsigned char)value;
+    putBytes(blob, bytes, length);
+}
+
+static void putSigned(Blob* blob, int64_t value){
+    putVarint(blob, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+//The parts of one feature inside a tile, in tile units.  Part i is points partStart[i] to partStart[i + 1] - 1
+typedef struct {
+    int32_t* x;
+    int32_t* y;
+    int numPoints;
+    int capacity;
+    int* partStart;
+    int numParts;
+    int partCapacity;
+    bool failed;
+} Parts;
+
+static void addPartPoint(Parts* parts, double x, double y){
+    int32_t qx = (int32_t)lround(x);
+    int32_t qy = (int32_t)lround(y);
+    int start = parts->partStart[parts->numParts];
+
+    //Points that round to the one before them add nothing
+    if (parts->numPoints > start && parts->x[parts->numPoints - 1] == qx && parts->y[parts->numPoints - 1] == qy){
+        return;
+    }
+    if (parts->numPoints == parts->capacity){
+        int capacity = parts->capacity > 0 ? parts->capacity * 2 : 256;
+        int32_t* newX = realloc(parts->x, sizeof(int32_t) * capacity);
+        int32_t* newY = newX != NULL ? realloc(parts->y, sizeof(int32_t) * capacity) : NULL;
+
+        parts->x = newX != NULL ? newX : parts->x;
+        parts->y = newY != NULL ? newY : parts->y;
+        if (newX == NULL || newY == NULL){
+            parts->failed = true;
+            return;
+        }
+        parts->capacity = capacity;
+    }
+    parts->x[parts->numPoints] = qx;
+    parts->y[parts->numPoints] = qy;
+    parts->numPoints++;
+}
+
+//Ends the current part, dropping it if it has fewer than two points
+static void endPart(Parts* parts){
+    int start = parts->partStart[parts->numParts];
+
+    if (parts->numPoints - start < 2){
+        parts->numPoints = start;
+        return;
+    }
+    if (parts->numParts + 2 > parts->partCapacity){
+        int capacity = parts->partCapacity * 2;
+        int* tmp = realloc(parts->partStart, sizeof(int) * capacity);
+
+        if (tmp == NULL){
+            parts->failed = true;
+            parts->numPoints = start;
+            return;
+        }
+        parts->partStart = tmp;
+        parts->partCapacity = capacity;
+    }
+    parts->numParts++;
+    parts->partStart[parts->numParts] = parts->numPoints;
+}
+
+/* Clips the segments of a line that cross a tile.  Consecutive segments that stay inside the buffered
+   tile are joined into one part. */
+static void clipLine(const Pyramid* p, const Tile* tile, const Feature* feature, const Crossing* crossings, size_t count,
+                     Parts* parts){
+    double scale = ldexp(1.0, tile->zoom);
+    double extent = p->options->extent;
+    double buffer = p->options->buffer;
+    double tolerance = getZoomTolerance(p, feature, tile->zoom);
+    int joinAt = -1;
+
+    for (size_t c = 0; c < count; c++){
+        int i = feature->first + crossings[c].segment;
+        int j = nextKept(p, feature, i, tolerance);
+        double px = (p->x[i] * scale - tile->x) * extent;
+        double py = (p->y[i] * scale - tile->y) * extent;
+        double qx = (p->x[j] * scale - tile->x) * extent;
+        double qy = (p->y[j] * scale - tile->y) * extent;
+        double t0, t1;
+
+        if (!clipToBox(px, py, qx, qy, -buffer, -buffer, extent + buffer, extent + buffer, &t0, &t1)){
+            continue;
+        }
+        if (i != joinAt || t0 > 0){
+            endPart(parts);
+            addPartPoint(parts, px + t0 * (qx - px), py + t0 * (qy - py));
+        }
+        addPartPoint(parts, px + t1 * (qx - px), py + t1 * (qy - py));
+        joinAt = t1 < 1 ? -1 : j;
+    }
+    endPart(parts);
+}
+
+static void putFeatureHeader(Blob* blob, const Feature* feature, int numParts){
+    const char* name = feature->name != NULL ? feature->name : "";
+    size_t length = strlen(name);
+
+    putVarint(blob, feature->kind);
+    putVarint(blob, feature->source);
+    putVarint(blob, feature->part);
+    putVarint(blob, length);
+    putBytes(blob, name, length);
+    putVarint(blob, numParts);
+}
+
+//Creates <directory>/<zoom>/<x> and returns the path of the tile file.  Returns false if a directory
+//could not be created
+static bool makeTilePath(const Pyramid* p, const Tile* tile, char* path, size_t size){
+    snprintf(path, size, "%s/%d/%u", p->directory, tile->zoom, tile->x);
+    if (mkdir(path, 0777) != 0 && errno != EEXIST){
+        return false;
+    }
+    return snprintf(path, size, "%s/%d/%u/%u.gpxt", p->directory, tile->zoom, tile->x, tile->y) < (int)size;
+}
+
+static void writeTile(void* userData, int index){
+    Pyramid* p = userData;
+    const Tile* tile = &p->tiles[index];
+    double scale = ldexp(1.0, tile->zoom);
+    double extent = p->options->extent;
+    Blob body = {NULL, 0, 0, false};
+    Parts parts = {NULL, NULL, 0, 0, malloc(sizeof(int) * 16), 0, 16, false};
+    long long numFeatures = 0;
+    long long numPoints = 0;
+    int64_t lastX = 0;
+    int64_t lastY = 0;
+
+    if (parts.partStart == NULL || atomic_load(&p->failed)){
+        atomic_store(&p->failed, true);
+        free(parts.partStart);
+        return;
+    }
+
+    for (size_t c = 0; c < tile->numCrossings; ){
+        const Feature* feature = &p->features[tile->crossings[c].feature];
+        size_t end = c + 1;
+        while (end < tile->numCrossings && tile->crossings[end].feature == tile->crossings[c].feature){
+            end++;
+        }
+
+        parts.numPoints = 0;
+        parts.numParts = 0;
+        parts.partStart[0] = 0;
+        if (feature->kind == GPX_TILE_WAYPOINT){
+            addPartPoint(&parts, (p->x[feature->first] * scale - tile->x) * extent, (p->y[feature->first] * scale - tile->y) * extent);
+            parts.numParts = 1;
+            parts.partStart[1] = 1;
+        }else{
+            clipLine(p, tile, feature, &tile->crossings[c], end - c, &parts);
+        }
+        c = end;
+
+        if (parts.numParts == 0 || parts.failed){
+            continue;
+        }
+        putFeatureHeader(&body, feature, parts.numParts);
+        for (int part = 0; part < parts.numParts; part++){
+            putVarint(&body, parts.partStart[part + 1] - parts.partStart[part]);
+            for (int i = parts.partStart[part]; i < parts.partStart[part + 1]; i++){
+                putSigned(&body, parts.x[i] - lastX);
+                putSigned(&body, parts.y[i] - lastY);
+                lastX = parts.x[i];
+                lastY = parts.y[i];
+            }
+        }
+        numFeatures++;
+        numPoints += parts.numPoints;
+        lastX = 0;
+        lastY = 0;
+    }
+
+    bool ok = !body.failed && !parts.failed;
+    if (ok && numFeatures > 0){
+        Blob header = {NULL, 0, 0, false};
+        char path[4096];
+
+        putBytes(&header, TILE_MAGIC, 4);
+        putVarint(&header, GPX_TILE_VERSION);
+        putVarint(&header, tile->zoom);
+        putVarint(&header, tile->x);
+        putVarint(&header, tile->y);
+        putVarint(&header, p->options->extent);
+        putVarint(&header, numFeatures);
+
+        FILE* file = !header.failed && makeTilePath(p, tile, path, sizeof(path)) ? fopen(path, "wb") : NULL;
+        ok = file != NULL && fwrite(header.data, 1, header.length, file) == header.length &&
+             fwrite(body.data, 1, body.length, file) == body.length;
+        ok = file != NULL && fclose(file) == 0 && ok;
+
+        if (ok){
+            atomic_fetch_add(&p->numTilesWritten, 1);
+            atomic_fetch_add(&p->numFeaturesWritten, numFeatures);
+            atomic_fetch_add(&p->numPointsWritten, numPoints);
+            atomic_fetch_add(&p->numBytesWritten, (long long)(header.length + body.length));
+        }
+        free(header.data);
+    }
+    if (!ok){
+        atomic_store(&p->failed, true);
+    }
+
+    free(body.data);
+    free(parts.x);
+    free(parts.y);
+    free(parts.partStart);
+}
+
+//Creates the directory and one subdirectory per zoom that has tiles
+static bool makeZoomDirectories(const Pyramid* p){
+    char path[4096];
+
+    if (mkdir(p->directory, 0777) != 0 && errno != EEXIST){
+        return false;
+    }
+    for (int z = 0; z <= p->options->maxZoom - p->options->minZoom; z++){
+        if (p->crossings[z].count == 0){
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s/%d", p->directory, p->options->minZoom + z) >= (int)sizeof(path) ||
+            (mkdir(path, 0777) != 0 && errno != EEXIST)){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeGPXTiles(const GPXdoc* doc, const char* directory, const GPXTileOptions* options, GPXTileStats* stats){
+    if (doc == NULL || directory == NULL || options == NULL || !isValidOptions(options) || !loadGPXdoc((GPXdoc*)doc)){
+        return false;
+    }
+
+    int numZooms = options->maxZoom - options->minZoom + 1;
+    Pyramid p;
+
+    memset(&p, 0, sizeof(Pyramid));
+    p.options = options;
+    p.directory = directory;
+    atomic_init(&p.failed, false);
+    atomic_init(&p.numTilesWritten, 0);
+    atomic_init(&p.numFeaturesWritten, 0);
+    atomic_init(&p.numPointsWritten, 0);
+    atomic_init(&p.numBytesWritten, 0);
+    p.crossings = calloc(numZooms, sizeof(CrossingList));
+
+    bool ok = p.crossings != NULL && collectFeatures(&p, doc);
+    if (ok){
+        runGPXTasks(p.numFeatures, options->numThreads, &rankFeature, &p);
+        runGPXTasks(numZooms, options->numThreads, &findCrossings, &p);
+        ok = !atomic_load(&p.failed) && listTiles(&p) && makeZoomDirectories(&p);
+    }
+    if (ok){
+        runGPXTasks((int)p.numTiles, options->numThreads, &writeTile, &p);
+        ok = !atomic_load(&p.failed);
+    }
+
+    if (stats != NULL){
+        stats->numTiles = atomic_load(&p.numTilesWritten);
+        stats->numFeatures = atomic_load(&p.numFeaturesWritten);
+        stats->numPoints = atomic_load(&p.numPointsWritten);
+        stats->numBytes = atomic_load(&p.numBytesWritten);
+    }
+
+    for (int z = 0; p.crossings != NULL && z < numZooms; z++){
+        free(p.crossings[z].items);
+    }
+    free(p.crossings);
+    free(p.tiles);
+    free(p.features);
+    free(p.x);
+    free(p.y);
+    free(p.rank);
+    return ok;
+}
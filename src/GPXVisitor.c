@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include "GPXVisitor.h"
+#include "GPXHelpers.h"
+
+//Traversal state.  The buffers are reused for every element, so a visit performs a fixed number of allocations
+typedef struct {
+    xmlTextReaderPtr reader;
+    const GPXVisitor* visitor;
+    StringBuilder text;
+    StringBuilder name;
+} VisitState;
+
+//Reads the child element the reader is positioned on into a name buffer or the gpxData callback
+static bool visitChildData(VisitState* state, StringBuilder* name, GPXPoint* point){
+    bool isName = localNameIs(state->reader, "name");
+    bool isEle = point != NULL && localNameIs(state->reader, "ele");
+    bool isTime = point != NULL && localNameIs(state->reader, "time");
+    char element[256];
+
+    //The local name is only valid until the reader moves on
+    strncpy(element, (const char*)xmlTextReaderConstLocalName(state->reader), sizeof(element) - 1);
+    element[sizeof(element) - 1] = '\0';
+
+    if (!readElementText(state->reader, &state->text)){
+        return false;
+    }
+
+    const char* value = state->text.str;
+    if (isName){
+        name->len = 0;
+        return appendString(name, value);
+    }
+    if (value[0] == '\0'){
+        return true;
+    }
+
+    if (isEle){
+        point->hasElevation = parseGPXDouble(value, &point->elevation);
+    }else if (isTime){
+        point->hasTime = parseGPXTime(value, &point->time);
+    }
+    if (state->visitor->gpxData != NULL){
+        state->visitor->gpxData(state->visitor->userData, element, value);
+    }
+    return true;
+}
+
+//Reads a <wpt>, <rtept> or <trkpt> and reports it to callback
+static bool visitPoint(VisitState* state, void (*callback)(void* userData, const GPXPoint* point)){
+    xmlTextReaderPtr reader = state->reader;
+    GPXPoint point = {"", 0.0, 0.0, 0.0, false, 0, false};
+    char* lat = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"lat");
+    char* lon = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"lon");
+    bool ok = parseGPXDouble(lat, &point.latitude) && parseGPXDouble(lon, &point.longitude);
+
+    xmlFree(lat);
+    xmlFree(lon);
+
+    state->name.len = 0;
+    ok = ok && appendString(&state->name, "");
+
+    if (ok && !xmlTextReaderIsEmptyElement(reader)){
+        int depth = xmlTextReaderDepth(reader);
+        int status = 0;
+
+        while (ok && (status = nextChildElement(reader, depth)) == 1){
+            ok = visitChildData(state, &state->name, &point);
+        }
+        ok = ok && status == 0;
+    }
+
+    if (ok && callback != NULL){
+        point.name = state->name.str;
+        callback(state->visitor->userData, &point);
+    }
+    return ok;
+}
+
+//Reports the start of a route or track once, with the name collected so far
+static void announce(VisitState* state, bool* announced, void (*callback)(void* userData, const char* name)){
+    if (!*announced && callback != NULL){
+        callback(state->visitor->userData, state->name.str);
+    }
+    *announced = true;
+}
+
+static bool visitRoute(VisitState* state){
+    const GPXVisitor* visitor = state->visitor;
+    bool announced = false;
+    bool ok = true;
+
+    state->name.len = 0;
+    ok = appendString(&state->name, "");
+
+    if (ok && !xmlTextReaderIsEmptyElement(state->reader)){
+        int depth = xmlTextReaderDepth(state->reader);
+        int status = 0;
+
+        while (ok && (status = nextChildElement(state->reader, depth)) == 1){
+            if (localNameIs(state->reader, "rtept")){
+                announce(state, &announced, visitor->beginRoute);
+                ok = visitPoint(state, visitor->routePoint);
+            }else{
+                ok = visitChildData(state, &state->name, NULL);
+            }
+        }
+        ok = ok && status == 0;
+    }
+
+    if (ok){
+        announce(state, &announced, visitor->beginRoute);
+        if (visitor->endRoute != NULL){
+            visitor->endRoute(visitor->userData);
+        }
+    }
+    return ok;
+}
+
+static bool visitTrackSegment(VisitState* state){
+    const GPXVisitor* visitor = state->visitor;
+    bool ok = true;
+
+    if (visitor->beginSegment != NULL){
+        visitor->beginSegment(visitor->userData);
+    }
+
+    if (!xmlTextReaderIsEmptyElement(state->reader)){
+        int depth = xmlTextReaderDepth(state->reader);
+        int status = 0;
+
+        while (ok && (status = nextChildElement(state->reader, depth)) == 1){
+            if (localNameIs(state->reader, "trkpt")){
+                ok = visitPoint(state, visitor->trackPoint);
+            }else{
+                ok = skipElement(state->reader);
+            }
+        }
+        ok = ok && status == 0;
+    }
+
+    if (ok && visitor->endSegment != NULL){
+        visitor->endSegment(visitor->userData);
+    }
+    return ok;
+}
+
+static bool visitTrack(VisitState* state){
+    const GPXVisitor* visitor = state->visitor;
+    bool announced = false;
+    bool ok = true;
+
+    state->name.len = 0;
+    ok = appendString(&state->name, "");
+
+    if (ok && !xmlTextReaderIsEmptyElement(state->reader)){
+        int depth = xmlTextReaderDepth(state->reader);
+        int status = 0;
+
+        while (ok && (status = nextChildElement(state->reader, depth)) == 1){
+            if (localNameIs(state->reader, "trkseg")){
+                announce(state, &announced, visitor->beginTrack);
+                ok = visitTrackSegment(state);
+            }else{
+                ok = visitChildData(state, &state->name, NULL);
+            }
+        }
+        ok = ok && status == 0;
+    }
+
+    if (ok){
+        announce(state, &announced, visitor->beginTrack);
+        if (visitor->endTrack != NULL){
+            visitor->endTrack(visitor->userData);
+        }
+    }
+    return ok;
+}
+
+//Positions the reader on the <gpx> root element and checks the attributes createGPXdoc requires
+static bool visitRoot(xmlTextReaderPtr reader){
+    do {
+        if (xmlTextReaderRead(reader) != 1){
+            return false;
+        }
+    } while (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT);
+
+    const char* href = (const char*)xmlTextReaderConstNamespaceUri(reader);
+    if (!localNameIs(reader, "gpx") || href == NULL || href[0] == '\0' || strlen(href) >= sizeof(((GPXdoc*)0)->namespace)){
+        return false;
+    }
+
+    char* version = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"version");
+    char* creator = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"creator");
+    double value;
+    bool ok = parseGPXDouble(version, &value) && creator != NULL && creator[0] != '\0';
+
+    xmlFree(version);
+    xmlFree(creator);
+    return ok;
+}
+
+bool visitGPXFile(char* fileName, const GPXVisitor* visitor){
+    if (fileName == NULL || fileName[0] == '\0' || visitor == NULL){
+        return false;
+    }
+
+    VisitState state = {xmlReaderForFile(fileName, NULL, 0), visitor, {NULL, 0, 0}, {NULL, 0, 0}};
+    if (state.reader == NULL){
+        return false;
+    }
+
+    bool ok = visitRoot(state.reader);
+
+    if (ok && !xmlTextReaderIsEmptyElement(state.reader)){
+        int status = 0;
+
+        while (ok && (status = nextChildElement(state.reader, 0)) == 1){
+            if (localNameIs(state.reader, "wpt")){
+                ok = visitPoint(&state, visitor->waypoint);
+            }else if (localNameIs(state.reader, "rte")){
+                ok = visitRoute(&state);
+            }else if (localNameIs(state.reader, "trk")){
+                ok = visitTrack(&state);
+            }else{
+                ok = skipElement(state.reader);
+            }
+        }
+        ok = ok && status == 0;
+    }
+
+    ok = ok && finishReading(state.reader);
+
+    xmlFreeTextReader(state.reader);
+    free(state.text.str);
+    free(state.name.str);
+    return ok;
+}
+
+/* ******************************* Counting *************************** */
+
+static void countWaypoint(void* userData, const GPXPoint* point){
+    ((GPXCounts*)userData)->numWaypoints++;
+}
+
+static void countRoute(void* userData, const char* name){
+    ((GPXCounts*)userData)->numRoutes++;
+}
+
+static void countTrack(void* userData, const char* name){
+    ((GPXCounts*)userData)->numTracks++;
+}
+
+static void countSegment(void* userData){
+    ((GPXCounts*)userData)->numSegments++;
+}
+
+static void countGPXData(void* userData, const char* name, const char* value){
+    ((GPXCounts*)userData)->numGPXData++;
+}
+
+bool countGPXFile(char* fileName, GPXCounts* counts){
+    if (counts == NULL){
+        return false;
+    }
+
+    GPXCounts result = {0, 0, 0, 0, 0};
+    GPXVisitor visitor = {0};
+
+    visitor.userData = &result;
+    visitor.waypoint = &countWaypoint;
+    visitor.beginRoute = &countRoute;
+    visitor.beginTrack = &countTrack;
+    visitor.beginSegment = &countSegment;
+    visitor.gpxData = &countGPXData;
+
+    if (!visitGPXFile(fileName, &visitor)){
+        return false;
+    }
+
+    *counts = result;
+    return true;
+}
@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "GPXWorkers.h"
+
+/* A thread's remaining tasks [front, back) are packed into one 64-bit word, front in the high half,
+   so that the owner taking from the front and thieves taking from the back agree through a single
+   compare-and-swap. */
+typedef struct {
+    _Atomic uint64_t range;
+
+    //Keep queues on separate cache lines
+    char padding[64 - sizeof(uint64_t)];
+} TaskQueue;
+
+typedef struct {
+    TaskQueue* queues;
+    int numQueues;
+    void (*task)(void* userData, int index);
+    void* userData;
+} Pool;
+
+typedef struct {
+    Pool* pool;
+    int self;
+} Worker;
+
+static uint64_t packRange(uint32_t front, uint32_t back){
+    return ((uint64_t)front << 32) | back;
+}
+
+static bool takeFront(TaskQueue* queue, int* index){
+    uint64_t range = atomic_load(&queue->range);
+
+    for (;;){
+        uint32_t front = range >> 32;
+        uint32_t back = (uint32_t)range;
+
+        if (front >= back){
+            return false;
+        }
+        if (atomic_compare_exchange_weak(&queue->range, &range, packRange(front + 1, back))){
+            *index = front;
+            return true;
+        }
+    }
+}
+
+static bool takeBack(TaskQueue* queue, int* index){
+    uint64_t range = atomic_load(&queue->range);
+
+    for (;;){
+        uint32_t front = range >> 32;
+        uint32_t back = (uint32_t)range;
+
+        if (front >= back){
+            return false;
+        }
+        if (atomic_compare_exchange_weak(&queue->range, &range, packRange(front, back - 1))){
+            *index = back - 1;
+            return true;
+        }
+    }
+}
+
+//Tasks are never added once the pool starts, so a worker is done when every queue is empty
+static void* runWorker(void* arg){
+    Worker* worker = arg;
+    Pool* pool = worker->pool;
+    int index;
+
+    for (;;){
+        if (takeFront(&pool->queues[worker->self], &index)){
+            pool->task(pool->userData, index);
+            continue;
+        }
+
+        bool stole = false;
+        for (int i = 1; i < pool->numQueues && !stole; i++){
+            stole = takeBack(&pool->queues[(worker->self + i) % pool->numQueues], &index);
+        }
+        if (!stole){
+            return NULL;
+        }
+        pool->task(pool->userData, index);
+    }
+}
+
+int getGPXProcessorCount(void){
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+void runGPXTasks(int count, int numThreads, void (*task)(void* userData, int index), void* userData){
+    if (count <= 0){
+        return;
+    }
+    if (numThreads <= 0){
+        numThreads = getGPXProcessorCount();
+    }
+    if (numThreads > count){
+        numThreads = count;
+    }
+
+    TaskQueue* queues = numThreads > 1 ? aligned_alloc(64, numThreads * sizeof(TaskQueue)) : NULL;
+    Worker* workers = numThreads > 1 ? malloc(numThreads * sizeof(Worker)) : NULL;
+    pthread_t* threads = numThreads > 1 ? malloc(numThreads * sizeof(pthread_t)) : NULL;
+
+    if (queues == NULL || workers == NULL || threads == NULL){
+        //Single-threaded, or not enough memory to set up the pool
+        free(queues);
+        free(workers);
+        free(threads);
+        for (int i = 0; i < count; i++){
+            task(userData, i);
+        }
+        return;
+    }
+
+    Pool pool = {queues, numThreads, task, userData};
+    for (int i = 0; i < numThreads; i++){
+        uint32_t front = (uint64_t)count * i / numThreads;
+        uint32_t back = (uint64_t)count * (i + 1) / numThreads;
+
+        atomic_init(&queues[i].range, packRange(front, back));
+        workers[i].pool = &pool;
+        workers[i].self = i;
+    }
+
+    //Worker 0 is the calling thread
+    bool* started = calloc(numThreads, sizeof(bool));
+    for (int i = 1; i < numThreads && started != NULL; i++){
+        started[i] = pthread_create(&threads[i], NULL, &runWorker, &workers[i]) == 0;
+    }
+    runWorker(&workers[0]);
+
+    for (int i = 1; i < numThreads && started != NULL; i++){
+        if (started[i]){
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    free(started);
+    free(queues);
+    free(workers);
+    free(threads);
+}
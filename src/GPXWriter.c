@@ -0,0 +1,564 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "GPXWriter.h"
+#include "GPXHelpers.h"
+#include "GPXLazy.h"
+
+/* ******************************* Shared *************************** */
+
+//Passes data to the sink in pieces of at most GPX_WRITER_CHUNK bytes
+static bool sinkWrite(const GPXSink* sink, const char* data, size_t len){
+    while (len > 0){
+        size_t n = len < GPX_WRITER_CHUNK ? len : GPX_WRITER_CHUNK;
+
+        if (!sink->write(sink->userData, data, n)){
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+//Formats milliseconds since the epoch as an ISO 8601 UTC timestamp, with milliseconds only if there are any
+static void formatTime(char* buf, size_t size, long long time){
+    long long seconds = time / 1000;
+    int millis = (int)(time % 1000);
+    if (millis < 0){
+        seconds--;
+        millis += 1000;
+    }
+
+    time_t t = (time_t)seconds;
+    struct tm tm;
+    size_t len = 0;
+
+    //xsd:dateTime needs at least four digits of year, which strftime's %Y does not give before year 1000
+    if (gmtime_r(&t, &tm) != NULL){
+        long long year = tm.tm_year + 1900LL;
+        int n = snprintf(buf, size, "%s%04lld-%02d-%02dT%02d:%02d:%02d", year < 0 ? "-" : "", year < 0 ? -year : year,
+                         tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        len = n > 0 && (size_t)n < size ? (size_t)n : 0;
+    }
+
+    if (millis != 0){
+        snprintf(buf + len, size - len, ".%03dZ", millis);
+    }else{
+        snprintf(buf + len, size - len, "Z");
+    }
+}
+
+//Typed waypoint fields, in the order they are written.  ele, time and speed come before <name>, as in
+//the GPX 1.0 schema, and the rest after the elements in isBeforeSat
+static const struct {
+    unsigned int field;
+    const char* name;
+} typedFields[] = {
+    {GPX_FIELD_ELEVATION, "ele"}, {GPX_FIELD_TIME, "time"}, {GPX_FIELD_SPEED, "speed"},
+    {GPX_FIELD_SATELLITES, "sat"}, {GPX_FIELD_HDOP, "hdop"}, {GPX_FIELD_VDOP, "vdop"}, {GPX_FIELD_PDOP, "pdop"}
+};
+
+#define NUM_TYPED_FIELDS (sizeof(typedFields) / sizeof(typedFields[0]))
+#define TYPED_BEFORE_NAME (GPX_FIELD_ELEVATION | GPX_FIELD_TIME | GPX_FIELD_SPEED)
+
+//Formats a typed field of a waypoint parsed with GPX_OPT_TYPED_ONLY.  Returns false if the field's value
+//is in otherData instead, or the waypoint has none
+static bool formatTypedField(char* buf, size_t size, const Waypoint* wpt, unsigned int field){
+    if (!(wpt->fields & GPX_FIELD_TYPED_ONLY) || !(wpt->fields & field)){
+        return false;
+    }
+
+    switch (field){
+        case GPX_FIELD_ELEVATION: formatGPXDouble(buf, size, wpt->elevation); break;
+        case GPX_FIELD_TIME:      formatTime(buf, size, wpt->time); break;
+        case GPX_FIELD_SPEED:     formatGPXFloat(buf, size, wpt->speed); break;
+        case GPX_FIELD_HDOP:      formatGPXFloat(buf, size, wpt->hdop); break;
+        case GPX_FIELD_VDOP:      formatGPXFloat(buf, size, wpt->vdop); break;
+        case GPX_FIELD_PDOP:      formatGPXFloat(buf, size, wpt->pdop); break;
+        default:                  snprintf(buf, size, "%d", wpt->satellites);
+    }
+    return true;
+}
+
+/* ******************************* GPX XML *************************** */
+
+//Output buffer context for the xmlTextWriter
+typedef struct {
+    const GPXSink* sink;
+    bool failed;
+} XmlOutput;
+
+static int xmlOutputWrite(void* context, const char* buffer, int len){
+    XmlOutput* out = context;
+
+    if (!sinkWrite(out->sink, buffer, len)){
+        out->failed = true;
+        return -1;
+    }
+    return len;
+}
+
+static int xmlOutputClose(void* context){
+    return 0;
+}
+
+static bool startElement(xmlTextWriterPtr writer, const char* name){
+    return xmlTextWriterStartElement(writer, (const xmlChar*)name) >= 0;
+}
+
+static bool endElement(xmlTextWriterPtr writer){
+    return xmlTextWriterEndElement(writer) >= 0;
+}
+
+static bool writeAttribute(xmlTextWriterPtr writer, const char* name, const char* value){
+    return xmlTextWriterWriteAttribute(writer, (const xmlChar*)name, (const xmlChar*)value) >= 0;
+}
+
+static bool writeCoordinate(xmlTextWriterPtr writer, const char* name, double value){
+    char buf[32];
+
+    formatGPXDouble(buf, sizeof(buf), value);
+    return writeAttribute(writer, name, buf);
+}
+
+static bool writeName(xmlTextWriterPtr writer, const char* name){
+    //An empty name is how the parser records a missing <name>
+    return name[0] == '\0' || xmlTextWriterWriteElement(writer, (const xmlChar*)"name", (const xmlChar*)name) >= 0;
+}
+
+//Elements the GPX schema places before <name> in a waypoint
+static bool isBeforeName(const GPXData* data){
+    const char* name = getGPXDataName(data);
+
+    return strcmp(name, "ele") == 0 || strcmp(name, "time") == 0 || strcmp(name, "magvar") == 0 ||
+           strcmp(name, "geoidheight") == 0;
+}
+
+static bool isAfterName(const GPXData* data){
+    return !isBeforeName(data);
+}
+
+//Elements the GPX schema places between <name> and <sat> in a waypoint
+static bool isBeforeSat(const GPXData* data){
+    static const char* names[] = {"cmt", "desc", "src", "link", "url", "urlname", "sym", "type", "fix"};
+    const char* name = getGPXDataName(data);
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if (strcmp(name, names[i]) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isAfterSat(const GPXData* data){
+    return isAfterName(data) && !isBeforeSat(data);
+}
+
+//Writes the GPXData in a list that pass the filter, or all of them if filter is NULL
+static bool writeXmlData(xmlTextWriterPtr writer, List* otherData, bool (*filter)(const GPXData* data)){
+    ListIterator iter = createIterator(otherData);
+    GPXData* data;
+
+    while ((data = nextElement(&iter)) != NULL){
+        if (filter != NULL && !filter(data)){
+            continue;
+        }
+        if (xmlTextWriterWriteElement(writer, (const xmlChar*)getGPXDataName(data), (const xmlChar*)getGPXDataValue(data)) < 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Writes the typed fields in mask that hold values left out of otherData
+static bool writeXmlTypedFields(xmlTextWriterPtr writer, const Waypoint* wpt, unsigned int mask){
+    char buf[64];
+
+    for (size_t i = 0; i < NUM_TYPED_FIELDS; i++){
+        if ((typedFields[i].field & mask) && formatTypedField(buf, sizeof(buf), wpt, typedFields[i].field) &&
+            xmlTextWriterWriteElement(writer, (const xmlChar*)typedFields[i].name, (const xmlChar*)buf) < 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeXmlWaypoint(xmlTextWriterPtr writer, const char* element, const Waypoint* wpt){
+    if (wpt->fields & GPX_FIELD_TYPED_ONLY){
+        return startElement(writer, element) &&
+               writeCoordinate(writer, "lat", wpt->latitude) &&
+               writeCoordinate(writer, "lon", wpt->longitude) &&
+               writeXmlTypedFields(writer, wpt, TYPED_BEFORE_NAME) &&
+               writeXmlData(writer, wpt->otherData, &isBeforeName) &&
+               writeName(writer, wpt->name) &&
+               writeXmlData(writer, wpt->otherData, &isBeforeSat) &&
+               writeXmlTypedFields(writer, wpt, ~TYPED_BEFORE_NAME) &&
+               writeXmlData(writer, wpt->otherData, &isAfterSat) &&
+               endElement(writer);
+    }
+
+    return startElement(writer, element) &&
+           writeCoordinate(writer, "lat", wpt->latitude) &&
+           writeCoordinate(writer, "lon", wpt->longitude) &&
+           writeXmlData(writer, wpt->otherData, &isBeforeName) &&
+           writeName(writer, wpt->name) &&
+           writeXmlData(writer, wpt->otherData, &isAfterName) &&
+           endElement(writer);
+}
+
+static bool writeXmlWaypoints(xmlTextWriterPtr writer, const char* element, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+
+    while ((wpt = nextElement(&iter)) != NULL){
+        if (!writeXmlWaypoint(writer, element, wpt)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeXmlRoute(xmlTextWriterPtr writer, const Route* rte){
+    return startElement(writer, "rte") &&
+           writeName(writer, rte->name) &&
+           writeXmlData(writer, rte->otherData, NULL) &&
+           writeXmlWaypoints(writer, "rtept", rte->waypoints) &&
+           endElement(writer);
+}
+
+static bool writeXmlTrack(xmlTextWriterPtr writer, const Track* trk){
+    if (!startElement(writer, "trk") || !writeName(writer, trk->name) || !writeXmlData(writer, trk->otherData, NULL)){
+        return false;
+    }
+
+    ListIterator iter = createIterator(trk->segments);
+    TrackSegment* seg;
+
+    while ((seg = nextElement(&iter)) != NULL){
+        if (!startElement(writer, "trkseg") || !writeXmlWaypoints(writer, "trkpt", seg->waypoints) || !endElement(writer)){
+            return false;
+        }
+    }
+    return endElement(writer);
+}
+
+static bool writeXmlDocument(xmlTextWriterPtr writer, const GPXdoc* doc){
+    char version[32];
+    formatGPXDouble(version, sizeof(version), doc->version);
+
+    if (xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL) < 0 || !startElement(writer, "gpx") ||
+        !writeAttribute(writer, "xmlns", doc->namespace) || !writeAttribute(writer, "version", version) ||
+        !writeAttribute(writer, "creator", doc->creator) || !writeXmlWaypoints(writer, "wpt", doc->waypoints)){
+        return false;
+    }
+
+    ListIterator iter = createIterator(doc->routes);
+    void* elem;
+
+    while ((elem = nextElement(&iter)) != NULL){
+        if (!writeXmlRoute(writer, elem)){
+            return false;
+        }
+    }
+
+    iter = createIterator(doc->tracks);
+    while ((elem = nextElement(&iter)) != NULL){
+        if (!writeXmlTrack(writer, elem)){
+            return false;
+        }
+    }
+
+    return xmlTextWriterEndDocument(writer) >= 0 && xmlTextWriterFlush(writer) >= 0;
+}
+
+static bool writeXml(const GPXdoc* doc, const GPXSink* sink){
+    XmlOutput out = {sink, false};
+    xmlOutputBufferPtr buffer = xmlOutputBufferCreateIO(&xmlOutputWrite, &xmlOutputClose, &out, NULL);
+
+    if (buffer == NULL){
+        return false;
+    }
+
+    //The writer takes ownership of the buffer
+    xmlTextWriterPtr writer = xmlNewTextWriter(buffer);
+    if (writer == NULL){
+        xmlOutputBufferClose(buffer);
+        return false;
+    }
+    xmlTextWriterSetIndent(writer, 1);
+    xmlTextWriterSetIndentString(writer, (const xmlChar*)"  ");
+
+    bool ok = writeXmlDocument(writer, doc);
+    xmlFreeTextWriter(writer);
+
+    return ok && !out.failed;
+}
+
+/* ******************************* JSON *************************** */
+
+//Output is collected in buf and passed to the sink whenever buf fills up.  Once a write fails, ok is
+//false and everything else is ignored
+typedef struct {
+    const GPXSink* sink;
+    bool ok;
+    size_t len;
+    char buf[GPX_WRITER_CHUNK];
+} JsonWriter;
+
+static void jsonFlush(JsonWriter* json){
+    if (json->ok && json->len > 0){
+        json->ok = json->sink->write(json->sink->userData, json->buf, json->len);
+    }
+    json->len = 0;
+}
+
+static void jsonWrite(JsonWriter* json, const char* data, size_t len){
+    while (json->ok && len > 0){
+        size_t n = sizeof(json->buf) - json->len;
+        if (n > len){
+            n = len;
+        }
+
+        memcpy(json->buf + json->len, data, n);
+        json->len += n;
+        data += n;
+        len -= n;
+
+        if (json->len == sizeof(json->buf)){
+            jsonFlush(json);
+        }
+    }
+}
+
+static void jsonText(JsonWriter* json, const char* text){
+    jsonWrite(json, text, strlen(text));
+}
+
+//Writes str as a quoted JSON string.  Runs of characters that need no escaping are copied in one go
+static void jsonString(JsonWriter* json, const char* str){
+    jsonWrite(json, "\"", 1);
+
+    const char* run = str;
+    for (const char* c = str; *c != '\0'; c++){
+        unsigned char ch = (unsigned char)*c;
+        if (ch >= 0x20 && ch != '"' && ch != '\\'){
+            continue;
+        }
+
+        jsonWrite(json, run, c - run);
+        run = c + 1;
+
+        char escape[8];
+        switch (ch){
+            case '"':  jsonText(json, "\\\""); break;
+            case '\\': jsonText(json, "\\\\"); break;
+            case '\n': jsonText(json, "\\n"); break;
+            case '\r': jsonText(json, "\\r"); break;
+            case '\t': jsonText(json, "\\t"); break;
+            default:
+                snprintf(escape, sizeof(escape), "\\u%04x", ch);
+                jsonText(json, escape);
+        }
+    }
+    jsonText(json, run);
+    jsonWrite(json, "\"", 1);
+}
+
+static void jsonNumber(JsonWriter* json, double value){
+    if (!isfinite(value)){
+        jsonText(json, "null");
+        return;
+    }
+
+    char buf[32];
+    formatGPXDouble(buf, sizeof(buf), value);
+    jsonText(json, buf);
+}
+
+static void jsonDataEntry(JsonWriter* json, const char* separator, const char* name, const char* value){
+    jsonText(json, separator);
+    jsonText(json, "{\"name\":");
+    jsonString(json, name);
+    jsonText(json, ",\"value\":");
+    jsonString(json, value);
+    jsonText(json, "}");
+}
+
+//Writes an otherData list, followed by the typed fields of wpt that were left out of it.  wpt is NULL
+//for routes and tracks
+static void jsonData(JsonWriter* json, List* otherData, const Waypoint* wpt){
+    ListIterator iter = createIterator(otherData);
+    GPXData* data;
+    const char* separator = "";
+
+    jsonText(json, "[");
+    while ((data = nextElement(&iter)) != NULL){
+        jsonDataEntry(json, separator, getGPXDataName(data), getGPXDataValue(data));
+        separator = ",";
+    }
+
+    char buf[64];
+    for (size_t i = 0; wpt != NULL && i < NUM_TYPED_FIELDS; i++){
+        if (formatTypedField(buf, sizeof(buf), wpt, typedFields[i].field)){
+            jsonDataEntry(json, separator, typedFields[i].name, buf);
+            separator = ",";
+        }
+    }
+    jsonText(json, "]");
+}
+
+static void jsonWaypoints(JsonWriter* json, List* waypoints){
+    ListIterator iter = createIterator(waypoints);
+    Waypoint* wpt;
+    const char* separator = "";
+
+    jsonText(json, "[");
+    while (json->ok && (wpt = nextElement(&iter)) != NULL){
+        jsonText(json, separator);
+        jsonText(json, "{\"name\":");
+        jsonString(json, wpt->name);
+        jsonText(json, ",\"lat\":");
+        jsonNumber(json, wpt->latitude);
+        jsonText(json, ",\"lon\":");
+        jsonNumber(json, wpt->longitude);
+        jsonText(json, ",\"otherData\":");
+        jsonData(json, wpt->otherData, wpt);
+        jsonText(json, "}");
+        separator = ",";
+    }
+    jsonText(json, "]");
+}
+
+static void jsonRoutes(JsonWriter* json, List* routes){
+    ListIterator iter = createIterator(routes);
+    Route* rte;
+    const char* separator = "";
+
+    jsonText(json, "[");
+    while (json->ok && (rte = nextElement(&iter)) != NULL){
+        jsonText(json, separator);
+        jsonText(json, "{\"name\":");
+        jsonString(json, rte->name);
+        jsonText(json, ",\"otherData\":");
+        jsonData(json, rte->otherData, NULL);
+        jsonText(json, ",\"points\":");
+        jsonWaypoints(json, rte->waypoints);
+        jsonText(json, "}");
+        separator = ",";
+    }
+    jsonText(json, "]");
+}
+
+static void jsonTracks(JsonWriter* json, List* tracks){
+    ListIterator iter = createIterator(tracks);
+    Track* trk;
+    const char* separator = "";
+
+    jsonText(json, "[");
+    while (json->ok && (trk = nextElement(&iter)) != NULL){
+        jsonText(json, separator);
+        jsonText(json, "{\"name\":");
+        jsonString(json, trk->name);
+        jsonText(json, ",\"otherData\":");
+        jsonData(json, trk->otherData, NULL);
+        jsonText(json, ",\"segments\":[");
+
+        ListIterator segIter = createIterator(trk->segments);
+        TrackSegment* seg;
+        const char* segSeparator = "";
+
+        while ((seg = nextElement(&segIter)) != NULL){
+            jsonText(json, segSeparator);
+            jsonText(json, "{\"points\":");
+            jsonWaypoints(json, seg->waypoints);
+            jsonText(json, "}");
+            segSeparator = ",";
+        }
+        jsonText(json, "]}");
+        separator = ",";
+    }
+    jsonText(json, "]");
+}
+
+static bool writeJson(const GPXdoc* doc, const GPXSink* sink){
+    JsonWriter* json = malloc(sizeof(JsonWriter));
+
+    if (json == NULL){
+        return false;
+    }
+    json->sink = sink;
+    json->ok = true;
+    json->len = 0;
+
+    jsonText(json, "{\"namespace\":");
+    jsonString(json, doc->namespace);
+    jsonText(json, ",\"version\":");
+    jsonNumber(json, doc->version);
+    jsonText(json, ",\"creator\":");
+    jsonString(json, doc->creator);
+    jsonText(json, ",\"waypoints\":");
+    jsonWaypoints(json, doc->waypoints);
+    jsonText(json, ",\"routes\":");
+    jsonRoutes(json, doc->routes);
+    jsonText(json, ",\"tracks\":");
+    jsonTracks(json, doc->tracks);
+    jsonText(json, "}\n");
+    jsonFlush(json);
+
+    bool ok = json->ok;
+    free(json);
+    return ok;
+}
+
+/* ******************************* Public API *************************** */
+
+bool writeGPXdoc(const GPXdoc* doc, GPXFormat format, const GPXSink* sink){
+    if (doc == NULL || sink == NULL || sink->write == NULL || !loadGPXdoc((GPXdoc*)doc)){
+        return false;
+    }
+    return format == GPX_FORMAT_JSON ? writeJson(doc, sink) : writeXml(doc, sink);
+}
+
+static bool fileWrite(void* userData, const char* data, size_t len){
+    return fwrite(data, 1, len, (FILE*)userData) == len;
+}
+
+bool writeGPXdocToFile(const GPXdoc* doc, GPXFormat format, FILE* file){
+    if (file == NULL){
+        return false;
+    }
+
+    GPXSink sink = {file, &fileWrite};
+    return writeGPXdoc(doc, format, &sink);
+}
+
+static bool fdWrite(void* userData, const char* data, size_t len){
+    int fd = *(int*)userData;
+
+    while (len > 0){
+        ssize_t written = write(fd, data, len);
+
+        if (written < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+bool writeGPXdocToFd(const GPXdoc* doc, GPXFormat format, int fd){
+    if (fd < 0){
+        return false;
+    }
+
+    GPXSink sink = {&fd, &fdWrite};
+    return writeGPXdoc(doc, format, &sink);
+}
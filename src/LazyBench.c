@@ -0,0 +1,291 @@
+/*
+ * Check and benchmark for lazy documents (GPXLazy.h).
+ *
+ * Usage: LazyBench file.gpx...
+ *
+ * Each file is parsed in full and with GPX_OPT_LAZY, with no other options, with GPX_OPT_ARENA and with
+ * GPX_OPT_TYPED_ONLY.  Before anything is loaded, the counts and names of the lazy document must match
+ * the full one.  Routes and tracks are then loaded in the ways a caller would - getRoute and getTrack,
+ * nextGPXRoute and nextGPXTrack, plain iterators with routeToString and getRouteLen, and writing the
+ * whole document - and each must print the same as in the full document.  A route or track that fails
+ * to load must be left as it was, and removing a track that has not been loaded must update
+ * getNumSegments.  The time to create the lazy document and answer the summary queries, and to create
+ * it and load everything, are compared with the full parse.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "GPXParser.h"
+#include "GPXLazy.h"
+#include "GPXDistance.h"
+#include "GPXWriter.h"
+#include "StringBuilder.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int failures;
+
+static void fail(const char* fileName, const char* mode, const char* what){
+	printf("  %s (%s): %s\n", fileName, mode, what);
+	failures++;
+}
+
+static bool appendSink(void* userData, const char* data, size_t len){
+	return appendStringLen(userData, data, len);
+}
+
+static char* toXML(const GPXdoc* doc){
+	StringBuilder sb = {NULL, 0, 0};
+	GPXSink sink = {&sb, &appendSink};
+
+	if (doc == NULL || !writeGPXdoc(doc, GPX_FORMAT_XML, &sink)){
+		free(sb.str);
+		return NULL;
+	}
+	return sb.str;
+}
+
+static bool sameString(char* a, char* b){
+	bool same = a != NULL && b != NULL && strcmp(a, b) == 0;
+	free(a);
+	free(b);
+	return same;
+}
+
+static int trackPoints(const Track* trk){
+	ListIterator iter = createIterator(trk->segments);
+	TrackSegment* seg;
+	int count = 0;
+
+	while ((seg = nextElement(&iter)) != NULL){
+		count += getLength(seg->waypoints);
+	}
+	return count;
+}
+
+//Summary queries that must not load anything: the counts and names of every route and track
+static long summarize(const GPXdoc* doc){
+	long total = getNumWaypoints(doc) + getNumRoutes(doc) + getNumTracks(doc) + getNumSegments(doc) + getNumGPXData(doc);
+	ListIterator iter = createIterator(doc->routes);
+	Route* rte;
+	Track* trk;
+
+	while ((rte = nextElement(&iter)) != NULL){
+		total += getRouteNumPoints(doc, rte) + strlen(rte->name);
+	}
+	iter = createIterator(doc->tracks);
+	while ((trk = nextElement(&iter)) != NULL){
+		total += getTrackNumPoints(doc, trk) + getTrackNumSegments(doc, trk) + strlen(trk->name);
+	}
+	return total;
+}
+
+static void checkSummary(const GPXdoc* full, const GPXdoc* lazy, const char* fileName, const char* mode){
+	if (getNumWaypoints(full) != getNumWaypoints(lazy) || getNumRoutes(full) != getNumRoutes(lazy) ||
+	    getNumTracks(full) != getNumTracks(lazy) || getNumSegments(full) != getNumSegments(lazy) ||
+	    getNumGPXData(full) != getNumGPXData(lazy)){
+		fail(fileName, mode, "document counts differ");
+	}
+
+	ListIterator fullIter = createIterator(full->routes);
+	ListIterator lazyIter = createIterator(lazy->routes);
+	Route* fullRte;
+	Route* lazyRte;
+	while ((fullRte = nextElement(&fullIter)) != NULL && (lazyRte = nextElement(&lazyIter)) != NULL){
+		if (strcmp(fullRte->name, lazyRte->name) != 0 || getLength(fullRte->waypoints) != getRouteNumPoints(lazy, lazyRte) ||
+		    getLength(fullRte->otherData) != getLength(lazyRte->otherData)){
+			fail(fileName, mode, "route summary differs");
+		}
+	}
+
+	fullIter = createIterator(full->tracks);
+	lazyIter = createIterator(lazy->tracks);
+	Track* fullTrk;
+	Track* lazyTrk;
+	while ((fullTrk = nextElement(&fullIter)) != NULL && (lazyTrk = nextElement(&lazyIter)) != NULL){
+		if (strcmp(fullTrk->name, lazyTrk->name) != 0 || trackPoints(fullTrk) != getTrackNumPoints(lazy, lazyTrk) ||
+		    getLength(fullTrk->segments) != getTrackNumSegments(lazy, lazyTrk) ||
+		    getLength(fullTrk->otherData) != getLength(lazyTrk->otherData)){
+			fail(fileName, mode, "track summary differs");
+		}
+	}
+}
+
+//Loads every other route and track by name and compares it with the full document
+static void checkLookups(const GPXdoc* full, GPXdoc* lazy, const char* fileName, const char* mode){
+	ListIterator iter = createIterator(full->routes);
+	Route* rte;
+	int i = 0;
+
+	while ((rte = nextElement(&iter)) != NULL){
+		Route* found = i++ % 2 == 0 ? getRoute(lazy, rte->name) : NULL;
+		if (found != NULL && getRoute(full, rte->name) == rte && !sameString(routeToString(rte), routeToString(found))){
+			fail(fileName, mode, "route loaded by getRoute differs");
+		}
+	}
+
+	iter = createIterator(full->tracks);
+	Track* trk;
+	i = 0;
+	while ((trk = nextElement(&iter)) != NULL){
+		Track* found = i++ % 2 == 0 ? getTrack(lazy, trk->name) : NULL;
+		if (found != NULL && getTrack(full, trk->name) == trk && !sameString(trackToString(trk), trackToString(found))){
+			fail(fileName, mode, "track loaded by getTrack differs");
+		}
+	}
+}
+
+//Loads the rest through the iterators and compares each element with the full document
+static void checkIterators(const GPXdoc* full, GPXdoc* lazy, const char* fileName, const char* mode){
+	ListIterator fullIter = createIterator(full->routes);
+	ListIterator lazyIter = createIterator(lazy->routes);
+	Route* fullRte;
+	Route* lazyRte;
+
+	while ((fullRte = nextElement(&fullIter)) != NULL && (lazyRte = nextGPXRoute(lazy, &lazyIter)) != NULL){
+		if (!sameString(routeToString(fullRte), routeToString(lazyRte))){
+			fail(fileName, mode, "route loaded by nextGPXRoute differs");
+		}
+	}
+
+	fullIter = createIterator(full->tracks);
+	lazyIter = createIterator(lazy->tracks);
+	Track* fullTrk;
+	Track* lazyTrk;
+	while ((fullTrk = nextElement(&fullIter)) != NULL && (lazyTrk = nextGPXTrack(lazy, &lazyIter)) != NULL){
+		if (!sameString(trackToString(fullTrk), trackToString(lazyTrk))){
+			fail(fileName, mode, "track loaded by nextGPXTrack differs");
+		}
+	}
+	if (isGPXdocLazy(lazy)){
+		fail(fileName, mode, "document is still lazy after iterating");
+	}
+}
+
+//Walks a new lazy document with plain iterators, which must load each element on first use of its lists
+static void checkPlainIteration(const GPXdoc* full, GPXdoc* lazy, const char* fileName, const char* mode){
+	ListIterator fullIter = createIterator(full->routes);
+	ListIterator lazyIter = createIterator(lazy->routes);
+	Route* fullRte;
+	Route* lazyRte;
+
+	while ((fullRte = nextElement(&fullIter)) != NULL && (lazyRte = nextElement(&lazyIter)) != NULL){
+		if (getRouteLen(fullRte) != getRouteLen(lazyRte) || !sameString(routeToString(fullRte), routeToString(lazyRte))){
+			fail(fileName, mode, "route read through a plain iterator differs");
+		}
+	}
+
+	fullIter = createIterator(full->tracks);
+	lazyIter = createIterator(lazy->tracks);
+	Track* fullTrk;
+	Track* lazyTrk;
+	while ((fullTrk = nextElement(&fullIter)) != NULL && (lazyTrk = nextElement(&lazyIter)) != NULL){
+		if (getTrackLen(fullTrk) != getTrackLen(lazyTrk) || !sameString(trackToString(fullTrk), trackToString(lazyTrk))){
+			fail(fileName, mode, "track read through a plain iterator differs");
+		}
+	}
+	if (isGPXdocLazy(lazy) || !checkGPXCounts(lazy)){
+		fail(fileName, mode, "document is still lazy after reading every element");
+	}
+}
+
+static void checkFile(const char* fileName, unsigned int options, const char* mode){
+	double start = now();
+	GPXdoc* full = createGPXdocWithOptions((char*)fileName, options);
+	double fullTime = now() - start;
+
+	start = now();
+	GPXdoc* lazy = createGPXdocWithOptions((char*)fileName, options | GPX_OPT_LAZY);
+	long summary = lazy != NULL ? summarize(lazy) : 0;
+	double lazyTime = now() - start;
+
+	if (full == NULL || lazy == NULL){
+		//Invalid points are only found when they are loaded, and the element that holds them stays unloaded
+		if (lazy != NULL ? loadGPXdoc(lazy) : full != NULL){
+			fail(fileName, mode, "only one of the parses failed");
+		}
+		if (lazy != NULL && (!isGPXdocLazy(lazy) || summarize(lazy) != summary || !checkGPXCounts(lazy))){
+			fail(fileName, mode, "failed load changed the document");
+		}
+		deleteGPXdoc(full);
+		deleteGPXdoc(lazy);
+		return;
+	}
+
+	bool wasLazy = isGPXdocLazy(lazy);
+	checkSummary(full, lazy, fileName, mode);
+	if (summary != summarize(full) || isGPXdocLazy(lazy) != wasLazy){
+		fail(fileName, mode, "summary queries differ or loaded the document");
+	}
+
+	checkLookups(full, lazy, fileName, mode);
+	checkIterators(full, lazy, fileName, mode);
+	if (getNumGPXData(full) != getNumGPXData(lazy) || getNumSegments(full) != getNumSegments(lazy) || !checkGPXCounts(lazy)){
+		fail(fileName, mode, "counts differ after loading");
+	}
+
+	start = now();
+	GPXdoc* loaded = createGPXdocWithOptions((char*)fileName, options | GPX_OPT_LAZY);
+	bool ok = loadGPXdoc(loaded);
+	double loadTime = now() - start;
+
+	//Writing loads the document as well
+	GPXdoc* written = createGPXdocWithOptions((char*)fileName, options | GPX_OPT_LAZY);
+	if (!ok || !sameString(toXML(full), toXML(loaded)) || !sameString(toXML(full), toXML(written)) || isGPXdocLazy(written)){
+		fail(fileName, mode, "loaded or written lazy document differs");
+	}
+	deleteGPXdoc(loaded);
+	deleteGPXdoc(written);
+
+	GPXdoc* iterated = createGPXdocWithOptions((char*)fileName, options | GPX_OPT_LAZY);
+	if (iterated != NULL){
+		checkPlainIteration(full, iterated, fileName, mode);
+	}
+	deleteGPXdoc(iterated);
+
+	printf("  %-10s full %8.1f ms   lazy + summary %8.1f ms (%5.1fx)   lazy + load all %8.1f ms%s\n", mode, fullTime * 1000,
+	       lazyTime * 1000, lazyTime > 0 ? fullTime / lazyTime : 0, loadTime * 1000, wasLazy ? "" : "   (not lazy)");
+
+	//Removing a track before it is loaded
+	if (!(options & GPX_OPT_ARENA) && getNumTracks(full) > 0){
+		GPXdoc* removed = createGPXdocWithOptions((char*)fileName, options | GPX_OPT_LAZY);
+		Track* first = removed != NULL ? getFromFront(removed->tracks) : NULL;
+		int expected = getNumSegments(full) - getLength(((Track*)getFromFront(full->tracks))->segments);
+
+		if (first != NULL){
+			deleteTrack(deleteDataFromList(removed->tracks, first));
+		}
+		if (removed == NULL || getNumSegments(removed) != expected || !loadGPXdoc(removed) || getNumSegments(removed) != expected){
+			fail(fileName, mode, "removing an unloaded track");
+		}
+		deleteGPXdoc(removed);
+	}
+
+	deleteGPXdoc(full);
+	deleteGPXdoc(lazy);
+}
+
+int main(int argc, char** argv){
+	if (argc < 2){
+		fprintf(stderr, "Usage: %s file.gpx...\n", argv[0]);
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++){
+		printf("%s\n", argv[i]);
+		checkFile(argv[i], 0, "heap");
+		checkFile(argv[i], GPX_OPT_ARENA, "arena");
+		checkFile(argv[i], GPX_OPT_TYPED_ONLY, "typed only");
+	}
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
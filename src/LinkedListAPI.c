@@ -1,6 +1,112 @@
 #include "LinkedListAPI.h"
+#include "StringBuilder.h"
 #include "assert.h"
 
+//Slab size used when createNodePool is given none
+#define DEFAULT_NODES_PER_SLAB 256
+
+/* ******************************* Node allocation *************************** */
+
+//Gives up one reference to a pool, freeing it with its slabs after the last one
+static void releasePool(NodePool* pool){
+	if (pool == NULL || --pool->numUsers > 0){
+		return;
+	}
+
+	while (pool->slabs != NULL){
+		NodeSlab* next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+	free(pool);
+}
+
+//Allocates a node for data from the list's pool, or with malloc for a list without one
+static Node* allocNode(List* list, void* data){
+	NodePool* pool = list->pool;
+
+	if (pool == NULL){
+		return initializeNode(data);
+	}
+
+	Node* node = pool->freeNodes;
+	if (node != NULL){
+		pool->freeNodes = node->next;
+	}else{
+		if (pool->slabs == NULL || pool->used == pool->nodesPerSlab){
+			NodeSlab* slab = malloc(sizeof(NodeSlab) + pool->nodesPerSlab * sizeof(Node));
+			if (slab == NULL){
+				return NULL;
+			}
+			slab->next = pool->slabs;
+			pool->slabs = slab;
+			pool->used = 0;
+		}
+		node = &pool->slabs->nodes[pool->used++];
+	}
+
+	node->data = data;
+	node->previous = NULL;
+	node->next = NULL;
+	return node;
+}
+
+//Gives a node back to where allocNode got it from
+static void releaseNode(List* list, Node* node){
+	if (list->pool == NULL){
+		free(node);
+		return;
+	}
+
+	node->next = list->pool->freeNodes;
+	list->pool->freeNodes = node;
+}
+
+NodePool* createNodePool(int nodesPerSlab){
+	NodePool* pool = malloc(sizeof(NodePool));
+
+	if (pool == NULL){
+		return NULL;
+	}
+
+	pool->slabs = NULL;
+	pool->used = 0;
+	pool->nodesPerSlab = nodesPerSlab > 0 ? nodesPerSlab : DEFAULT_NODES_PER_SLAB;
+	pool->freeNodes = NULL;
+	pool->numUsers = 1;
+	return pool;
+}
+
+void deleteNodePool(NodePool* pool){
+	releasePool(pool);
+}
+
+bool setListNodePool(List* list, NodePool* pool){
+	if (list == NULL || list->head != NULL){
+		return false;
+	}
+
+	if (pool != NULL){
+		pool->numUsers++;
+	}
+	releasePool(list->pool);
+	list->pool = pool;
+	return true;
+}
+
+//Calls the list's fill function, if it has one, unsetting it first so that it runs only once
+static void fillList(List* list){
+	if (list == NULL || list->fill == NULL){
+		return;
+	}
+
+	void (*fill)(void* source, List* list) = list->fill;
+	list->fill = NULL;
+	fill(list->source, list);
+}
+
+/* ******************************* List functions *************************** */
+
 /** Function to initialize the list metadata head to the appropriate function pointers. Allocates memory to the struct.
 *@return pointer to the list head
 *@param printFunction function pointer to print a single node of the list
@@ -14,6 +120,9 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
     assert(compareFunction != NULL);
 
     List * tmpList = malloc(sizeof(List));
+	if (tmpList == NULL){
+		return NULL;
+	}
 	
 	tmpList->head = NULL;
 	tmpList->tail = NULL;
@@ -23,6 +132,13 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 	tmpList->deleteData = deleteFunction;
 	tmpList->compare = compareFunction;
 	tmpList->printData = printFunction;
+
+	tmpList->onInsert = NULL;
+	tmpList->onRemove = NULL;
+	tmpList->observer = NULL;
+	tmpList->pool = NULL;
+	tmpList->fill = NULL;
+	tmpList->source = NULL;
 	
 	return tmpList;
 }
@@ -37,6 +153,9 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 void freeList(List* list){	
 
     clearList(list);
+	if (list != NULL){
+		releasePool(list->pool);
+	}
 	free(list);
 }
 
@@ -52,6 +171,8 @@ void clearList(List* list){
     if (list == NULL){
 		return;
 	}
+
+	list->fill = NULL;
 	
 	if (list->head == NULL && list->tail == NULL){
 		return;
@@ -60,10 +181,13 @@ void clearList(List* list){
 	Node* tmp;
 	
 	while (list->head != NULL){
+		if (list->onRemove != NULL){
+			list->onRemove(list->observer, list->head->data);
+		}
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		releaseNode(list, tmp);
 	}
 	
 	list->head = NULL;
@@ -104,10 +228,13 @@ void insertBack(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
 		return;
 	}
-	
-	(list->length)++;
+	fillList(list);
 
-	Node* newNode = initializeNode(toBeAdded);
+	Node* newNode = allocNode(list, toBeAdded);
+	if (newNode == NULL){
+		return;
+	}
+	(list->length)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -117,6 +244,10 @@ void insertBack(List* list, void* toBeAdded){
         list->tail->next = newNode;
     	list->tail = newNode;
     }
+
+	if (list->onInsert != NULL){
+		list->onInsert(list->observer, toBeAdded);
+	}
 }
 
 /**Inserts a Node at the front of a linked list.  List metadata is updated
@@ -129,10 +260,13 @@ void insertFront(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
 		return;
 	}
-	
-	(list->length)++;
+	fillList(list);
 
-	Node* newNode = initializeNode(toBeAdded);
+	Node* newNode = allocNode(list, toBeAdded);
+	if (newNode == NULL){
+		return;
+	}
+	(list->length)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -142,6 +276,105 @@ void insertFront(List* list, void* toBeAdded){
         list->head->previous = newNode;
     	list->head = newNode;
     }
+
+	if (list->onInsert != NULL){
+		list->onInsert(list->observer, toBeAdded);
+	}
+}
+
+bool insertBackArray(List* list, void* const* data, int count){
+	if (list == NULL || data == NULL || count < 0){
+		return false;
+	}
+	for (int i = 0; i < count; i++){
+		if (data[i] == NULL){
+			return false;
+		}
+	}
+	fillList(list);
+	if (count == 0){
+		return true;
+	}
+
+	//Chain the new nodes on their own first, so that running out of memory leaves the list as it was
+	Node* first = NULL;
+	Node* last = NULL;
+
+	for (int i = 0; i < count; i++){
+		Node* newNode = allocNode(list, data[i]);
+
+		if (newNode == NULL){
+			while (first != NULL){
+				Node* next = first->next;
+				releaseNode(list, first);
+				first = next;
+			}
+			return false;
+		}
+
+		newNode->previous = last;
+		if (last == NULL){
+			first = newNode;
+		}else{
+			last->next = newNode;
+		}
+		last = newNode;
+	}
+
+	if (list->tail == NULL){
+		list->head = first;
+	}else{
+		list->tail->next = first;
+		first->previous = list->tail;
+	}
+	list->tail = last;
+	list->length += count;
+
+	if (list->onInsert != NULL){
+		for (int i = 0; i < count; i++){
+			list->onInsert(list->observer, data[i]);
+		}
+	}
+	return true;
+}
+
+bool moveListElements(List* list, List* other){
+	if (list == NULL || other == NULL || list == other || list->pool != other->pool){
+		return false;
+	}
+	fillList(list);
+	fillList(other);
+	if (other->head == NULL){
+		return true;
+	}
+
+	Node* first = other->head;
+
+	if (other->onRemove != NULL){
+		for (Node* node = first; node != NULL; node = node->next){
+			other->onRemove(other->observer, node->data);
+		}
+	}
+
+	if (list->tail == NULL){
+		list->head = first;
+	}else{
+		list->tail->next = first;
+		first->previous = list->tail;
+	}
+	list->tail = other->tail;
+	list->length += other->length;
+
+	other->head = NULL;
+	other->tail = NULL;
+	other->length = 0;
+
+	if (list->onInsert != NULL){
+		for (Node* node = first; node != NULL; node = node->next){
+			list->onInsert(list->observer, node->data);
+		}
+	}
+	return true;
 }
 
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
@@ -150,6 +383,7 @@ void insertFront(List* list, void* toBeAdded){
  *@return pointer to the data located at the head of the list
  **/
 void* getFromFront(List * list){
+	fillList(list);
 	if (list->head == NULL){
 		return NULL;
 	}
@@ -163,6 +397,7 @@ void* getFromFront(List * list){
  *@return pointer to the data located at the tail of the list
  **/
 void* getFromBack(List * list){
+	fillList(list);
 	if (list->tail == NULL){
 		return NULL;
 	}
@@ -174,11 +409,16 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 	if (list == NULL || toBeDeleted == NULL){
 		return NULL;
 	}
+	fillList(list);
 	
 	Node* tmp = list->head;
 	
 	while(tmp != NULL){
 		if (list->compare(toBeDeleted, tmp->data) == 0){
+			if (list->onRemove != NULL){
+				list->onRemove(list->observer, tmp->data);
+			}
+
 			//Unlink the node
 			Node* delNode = tmp;
 			
@@ -195,7 +435,7 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 			}
 			
 			void* data = delNode->data;
-			free(delNode);
+			releaseNode(list, delNode);
 			
 			(list->length)--;
 
@@ -223,6 +463,7 @@ void insertSorted(List *list, void *toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
 		return;
 	}
+	fillList(list);
 
 	if (list->head == NULL){
 		insertBack(list, toBeAdded);
@@ -252,13 +493,20 @@ void insertSorted(List *list, void *toBeAdded){
 			free(currDescr);
 			free(newDescr);
 		
-			Node* newNode = initializeNode(toBeAdded);
+			Node* newNode = allocNode(list, toBeAdded);
+			if (newNode == NULL){
+				return;
+			}
 			newNode->next = currNode;
 			newNode->previous = currNode->previous;
 			currNode->previous->next = newNode;
 			currNode->previous = newNode;
 			(list->length)++;
 
+			if (list->onInsert != NULL){
+				list->onInsert(list->observer, toBeAdded);
+			}
+
 			return;
 		}
 	
@@ -277,28 +525,31 @@ returned string must be freed by the calling function.
  **/
 char* toString(List * list){
 	ListIterator iter = createIterator(list);
-	char* str;
-		
-	str = (char*)malloc(sizeof(char));
-	strcpy(str, "");
+	StringBuilder sb = {NULL, 0, 0};
+
+	if (!appendString(&sb, "")){
+		return NULL;
+	}
 	
 	void* elem;
 	while((elem = nextElement(&iter)) != NULL){
 		char* currDescr = list->printData(elem);
-		int newLen = strlen(str)+50+strlen(currDescr);
-		str = (char*)realloc(str, newLen);
-		strcat(str, "\n");
-		strcat(str, currDescr);
+		bool ok = currDescr != NULL && appendString(&sb, "\n") && appendString(&sb, currDescr);
 		
 		free(currDescr);
+		if (!ok){
+			free(sb.str);
+			return NULL;
+		}
 	}
 	
-	return str;
+	return sb.str;
 }
 
 ListIterator createIterator(List* list){
     ListIterator iter;
 
+    fillList(list);
     iter.current = list->head;
     
     return iter;
@@ -316,6 +567,7 @@ void* nextElement(ListIterator* iter){
 }
 
 int getLength(List* list){
+	fillList(list);
 	return list->length;
 }
 
@@ -336,3 +588,22 @@ void* findElement(List * list, bool (*customCompare)(const void* first,const voi
 
 	return NULL;
 }
+
+void setListObserver(List* list, void* observer, void (*onInsert)(void* observer, void* data), void (*onRemove)(void* observer, void* data)){
+	if (list == NULL){
+		return;
+	}
+
+	list->observer = observer;
+	list->onInsert = onInsert;
+	list->onRemove = onRemove;
+}
+
+void setListFill(List* list, void* source, void (*fill)(void* source, List* list)){
+	if (list == NULL){
+		return;
+	}
+
+	list->source = source;
+	list->fill = fill;
+}
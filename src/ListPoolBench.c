@@ -0,0 +1,310 @@
+/*
+ * Check and benchmark for list node pools and insertBackArray (LinkedListAPI.h).
+ *
+ * Usage: ListPoolBench [file.gpx...]
+ *
+ * Built with -Wl,--wrap=malloc -Wl,--wrap=free, so every malloc and free made by the list and parser code
+ * goes through the counters below, which can also be told to make a malloc fail.  The libxml2 library
+ * allocates through its own references to malloc and is not counted.
+ *
+ * Lists of a million elements are filled with insertBack, with insertBack from a pool and with
+ * insertBackArray, and the mallocs and time of each are compared; the lists must be intact afterwards.
+ * Nodes removed from a pooled list must be reused without new mallocs, and a failed malloc must leave
+ * insertBack and insertBackArray with the list unchanged.  Each file given is parsed with and without
+ * GPX_OPT_NODE_POOL; both must write the same XML.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "LinkedListAPI.h"
+#include "GPXParser.h"
+#include "GPXWriter.h"
+#include "StringBuilder.h"
+
+#define NUM_ELEMENTS 1000000
+
+/* ******************************* Instrumented allocator *************************** */
+
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+
+static long numMallocs;
+static long numFrees;
+
+//When positive, the malloc that brings it to 0 fails
+static long failAfter;
+
+void* __wrap_malloc(size_t size){
+	if (failAfter > 0 && --failAfter == 0){
+		return NULL;
+	}
+	numMallocs++;
+	return __real_malloc(size);
+}
+
+void __wrap_free(void* ptr){
+	if (ptr != NULL){
+		numFrees++;
+	}
+	__real_free(ptr);
+}
+
+/* ******************************* Helpers *************************** */
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int failures;
+
+static void fail(const char* what){
+	printf("  %s\n", what);
+	failures++;
+}
+
+static char* printInt(void* data){
+	char* str = malloc(16);
+	if (str != NULL){
+		snprintf(str, 16, "%d", *(int*)data);
+	}
+	return str;
+}
+
+static void deleteNothing(void* data){
+}
+
+static int compareInts(const void* first, const void* second){
+	return *(const int*)first - *(const int*)second;
+}
+
+static List* newList(void){
+	return initializeList(&printInt, &deleteNothing, &compareInts);
+}
+
+//Checks that list holds values[0..count) in order, with consistent links and length
+static bool isIntact(const List* list, int* const* values, int count){
+	const Node* prev = NULL;
+	const Node* node = list->head;
+	int i = 0;
+
+	for (; node != NULL; prev = node, node = node->next, i++){
+		if (i >= count || node->data != values[i] || node->previous != prev){
+			return false;
+		}
+	}
+	return i == count && list->tail == prev && list->length == count;
+}
+
+/* ******************************* List checks *************************** */
+
+typedef enum { FILL_MALLOC, FILL_POOL, FILL_ARRAY } FillMode;
+
+static void benchFill(int** values, FillMode mode, const char* label){
+	NodePool* pool = mode == FILL_MALLOC ? NULL : createNodePool(0);
+	List* list = newList();
+
+	setListNodePool(list, pool);
+	deleteNodePool(pool);
+
+	long mallocs = numMallocs;
+	double start = now();
+	if (mode == FILL_ARRAY){
+		if (!insertBackArray(list, (void* const*)values, NUM_ELEMENTS)){
+			fail("insertBackArray failed");
+		}
+	}else{
+		for (int i = 0; i < NUM_ELEMENTS; i++){
+			insertBack(list, values[i]);
+		}
+	}
+	double fillTime = now() - start;
+	mallocs = numMallocs - mallocs;
+
+	if (!isIntact(list, values, NUM_ELEMENTS)){
+		fail("filled list is not intact");
+	}
+
+	start = now();
+	freeList(list);
+	double freeTime = now() - start;
+
+	printf("  %-22s %8ld mallocs   fill %7.1f ms   free %7.1f ms\n", label, mallocs, fillTime * 1000, freeTime * 1000);
+}
+
+static void checkReuse(int** values){
+	NodePool* pool = createNodePool(64);
+	List* list = newList();
+	List* other = newList();
+
+	setListNodePool(list, pool);
+	setListNodePool(other, pool);
+	deleteNodePool(pool);
+
+	for (int i = 0; i < 1000; i++){
+		insertBack(list, values[i]);
+	}
+	for (int i = 0; i < 1000; i += 2){
+		deleteDataFromList(list, values[i]);
+	}
+
+	//Nodes freed by one list are taken by another list of the same pool
+	long mallocs = numMallocs;
+	for (int i = 0; i < 500; i++){
+		insertBack(other, values[i]);
+	}
+	if (numMallocs != mallocs){
+		fail("freed pool nodes were not reused");
+	}
+
+	int* odd[500];
+	for (int i = 0; i < 500; i++){
+		odd[i] = values[2 * i + 1];
+	}
+	if (!isIntact(list, odd, 500) || !isIntact(other, values, 500)){
+		fail("lists sharing a pool are not intact");
+	}
+
+	//The pool lives until the last list using it is freed
+	long frees = numFrees;
+	freeList(list);
+	if (numFrees - frees != 1){
+		fail("pool was freed while a list still used it");
+	}
+	freeList(other);
+
+	List* full = newList();
+	insertBack(full, values[0]);
+	if (setListNodePool(full, NULL)){
+		fail("setListNodePool accepted a list that is not empty");
+	}
+	freeList(full);
+}
+
+static void checkFailures(int** values){
+	for (int pooled = 0; pooled < 2; pooled++){
+		NodePool* pool = pooled ? createNodePool(4) : NULL;
+		List* list = newList();
+
+		setListNodePool(list, pool);
+		deleteNodePool(pool);
+		for (int i = 0; i < 4; i++){
+			insertBack(list, values[i]);
+		}
+
+		failAfter = 1;
+		insertBack(list, values[4]);
+		failAfter = 1;
+		insertFront(list, values[4]);
+		failAfter = 0;
+		if (!isIntact(list, values, 4)){
+			fail(pooled ? "failed pooled insert changed the list" : "failed insert changed the list");
+		}
+
+		//The third malloc fails: the third node, or the third slab of the pool
+		failAfter = 3;
+		if (insertBackArray(list, (void* const*)values + 4, pooled ? 12 : 8) || !isIntact(list, values, 4)){
+			fail("insertBackArray was not all or nothing");
+		}
+		failAfter = 0;
+
+		if (!insertBackArray(list, (void* const*)values + 4, 8) || !isIntact(list, values, 12)){
+			fail("insertBackArray after a failure");
+		}
+		void* withNull[2] = {values[12], NULL};
+		if (insertBackArray(list, withNull, 2) || !insertBackArray(list, withNull, 0) || !isIntact(list, values, 12)){
+			fail("insertBackArray accepted a NULL element");
+		}
+		freeList(list);
+	}
+}
+
+/* ******************************* Documents *************************** */
+
+static bool appendSink(void* userData, const char* data, size_t len){
+	return appendStringLen(userData, data, len);
+}
+
+static char* toXML(const GPXdoc* doc){
+	StringBuilder sb = {NULL, 0, 0};
+	GPXSink sink = {&sb, &appendSink};
+
+	if (doc == NULL || !writeGPXdoc(doc, GPX_FORMAT_XML, &sink)){
+		free(sb.str);
+		return NULL;
+	}
+	return sb.str;
+}
+
+static void checkFile(const char* fileName){
+	long mallocs = numMallocs;
+	double start = now();
+	GPXdoc* plain = createGPXdocWithOptions((char*)fileName, 0);
+	double plainTime = now() - start;
+	long plainMallocs = numMallocs - mallocs;
+
+	mallocs = numMallocs;
+	start = now();
+	GPXdoc* pooled = createGPXdocWithOptions((char*)fileName, GPX_OPT_NODE_POOL);
+	double pooledTime = now() - start;
+	long pooledMallocs = numMallocs - mallocs;
+
+	if ((plain == NULL) != (pooled == NULL)){
+		fail("only one of the parses failed");
+	}else if (plain != NULL){
+		char* plainXML = toXML(plain);
+		char* pooledXML = toXML(pooled);
+
+		if (plainXML == NULL || pooledXML == NULL || strcmp(plainXML, pooledXML) != 0){
+			fail("pooled document differs");
+		}
+		free(plainXML);
+		free(pooledXML);
+	}
+
+	start = now();
+	deleteGPXdoc(plain);
+	double plainFree = now() - start;
+	start = now();
+	deleteGPXdoc(pooled);
+	double pooledFree = now() - start;
+
+	printf("  %-12s %10ld mallocs   parse %8.1f ms   free %7.1f ms\n", "no pool", plainMallocs, plainTime * 1000, plainFree * 1000);
+	printf("  %-12s %10ld mallocs   parse %8.1f ms   free %7.1f ms\n", "node pool", pooledMallocs, pooledTime * 1000, pooledFree * 1000);
+}
+
+int main(int argc, char** argv){
+	int* storage = malloc(NUM_ELEMENTS * sizeof(int));
+	int** values = malloc(NUM_ELEMENTS * sizeof(int*));
+
+	if (storage == NULL || values == NULL){
+		return 1;
+	}
+	for (int i = 0; i < NUM_ELEMENTS; i++){
+		storage[i] = i;
+		values[i] = &storage[i];
+	}
+
+	printf("lists of %d elements\n", NUM_ELEMENTS);
+	benchFill(values, FILL_MALLOC, "insertBack");
+	benchFill(values, FILL_POOL, "insertBack, pool");
+	benchFill(values, FILL_ARRAY, "insertBackArray, pool");
+	checkReuse(values);
+	checkFailures(values);
+
+	for (int i = 1; i < argc; i++){
+		printf("%s\n", argv[i]);
+		checkFile(argv[i]);
+	}
+
+	free(values);
+	free(storage);
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
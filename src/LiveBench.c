@@ -0,0 +1,576 @@
+/*
+ * Check and benchmark for following a GPX file that is still being written (GPXLive.h).
+ *
+ * Usage: LiveBench [-n points] [-f source.gpx] scratch.gpx
+ *   -n  number of track points in the generated document (default 20000)
+ *   -f  replay the bytes of an existing GPX file instead of a generated document
+ *
+ * scratch.gpx is overwritten.  The document is written to it in several ways, with an update after
+ * every write:
+ *   append    in chunks of random size, cut anywhere, even inside a tag
+ *   rewrite   like a logger that writes each point followed by the closing tags, and then overwrites
+ *             those tags with the next point (generated documents only)
+ *   truncate  cut back to an earlier length, then appended again
+ *   change    a byte before the resume point is changed without changing the length
+ *   race      a writer thread appends while the main thread keeps updating
+ * For a generated document the counts of the live document must match the elements that end before
+ * getGPXLiveOffset after every update.  At checkpoints, and whenever the file holds the whole document,
+ * the XML of the live document must be the same as that of a document parsed from scratch.  The time
+ * of an update is compared with parsing the whole file.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "GPXParser.h"
+#include "GPXLive.h"
+#include "GPXWriter.h"
+#include "StringBuilder.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rngState = 0x9e3779b97f4a7c15ULL;
+
+static size_t randomBelow(size_t limit){
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return limit > 0 ? rngState % limit : 0;
+}
+
+/* ******************************* Source document *************************** */
+
+//Elements counted by the checks, and where each one becomes part of the live document: at its end for
+//waypoints, routes and track points, and at the end of its start tag for tracks and segments
+typedef enum {WPT, RTE, TRK, TRKSEG, TRKPT, NUM_KINDS} Kind;
+
+typedef struct {
+	StringBuilder text;
+	size_t* marks[NUM_KINDS];
+	int numMarks[NUM_KINDS];
+	int capacity[NUM_KINDS];
+	bool generated;
+} Source;
+
+static void mark(Source* source, Kind kind){
+	if (source->numMarks[kind] == source->capacity[kind]){
+		source->capacity[kind] = source->capacity[kind] * 2 + 16;
+		source->marks[kind] = realloc(source->marks[kind], source->capacity[kind] * sizeof(size_t));
+	}
+	source->marks[kind][source->numMarks[kind]++] = source->text.len;
+}
+
+//Number of elements of a kind that are complete in the first offset bytes
+static int countBefore(const Source* source, Kind kind, size_t offset){
+	int low = 0;
+	int high = source->numMarks[kind];
+
+	while (low < high){
+		int middle = (low + high) / 2;
+		if (source->marks[kind][middle] <= offset){
+			low = middle + 1;
+		}else{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+static void generate(Source* source, int numPoints){
+	StringBuilder* sb = &source->text;
+	int numTracks = 3;
+	int segmentsPerTrack = 3;
+	int perSegment = numPoints / (numTracks * segmentsPerTrack) + 1;
+	int point = 0;
+
+	appendString(sb, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- written by LiveBench -->\n");
+	appendString(sb, "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" "
+		"xmlns:gpxtpx=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v1\" version=\"1.1\" creator=\"LiveBench\">\n");
+	appendString(sb, "  <metadata><name>Live</name></metadata>\n");
+
+	for (int t = 0; t < numTracks; t++){
+		appendString(sb, "  <trk>");
+		mark(source, TRK);
+		if (t == 1){
+			appendFormat(sb, "<name>Track %d</name>", t);
+		}
+		appendString(sb, "\n");
+		for (int s = 0; s < segmentsPerTrack && point < numPoints; s++){
+			appendString(sb, "    <trkseg>");
+			mark(source, TRKSEG);
+			appendString(sb, "\n");
+			for (int i = 0; i < perSegment && point < numPoints; i++, point++){
+				double lat = 45 + point * 1e-5;
+				double lon = -75.5 + (point % 1000) * 1e-5;
+
+				if (point % 50 == 0){
+					appendString(sb, "      <!-- lap <trkpt> -->\n");
+				}
+				if (point % 7 == 0){
+					appendFormat(sb, "      <trkpt lat=\"%.6f\" lon=\"%.6f\"/>", lat, lon);
+				}else{
+					appendFormat(sb, "      <trkpt lat=\"%.6f\" lon='%.6f'><ele>%.1f</ele><time>2020-09-13T12:%02d:%02dZ</time>"
+						"<extensions><gpxtpx:TrackPointExtension><gpxtpx:hr>%d</gpxtpx:hr></gpxtpx:TrackPointExtension>"
+						"</extensions></trkpt>", lat, lon, 100 + point % 300 * 0.5, point / 60 % 60, point % 60, 90 + point % 80);
+				}
+				mark(source, TRKPT);
+				appendString(sb, "\n");
+			}
+			appendString(sb, "    </trkseg>\n");
+		}
+		if (t == 0){
+			appendString(sb, "    <name>Track 0</name><desc><![CDATA[a > b]]></desc>\n");
+		}
+		appendString(sb, "  </trk>\n");
+
+		appendFormat(sb, "  <wpt lat=\"%d.5\" lon=\"-75.5\"><name>Stop %d</name><desc>caf\xc3\xa9 &amp; bar</desc></wpt>", 45 + t, t);
+		mark(source, WPT);
+		appendString(sb, "\n  <rte><name>Route</name><rtept lat=\"45\" lon=\"-75\"/><rtept lat=\"46\" lon=\"-76\"/></rte>");
+		mark(source, RTE);
+		appendString(sb, "\n");
+	}
+	appendString(sb, "</gpx>\n");
+	source->generated = true;
+}
+
+static bool readSource(Source* source, const char* fileName){
+	FILE* file = fopen(fileName, "rb");
+	char buffer[65536];
+	size_t count;
+
+	if (file == NULL){
+		return false;
+	}
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0){
+		appendStringLen(&source->text, buffer, count);
+	}
+	fclose(file);
+	return source->text.len > 0;
+}
+
+/* ******************************* Checks *************************** */
+
+static int failures;
+
+static bool appendSink(void* userData, const char* data, size_t len){
+	return appendStringLen(userData, data, len);
+}
+
+static char* toXML(const GPXdoc* doc){
+	StringBuilder sb = {NULL, 0, 0};
+	GPXSink sink = {&sb, &appendSink};
+
+	if (doc == NULL || !writeGPXdoc(doc, GPX_FORMAT_XML, &sink)){
+		free(sb.str);
+		return NULL;
+	}
+	return sb.str;
+}
+
+static int countTrackPoints(const GPXdoc* doc){
+	ListIterator tracks = createIterator(doc->tracks);
+	Track* trk;
+	int count = 0;
+
+	while ((trk = nextElement(&tracks)) != NULL){
+		ListIterator segments = createIterator(trk->segments);
+		TrackSegment* seg;
+		while ((seg = nextElement(&segments)) != NULL){
+			count += getLength(seg->waypoints);
+		}
+	}
+	return count;
+}
+
+static void fail(const char* scenario, const char* what){
+	printf("%s: %s\n", scenario, what);
+	failures++;
+}
+
+//Checks the counts of the live document against the elements complete before its offset
+static void checkCounts(const Source* source, GPXLiveFile* live, const char* scenario){
+	GPXdoc* doc = getGPXLiveDoc(live);
+	size_t offset = getGPXLiveOffset(live);
+
+	if (!source->generated || doc == NULL){
+		return;
+	}
+
+	int actual[NUM_KINDS] = {getNumWaypoints(doc), getNumRoutes(doc), getNumTracks(doc), getNumSegments(doc), countTrackPoints(doc)};
+	for (int kind = 0; kind < NUM_KINDS; kind++){
+		int expected = countBefore(source, kind, offset);
+		if (actual[kind] != expected){
+			char what[128];
+			snprintf(what, sizeof(what), "at offset %zu, %d elements of kind %d instead of %d", offset, actual[kind], kind, expected);
+			fail(scenario, what);
+			return;
+		}
+	}
+}
+
+//Checks that the live document is the one read from scratch: by createGPXdoc when the file holds the
+//whole document, and by a new live file otherwise
+static void checkSameAsFresh(GPXLiveFile* live, const char* fileName, bool complete, const char* scenario){
+	GPXdoc* fresh = NULL;
+	GPXLiveFile* freshLive = NULL;
+
+	if (complete){
+		fresh = createGPXdoc((char*)fileName);
+	}else{
+		freshLive = openGPXLiveFile(fileName, 0);
+		fresh = getGPXLiveDoc(freshLive);
+	}
+
+	//A live file keeps its document while the file cannot be read
+	if (freshLive != NULL && fresh == NULL){
+		closeGPXLiveFile(freshLive);
+		return;
+	}
+
+	char* expected = toXML(fresh);
+	char* actual = toXML(getGPXLiveDoc(live));
+	if ((expected == NULL) != (actual == NULL) || (expected != NULL && strcmp(expected, actual) != 0)){
+		fail(scenario, complete ? "differs from createGPXdoc" : "differs from a new live file");
+	}else if (freshLive != NULL && getGPXLiveOffset(freshLive) != getGPXLiveOffset(live)){
+		fail(scenario, "offset differs from a new live file");
+	}
+
+	free(expected);
+	free(actual);
+	if (complete){
+		deleteGPXdoc(fresh);
+	}
+	closeGPXLiveFile(freshLive);
+}
+
+/* ******************************* File writes *************************** */
+
+static void writeAt(int fd, const char* data, size_t length, size_t offset){
+	while (length > 0){
+		ssize_t count = pwrite(fd, data, length, offset);
+		if (count <= 0){
+			perror("pwrite");
+			exit(1);
+		}
+		data += count;
+		length -= count;
+		offset += count;
+	}
+}
+
+static void truncateTo(int fd, size_t length){
+	if (ftruncate(fd, length) != 0){
+		perror("ftruncate");
+		exit(1);
+	}
+}
+
+static size_t randomChunk(size_t average){
+	return 1 + randomBelow(average * 2);
+}
+
+//Returns true if a new live file can read the file
+static bool canRead(const char* fileName){
+	GPXLiveFile* live = openGPXLiveFile(fileName, 0);
+	bool readable = getGPXLiveDoc(live) != NULL;
+
+	closeGPXLiveFile(live);
+	return readable;
+}
+
+/* Appends the source from offset start to the end in chunks, updating after each one.  Updates may only
+   fail while the file cannot be read from scratch either, and only parse the whole file again after
+   failing.  previous is the status of the update before.  Returns the time spent in updates */
+static double appendInChunks(const Source* source, int fd, GPXLiveFile* live, const char* fileName, size_t start,
+                             size_t average, GPXLiveStatus previous, const char* scenario, int* numUpdates){
+	const StringBuilder* text = &source->text;
+	size_t numChunks = text->len / average + 1;
+	size_t checkEvery = numChunks / 8 + 1;
+	size_t chunk = 0;
+	double updateTime = 0;
+
+	for (size_t offset = start; offset < text->len; chunk++){
+		size_t length = randomChunk(average);
+		if (length > text->len - offset){
+			length = text->len - offset;
+		}
+		writeAt(fd, text->str + offset, length, offset);
+		offset += length;
+
+		double begin = now();
+		GPXLiveStatus status = updateGPXLiveFile(live);
+		updateTime += now() - begin;
+		(*numUpdates)++;
+
+		if ((status == GPX_LIVE_FAILED && canRead(fileName)) || (status == GPX_LIVE_RELOADED && previous != GPX_LIVE_FAILED)){
+			char what[128];
+			snprintf(what, sizeof(what), "status %d after appending up to %zu", status, offset);
+			fail(scenario, what);
+		}
+		previous = status;
+		checkCounts(source, live, scenario);
+		if (chunk % checkEvery == 0 && offset < text->len){
+			checkSameAsFresh(live, fileName, false, scenario);
+		}
+	}
+	checkSameAsFresh(live, fileName, true, scenario);
+	return updateTime;
+}
+
+/* ******************************* Scenarios *************************** */
+
+static int openScratch(const char* fileName){
+	int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		perror(fileName);
+		exit(1);
+	}
+	return fd;
+}
+
+static void appendScenario(const Source* source, const char* fileName){
+	int fd = openScratch(fileName);
+	GPXLiveFile* live = openGPXLiveFile(fileName, GPX_OPT_ARENA);
+	int numUpdates = 0;
+	size_t average = source->text.len / 400 + 64;
+
+	double updateTime = appendInChunks(source, fd, live, fileName, 0, average, GPX_LIVE_FAILED, "append", &numUpdates);
+
+	double begin = now();
+	GPXdoc* doc = createGPXdoc((char*)fileName);
+	double parseTime = now() - begin;
+	deleteGPXdoc(doc);
+
+	printf("append: %d updates of %zu bytes on average, %.3f ms per update, full parse %.1f ms\n", numUpdates,
+		average, updateTime * 1000 / numUpdates, parseTime * 1000);
+
+	//The time of one update that appends a single chunk at the end of the file
+	const StringBuilder* text = &source->text;
+	size_t cut = text->len - average;
+	truncateTo(fd, cut);
+	GPXLiveFile* tail = openGPXLiveFile(fileName, 0);
+	writeAt(fd, text->str + cut, text->len - cut, cut);
+	begin = now();
+	GPXLiveStatus status = updateGPXLiveFile(tail);
+	double tailTime = now() - begin;
+	if (status == GPX_LIVE_FAILED){
+		fail("append", "the last chunk could not be read");
+	}
+	printf("append: last %zu bytes of %.1f MB in %.3f ms (%.0fx faster than a full parse)\n", average,
+		text->len / 1048576.0, tailTime * 1000, parseTime / tailTime);
+
+	closeGPXLiveFile(tail);
+	closeGPXLiveFile(live);
+	close(fd);
+}
+
+static void rewriteScenario(const Source* source, const char* fileName){
+	const char* closing = "    </trkseg>\n  </trk>\n</gpx>\n";
+	const StringBuilder* text = &source->text;
+	int fd = openScratch(fileName);
+	GPXLiveFile* live = openGPXLiveFile(fileName, 0);
+	int numPoints = source->numMarks[TRKPT];
+	int step = numPoints / 200 + 1;
+	size_t written = 0;
+
+	for (int i = 0; i < numPoints; i += step){
+		size_t end = source->marks[TRKPT][i];
+		writeAt(fd, text->str + written, end - written, written);
+		writeAt(fd, closing, strlen(closing), end);
+		written = end;
+
+		GPXLiveStatus status = updateGPXLiveFile(live);
+		if (status != (i == 0 ? GPX_LIVE_RELOADED : GPX_LIVE_APPENDED)){
+			char what[128];
+			snprintf(what, sizeof(what), "status %d after point %d", status, i);
+			fail("rewrite", what);
+		}
+		checkCounts(source, live, "rewrite");
+		if (i % (step * 20) == 0){
+			checkSameAsFresh(live, fileName, true, "rewrite");
+		}
+	}
+	closeGPXLiveFile(live);
+	close(fd);
+}
+
+static void truncateScenario(const Source* source, const char* fileName){
+	const StringBuilder* text = &source->text;
+	int fd = openScratch(fileName);
+	GPXLiveFile* live = openGPXLiveFile(fileName, 0);
+	int numUpdates = 0;
+
+	writeAt(fd, text->str, text->len, 0);
+	updateGPXLiveFile(live);
+	for (int round = 0; round < 4; round++){
+		size_t length = round == 0 ? 0 : randomBelow(text->len);
+		size_t offset = getGPXLiveOffset(live);
+
+		truncateTo(fd, length);
+		GPXLiveStatus status = updateGPXLiveFile(live);
+		if (length < offset && status != GPX_LIVE_RELOADED && status != GPX_LIVE_FAILED){
+			fail("truncate", "not parsed again after the file was cut");
+		}
+		if (status != GPX_LIVE_FAILED){
+			checkCounts(source, live, "truncate");
+		}
+		appendInChunks(source, fd, live, fileName, length, text->len / 50 + 64, status, "truncate", &numUpdates);
+	}
+	closeGPXLiveFile(live);
+	close(fd);
+}
+
+static void changeScenario(const Source* source, const char* fileName){
+	const StringBuilder* text = &source->text;
+	int fd = openScratch(fileName);
+	GPXLiveFile* live = openGPXLiveFile(fileName, 0);
+	const char* creator = strstr(text->str, "creator=\"");
+
+	writeAt(fd, text->str, text->len / 2, 0);
+	GPXLiveStatus status = updateGPXLiveFile(live);
+	if (creator != NULL && (size_t)(creator - text->str) + 9 < getGPXLiveOffset(live)){
+		size_t at = creator - text->str + 9;
+		writeAt(fd, "X", 1, at);
+		if (updateGPXLiveFile(live) != GPX_LIVE_RELOADED || getGPXLiveDoc(live)->creator[0] != 'X'){
+			fail("change", "not parsed again after an earlier byte changed");
+		}
+		writeAt(fd, text->str + at, 1, at);
+		status = updateGPXLiveFile(live);
+		if (status != GPX_LIVE_RELOADED){
+			fail("change", "not parsed again after the byte was changed back");
+		}
+	}
+
+	int numUpdates = 0;
+	appendInChunks(source, fd, live, fileName, text->len / 2, text->len / 50 + 64, status, "change", &numUpdates);
+	closeGPXLiveFile(live);
+	close(fd);
+}
+
+typedef struct {
+	const Source* source;
+	int fd;
+	atomic_bool done;
+} Writer;
+
+static void* writeSlowly(void* arg){
+	Writer* writer = arg;
+	const StringBuilder* text = &writer->source->text;
+	size_t average = text->len / 300 + 64;
+
+	for (size_t offset = 0; offset < text->len;){
+		size_t length = randomChunk(average);
+		if (length > text->len - offset){
+			length = text->len - offset;
+		}
+		writeAt(writer->fd, text->str + offset, length, offset);
+		offset += length;
+
+		struct timespec pause = {0, (long)randomBelow(200000)};
+		nanosleep(&pause, NULL);
+	}
+	atomic_store(&writer->done, true);
+	return NULL;
+}
+
+static void raceScenario(const Source* source, const char* fileName){
+	Writer writer = {source, openScratch(fileName), false};
+	GPXLiveFile* live = openGPXLiveFile(fileName, GPX_OPT_ARENA);
+	pthread_t thread;
+	int numUpdates = 0;
+	int numAppended = 0;
+
+	pthread_create(&thread, NULL, &writeSlowly, &writer);
+	while (!atomic_load(&writer.done)){
+		size_t offset = getGPXLiveOffset(live);
+		GPXLiveStatus status = updateGPXLiveFile(live);
+
+		numUpdates++;
+		numAppended += status == GPX_LIVE_APPENDED;
+		if ((status == GPX_LIVE_FAILED && getGPXLiveDoc(live) != NULL) || (status == GPX_LIVE_RELOADED && offset > 0) ||
+		    getGPXLiveOffset(live) < offset){
+			char what[128];
+			snprintf(what, sizeof(what), "status %d with the offset going from %zu to %zu", status, offset, getGPXLiveOffset(live));
+			fail("race", what);
+		}
+		checkCounts(source, live, "race");
+	}
+	pthread_join(thread, NULL);
+
+	updateGPXLiveFile(live);
+	checkCounts(source, live, "race");
+	checkSameAsFresh(live, fileName, true, "race");
+	printf("race: %d updates while writing, %d appended\n", numUpdates, numAppended);
+
+	closeGPXLiveFile(live);
+	close(writer.fd);
+}
+
+int main(int argc, char** argv){
+	const char* sourceName = NULL;
+	int numPoints = 20000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:f:")) != -1){
+		switch (opt){
+			case 'n':
+				numPoints = atoi(optarg);
+				break;
+			case 'f':
+				sourceName = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-n points] [-f source.gpx] scratch.gpx\n", argv[0]);
+				return 1;
+		}
+	}
+	if (argc - optind != 1 || numPoints < 1){
+		fprintf(stderr, "Usage: %s [-n points] [-f source.gpx] scratch.gpx\n", argv[0]);
+		return 1;
+	}
+
+	Source source;
+	memset(&source, 0, sizeof(Source));
+	if (sourceName != NULL && !readSource(&source, sourceName)){
+		fprintf(stderr, "Could not read %s\n", sourceName);
+		return 1;
+	}
+	if (sourceName == NULL){
+		generate(&source, numPoints);
+	}
+
+	const char* fileName = argv[optind];
+	GPXdoc* check = createGPXdocFromMemory(source.text.str, source.text.len, 0);
+	if (check == NULL){
+		fprintf(stderr, "%s is not a valid GPX file\n", sourceName != NULL ? sourceName : "The generated document");
+		return 1;
+	}
+	deleteGPXdoc(check);
+	printf("%s: %.1f MB\n", sourceName != NULL ? sourceName : "generated", source.text.len / 1048576.0);
+
+	appendScenario(&source, fileName);
+	if (source.generated){
+		rewriteScenario(&source, fileName);
+	}
+	truncateScenario(&source, fileName);
+	changeScenario(&source, fileName);
+	raceScenario(&source, fileName);
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	free(source.text.str);
+	for (int kind = 0; kind < NUM_KINDS; kind++){
+		free(source.marks[kind]);
+	}
+	return failures == 0 ? 0 : 1;
+}
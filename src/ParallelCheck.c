@@ -0,0 +1,284 @@
+/*
+ * Check that a parse on several threads (GPXParallel.h) gives the same document as a serial one.
+ *
+ * Usage: ParallelCheck [file.gpx...]
+ *
+ * Documents of a few MB are generated with tracks only, with routes only, with waypoints, routes and
+ * tracks mixed, with every element under a namespace prefix, and with a DOCTYPE, which the scan must
+ * reject so that the document is parsed in one piece.  Each of them, and each file given, is parsed
+ * with createGPXdocFromMemory and with parseGPXParallel on 2, 8 and 32 threads, with no options,
+ * GPX_OPT_ARENA and GPX_OPT_TYPED_ONLY.  Both documents must print the same with GPXdocToString, have
+ * the same counts, and pass checkGPXCounts.  A line per document gives its counts and whether the scan
+ * split it.
+ *
+ * Exits with 1 on any difference.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "GPXParser.h"
+#include "GPXParallel.h"
+#include "GPXScan.h"
+#include "StringBuilder.h"
+
+#define NUM_POINTS 20000
+
+static const int threadCounts[] = {2, 8, 32};
+static const unsigned int optionSets[] = {0, GPX_OPT_ARENA, GPX_OPT_TYPED_ONLY};
+static const char* optionNames[] = {"default", "arena", "typed only"};
+
+#define NUM_THREAD_COUNTS (sizeof(threadCounts) / sizeof(threadCounts[0]))
+#define NUM_OPTION_SETS (sizeof(optionSets) / sizeof(optionSets[0]))
+
+/* ******************************* Generated documents *************************** */
+
+typedef enum {
+	DOC_TRACKS,
+	DOC_ROUTES,
+	DOC_MIXED,
+	DOC_PREFIXED,
+	DOC_DOCTYPE
+} DocKind;
+
+typedef struct {
+	const char* name;
+	DocKind kind;
+	//Whether scanGPXDocument must accept the document, so that it is really split
+	bool splits;
+} Generated;
+
+static const Generated generated[] = {
+	{"tracks", DOC_TRACKS, true},
+	{"routes", DOC_ROUTES, true},
+	{"mixed", DOC_MIXED, true},
+	{"prefixed", DOC_PREFIXED, true},
+	{"doctype", DOC_DOCTYPE, false},
+};
+
+#define NUM_GENERATED (sizeof(generated) / sizeof(generated[0]))
+
+//Appends a point named tag.  The children vary with i: typed ones, others that stay in otherData, text
+//with entities and CDATA, an extension, or none at all
+static void appendPoint(StringBuilder* sb, const char* p, const char* tag, int i){
+	double lat = 45 + (i % 5000) * 1e-4;
+	double lon = -75.5 + (i % 7000) * 1e-4;
+
+	if (i % 11 == 0){
+		appendFormat(sb, "<%s%s lat=\"%.6f\" lon=\"%.6f\"/>\n", p, tag, lat, lon);
+		return;
+	}
+	appendFormat(sb, "<%s%s lat=\"%.6f\" lon='%.6f'>", p, tag, lat, lon);
+	appendFormat(sb, "<%sele>%d.%d</%sele>", p, 100 + i % 300, i % 10, p);
+	if (i % 3 != 0){
+		appendFormat(sb, "<%stime>2020-09-13T%02d:%02d:%02dZ</%stime>", p, i / 3600 % 24, i / 60 % 60, i % 60, p);
+	}
+	if (i % 5 == 0){
+		appendFormat(sb, "<%sname>P%d</%sname><%ssym>Flag</%ssym>", p, i, p, p, p);
+	}
+	if (i % 7 == 0){
+		appendFormat(sb, "<%sdesc>a &amp; b <![CDATA[<c>]]></%sdesc><%ssat>%d</%ssat><%shdop>1.%d</%shdop>",
+		             p, p, p, i % 12, p, p, i % 10, p);
+	}
+	if (i % 13 == 0){
+		appendFormat(sb, "<%sextensions><x:hr xmlns:x=\"urn:x\">%d</x:hr></%sextensions>", p, 80 + i % 40, p);
+	}
+	appendFormat(sb, "</%s%s>\n", p, tag);
+}
+
+static void appendRoute(StringBuilder* sb, const char* p, int index, int numPoints, int* next){
+	appendFormat(sb, "<%srte><%sname>Route %d</%sname><%sdesc>route</%sdesc>\n", p, p, index, p, p, p);
+	for (int i = 0; i < numPoints; i++){
+		appendPoint(sb, p, "rtept", (*next)++);
+		if (i % 500 == 499){
+			appendString(sb, "<!-- lap -->\n");
+		}
+	}
+	appendFormat(sb, "</%srte>\n", p);
+}
+
+static void appendTrack(StringBuilder* sb, const char* p, int index, int numSegments, int numPoints, int* next){
+	appendFormat(sb, "<%strk><%sname>Track %d</%sname><%stype>run</%stype>\n", p, p, index, p, p, p);
+	for (int s = 0; s < numSegments; s++){
+		appendFormat(sb, "<%strkseg>\n", p);
+		for (int i = 0; i < numPoints / numSegments; i++){
+			appendPoint(sb, p, "trkpt", (*next)++);
+		}
+		appendFormat(sb, "</%strkseg>\n", p);
+	}
+	appendFormat(sb, "</%strk>\n", p);
+}
+
+static char* generate(DocKind kind, size_t* length){
+	StringBuilder sb = {NULL, 0, 0};
+	const char* p = kind == DOC_PREFIXED ? "g:" : "";
+	int next = 0;
+
+	appendString(&sb, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	if (kind == DOC_DOCTYPE){
+		appendString(&sb, "<!DOCTYPE gpx>\n");
+	}
+	appendFormat(&sb, "<%sgpx %s=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"ParallelCheck\">\n",
+	             p, kind == DOC_PREFIXED ? "xmlns:g" : "xmlns");
+	appendFormat(&sb, "<%smetadata><%sname>%s</%sname></%smetadata>\n", p, p, "Check", p, p);
+
+	switch (kind){
+		case DOC_TRACKS:
+			//One track of many segments, one of a single long segment, and a short one
+			appendTrack(&sb, p, 0, 40, NUM_POINTS / 2, &next);
+			appendTrack(&sb, p, 1, 1, NUM_POINTS / 2, &next);
+			appendTrack(&sb, p, 2, 1, 10, &next);
+			break;
+		case DOC_ROUTES:
+			appendRoute(&sb, p, 0, NUM_POINTS / 2, &next);
+			for (int i = 1; i <= 50; i++){
+				appendRoute(&sb, p, i, NUM_POINTS / 100, &next);
+			}
+			break;
+		default:
+			for (int i = 0; i < 500; i++){
+				appendPoint(&sb, p, "wpt", next++);
+			}
+			for (int i = 0; i < 4; i++){
+				appendRoute(&sb, p, i, NUM_POINTS / 10, &next);
+				appendTrack(&sb, p, i, 1 + 4 * i, NUM_POINTS / 10, &next);
+				appendPoint(&sb, p, "wpt", next++);
+			}
+			break;
+	}
+
+	appendFormat(&sb, "</%sgpx>\n", p);
+	*length = sb.len;
+	return sb.str;
+}
+
+/* ******************************* Comparison *************************** */
+
+static bool scanAccepts(const char* data, size_t length){
+	Scan scan;
+	memset(&scan, 0, sizeof(scan));
+	scan.data = data;
+	scan.size = length;
+	scan.unitSize = SIZE_MAX;
+
+	bool ok = scanGPXDocument(&scan);
+	clearGPXScan(&scan);
+	return ok;
+}
+
+static bool sameCounts(const GPXdoc* first, const GPXdoc* second){
+	return getNumWaypoints(first) == getNumWaypoints(second) && getNumRoutes(first) == getNumRoutes(second) &&
+	       getNumTracks(first) == getNumTracks(second) && getNumSegments(first) == getNumSegments(second) &&
+	       getNumGPXData(first) == getNumGPXData(second);
+}
+
+//Compares the parallel parses of data with the serial one and prints a line for the document.  Returns the
+//number of differences
+static int checkDocument(const char* name, const char* data, size_t length){
+	int failures = 0;
+	int counts[5] = {0};
+
+	for (size_t o = 0; o < NUM_OPTION_SETS; o++){
+		GPXdoc* serial = createGPXdocFromMemory(data, length, optionSets[o]);
+		char* serialText = serial != NULL ? GPXdocToString(serial) : NULL;
+
+		if (serialText == NULL || !checkGPXCounts(serial)){
+			printf("  %-10s %-10s serial parse failed\n", name, optionNames[o]);
+			failures++;
+		}else if (o == 0){
+			int serialCounts[] = {getNumWaypoints(serial), getNumRoutes(serial), getNumTracks(serial),
+			                      getNumSegments(serial), getNumGPXData(serial)};
+			memcpy(counts, serialCounts, sizeof(counts));
+		}
+
+		for (size_t t = 0; serialText != NULL && t < NUM_THREAD_COUNTS; t++){
+			GPXdoc* parallel = parseGPXParallel(data, length, name, optionSets[o], threadCounts[t]);
+			char* parallelText = parallel != NULL ? GPXdocToString(parallel) : NULL;
+			const char* problem = NULL;
+
+			if (parallelText == NULL){
+				problem = "parse failed";
+			}else if (strcmp(serialText, parallelText) != 0){
+				problem = "GPXdocToString differs";
+			}else if (!sameCounts(serial, parallel)){
+				problem = "counts differ";
+			}else if (!checkGPXCounts(parallel)){
+				problem = "checkGPXCounts failed";
+			}
+
+			if (problem != NULL){
+				printf("  %-10s %-10s %2d threads: %s\n", name, optionNames[o], threadCounts[t], problem);
+				failures++;
+			}
+			free(parallelText);
+			deleteGPXdoc(parallel);
+		}
+
+		free(serialText);
+		deleteGPXdoc(serial);
+	}
+
+	printf("%-10s %5.1f MB %-6s %4d wpt %4d rte %4d trk %4d trkseg %6d GPXData   %s\n", name,
+	       length / (1024.0 * 1024.0), scanAccepts(data, length) ? "split" : "serial", counts[0], counts[1], counts[2],
+	       counts[3], counts[4], failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+static char* readFile(const char* fileName, size_t* length){
+	FILE* fp = fopen(fileName, "rb");
+	char* data = NULL;
+
+	if (fp != NULL && fseek(fp, 0, SEEK_END) == 0){
+		long size = ftell(fp);
+
+		data = size > 0 ? malloc(size) : NULL;
+		rewind(fp);
+		if (data != NULL && fread(data, 1, size, fp) != (size_t)size){
+			free(data);
+			data = NULL;
+		}
+		*length = size;
+	}
+	if (fp != NULL){
+		fclose(fp);
+	}
+	return data;
+}
+
+int main(int argc, char** argv){
+	int failures = 0;
+
+	for (size_t i = 0; i < NUM_GENERATED; i++){
+		size_t length;
+		char* data = generate(generated[i].kind, &length);
+
+		if (data == NULL){
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		if (scanAccepts(data, length) != generated[i].splits){
+			printf("  %-10s scan %s the document\n", generated[i].name, generated[i].splits ? "rejects" : "accepts");
+			failures++;
+		}
+
+		failures += checkDocument(generated[i].name, data, length);
+		free(data);
+	}
+
+	for (int i = 1; i < argc; i++){
+		size_t length = 0;
+		char* data = readFile(argv[i], &length);
+
+		if (data == NULL){
+			printf("%s: cannot read\n", argv[i]);
+			failures++;
+			continue;
+		}
+
+		failures += checkDocument(argv[i], data, length);
+		free(data);
+	}
+
+	printf("%s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
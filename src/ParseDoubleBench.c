@@ -0,0 +1,213 @@
+/*
+ * Equivalence test and benchmark for parseGPXDouble, the number parser used for lat, lon and <ele>.
+ *
+ * Usage: ParseDoubleBench [cases]
+ *   Compares parseGPXDouble with strtod on the given number of generated inputs (default 2000000):
+ *   coordinates and elevations as GPX files write them, random doubles in every notation, random digit
+ *   strings with long mantissas and extreme exponents, and malformed text.  Both must accept or reject
+ *   each input alike and agree to the bit on the value.  The check is repeated with a locale that uses
+ *   a decimal comma, if one is installed.  Then times both parsers on typical coordinates.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <locale.h>
+#include <time.h>
+#include "GPXHelpers.h"
+
+#define BENCH_VALUES 1000000
+#define BENCH_ROUNDS 5
+
+static const char* fixedCases[] = {
+	"0", "-0", "+0", "0.0", "-0.0", ".5", "5.", ".", "-", "+", "", " ", "1e", "1e+", "1e-", "e5", "1.5e3",
+	"1E-3", "-.5e-2", "00000000000000000000001.5", "0.000000000000000000000000000001", "1,5", "1.5.2",
+	" 45.5 ", "\t-73.25\n", "45.5x", "0x1p3", "0X1P-2", "inf", "-Infinity", "nan", "NAN(123)",
+	"9007199254740992", "9007199254740993", "18446744073709551615", "18446744073709551616",
+	"1e22", "1e23", "1e-22", "1e-23", "1e308", "1e309", "4.9e-324", "2.4703282292062327e-324",
+	"2.2250738585072011e-308", "1.7976931348623157e308", "123456789012345678901234567890",
+	"0.1", "0.2", "0.3", "3.141592653589793238462643383279", "1e99999999999", "1e-99999999999"
+};
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void){
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static int randomInt(int n){
+	return (int)(nextRandom() % n);
+}
+
+static double randomDouble(double low, double high){
+	return low + (high - low) * (nextRandom() >> 11) / 9007199254740992.0;
+}
+
+static void generateCase(char* buf, size_t size){
+	switch (randomInt(6)){
+		case 0:
+			snprintf(buf, size, "%.*f", randomInt(10), randomDouble(-180, 180));
+			break;
+		case 1:
+			snprintf(buf, size, "%.*f", randomInt(3), randomDouble(-500, 9000));
+			break;
+		case 2: {
+			uint64_t bits = nextRandom();
+			double value;
+			memcpy(&value, &bits, sizeof(value));
+			if (randomInt(2)){
+				snprintf(buf, size, "%.17g", value);
+			}else{
+				snprintf(buf, size, "%.*e", randomInt(18), value);
+			}
+			break;
+		}
+		case 3:
+			snprintf(buf, size, "%.*g", 1 + randomInt(17), randomDouble(-1, 1) * pow(10, randomInt(60) - 30));
+			break;
+		default: {
+			//Random digits, point, sign and exponent, with the occasional stray character
+			size_t len = 0;
+			int digits = 1 + randomInt(25);
+			int point = randomInt(digits + 2);
+
+			if (randomInt(3) == 0){
+				buf[len++] = "-+"[randomInt(2)];
+			}
+			for (int i = 0; i < digits; i++){
+				if (i == point){
+					buf[len++] = '.';
+				}
+				buf[len++] = randomInt(4) == 0 ? '0' : '0' + randomInt(10);
+			}
+			if (randomInt(3) == 0){
+				len += snprintf(buf + len, size - len, "e%d", randomInt(700) - 350);
+			}
+			if (randomInt(20) == 0){
+				buf[randomInt(len)] = " .e-x,"[randomInt(6)];
+			}
+			buf[len] = '\0';
+		}
+	}
+}
+
+//Reference behaviour: strtod in the C locale, rejecting inputs with anything but whitespace after the number
+static bool referenceParse(const char* str, double* result){
+	char* end;
+	double value = strtod(str, &end);
+
+	if (end == str){
+		return false;
+	}
+	while (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r'){
+		end++;
+	}
+	*result = value;
+	return *end == '\0';
+}
+
+static int compareCase(const char* str){
+	double expected = 0;
+	double actual = 0;
+	bool expectedOk = referenceParse(str, &expected);
+	bool actualOk = parseGPXDouble(str, &actual);
+
+	if (expectedOk != actualOk || (expectedOk && memcmp(&expected, &actual, sizeof(double)) != 0 && !(isnan(expected) && isnan(actual)))){
+		printf("Mismatch on \"%s\": strtod %s %.17g, parseGPXDouble %s %.17g\n", str,
+			expectedOk ? "accepts" : "rejects", expected, actualOk ? "accepts" : "rejects", actual);
+		return 1;
+	}
+	return 0;
+}
+
+static int checkLocale(const char* name){
+	if (setlocale(LC_NUMERIC, name) == NULL){
+		printf("Locale %s is not installed, skipped\n", name);
+		return 0;
+	}
+
+	double value = 0;
+	int failed = !parseGPXDouble("45.123456789", &value) || value != 45.123456789 ||
+	             !parseGPXDouble("1.7976931348623157e308", &value) || value != 1.7976931348623157e308 ||
+	             parseGPXDouble("45,5", &value);
+	printf("Locale %s: %s\n", name, failed ? "FAILED" : "ok");
+	setlocale(LC_NUMERIC, "C");
+	return failed;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchmark(void){
+	char (*values)[24] = malloc(BENCH_VALUES * sizeof(*values));
+	if (values == NULL){
+		return;
+	}
+
+	for (int i = 0; i < BENCH_VALUES; i++){
+		switch (i % 3){
+			case 0:
+				snprintf(values[i], sizeof(values[i]), "%.7f", randomDouble(-90, 90));
+				break;
+			case 1:
+				snprintf(values[i], sizeof(values[i]), "%.7f", randomDouble(-180, 180));
+				break;
+			default:
+				snprintf(values[i], sizeof(values[i]), "%.1f", randomDouble(-100, 4000));
+		}
+	}
+
+	double best[2] = {1e9, 1e9};
+	volatile double sink = 0;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++){
+		double start = now();
+		for (int i = 0; i < BENCH_VALUES; i++){
+			sink += strtod(values[i], NULL);
+		}
+		double elapsed = now() - start;
+		best[0] = elapsed < best[0] ? elapsed : best[0];
+
+		start = now();
+		for (int i = 0; i < BENCH_VALUES; i++){
+			double value;
+			parseGPXDouble(values[i], &value);
+			sink += value;
+		}
+		elapsed = now() - start;
+		best[1] = elapsed < best[1] ? elapsed : best[1];
+	}
+
+	printf("%-16s %8.1f ns/value\n", "strtod", best[0] * 1e9 / BENCH_VALUES);
+	printf("%-16s %8.1f ns/value  (%.2fx)\n", "parseGPXDouble", best[1] * 1e9 / BENCH_VALUES, best[0] / best[1]);
+	free(values);
+}
+
+int main(int argc, char** argv){
+	long cases = argc > 1 ? atol(argv[1]) : 2000000;
+	int failed = 0;
+	char buf[128];
+
+	for (size_t i = 0; i < sizeof(fixedCases) / sizeof(fixedCases[0]); i++){
+		failed += compareCase(fixedCases[i]);
+	}
+	for (long i = 0; i < cases && failed < 20; i++){
+		generateCase(buf, sizeof(buf));
+		failed += compareCase(buf);
+	}
+	printf("%ld generated cases: %s\n", cases, failed == 0 ? "ok" : "FAILED");
+
+	failed += checkLocale("de_DE.UTF-8");
+	failed += checkLocale("fr_FR.UTF-8");
+
+	benchmark();
+	return failed == 0 ? 0 : 1;
+}
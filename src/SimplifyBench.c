@@ -0,0 +1,383 @@
+/*
+ * Equivalence test and benchmark for track simplification.
+ *
+ * Usage: SimplifyBench [file.gpx]
+ *   Simplifies the longest track of the file, or a generated track of 1000000 points (a noisy random
+ *   walk in two segments) if none is given, with both methods at several tolerances and reports the
+ *   time and the number of points kept.  Checks that:
+ *     - no point removed by Douglas-Peucker is farther than the tolerance from the simplified line
+ *     - both methods match a straightforward reference (recursive Douglas-Peucker, quadratic
+ *       Visvalingam-Whyatt) on the first points of the track
+ *     - every precomputed level matches simplifyTrack at the level's tolerance
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "GPXParser.h"
+#include "GPXHelpers.h"
+#include "GPXSimplify.h"
+#include "GPXDistance.h"
+
+#define GENERATED_POINTS 1000000
+#define REFERENCE_POINTS 4000
+#define NUM_LEVELS 12
+
+static const double tolerances[] = {1, 5, 20, 100};
+static const char* methodNames[] = {"douglas-peucker", "visvalingam"};
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void){
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static double nextUniform(void){
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//The bench owns the generated waypoints through the document; lists built here only borrow them
+static void keepData(void* data){
+}
+
+static List* createBorrowedList(void){
+	return initializeList(&waypointToString, &keepData, &compareWaypoints);
+}
+
+//A track of GENERATED_POINTS points: a random walk with a slowly turning heading and GPS-like jitter
+static GPXdoc* generateDocument(void){
+	GPXdoc* doc = createEmptyGPXdoc();
+	Track* trk = createTrack();
+	double lat = 43.5;
+	double lon = -80.5;
+	double heading = 0;
+
+	insertBack(doc->tracks, trk);
+	for (int s = 0; s < 2; s++){
+		TrackSegment* seg = createTrackSegment();
+		insertBack(trk->segments, seg);
+
+		for (int i = 0; i < GENERATED_POINTS / 2; i++){
+			Waypoint* wpt = createWaypoint();
+
+			heading += (nextUniform() - 0.5) * 0.3;
+			lat += cos(heading) * 0.00003;
+			lon += sin(heading) * 0.00004;
+			wpt->latitude = lat + (nextUniform() - 0.5) * 0.00002;
+			wpt->longitude = lon + (nextUniform() - 0.5) * 0.00002;
+			insertBack(seg->waypoints, wpt);
+		}
+	}
+	return doc;
+}
+
+static Track* findLongestTrack(const GPXdoc* doc){
+	ListIterator iter = createIterator(doc->tracks);
+	Track* trk;
+	Track* longest = NULL;
+	long most = -1;
+
+	while ((trk = nextElement(&iter)) != NULL){
+		long count = 0;
+		ListIterator segIter = createIterator(trk->segments);
+		TrackSegment* seg;
+
+		while ((seg = nextElement(&segIter)) != NULL){
+			count += getLength(seg->waypoints);
+		}
+		if (count > most){
+			most = count;
+			longest = trk;
+		}
+	}
+	return longest;
+}
+
+/* ******************************* Reference *************************** */
+
+//Points projected the way the library does: equirectangular around the mean latitude
+typedef struct {
+	int count;
+	const Waypoint** points;
+	double* x;
+	double* y;
+	bool* kept;
+} Projected;
+
+static double meanLatitude(List* waypoints, double sum, int* count){
+	ListIterator iter = createIterator(waypoints);
+	const Waypoint* wpt;
+
+	while ((wpt = nextElement(&iter)) != NULL){
+		if (isfinite(wpt->latitude) && isfinite(wpt->longitude)){
+			sum += wpt->latitude;
+			(*count)++;
+		}
+	}
+	return sum;
+}
+
+//latitude is the mean latitude of the whole input given to the library, which may span several lists
+static void project(Projected* p, List* waypoints, double latitude){
+	ListIterator iter = createIterator(waypoints);
+	const Waypoint* wpt;
+
+	p->count = 0;
+	p->points = malloc(sizeof(Waypoint*) * (getLength(waypoints) + 1));
+	p->x = malloc(sizeof(double) * (getLength(waypoints) + 1));
+	p->y = malloc(sizeof(double) * (getLength(waypoints) + 1));
+	p->kept = calloc(getLength(waypoints) + 1, sizeof(bool));
+	while ((wpt = nextElement(&iter)) != NULL){
+		if (isfinite(wpt->latitude) && isfinite(wpt->longitude)){
+			p->points[p->count++] = wpt;
+		}
+	}
+
+	double scale = EARTH_RADIUS * M_PI / 180.0;
+	double xScale = scale * cos(latitude * M_PI / 180.0);
+	for (int i = 0; i < p->count; i++){
+		p->x[i] = p->points[i]->longitude * xScale;
+		p->y[i] = p->points[i]->latitude * scale;
+	}
+}
+
+static void clearProjected(Projected* p){
+	free(p->points);
+	free(p->x);
+	free(p->y);
+	free(p->kept);
+}
+
+static double segmentDistance(const Projected* p, int a, int b, int i){
+	double dx = p->x[b] - p->x[a];
+	double dy = p->y[b] - p->y[a];
+	double px = p->x[i] - p->x[a];
+	double py = p->y[i] - p->y[a];
+	double length2 = dx * dx + dy * dy;
+	double t = length2 > 0 ? (px * dx + py * dy) / length2 : 0;
+
+	t = t < 0 ? 0 : t > 1 ? 1 : t;
+	return hypot(px - t * dx, py - t * dy);
+}
+
+static void referenceDouglasPeucker(Projected* p, int first, int last, double tolerance){
+	double farthest = -1;
+	int split = -1;
+
+	for (int i = first + 1; i < last; i++){
+		double d = segmentDistance(p, first, last, i);
+		if (d > farthest){
+			farthest = d;
+			split = i;
+		}
+	}
+	if (split >= 0 && farthest > tolerance){
+		p->kept[split] = true;
+		referenceDouglasPeucker(p, first, split, tolerance);
+		referenceDouglasPeucker(p, split, last, tolerance);
+	}
+}
+
+static void referenceVisvalingam(Projected* p, double tolerance){
+	int* alive = malloc(sizeof(int) * p->count);
+	int n = p->count;
+	double removed = 0;
+
+	for (int i = 0; i < n; i++){
+		alive[i] = i;
+	}
+	while (n > 2){
+		int best = -1;
+		double bestArea = INFINITY;
+
+		for (int k = 1; k < n - 1; k++){
+			int a = alive[k - 1], i = alive[k], b = alive[k + 1];
+			double area = fabs((p->x[i] - p->x[a]) * (p->y[b] - p->y[a]) - (p->x[b] - p->x[a]) * (p->y[i] - p->y[a])) / 2;
+			if (area < bestArea){
+				bestArea = area;
+				best = k;
+			}
+		}
+		if (bestArea < removed){
+			bestArea = removed;
+		}
+		if (bestArea > tolerance * tolerance){
+			break;
+		}
+		removed = bestArea;
+		memmove(alive + best, alive + best + 1, sizeof(int) * (n - best - 1));
+		n--;
+	}
+	for (int k = 0; k < n; k++){
+		p->kept[alive[k]] = true;
+	}
+	free(alive);
+}
+
+//Whether result holds exactly the points marked as kept in p
+static bool matchesReference(const Projected* p, const GPXSimplified* result){
+	int k = 0;
+
+	for (int i = 0; i < p->count; i++){
+		if (p->kept[i] && (k >= result->numPoints || result->points[k++] != p->points[i])){
+			return false;
+		}
+	}
+	return k == result->numPoints;
+}
+
+static int checkReference(const Track* trk){
+	TrackSegment* seg = getFromFront(trk->segments);
+	if (seg == NULL){
+		return 0;
+	}
+
+	List* subset = createBorrowedList();
+	ListIterator iter = createIterator(seg->waypoints);
+	Waypoint* wpt;
+	int failed = 0;
+	int count = 0;
+
+	for (int i = 0; i < REFERENCE_POINTS && (wpt = nextElement(&iter)) != NULL; i++){
+		insertBack(subset, wpt);
+	}
+	double latitude = meanLatitude(subset, 0, &count) / count;
+	if (count == 0){
+		freeList(subset);
+		return 0;
+	}
+
+	for (size_t t = 0; t < sizeof(tolerances) / sizeof(tolerances[0]); t++){
+		for (int method = 0; method < 2; method++){
+			Projected p;
+			project(&p, subset, latitude);
+			p.kept[0] = p.kept[p.count - 1] = true;
+			if (method == GPX_SIMPLIFY_DOUGLAS_PEUCKER){
+				referenceDouglasPeucker(&p, 0, p.count - 1, tolerances[t]);
+			}else{
+				referenceVisvalingam(&p, tolerances[t]);
+			}
+
+			GPXSimplified* result = simplifyWaypoints(subset, method, tolerances[t]);
+			if (!matchesReference(&p, result)){
+				printf("Mismatch with the reference %s at %g m\n", methodNames[method], tolerances[t]);
+				failed++;
+			}
+			deleteSimplified(result);
+			clearProjected(&p);
+		}
+	}
+	freeList(subset);
+	return failed;
+}
+
+//Number of points of a segment that Douglas-Peucker removed and that are farther than tolerance from the
+//simplified line
+static int checkErrorBound(const TrackSegment* seg, double latitude, const GPXSimplified* result, int part, double tolerance){
+	Projected p;
+	int violations = 0;
+	int k = result->partStart[part];
+	int previous = 0;
+
+	project(&p, seg->waypoints, latitude);
+	for (int i = 0; i < p.count; i++){
+		if (k < result->partStart[part + 1] && p.points[i] == result->points[k]){
+			for (int j = previous + 1; j < i; j++){
+				violations += segmentDistance(&p, previous, i, j) > tolerance * (1 + 1e-9);
+			}
+			previous = i;
+			k++;
+		}
+	}
+	clearProjected(&p);
+	return violations;
+}
+
+static bool sameResult(const GPXSimplified* a, const GPXSimplified* b){
+	return a->numPoints == b->numPoints && a->numParts == b->numParts &&
+	       memcmp(a->points, b->points, sizeof(Waypoint*) * a->numPoints) == 0 &&
+	       memcmp(a->partStart, b->partStart, sizeof(int) * (a->numParts + 1)) == 0;
+}
+
+int main(int argc, char** argv){
+	GPXdoc* doc = argc > 1 ? createGPXdoc(argv[1]) : generateDocument();
+	Track* trk = doc != NULL ? findLongestTrack(doc) : NULL;
+
+	if (trk == NULL){
+		fprintf(stderr, "No track in %s\n", argc > 1 ? argv[1] : "the generated document");
+		deleteGPXdoc(doc);
+		return 1;
+	}
+
+	int numPoints = 0;
+	double latitude = 0;
+	ListIterator iter = createIterator(trk->segments);
+	TrackSegment* seg;
+	while ((seg = nextElement(&iter)) != NULL){
+		latitude = meanLatitude(seg->waypoints, latitude, &numPoints);
+	}
+	latitude /= numPoints;
+	printf("%d points in %d segments\n", numPoints, getLength(trk->segments));
+
+	int failed = checkReference(trk);
+
+	for (int method = 0; method < 2; method++){
+		for (size_t t = 0; t < sizeof(tolerances) / sizeof(tolerances[0]); t++){
+			double begin = now();
+			GPXSimplified* result = simplifyTrack(trk, method, tolerances[t]);
+			double elapsed = now() - begin;
+
+			int violations = 0;
+			if (method == GPX_SIMPLIFY_DOUGLAS_PEUCKER){
+				iter = createIterator(trk->segments);
+				for (int part = 0; (seg = nextElement(&iter)) != NULL; part++){
+					violations += checkErrorBound(seg, latitude, result, part, tolerances[t]);
+				}
+				failed += violations;
+			}
+			printf("%-16s %6g m  %8d points kept  %8.1f ms%s\n", methodNames[method], tolerances[t], result->numPoints,
+				elapsed * 1e3, violations > 0 ? "  ERROR BOUND EXCEEDED" : "");
+			deleteSimplified(result);
+		}
+
+		double begin = now();
+		GPXSimplifyLevels* levels = createTrackLevels(trk, method, 0.5, NUM_LEVELS);
+		double buildTime = now() - begin;
+
+		begin = now();
+		long total = 0;
+		for (int i = 0; i < 1000000; i++){
+			total += getSimplifyLevel(levels, ldexp(0.5, i % NUM_LEVELS))->numPoints;
+		}
+		double lookupTime = now() - begin;
+
+		int mismatches = 0;
+		for (int i = 0; i < getSimplifyLevelCount(levels); i++){
+			GPXSimplified* direct = simplifyTrack(trk, method, getSimplifyLevelTolerance(levels, i));
+			mismatches += !sameResult(direct, getSimplifyLevel(levels, getSimplifyLevelTolerance(levels, i)));
+			deleteSimplified(direct);
+		}
+		failed += mismatches;
+
+		printf("%-16s %d levels from 0.5 m built in %.1f ms, %.0f ns per lookup (%ld), %s\n", methodNames[method],
+			NUM_LEVELS, buildTime * 1e3, lookupTime * 1e3, total, mismatches == 0 ? "levels ok" : "LEVELS DIFFER");
+		deleteSimplifyLevels(levels);
+	}
+
+	printf("%s\n", failed == 0 ? "ok" : "FAILED");
+	deleteGPXdoc(doc);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/*
+ * Command-line front end for GPX snapshots.
+ *
+ * Usage: SnapshotTool write file.gpx file.snap
+ *          parses file.gpx and writes its snapshot to file.snap
+ *        SnapshotTool read file.snap
+ *          loads a snapshot and prints its counts
+ *        SnapshotTool check file.gpx...
+ *          round-trip test: for each file, writes a snapshot in memory, loads it back and compares
+ *          GPXdocToString and the GPX XML and JSON output of the loaded document with the parsed one.
+ *          A truncated copy of every snapshot must be rejected.  Prints the parse and load times.
+ *
+ * Exits with 1 if any file fails.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "GPXSnapshot.h"
+#include "StringBuilder.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool builderWrite(void* userData, const char* data, size_t len){
+	return appendStringLen(userData, data, len);
+}
+
+static char* writeToMemory(const GPXdoc* doc, int format, size_t* len){
+	StringBuilder sb = {NULL, 0, 0};
+	GPXSink sink = {&sb, &builderWrite};
+	bool ok = format < 0 ? writeGPXSnapshot(doc, &sink) : writeGPXdoc(doc, format, &sink);
+
+	if (!ok){
+		free(sb.str);
+		return NULL;
+	}
+	*len = sb.len;
+	return sb.str;
+}
+
+static void printCounts(const char* fileName, const GPXdoc* doc){
+	printf("%s: waypoints=%d routes=%d tracks=%d segments=%d data=%d\n", fileName,
+		getNumWaypoints(doc), getNumRoutes(doc), getNumTracks(doc), getNumSegments(doc), getNumGPXData(doc));
+}
+
+static bool sameOutput(GPXdoc* parsed, GPXdoc* loaded){
+	char* first = GPXdocToString(parsed);
+	char* second = GPXdocToString(loaded);
+	bool same = first != NULL && second != NULL && strcmp(first, second) == 0;
+
+	free(first);
+	free(second);
+
+	for (int format = GPX_FORMAT_XML; same && format <= GPX_FORMAT_JSON; format++){
+		size_t firstLen = 0;
+		size_t secondLen = 0;
+
+		first = writeToMemory(parsed, format, &firstLen);
+		second = writeToMemory(loaded, format, &secondLen);
+		same = first != NULL && second != NULL && firstLen == secondLen && memcmp(first, second, firstLen) == 0;
+		free(first);
+		free(second);
+	}
+
+	return same && getNumSegments(parsed) == getNumSegments(loaded) && getNumGPXData(parsed) == getNumGPXData(loaded);
+}
+
+static bool checkFile(const char* fileName){
+	double start = now();
+	GPXdoc* parsed = createGPXdoc((char*)fileName);
+	double parseTime = now() - start;
+
+	if (parsed == NULL){
+		printf("%s: invalid GPX\n", fileName);
+		return false;
+	}
+
+	size_t size = 0;
+	char* snapshot = writeToMemory(parsed, -1, &size);
+	if (snapshot == NULL){
+		printf("%s: could not write the snapshot\n", fileName);
+		deleteGPXdoc(parsed);
+		return false;
+	}
+
+	start = now();
+	GPXdoc* loaded = loadGPXSnapshotFromMemory(snapshot, size);
+	double loadTime = now() - start;
+
+	GPXdoc* truncated = loadGPXSnapshotFromMemory(snapshot, size - 1);
+	bool ok = loaded != NULL && truncated == NULL && sameOutput(parsed, loaded);
+
+	printf("%s: %s, %zu byte snapshot, parse %.3f s, load %.3f s\n", fileName, ok ? "ok" : "MISMATCH", size, parseTime, loadTime);
+
+	deleteGPXdoc(truncated);
+	deleteGPXdoc(loaded);
+	deleteGPXdoc(parsed);
+	free(snapshot);
+	return ok;
+}
+
+int main(int argc, char** argv){
+	if (argc == 4 && strcmp(argv[1], "write") == 0){
+		GPXdoc* doc = createGPXdoc(argv[2]);
+		FILE* file = doc != NULL ? fopen(argv[3], "wb") : NULL;
+		bool ok = file != NULL && writeGPXSnapshotToFile(doc, file);
+
+		if (file != NULL && fclose(file) != 0){
+			ok = false;
+		}
+		if (!ok){
+			fprintf(stderr, "Could not write a snapshot of %s to %s\n", argv[2], argv[3]);
+		}
+		deleteGPXdoc(doc);
+		xmlCleanupParser();
+		return ok ? 0 : 1;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "read") == 0){
+		double start = now();
+		GPXdoc* doc = loadGPXSnapshot(argv[2]);
+		double elapsed = now() - start;
+
+		if (doc == NULL){
+			fprintf(stderr, "%s is not a valid snapshot\n", argv[2]);
+			return 1;
+		}
+		printCounts(argv[2], doc);
+		fprintf(stderr, "Loaded in %.3f s\n", elapsed);
+		deleteGPXdoc(doc);
+		return 0;
+	}
+
+	if (argc >= 3 && strcmp(argv[1], "check") == 0){
+		int failed = 0;
+
+		for (int i = 2; i < argc; i++){
+			failed += !checkFile(argv[i]);
+		}
+		xmlCleanupParser();
+		return failed == 0 ? 0 : 1;
+	}
+
+	fprintf(stderr, "Usage: %s write file.gpx file.snap | read file.snap | check file.gpx...\n", argv[0]);
+	return 2;
+}
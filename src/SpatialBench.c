@@ -0,0 +1,263 @@
+/*
+ * Equivalence test and benchmark for the spatial index and the parse-time bounds.
+ *
+ * Usage: SpatialBench [file.gpx]
+ *   Parses the file, or a generated document of 1000000 track points (random walks in several tracks,
+ *   plus routes and waypoints) if none is given.  Checks that the bounds the parser stored match a
+ *   recomputation, then runs random viewport (box) and radius queries through a GPXSpatialIndex and
+ *   through a scan of every list of the document, checks that both find the same points and reports
+ *   the time per query of each.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "GPXParser.h"
+#include "GPXSpatial.h"
+#include "GPXDistance.h"
+
+#define GENERATED_POINTS 1000000
+#define NUM_QUERIES 2000
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void){
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+//Uniform in [0, 1)
+static double nextUniform(void){
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void appendPoint(char** text, size_t* len, size_t* cap, const char* element, double lat, double lon){
+	if (*cap - *len < 128){
+		*cap *= 2;
+		*text = realloc(*text, *cap);
+	}
+	*len += snprintf(*text + *len, *cap - *len, "<%s lat=\"%.6f\" lon=\"%.6f\"/>\n", element, lat, lon);
+}
+
+//Builds a GPX document with GENERATED_POINTS track points in random walks over southern Ontario
+static GPXdoc* generateDocument(void){
+	size_t cap = 1 << 20;
+	size_t len = 0;
+	char* text = malloc(cap);
+
+	len += snprintf(text, cap, "<?xml version=\"1.0\"?>\n<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"SpatialBench\">\n");
+	for (int i = 0; i < 1000; i++){
+		appendPoint(&text, &len, &cap, "wpt", 42 + 4 * nextUniform(), -83 + 8 * nextUniform());
+	}
+	for (int r = 0; r < 10; r++){
+		len += snprintf(text + len, cap - len, "<rte>\n");
+		for (int i = 0; i < 100; i++){
+			appendPoint(&text, &len, &cap, "rtept", 42 + 4 * nextUniform(), -83 + 8 * nextUniform());
+		}
+		len += snprintf(text + len, cap - len, "</rte>\n");
+	}
+
+	int perTrack = GENERATED_POINTS / 20;
+	for (int t = 0; t < 20; t++){
+		double lat = 42 + 4 * nextUniform();
+		double lon = -83 + 8 * nextUniform();
+
+		len += snprintf(text + len, cap - len, "<trk><trkseg>\n");
+		for (int i = 0; i < perTrack; i++){
+			lat += (nextUniform() - 0.5) * 0.002;
+			lon += (nextUniform() - 0.5) * 0.002;
+			appendPoint(&text, &len, &cap, "trkpt", lat, lon);
+			if (i % 10000 == 9999){
+				len += snprintf(text + len, cap - len, "</trkseg><trkseg>\n");
+			}
+		}
+		len += snprintf(text + len, cap - len, "</trkseg></trk>\n");
+	}
+	len += snprintf(text + len, cap - len, "</gpx>\n");
+
+	GPXdoc* doc = createGPXdocFromMemory(text, len, GPX_OPT_ARENA);
+	free(text);
+	return doc;
+}
+
+//Number of routes and tracks whose stored bounds differ from a recomputation with updateGPXBounds
+static int checkBounds(GPXdoc* doc){
+	int numRoutes = getLength(doc->routes);
+	int numTracks = getLength(doc->tracks);
+	GPXBounds* saved = malloc(sizeof(GPXBounds) * (numRoutes + numTracks + 1));
+	ListIterator routes = createIterator(doc->routes);
+	ListIterator tracks = createIterator(doc->tracks);
+	Route* rte;
+	Track* trk;
+	int failed = 0;
+
+	for (int i = 0; (rte = nextElement(&routes)) != NULL; i++){
+		saved[i] = rte->bounds;
+	}
+	for (int i = numRoutes; (trk = nextElement(&tracks)) != NULL; i++){
+		saved[i] = trk->bounds;
+	}
+
+	updateGPXBounds(doc);
+	routes = createIterator(doc->routes);
+	tracks = createIterator(doc->tracks);
+	for (int i = 0; (rte = nextElement(&routes)) != NULL; i++){
+		failed += memcmp(&saved[i], &rte->bounds, sizeof(GPXBounds)) != 0;
+	}
+	for (int i = numRoutes; (trk = nextElement(&tracks)) != NULL; i++){
+		failed += memcmp(&saved[i], &trk->bounds, sizeof(GPXBounds)) != 0;
+	}
+	free(saved);
+	return failed;
+}
+
+//Linear reference: every point of the document checked against the box or circle
+typedef struct {
+	bool isRadius;
+	GPXBounds box;
+	double latitude;
+	double longitude;
+	double radius;
+	int count;
+	uint64_t checksum;
+} Scan;
+
+static bool inBox(const GPXBounds* box, double lat, double lon){
+	bool inLongitude = box->minLongitude <= box->maxLongitude ? lon >= box->minLongitude && lon <= box->maxLongitude
+	                                                          : lon >= box->minLongitude || lon <= box->maxLongitude;
+	return lat >= box->minLatitude && lat <= box->maxLatitude && inLongitude;
+}
+
+static uint64_t pointHash(const Waypoint* wpt){
+	uint64_t h = (uintptr_t)wpt;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	return h ^ (h >> 33);
+}
+
+static void scanList(Scan* scan, List* waypoints){
+	ListIterator iter = createIterator(waypoints);
+	Waypoint* wpt;
+
+	while ((wpt = nextElement(&iter)) != NULL){
+		bool match = scan->isRadius
+			? haversineDistance(scan->latitude, scan->longitude, wpt->latitude, wpt->longitude) <= scan->radius
+			: inBox(&scan->box, wpt->latitude, wpt->longitude);
+		if (match){
+			scan->count++;
+			scan->checksum += pointHash(wpt);
+		}
+	}
+}
+
+static void scanDocument(Scan* scan, const GPXdoc* doc){
+	scanList(scan, doc->waypoints);
+
+	ListIterator iter = createIterator(doc->routes);
+	Route* rte;
+	while ((rte = nextElement(&iter)) != NULL){
+		scanList(scan, rte->waypoints);
+	}
+
+	iter = createIterator(doc->tracks);
+	Track* trk;
+	while ((trk = nextElement(&iter)) != NULL){
+		ListIterator segIter = createIterator(trk->segments);
+		TrackSegment* seg;
+
+		while ((seg = nextElement(&segIter)) != NULL){
+			scanList(scan, seg->waypoints);
+		}
+	}
+}
+
+static bool addToChecksum(void* userData, const GPXPointRef* point){
+	*(uint64_t*)userData += pointHash(point->wpt);
+	return true;
+}
+
+int main(int argc, char** argv){
+	double begin = now();
+	GPXdoc* doc = argc > 1 ? createGPXdocWithOptions(argv[1], GPX_OPT_ARENA) : generateDocument();
+	double parseTime = now() - begin;
+
+	if (doc == NULL){
+		fprintf(stderr, "Could not parse %s\n", argc > 1 ? argv[1] : "the generated document");
+		return 1;
+	}
+
+	int failed = checkBounds(doc);
+	GPXBounds extent;
+	getGPXdocBounds(doc, &extent);
+
+	begin = now();
+	GPXSpatialIndex* index = createSpatialIndex(doc);
+	double buildTime = now() - begin;
+	if (index == NULL){
+		fprintf(stderr, "Could not build the index\n");
+		return 1;
+	}
+
+	printf("%d points, parsed in %.2f s, index built in %.3f s, %.1f MB\n", getSpatialIndexCount(index), parseTime,
+		buildTime, getSpatialIndexSize(index) / 1048576.0);
+	printf("bounds: lat %.6f to %.6f, lon %.6f to %.6f, %s\n", extent.minLatitude, extent.maxLatitude,
+		extent.minLongitude, extent.maxLongitude, failed == 0 ? "ok" : "FAILED");
+
+	double height = extent.maxLatitude - extent.minLatitude;
+	double width = extent.maxLongitude - extent.minLongitude;
+	double indexTime[2] = {0, 0};
+	double scanTime[2] = {0, 0};
+	long found[2] = {0, 0};
+
+	for (int i = 0; i < NUM_QUERIES; i++){
+		bool isRadius = i % 2 == 1;
+		double size = 0.002 + 0.05 * nextUniform();
+		Scan scan = {isRadius, {0, 0, 0, 0}, 0, 0, 0, 0, 0};
+		uint64_t checksum = 0;
+		int count;
+
+		scan.latitude = extent.minLatitude + height * nextUniform();
+		scan.longitude = extent.minLongitude + width * nextUniform();
+		scan.radius = size * height * 111000;
+		scan.box = (GPXBounds){scan.latitude, scan.longitude, scan.latitude + size * height, scan.longitude + size * width};
+
+		begin = now();
+		count = isRadius ? queryRadius(index, scan.latitude, scan.longitude, scan.radius, &addToChecksum, &checksum)
+		                 : queryBox(index, &scan.box, &addToChecksum, &checksum);
+		indexTime[isRadius] += now() - begin;
+
+		begin = now();
+		scanDocument(&scan, doc);
+		scanTime[isRadius] += now() - begin;
+
+		found[isRadius] += count;
+		if (count != scan.count || checksum != scan.checksum){
+			printf("Mismatch on query %d: index %d points, scan %d points\n", i, count, scan.count);
+			failed++;
+		}
+	}
+
+	const char* names[2] = {"box", "radius"};
+	for (int k = 0; k < 2; k++){
+		int queries = NUM_QUERIES / 2;
+		printf("%-6s %6.1f points/query  index %9.1f us/query  scan %9.1f us/query  (%.0fx)\n", names[k],
+			(double)found[k] / queries, indexTime[k] * 1e6 / queries, scanTime[k] * 1e6 / queries, scanTime[k] / indexTime[k]);
+	}
+	printf("%d queries: %s\n", NUM_QUERIES, failed == 0 ? "ok" : "FAILED");
+
+	deleteSpatialIndex(index);
+	deleteGPXdoc(doc);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+ * Benchmark of the streaming constructor against the DOM one.
+ *
+ * Usage: StreamBench [-cache] file.gpx [runs]
+ *
+ * createGPXdoc, which builds the libxml2 tree first, createGPXdocStreaming, which reads the file
+ * with an xmlTextReader, and the streaming parse with GPX_OPT_SHARED_NAMES each parse the file runs
+ * times (default 3) in a child process of its own, so that the peak resident set size the kernel
+ * reports for the child (ru_maxrss) belongs to that constructor alone.  Prints the best time, the
+ * throughput in MB/s and the peak RSS of each, then checks in another child that all the documents
+ * print the same with GPXdocToString.
+ *
+ * With -cache, createGPXdocWithOptions reads the file through stdio buffers, with GPX_OPT_MMAP, and with
+ * GPX_OPT_ARENA and GPX_OPT_MMAP, each runs times with a cold page cache and runs times with a warm one.
+ * Before a cold run the file's pages are dropped from the cache with posix_fadvise(POSIX_FADV_DONTNEED);
+ * a warm run follows a parse of the same file.  Prints the fastest and slowest run of each.
+ *
+ * Exits with 1 if a parse fails or the documents differ.
+ */
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "GPXParser.h"
+
+#define DEFAULT_RUNS 3
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static GPXdoc* createSharedNames(char* fileName){
+	return createGPXdocWithOptions(fileName, GPX_OPT_SHARED_NAMES);
+}
+
+typedef struct {
+	const char* name;
+	GPXdoc* (*create)(char* fileName);
+} Constructor;
+
+static const Constructor constructors[] = {
+	{"createGPXdoc", &createGPXdoc},
+	{"createGPXdocStreaming", &createGPXdocStreaming},
+	{"GPX_OPT_SHARED_NAMES", &createSharedNames},
+};
+
+#define NUM_CONSTRUCTORS (sizeof(constructors) / sizeof(constructors[0]))
+
+//Runs the constructor in a child.  Returns the best time in seconds, or a negative value if a parse failed
+static double runChild(const Constructor* constructor, char* fileName, int runs, long* maxRSS){
+	int fds[2];
+	double best = -1;
+
+	if (pipe(fds) != 0){
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0){
+		close(fds[0]);
+		for (int i = 0; i < runs; i++){
+			double start = now();
+			GPXdoc* doc = constructor->create(fileName);
+			double elapsed = now() - start;
+
+			if (doc == NULL){
+				elapsed = -1;
+			}
+			if (elapsed < 0 || best < 0 || elapsed < best){
+				best = elapsed;
+			}
+			deleteGPXdoc(doc);
+			if (best < 0){
+				break;
+			}
+		}
+		_exit(write(fds[1], &best, sizeof(best)) == sizeof(best) ? 0 : 1);
+	}
+
+	close(fds[1]);
+	if (pid < 0 || read(fds[0], &best, sizeof(best)) != sizeof(best)){
+		best = -1;
+	}
+	close(fds[0]);
+
+	int status;
+	struct rusage usage;
+	if (pid > 0 && wait4(pid, &status, 0, &usage) == pid){
+		//Kilobytes on Linux
+		*maxRSS = usage.ru_maxrss;
+	}
+	return best;
+}
+
+//Checks in a child that all the constructors print the same document as the first
+static bool sameDocuments(char* fileName){
+	pid_t pid = fork();
+
+	if (pid == 0){
+		GPXdoc* first = constructors[0].create(fileName);
+		char* firstText = first != NULL ? GPXdocToString(first) : NULL;
+		bool same = firstText != NULL;
+
+		for (size_t i = 1; same && i < NUM_CONSTRUCTORS; i++){
+			GPXdoc* doc = constructors[i].create(fileName);
+			char* text = doc != NULL ? GPXdocToString(doc) : NULL;
+
+			same = text != NULL && strcmp(firstText, text) == 0;
+			free(text);
+			deleteGPXdoc(doc);
+		}
+		_exit(same ? 0 : 1);
+	}
+
+	int status;
+	return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* ******************************* Cold and warm cache *************************** */
+
+typedef struct {
+	const char* name;
+	unsigned int options;
+} InputPath;
+
+static const InputPath inputPaths[] = {
+	{"stdio", 0},
+	{"mmap", GPX_OPT_MMAP},
+	{"arena + mmap", GPX_OPT_ARENA | GPX_OPT_MMAP},
+};
+
+#define NUM_INPUT_PATHS (sizeof(inputPaths) / sizeof(inputPaths[0]))
+
+//Drops the pages of the file from the page cache, so that the next read comes from the disk
+static bool evict(const char* fileName){
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd < 0){
+		return false;
+	}
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return ok;
+}
+
+//Parses the file runs times, evicting it first when cold is set.  Returns false if a parse fails
+static bool timeInputPath(const InputPath* path, char* fileName, int runs, bool cold, double* fastest, double* slowest){
+	for (int i = 0; i < runs; i++){
+		if (cold && !evict(fileName)){
+			return false;
+		}
+
+		double start = now();
+		GPXdoc* doc = createGPXdocWithOptions(fileName, path->options);
+		double elapsed = now() - start;
+
+		if (doc == NULL){
+			return false;
+		}
+		deleteGPXdoc(doc);
+		if (i == 0 || elapsed < *fastest){
+			*fastest = elapsed;
+		}
+		if (i == 0 || elapsed > *slowest){
+			*slowest = elapsed;
+		}
+	}
+	return true;
+}
+
+static bool benchCache(char* fileName, double megabytes, int runs){
+	printf("%s: %.1f MB, %d runs each\n", fileName, megabytes, runs);
+	for (size_t i = 0; i < NUM_INPUT_PATHS; i++){
+		double coldFastest = 0, coldSlowest = 0, warmFastest = 0, warmSlowest = 0;
+
+		//The last cold run leaves the file in the cache for the warm ones
+		if (!timeInputPath(&inputPaths[i], fileName, runs, true, &coldFastest, &coldSlowest) ||
+		    !timeInputPath(&inputPaths[i], fileName, runs, false, &warmFastest, &warmSlowest)){
+			printf("  %-14s failed\n", inputPaths[i].name);
+			return false;
+		}
+		printf("  %-14s cold %8.1f - %8.1f ms   warm %8.1f - %8.1f ms\n", inputPaths[i].name, coldFastest * 1000,
+		       coldSlowest * 1000, warmFastest * 1000, warmSlowest * 1000);
+	}
+	return true;
+}
+
+int main(int argc, char** argv){
+	bool cache = argc > 1 && strcmp(argv[1], "-cache") == 0;
+	int first = cache ? 2 : 1;
+
+	if (argc <= first){
+		fprintf(stderr, "Usage: %s [-cache] file.gpx [runs]\n", argv[0]);
+		return 1;
+	}
+
+	char* fileName = argv[first];
+	int runs = argc > first + 1 ? atoi(argv[first + 1]) : DEFAULT_RUNS;
+	struct stat info;
+
+	if (stat(fileName, &info) != 0 || runs < 1){
+		fprintf(stderr, "Cannot read %s\n", fileName);
+		return 1;
+	}
+
+	double megabytes = info.st_size / (1024.0 * 1024.0);
+
+	if (cache){
+		bool ok = benchCache(fileName, megabytes, runs);
+
+		printf("%s\n", ok ? "ok" : "FAILED");
+		return ok ? 0 : 1;
+	}
+
+	bool ok = true;
+
+	printf("%s: %.1f MB, best of %d\n", fileName, megabytes, runs);
+	for (size_t i = 0; i < NUM_CONSTRUCTORS; i++){
+		long maxRSS = 0;
+		double best = runChild(&constructors[i], fileName, runs, &maxRSS);
+
+		if (best < 0){
+			printf("  %-22s failed\n", constructors[i].name);
+			ok = false;
+			continue;
+		}
+		printf("  %-22s %8.1f ms  %7.1f MB/s   peak RSS %7.1f MB\n", constructors[i].name, best * 1000,
+		       best > 0 ? megabytes / best : 0, maxRSS / 1024.0);
+	}
+
+	if (ok && !sameDocuments(fileName)){
+		printf("  documents differ\n");
+		ok = false;
+	}
+
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
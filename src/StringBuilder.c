@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "StringBuilder.h"
+
+#define MIN_CAPACITY 64
+
+//Makes room for extra more characters plus the terminator
+static bool reserve(StringBuilder* sb, size_t extra){
+    if (sb->len + extra + 1 <= sb->cap){
+        return true;
+    }
+
+    size_t cap = sb->cap == 0 ? MIN_CAPACITY : sb->cap;
+    while (sb->len + extra + 1 > cap){
+        cap *= 2;
+    }
+
+    char* tmp = realloc(sb->str, cap);
+    if (tmp == NULL){
+        return false;
+    }
+    sb->str = tmp;
+    sb->cap = cap;
+    return true;
+}
+
+bool appendStringLen(StringBuilder* sb, const char* str, size_t len){
+    if (!reserve(sb, len)){
+        return false;
+    }
+
+    memcpy(sb->str + sb->len, str, len);
+    sb->len += len;
+    sb->str[sb->len] = '\0';
+    return true;
+}
+
+bool appendString(StringBuilder* sb, const char* str){
+    return appendStringLen(sb, str, strlen(str));
+}
+
+bool appendFormat(StringBuilder* sb, const char* format, ...){
+    //Try to format into the space that is already there, and grow only if it does not fit
+    if (!reserve(sb, 0)){
+        return false;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(sb->str + sb->len, sb->cap - sb->len, format, args);
+    va_end(args);
+
+    if (len < 0){
+        sb->str[sb->len] = '\0';
+        return false;
+    }
+    if ((size_t)len >= sb->cap - sb->len){
+        if (!reserve(sb, len)){
+            sb->str[sb->len] = '\0';
+            return false;
+        }
+
+        va_start(args, format);
+        vsnprintf(sb->str + sb->len, sb->cap - sb->len, format, args);
+        va_end(args);
+    }
+
+    sb->len += len;
+    return true;
+}
@@ -0,0 +1,295 @@
+/*
+ * Benchmark and format check for the tile pyramid writer.
+ *
+ * Usage: TileBench [-j threads] [-z maxZoom] [-s] file.gpx directory
+ *   -j  number of worker threads (default: one per online processor)
+ *   -z  largest zoom level to write (default 14)
+ *   -s  also write the pyramid with one thread and report the speedup
+ *
+ * Parses the file, writes its tiles to directory with writeGPXTiles and reports tiles per second.  Then
+ * reads every tile back and checks that it is well formed, that its header matches its path, that no
+ * coordinate is outside the buffered tile, that the totals match the returned GPXTileStats and that
+ * every waypoint is found in exactly one tile (not counting buffers) at every zoom.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "GPXParser.h"
+#include "GPXTiles.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+	const unsigned char* data;
+	size_t length;
+	size_t offset;
+	bool failed;
+} Reader;
+
+static uint64_t readVarint(Reader* r){
+	uint64_t value = 0;
+
+	for (int shift = 0; shift < 64; shift += 7){
+		if (r->offset >= r->length){
+			break;
+		}
+		unsigned char byte = r->data[r->offset++];
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0){
+			return value;
+		}
+	}
+	r->failed = true;
+	return 0;
+}
+
+static int64_t readSigned(Reader* r){
+	uint64_t value = readVarint(r);
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//Totals over every tile read back
+typedef struct {
+	const GPXTileOptions* options;
+	GPXTileStats stats;
+	//Waypoints inside the unbuffered tile, per zoom
+	long long homeWaypoints[GPX_TILE_MAX_ZOOM + 1];
+	int failed;
+} Check;
+
+static void checkTile(Check* check, const char* path, int zoom, long x, long y){
+	FILE* file = fopen(path, "rb");
+	unsigned char* data = NULL;
+	long length = -1;
+
+	if (file != NULL && fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0){
+		data = malloc(length);
+		if (data != NULL && fread(data, 1, length, file) != (size_t)length){
+			length = -1;
+		}
+	}
+	if (file != NULL){
+		fclose(file);
+	}
+	if (data == NULL || length < 4 || memcmp(data, "GPXT", 4) != 0){
+		printf("%s: unreadable or not a tile\n", path);
+		check->failed++;
+		free(data);
+		return;
+	}
+
+	Reader r = {data, length, 4, false};
+	int64_t extent = check->options->extent;
+	int64_t buffer = check->options->buffer;
+	uint64_t version = readVarint(&r);
+	uint64_t z = readVarint(&r);
+	uint64_t tx = readVarint(&r);
+	uint64_t ty = readVarint(&r);
+	uint64_t tileExtent = readVarint(&r);
+	uint64_t numFeatures = readVarint(&r);
+	bool ok = version == GPX_TILE_VERSION && z == (uint64_t)zoom && tx == (uint64_t)x && ty == (uint64_t)y &&
+	          tileExtent == (uint64_t)extent && numFeatures > 0;
+
+	for (uint64_t f = 0; ok && f < numFeatures && !r.failed; f++){
+		uint64_t kind = readVarint(&r);
+		readVarint(&r);
+		readVarint(&r);
+		uint64_t nameLength = readVarint(&r);
+		if (nameLength > r.length - r.offset){
+			ok = false;
+			break;
+		}
+		r.offset += nameLength;
+
+		uint64_t numParts = readVarint(&r);
+		int64_t px = 0;
+		int64_t py = 0;
+		ok = kind <= GPX_TILE_TRACK && numParts > 0 && (kind != GPX_TILE_WAYPOINT || numParts == 1);
+		for (uint64_t part = 0; ok && part < numParts && !r.failed; part++){
+			uint64_t numPoints = readVarint(&r);
+
+			ok = kind == GPX_TILE_WAYPOINT ? numPoints == 1 : numPoints >= 2;
+			for (uint64_t i = 0; ok && i < numPoints && !r.failed; i++){
+				px += readSigned(&r);
+				py += readSigned(&r);
+				ok = px >= -buffer && py >= -buffer && px <= extent + buffer && py <= extent + buffer;
+			}
+			check->stats.numPoints += numPoints;
+			if (kind == GPX_TILE_WAYPOINT && px >= 0 && py >= 0 && px < extent && py < extent){
+				check->homeWaypoints[zoom]++;
+			}
+		}
+	}
+	if (!ok || r.failed || r.offset != r.length){
+		printf("%s: malformed tile\n", path);
+		check->failed++;
+	}
+
+	check->stats.numTiles++;
+	check->stats.numFeatures += numFeatures;
+	check->stats.numBytes += length;
+	free(data);
+}
+
+//Calls visit with the number in every entry name of a directory that is a whole number
+static void forEachNumber(const char* directory, void (*visit)(void* userData, const char* path, long number), void* userData){
+	DIR* dir = opendir(directory);
+	struct dirent* entry;
+
+	while (dir != NULL && (entry = readdir(dir)) != NULL){
+		char* end;
+		long number = strtol(entry->d_name, &end, 10);
+		char path[4096];
+
+		if (end != entry->d_name && (*end == '\0' || strcmp(end, ".gpxt") == 0)){
+			snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+			visit(userData, path, number);
+		}
+	}
+	if (dir != NULL){
+		closedir(dir);
+	}
+}
+
+typedef struct {
+	Check* check;
+	int zoom;
+	long x;
+} Walk;
+
+static void visitTile(void* userData, const char* path, long y){
+	Walk* walk = userData;
+	checkTile(walk->check, path, walk->zoom, walk->x, y);
+}
+
+static void visitColumn(void* userData, const char* path, long x){
+	Walk walk = *(Walk*)userData;
+	walk.x = x;
+	forEachNumber(path, &visitTile, &walk);
+}
+
+static void visitZoom(void* userData, const char* path, long zoom){
+	Walk walk = {userData, (int)zoom, 0};
+	if (zoom >= 0 && zoom <= GPX_TILE_MAX_ZOOM){
+		forEachNumber(path, &visitColumn, &walk);
+	}
+}
+
+static long long countFiniteWaypoints(const GPXdoc* doc){
+	ListIterator iter = createIterator(doc->waypoints);
+	Waypoint* wpt;
+	long long count = 0;
+
+	while ((wpt = nextElement(&iter)) != NULL){
+		//Points on the south edge of the map or on longitude 180 are on the far edge of their tiles
+		count += isfinite(wpt->latitude) && wpt->latitude > -85.0511 && wpt->longitude < 180;
+	}
+	return count;
+}
+
+int main(int argc, char** argv){
+	GPXTileOptions options;
+	bool scaling = false;
+	int opt;
+
+	initGPXTileOptions(&options);
+	while ((opt = getopt(argc, argv, "j:z:s")) != -1){
+		switch (opt){
+			case 'j':
+				options.numThreads = atoi(optarg);
+				break;
+			case 'z':
+				options.maxZoom = atoi(optarg);
+				break;
+			case 's':
+				scaling = true;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-j threads] [-z maxZoom] [-s] file.gpx directory\n", argv[0]);
+				return 1;
+		}
+	}
+	if (argc - optind != 2){
+		fprintf(stderr, "Usage: %s [-j threads] [-z maxZoom] [-s] file.gpx directory\n", argv[0]);
+		return 1;
+	}
+
+	double begin = now();
+	GPXdoc* doc = createGPXdocWithOptions(argv[optind], GPX_OPT_ARENA);
+	double parseTime = now() - begin;
+	if (doc == NULL){
+		fprintf(stderr, "Could not parse %s\n", argv[optind]);
+		return 1;
+	}
+	printf("%s: %d waypoints, %d routes, %d tracks, %d segments, parsed in %.2f s\n", argv[optind],
+		getNumWaypoints(doc), getNumRoutes(doc), getNumTracks(doc), getNumSegments(doc), parseTime);
+
+	const char* directory = argv[optind + 1];
+	GPXTileStats stats;
+	double serialTime = 0;
+
+	if (scaling){
+		GPXTileOptions serial = options;
+		serial.numThreads = 1;
+		begin = now();
+		if (!writeGPXTiles(doc, directory, &serial, &stats)){
+			fprintf(stderr, "Could not write the tiles to %s\n", directory);
+			return 1;
+		}
+		serialTime = now() - begin;
+	}
+
+	begin = now();
+	if (!writeGPXTiles(doc, directory, &options, &stats)){
+		fprintf(stderr, "Could not write the tiles to %s\n", directory);
+		return 1;
+	}
+	double tileTime = now() - begin;
+
+	printf("zoom %d to %d: %lld tiles, %lld features, %lld points, %.1f MB in %.2f s: %.0f tiles/s\n", options.minZoom,
+		options.maxZoom, stats.numTiles, stats.numFeatures, stats.numPoints, stats.numBytes / 1048576.0, tileTime,
+		stats.numTiles / tileTime);
+	if (scaling){
+		printf("1 thread: %.2f s, %.0f tiles/s (%.1fx)\n", serialTime, stats.numTiles / serialTime, serialTime / tileTime);
+	}
+
+	//Tiles left in the directory by earlier runs at other zoom levels are not counted
+	Check check;
+	memset(&check, 0, sizeof(Check));
+	check.options = &options;
+	for (int z = options.minZoom; z <= options.maxZoom; z++){
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/%d", directory, z);
+		visitZoom(&check, path, z);
+	}
+
+	if (check.stats.numTiles != stats.numTiles || check.stats.numFeatures != stats.numFeatures ||
+	    check.stats.numPoints != stats.numPoints || check.stats.numBytes != stats.numBytes){
+		printf("Tiles read back: %lld tiles, %lld features, %lld points, %lld bytes - totals differ\n", check.stats.numTiles,
+			check.stats.numFeatures, check.stats.numPoints, check.stats.numBytes);
+		check.failed++;
+	}
+
+	long long numWaypoints = countFiniteWaypoints(doc);
+	for (int z = options.minZoom; z <= options.maxZoom; z++){
+		if (check.homeWaypoints[z] != numWaypoints){
+			printf("zoom %d: %lld of %lld waypoints found\n", z, check.homeWaypoints[z], numWaypoints);
+			check.failed++;
+		}
+	}
+
+	printf("%s\n", check.failed == 0 ? "ok" : "FAILED");
+	deleteGPXdoc(doc);
+	return check.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*
+ * Equivalence test and benchmark for parseGPXTime, the ISO-8601 decoder behind Waypoint.time.
+ *
+ * Usage: TimeBench [cases]
+ *   Checks parseGPXTime on the given number of random timestamps (default 1000000) between 1900 and
+ *   2100, written with and without fractional seconds and UTC offsets, against strptime and mktime
+ *   (run with TZ=UTC, so mktime converts UTC), plus a list of edge cases and malformed values.  Then
+ *   times both on typical GPX track point times.
+ *
+ * Exits with 1 on any difference.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "GPXHelpers.h"
+
+#define BENCH_VALUES 1000000
+#define BENCH_ROUNDS 5
+
+typedef struct {
+	const char* text;
+	long long expected;
+	bool valid;
+} EdgeCase;
+
+static const EdgeCase edgeCases[] = {
+	{"1970-01-01T00:00:00Z", 0, true},
+	{"1970-01-01T00:00:00", 0, true},
+	{" 1970-01-01T00:00:00.0005Z\n", 1, true},
+	{"1969-12-31T23:59:59.999Z", -1, true},
+	{"2000-02-29T12:00:00Z", 951825600000LL, true},
+	{"2020-09-13T12:26:40.5Z", 1600000000500LL, true},
+	{"2020-09-13T14:26:40+02:00", 1600000000000LL, true},
+	{"2020-09-13T07:56:40-0430", 1600000000000LL, true},
+	{"2020-09-13T17:26:40+05", 1600000000000LL, true},
+	{"2020-09-13t12:26:40z", 1600000000000LL, true},
+	{"2020-09-13T12:26:40,25Z", 1600000000250LL, true},
+	{"2016-12-31T23:59:60Z", 1483228800000LL, true},
+	{"2020-09-13T12:26:59.9996Z", 1600000020000LL, true},
+	{"1900-02-29T00:00:00Z", 0, false},
+	{"2021-02-29T00:00:00Z", 0, false},
+	{"2020-04-31T00:00:00Z", 0, false},
+	{"2020-13-01T00:00:00Z", 0, false},
+	{"2020-09-13T24:00:00Z", 0, false},
+	{"2020-09-13T12:60:00Z", 0, false},
+	{"2020-09-13T12:26:61Z", 0, false},
+	{"2020-09-13 12:26:40Z", 0, false},
+	{"2020-9-13T12:26:40Z", 0, false},
+	{"2020-09-13T12:26Z", 0, false},
+	{"2020-09-13T12:26:40.Z", 0, false},
+	{"2020-09-13T12:26:40+2:00", 0, false},
+	{"2020-09-13T12:26:40+02:60", 0, false},
+	{"2020-09-13T12:26:40ZZ", 0, false},
+	{"2020-09-13", 0, false},
+	{"", 0, false},
+	{"garbage", 0, false}
+};
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void){
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+//Reference decoding: strptime and mktime for the date and time, then the fraction and offset by hand
+static bool referenceTime(const char* str, int millis, int offset, long long* result){
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+
+	if (strptime(str, "%Y-%m-%dT%H:%M:%S", &tm) == NULL){
+		return false;
+	}
+	tm.tm_isdst = 0;
+	time_t seconds = mktime(&tm);
+
+	*result = (long long)seconds * 1000 + millis - offset * 60000LL;
+	return true;
+}
+
+//Writes a random timestamp to buf and its expected value to expected
+static bool generateCase(char* buf, size_t size, long long* expected){
+	time_t seconds = (time_t)(nextRandom() % (200LL * 365 * 86400)) - 70LL * 365 * 86400;
+	struct tm tm;
+	gmtime_r(&seconds, &tm);
+
+	int millis = 0;
+	int offset = 0;
+	char fraction[8] = "";
+	char zone[8] = "Z";
+
+	switch (nextRandom() % 3){
+		case 1:
+			millis = nextRandom() % 1000;
+			snprintf(fraction, sizeof(fraction), ".%03d", millis);
+			break;
+		case 2:
+			millis = (nextRandom() % 10) * 100;
+			snprintf(fraction, sizeof(fraction), ".%d", millis / 100);
+			break;
+	}
+	if (nextRandom() % 2){
+		offset = (int)(nextRandom() % (14 * 60 * 2 + 1)) - 14 * 60;
+		snprintf(zone, sizeof(zone), "%c%02d:%02d", offset < 0 ? '-' : '+', abs(offset) / 60, abs(offset) % 60);
+	}
+
+	size_t len = strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+	if (!referenceTime(buf, millis, offset, expected)){
+		return false;
+	}
+	snprintf(buf + len, size - len, "%s%s", fraction, zone);
+	return true;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchmark(void){
+	char (*values)[32] = malloc(BENCH_VALUES * sizeof(*values));
+	if (values == NULL){
+		return;
+	}
+
+	time_t start = 1600000000;
+	for (int i = 0; i < BENCH_VALUES; i++){
+		time_t seconds = start + i;
+		struct tm tm;
+		gmtime_r(&seconds, &tm);
+		strftime(values[i], sizeof(values[i]), "%Y-%m-%dT%H:%M:%SZ", &tm);
+	}
+
+	double best[2] = {1e9, 1e9};
+	volatile long long sink = 0;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++){
+		double begin = now();
+		for (int i = 0; i < BENCH_VALUES; i++){
+			struct tm tm;
+			memset(&tm, 0, sizeof(tm));
+			strptime(values[i], "%Y-%m-%dT%H:%M:%S", &tm);
+			sink += mktime(&tm);
+		}
+		double elapsed = now() - begin;
+		best[0] = elapsed < best[0] ? elapsed : best[0];
+
+		begin = now();
+		for (int i = 0; i < BENCH_VALUES; i++){
+			long long value = 0;
+			parseGPXTime(values[i], &value);
+			sink += value;
+		}
+		elapsed = now() - begin;
+		best[1] = elapsed < best[1] ? elapsed : best[1];
+	}
+
+	printf("%-16s %8.1f ns/value\n", "strptime+mktime", best[0] * 1e9 / BENCH_VALUES);
+	printf("%-16s %8.1f ns/value  (%.1fx)\n", "parseGPXTime", best[1] * 1e9 / BENCH_VALUES, best[0] / best[1]);
+	free(values);
+}
+
+int main(int argc, char** argv){
+	long cases = argc > 1 ? atol(argv[1]) : 1000000;
+	int failed = 0;
+
+	setenv("TZ", "UTC", 1);
+	tzset();
+
+	for (size_t i = 0; i < sizeof(edgeCases) / sizeof(edgeCases[0]); i++){
+		long long value = 0;
+		bool ok = parseGPXTime(edgeCases[i].text, &value);
+
+		if (ok != edgeCases[i].valid || (ok && value != edgeCases[i].expected)){
+			printf("Mismatch on \"%s\": expected %s %lld, got %s %lld\n", edgeCases[i].text,
+				edgeCases[i].valid ? "valid" : "invalid", edgeCases[i].expected, ok ? "valid" : "invalid", value);
+			failed++;
+		}
+	}
+
+	char buf[64];
+	for (long i = 0; i < cases && failed < 20; i++){
+		long long expected;
+		long long value = 0;
+
+		if (!generateCase(buf, sizeof(buf), &expected)){
+			continue;
+		}
+		if (!parseGPXTime(buf, &value) || value != expected){
+			printf("Mismatch on \"%s\": expected %lld, got %lld\n", buf, expected, value);
+			failed++;
+		}
+	}
+	printf("%ld generated cases: %s\n", cases, failed == 0 ? "ok" : "FAILED");
+
+	benchmark();
+	return failed == 0 ? 0 : 1;
+}
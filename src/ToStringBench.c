@@ -0,0 +1,58 @@
+/*
+ * Times trackToString on single-segment tracks of 1k to 1M points.  Each point has one GPXData element.
+ * With linear-time printing the time per point stays flat as the track grows.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <time.h>
+#include "GPXParser.h"
+
+static Track* makeTrack(int numPoints){
+	Track* trk = malloc(sizeof(Track));
+	TrackSegment* seg = malloc(sizeof(TrackSegment));
+
+	trk->name = malloc(6);
+	strcpy(trk->name, "bench");
+	trk->segments = initializeList(&trackSegmentToString, &deleteTrackSegment, &compareTrackSegments);
+	trk->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+	seg->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
+	insertBack(trk->segments, seg);
+
+	for (int i = 0; i < numPoints; i++){
+		Waypoint* wpt = malloc(sizeof(Waypoint));
+		GPXData* ele = malloc(sizeof(GPXData) + 16);
+
+		wpt->name = malloc(1);
+		wpt->name[0] = '\0';
+		wpt->latitude = 43.5 + i * 1e-6;
+		wpt->longitude = -80.2 - i * 1e-6;
+		wpt->time = GPX_NO_TIME;
+		wpt->fields = 0;
+		wpt->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+		strcpy(ele->name, "ele");
+		snprintf(ele->value, 16, "%d", 300 + i % 100);
+		insertBack(wpt->otherData, ele);
+		insertBack(seg->waypoints, wpt);
+	}
+	return trk;
+}
+
+int main(void){
+	printf("%10s %12s %10s %14s\n", "points", "bytes", "seconds", "ns per point");
+
+	for (int numPoints = 1000; numPoints <= 1000000; numPoints *= 10){
+		Track* trk = makeTrack(numPoints);
+		struct timespec start, end;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		char* str = trackToString(trk);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%10d %12zu %10.4f %14.1f\n", numPoints, strlen(str), seconds, seconds * 1e9 / numPoints);
+
+		free(str);
+		deleteTrack(trk);
+	}
+	return 0;
+}